@@ -18,6 +18,23 @@
 #define GPS_RX_PIN 4
 #define GPS_TX_PIN 5
 
+// GPS time pulse (PPS) input. With a pin set, packet timestamps come from a
+// clock disciplined to the PPS edges instead of the GPS-synced system clock.
+// -1 disables PPS.
+#ifndef PPS_PIN
+#define PPS_PIN -1
+#endif
+
+// Keep using the PPS clock this long after the last edge (ms)
+#ifndef PPS_HOLDOVER_MS
+#define PPS_HOLDOVER_MS 10000
+#endif
+
+// PPS offsets beyond this are treated as glitches, then stepped if they persist (us)
+#ifndef PPS_STEP_THRESHOLD_US
+#define PPS_STEP_THRESHOLD_US 1000
+#endif
+
 // Test packet configuration
 #ifndef PACKET_SIZE
 #define PACKET_SIZE 75 // Default packet size in bytes (simulating MAVLink telemetry)
@@ -27,9 +44,305 @@
 #define PACKET_RATE 10 // Default packet sending rate in Hz
 #endif
 
+// Largest payload the serial console can select at runtime (bytes). Sizes the
+// send buffers; ESP-NOW frames are further limited to 250 bytes with the header.
+#ifndef MAX_PACKET_SIZE
+#define MAX_PACKET_SIZE 1024
+#endif
+
+// Protocol sweep: both ends rotate through ESP-NOW, Wi-Fi 4, Wi-Fi 6 and
+// Wi-Fi LR, switching together every SWEEP_SLOT_S seconds on UTC second
+// boundaries from GPS time. 0 runs the selected protocol only.
+#ifndef SWEEP_SLOT_S
+#define SWEEP_SLOT_S 0
+#endif
+
+// Aggregation: the sender packs up to AGGREGATE_RECORDS test packets into one
+// frame, each with its own sequence number and timestamp, and sends a partly
+// filled frame AGGREGATE_FLUSH_MS after its first packet. 1 sends every
+// packet in its own frame. Echo requests are always sent alone.
+#ifndef AGGREGATE_RECORDS
+#define AGGREGATE_RECORDS 1
+#endif
+
+#ifndef AGGREGATE_FLUSH_MS
+#define AGGREGATE_FLUSH_MS 20
+#endif
+
+// ESP-NOW flow control: the sender holds packets while TX_WINDOW frames
+// await the driver's send callback, so the test measures the link rather
+// than the driver queue overflowing. 0 sends on schedule regardless.
+#ifndef TX_WINDOW
+#define TX_WINDOW 0
+#endif
+
+// ESP-NOW peer: broadcast frames are never acknowledged or retried. With
+// unicast the receiver advertises itself every DISCOVERY_INTERVAL_MS and
+// each sender sends to the first receiver it hears, with MAC ACKs and retries.
+#define ESPNOW_PEER_BROADCAST 0
+#define ESPNOW_PEER_UNICAST 1
+
+#ifndef ESPNOW_PEER
+#define ESPNOW_PEER ESPNOW_PEER_BROADCAST
+#endif
+
+#ifndef DISCOVERY_INTERVAL_MS
+#define DISCOVERY_INTERVAL_MS 1000
+#endif
+
+// ESP-NOW PHY rate as a wifi_phy_rate_t value (see src/protocol/phy_rate.h);
+// 0xFF leaves the driver's default
+#ifndef ESPNOW_RATE
+#define ESPNOW_RATE 0xFF
+#endif
+
+// Unicast ESP-NOW: times a frame the peer did not acknowledge, after the
+// MAC's own retries, is sent again. The driver's retry limit cannot be set,
+// so these come on top. Non-zero sends one frame at a time.
+#ifndef ESPNOW_RETRIES
+#define ESPNOW_RETRIES 0
+#endif
+
+// Sender test profile: fixed payload size and rate, or a throughput
+// ramp/burst that steps payload size and rate (payload size is capped at
+// what the protocol can carry)
+#define TEST_PROFILE_FIXED 0
+#define TEST_PROFILE_RAMP 1
+#define TEST_PROFILE_BURST 2
+
+#ifndef TEST_PROFILE
+#define TEST_PROFILE TEST_PROFILE_FIXED
+#endif
+
+#ifndef RAMP_RATE_START
+#define RAMP_RATE_START PACKET_RATE // Hz
+#endif
+
+#ifndef RAMP_RATE_END
+#define RAMP_RATE_END 2000 // Hz
+#endif
+
+#ifndef RAMP_SIZE_START
+#define RAMP_SIZE_START PACKET_SIZE // bytes
+#endif
+
+#ifndef RAMP_SIZE_END
+#define RAMP_SIZE_END PACKET_SIZE // bytes
+#endif
+
+#ifndef RAMP_STEPS
+#define RAMP_STEPS 8
+#endif
+
+#ifndef RAMP_STEP_MS
+#define RAMP_STEP_MS 10000
+#endif
+
+#ifndef BURST_RATE
+#define BURST_RATE 1000 // Hz during a burst
+#endif
+
+#ifndef BURST_ON_MS
+#define BURST_ON_MS 2000
+#endif
+
+#ifndef BURST_OFF_MS
+#define BURST_OFF_MS 3000
+#endif
+
+#ifndef BURST_CYCLES
+#define BURST_CYCLES 4
+#endif
+
+// Receiver queue between the radio callback and packet processing (power of two)
+#ifndef RX_QUEUE_SIZE
+#define RX_QUEUE_SIZE 64
+#endif
+
+// FreeRTOS tasks, all pinned to TASK_CORE: the ESP32-C6 has a single
+// high-performance core, so priorities alone decide what runs. The Wi-Fi,
+// lwIP and esp_timer tasks (18-23) stay above all of these; the Arduino loop
+// task (1) runs the serial console and the protocol sweep.
+#ifndef TASK_CORE
+#define TASK_CORE 0
+#endif
+
+// Role task: sends on the sender's timer, drains the receiver's queue on
+// every packet, and wakes every ROLE_TASK_IDLE_MS for periodic work
+#ifndef ROLE_TASK_PRIORITY
+#define ROLE_TASK_PRIORITY 10
+#endif
+
+#ifndef ROLE_TASK_STACK
+#define ROLE_TASK_STACK 6144 // Bytes
+#endif
+
+#ifndef ROLE_TASK_IDLE_MS
+#define ROLE_TASK_IDLE_MS 20
+#endif
+
+// GPS task: parses UBX messages when the UART receives them
+#ifndef GPS_TASK_PRIORITY
+#define GPS_TASK_PRIORITY 5
+#endif
+
+#ifndef GPS_TASK_STACK
+#define GPS_TASK_STACK 4096
+#endif
+
+// Reporter task: time sync, link events and statistics every REPORT_INTERVAL_MS
+#ifndef REPORT_TASK_PRIORITY
+#define REPORT_TASK_PRIORITY 1
+#endif
+
+#ifndef REPORT_TASK_STACK
+#define REPORT_TASK_STACK 6144
+#endif
+
+#ifndef REPORT_INTERVAL_MS
+#define REPORT_INTERVAL_MS 100
+#endif
+
+// CPU share and least free stack of each task, printed by the reporter every
+// TASK_REPORT_MS. 0 disables the report.
+#ifndef TASK_REPORT_MS
+#define TASK_REPORT_MS 60000
+#endif
+
+// Node id sent in every packet so a receiver can tell senders apart in the
+// log. 0 uses the low 16 bits of the factory MAC address.
+#ifndef NODE_ID
+#define NODE_ID 0
+#endif
+
+// Senders the receiver keeps separate statistics for (about 2.5 KB each).
+// Packets from further senders are still logged.
+#ifndef MAX_PEERS
+#define MAX_PEERS 20
+#endif
+
+// Live range profile on the receiver: received, lost, RSSI and latency in
+// RANGE_PROFILE_BIN_M distance bins over the whole test, printed as a table
+// every RANGE_PROFILE_INTERVAL_MS. RANGE_PROFILE_BINS bins of about 420 bytes
+// each, including the row the report prints from, the last one open-ended;
+// 0 disables the profile.
+#ifndef RANGE_PROFILE_BIN_M
+#define RANGE_PROFILE_BIN_M 25
+#endif
+
+#ifndef RANGE_PROFILE_BINS
+#define RANGE_PROFILE_BINS 80
+#endif
+
+#ifndef RANGE_PROFILE_INTERVAL_MS
+#define RANGE_PROFILE_INTERVAL_MS 30000
+#endif
+
+// Log output format. In binary mode the sender also logs every packet it
+// sends and the driver's outcome for it (join with tools/logjoin).
+#define LOG_FORMAT_NONE 0   // No per-packet log, only the periodic statistics
+#define LOG_FORMAT_CSV 1    // One human-readable CSV line per received packet
+#define LOG_FORMAT_BINARY 2 // Framed, CRC'd binary records (decode with tools/logdecode)
+
+#ifndef LOG_FORMAT
+#define LOG_FORMAT LOG_FORMAT_CSV
+#endif
+
+// Where the receiver's log records go
+#define LOG_SINK_SERIAL 0 // Serial port, captured on the host
+#define LOG_SINK_SD 1     // FAT SD card over SPI, a new file per session
+#define LOG_SINK_FLASH 2  // Ring of files in the internal flash LittleFS partition
+
+#ifndef LOG_SINK
+#define LOG_SINK LOG_SINK_SERIAL
+#endif
+
+// Log batching: records are collected in LOG_BLOCK_COUNT blocks of
+// LOG_BLOCK_SIZE bytes, a multiple of the SD sector and flash page, and each
+// block is written to the sink in one call from the log task
+#ifndef LOG_BLOCK_SIZE
+#define LOG_BLOCK_SIZE 4096
+#endif
+
+#ifndef LOG_BLOCK_COUNT
+#define LOG_BLOCK_COUNT 4 // Power of two
+#endif
+
+// Maximum time a record waits in a partially filled block (ms)
+#ifndef LOG_FLUSH_INTERVAL_MS
+#define LOG_FLUSH_INTERVAL_MS 100
+#endif
+
+// How often an SD or flash file is committed with fsync() (ms): the most a
+// power cut can lose. Each commit rewrites file metadata, so flash ages
+// faster with shorter intervals. 0 commits every block.
+#ifndef LOG_SYNC_INTERVAL_MS
+#define LOG_SYNC_INTERVAL_MS 1000
+#endif
+
+// Flash ring: file size, and the share of the partition the files may use;
+// the oldest file is deleted to make room for the next
+#ifndef LOG_SEGMENT_SIZE
+#define LOG_SEGMENT_SIZE 65536
+#endif
+
+#ifndef LOG_FLASH_USAGE_PERCENT
+#define LOG_FLASH_USAGE_PERCENT 75
+#endif
+
+// SD card SPI pins and clock
+#ifndef SD_CS_PIN
+#define SD_CS_PIN 18
+#endif
+
+#ifndef SD_SCK_PIN
+#define SD_SCK_PIN 21
+#endif
+
+#ifndef SD_MISO_PIN
+#define SD_MISO_PIN 20
+#endif
+
+#ifndef SD_MOSI_PIN
+#define SD_MOSI_PIN 19
+#endif
+
+#ifndef SD_SPI_FREQUENCY
+#define SD_SPI_FREQUENCY 20000000
+#endif
+
+// Log task: writes full blocks to the sink, below the role task so a slow
+// card never delays packet handling
+#ifndef LOG_TASK_PRIORITY
+#define LOG_TASK_PRIORITY 3
+#endif
+
+#ifndef LOG_TASK_STACK
+#define LOG_TASK_STACK 4096
+#endif
+
+// Iterations per stage for the on-target receiver benchmark (RECEIVER_BENCHMARK builds)
+#ifndef RECEIVER_BENCHMARK_ITERATIONS
+#define RECEIVER_BENCHMARK_ITERATIONS 2000
+#endif
+
+// Capture per-frame radio metadata (RSSI, noise floor, PHY rate) for Wi-Fi
+// UDP packets with a promiscuous-mode callback. 0 falls back to the
+// station's averaged beacon RSSI.
+#ifndef WIFI_RX_CAPTURE
+#define WIFI_RX_CAPTURE 1
+#endif
+
+// Echo mode: every ECHO_INTERVAL-th packet asks the receiver for a reply, so
+// the sender can measure round-trip time on its own clock and estimate the
+// receiver's clock offset. 0 disables echo requests.
+#ifndef ECHO_INTERVAL
+#define ECHO_INTERVAL 0
+#endif
+
 // Clock synchronization configuration
-#define SYNC_PING_COUNT 10 // Number of pings to send for initial synchronization
-#define SYNC_TIMEOUT 5000  // Timeout in ms for each ping/ack exchange
+#define SYNC_PING_COUNT 10 // Echo exchanges in the clock offset filter window
+#define SYNC_TIMEOUT 5000  // Echo replies with a longer round trip (ms) are discarded
 
 // Network credentials
 #define WIFI_SSID "DroneMeshTest"
@@ -40,6 +353,12 @@
 #define PROTOCOL_WIFI_LR 3
 #define PROTOCOL_ESP_NOW 4
 
+// Protocol used until a saved profile or the serial console selects another.
+// Define WIFI_LR with PROTOCOL_ESP_NOW for ESP-NOW over the LR PHY.
+#ifndef PROTOCOL
+#define PROTOCOL PROTOCOL_ESP_NOW
+#endif
+
 // AP and STA IP addresses (static)
 #define AP_IP "192.168.4.1"
 #define STA_IP "192.168.4.2"
@@ -0,0 +1,154 @@
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+
+// Minimal Arduino/ESP32 API for host builds of the role, protocol and
+// statistics code. Only what the firmware sources actually use is provided.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include "sim_node.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define RISING 0x01
+#define FALLING 0x02
+#define LED_BUILTIN 8
+#define SERIAL_8N1 0x800001c
+#define IRAM_ATTR
+
+// Critical sections guard nothing: the simulation runs every node on one thread
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+// Firmware format strings are written for the ESP32's ILP32 ABI, where long
+// is 32 bits and uint32_t is passed to "%lu". These wrappers drop the single
+// 'l' length modifier so such calls print correctly on LP64 hosts.
+int simVsnprintf(char *buffer, size_t length, const char *format, va_list args);
+int simSnprintf(char *buffer, size_t length, const char *format, ...);
+int simSprintf(char *buffer, const char *format, ...);
+
+#define sprintf simSprintf
+#define snprintf simSnprintf
+
+// On the ESP32 the system time is esp_timer plus an offset set by
+// settimeofday(). Route the calls to the current simulated node's clock.
+int simGettimeofday(struct timeval *tv, void *tz);
+int simSettimeofday(const struct timeval *tv, const void *tz);
+int simAdjtime(const struct timeval *delta, struct timeval *olddelta);
+
+#define gettimeofday simGettimeofday
+#define settimeofday simSettimeofday
+#define adjtime simAdjtime
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+
+    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+
+    virtual int availableForWrite()
+    {
+        return 0;
+    }
+
+    virtual void flush() {}
+
+    size_t printf(const char *format, ...);
+
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(int n);
+    size_t print(unsigned int n);
+    size_t print(long n);
+    size_t print(unsigned long n);
+    size_t print(double n, int digits = 2);
+
+    size_t println();
+
+    template <typename T>
+    size_t println(T value)
+    {
+        return print(value) + println();
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available()
+    {
+        return 0;
+    }
+
+    virtual int read()
+    {
+        return -1;
+    }
+};
+
+// Serial writes to the current node's console; Serial1 (the GPS UART) has
+// no device behind it, positions come from a GpsSource instead
+class HardwareSerial : public Stream
+{
+public:
+    explicit HardwareSerial(bool console) : console(console) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+    void updateBaudRate(unsigned long baud);
+
+    using Print::write;
+    virtual size_t write(const uint8_t *buffer, size_t size) override;
+    virtual int availableForWrite() override;
+    virtual void flush() override;
+
+    using Stream::read;
+    size_t read(uint8_t *buffer, size_t size);
+
+    operator bool() const
+    {
+        return true;
+    }
+
+private:
+    bool console;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+// Interrupts are raised by the simulation driver with simRaiseEdge()
+inline int digitalPinToInterrupt(int pin)
+{
+    return pin;
+}
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+#endif // ARDUINO_SHIM_H
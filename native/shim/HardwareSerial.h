@@ -0,0 +1,6 @@
+#ifndef HARDWARE_SERIAL_SHIM_H
+#define HARDWARE_SERIAL_SHIM_H
+
+#include "Arduino.h"
+
+#endif // HARDWARE_SERIAL_SHIM_H
@@ -0,0 +1,545 @@
+#include "Arduino.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include <vector>
+
+// The shim itself formats with the host ABI
+#undef sprintf
+#undef snprintf
+
+HardwareSerial Serial(true);
+HardwareSerial Serial1(false);
+
+// Simulation clock and the node the shim currently acts on
+static int64_t simulationTime_us = 0;
+static SimNode defaultNode("host", stdout);
+static SimNode *currentNode = &defaultNode;
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    SimNode *node;
+    bool armed;
+    bool periodic;
+    uint64_t period_us;
+    int64_t expiry_us; // In the owning node's esp_timer time
+};
+
+static std::vector<esp_timer *> timers;
+
+SimNode::SimNode(const char *name, FILE *console, double drift_ppm)
+    : name(name), console(console), boot_us(simNow()), drift_ppm(drift_ppm), wallOffset_us(0)
+{
+    for (int i = 0; i < MAX_INTERRUPTS; i++)
+    {
+        interrupts[i].pin = -1;
+    }
+
+    // Locally administered and unique per node
+    static uint8_t nodes = 0;
+    static const uint8_t base[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x00};
+    memcpy(mac, base, sizeof(mac));
+    mac[5] = ++nodes;
+}
+
+int64_t SimNode::localMicros(int64_t time_us) const
+{
+    int64_t elapsed = time_us - boot_us;
+    return elapsed + (int64_t)(elapsed * drift_ppm * 1e-6);
+}
+
+int64_t SimNode::simulationTime(int64_t local_us) const
+{
+    int64_t time_us = boot_us + (int64_t)(local_us / (1.0 + drift_ppm * 1e-6));
+
+    // Undo rounding so the timer never fires before its local deadline
+    while (localMicros(time_us) < local_us)
+    {
+        time_us++;
+    }
+
+    return time_us;
+}
+
+int64_t simNow()
+{
+    return simulationTime_us;
+}
+
+void simAdvanceTo(int64_t time_us)
+{
+    if (time_us > simulationTime_us)
+    {
+        simulationTime_us = time_us;
+    }
+}
+
+void simSetNode(SimNode *node)
+{
+    currentNode = node ? node : &defaultNode;
+}
+
+SimNode *simGetNode()
+{
+    return currentNode;
+}
+
+int64_t simNextTimer()
+{
+    int64_t next = INT64_MAX;
+    for (const esp_timer *timer : timers)
+    {
+        if (timer->armed)
+        {
+            int64_t expiry = timer->node->simulationTime(timer->expiry_us);
+            if (expiry < next)
+            {
+                next = expiry;
+            }
+        }
+    }
+    return next;
+}
+
+void simRunTimers()
+{
+    while (true)
+    {
+        // Earliest due timer first, as the esp_timer task would
+        esp_timer *due = nullptr;
+        int64_t dueTime = INT64_MAX;
+        for (esp_timer *timer : timers)
+        {
+            if (timer->armed)
+            {
+                int64_t expiry = timer->node->simulationTime(timer->expiry_us);
+                if (expiry <= simulationTime_us && expiry < dueTime)
+                {
+                    due = timer;
+                    dueTime = expiry;
+                }
+            }
+        }
+
+        if (!due)
+        {
+            return;
+        }
+
+        if (due->periodic)
+        {
+            due->expiry_us += due->period_us;
+        }
+        else
+        {
+            due->armed = false;
+        }
+
+        SimNode *previous = currentNode;
+        currentNode = due->node;
+        due->callback(due->arg);
+        currentNode = previous;
+    }
+}
+
+int simVsnprintf(char *buffer, size_t length, const char *format, va_list args)
+{
+    // Rewrite "%lu"/"%ld"/"%lx" to their int forms, keep "%llu" and friends
+    size_t formatLength = strlen(format);
+    char stackFormat[256];
+    char *rewritten = formatLength < sizeof(stackFormat) ? stackFormat : (char *)malloc(formatLength + 1);
+
+    const char *in = format;
+    char *out = rewritten;
+    while (*in)
+    {
+        if (*in != '%')
+        {
+            *out++ = *in++;
+            continue;
+        }
+
+        *out++ = *in++;
+        while (*in && strchr("-+ #0123456789.*", *in))
+        {
+            *out++ = *in++;
+        }
+
+        if (in[0] == 'l' && in[1] != 'l')
+        {
+            in++;
+        }
+        else if (in[0] == 'l' && in[1] == 'l')
+        {
+            *out++ = *in++;
+            *out++ = *in++;
+        }
+
+        if (*in)
+        {
+            *out++ = *in++;
+        }
+    }
+    *out = '\0';
+
+    int result = vsnprintf(buffer, length, rewritten, args);
+
+    if (rewritten != stackFormat)
+    {
+        free(rewritten);
+    }
+
+    return result;
+}
+
+int simSnprintf(char *buffer, size_t length, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int result = simVsnprintf(buffer, length, format, args);
+    va_end(args);
+    return result;
+}
+
+int simSprintf(char *buffer, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int result = simVsnprintf(buffer, SIZE_MAX, format, args);
+    va_end(args);
+    return result;
+}
+
+int simGettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+
+    int64_t now_us = currentNode->localMicros(simulationTime_us) + currentNode->wallOffset_us;
+    tv->tv_sec = (time_t)(now_us / 1000000);
+    tv->tv_usec = (suseconds_t)(now_us % 1000000);
+    return 0;
+}
+
+int simSettimeofday(const struct timeval *tv, const void *tz)
+{
+    (void)tz;
+
+    int64_t wall_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    currentNode->wallOffset_us = wall_us - currentNode->localMicros(simulationTime_us);
+    return 0;
+}
+
+int simAdjtime(const struct timeval *delta, struct timeval *olddelta)
+{
+    // The ESP32 slews the clock gradually; the simulation applies the
+    // correction at once, which is close enough at the sync interval
+    if (delta)
+    {
+        currentNode->wallOffset_us += (int64_t)delta->tv_sec * 1000000 + delta->tv_usec;
+    }
+
+    if (olddelta)
+    {
+        olddelta->tv_sec = 0;
+        olddelta->tv_usec = 0;
+    }
+
+    return 0;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    char stackBuffer[256];
+    char *buffer = stackBuffer;
+
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int length = simVsnprintf(buffer, sizeof(stackBuffer), format, args);
+    va_end(args);
+
+    if (length < 0)
+    {
+        va_end(copy);
+        return 0;
+    }
+
+    if ((size_t)length >= sizeof(stackBuffer))
+    {
+        buffer = (char *)malloc(length + 1);
+        simVsnprintf(buffer, length + 1, format, copy);
+    }
+    va_end(copy);
+
+    size_t written = write((const uint8_t *)buffer, length);
+
+    if (buffer != stackBuffer)
+    {
+        free(buffer);
+    }
+
+    return written;
+}
+
+size_t Print::print(const char *s)
+{
+    return write((const uint8_t *)s, strlen(s));
+}
+
+size_t Print::print(char c)
+{
+    return write((uint8_t)c);
+}
+
+size_t Print::print(int n)
+{
+    return printf("%d", n);
+}
+
+size_t Print::print(unsigned int n)
+{
+    return printf("%u", n);
+}
+
+size_t Print::print(long n)
+{
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%ld", n);
+    return write((const uint8_t *)buffer, length);
+}
+
+size_t Print::print(unsigned long n)
+{
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%lu", n);
+    return write((const uint8_t *)buffer, length);
+}
+
+size_t Print::print(double n, int digits)
+{
+    return printf("%.*f", digits, n);
+}
+
+size_t Print::println()
+{
+    return print("\r\n");
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin)
+{
+    (void)baud;
+    (void)config;
+    (void)rxPin;
+    (void)txPin;
+}
+
+void HardwareSerial::updateBaudRate(unsigned long baud)
+{
+    (void)baud;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    if (console && currentNode->console)
+    {
+        return fwrite(buffer, 1, size, currentNode->console);
+    }
+
+    return size;
+}
+
+int HardwareSerial::availableForWrite()
+{
+    // The host console never applies backpressure
+    return 4096;
+}
+
+void HardwareSerial::flush()
+{
+    if (console && currentNode->console)
+    {
+        fflush(currentNode->console);
+    }
+}
+
+size_t HardwareSerial::read(uint8_t *buffer, size_t size)
+{
+    (void)buffer;
+    (void)size;
+    return 0;
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(currentNode->localMicros(simulationTime_us) / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)currentNode->localMicros(simulationTime_us);
+}
+
+void delay(uint32_t ms)
+{
+    simAdvanceTo(simulationTime_us + (int64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    simAdvanceTo(simulationTime_us + us);
+}
+
+void yield()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    (void)pin;
+    (void)value;
+}
+
+int digitalRead(uint8_t pin)
+{
+    (void)pin;
+    return LOW;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode)
+{
+    (void)mode;
+
+    detachInterrupt(pin);
+    for (int i = 0; i < SimNode::MAX_INTERRUPTS; i++)
+    {
+        if (currentNode->interrupts[i].pin < 0)
+        {
+            currentNode->interrupts[i].pin = pin;
+            currentNode->interrupts[i].handler = handler;
+            currentNode->interrupts[i].arg = arg;
+            return;
+        }
+    }
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    for (int i = 0; i < SimNode::MAX_INTERRUPTS; i++)
+    {
+        if (currentNode->interrupts[i].pin == pin)
+        {
+            currentNode->interrupts[i].pin = -1;
+        }
+    }
+}
+
+void simRaiseEdge(int pin)
+{
+    for (int i = 0; i < SimNode::MAX_INTERRUPTS; i++)
+    {
+        if (currentNode->interrupts[i].pin == pin)
+        {
+            currentNode->interrupts[i].handler(currentNode->interrupts[i].arg);
+        }
+    }
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+    memcpy(mac, currentNode->mac, sizeof(currentNode->mac));
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time()
+{
+    return currentNode->localMicros(simulationTime_us);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    if (!args || !args->callback || !handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_timer *timer = new esp_timer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->name = args->name;
+    timer->node = currentNode;
+    timer->armed = false;
+    timer->periodic = false;
+    timer->period_us = 0;
+    timer->expiry_us = 0;
+
+    timers.push_back(timer);
+    *handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->armed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->armed = true;
+    timer->periodic = false;
+    timer->expiry_us = timer->node->localMicros(simulationTime_us) + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    if (timer->armed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->armed = true;
+    timer->periodic = true;
+    timer->period_us = period_us > 0 ? period_us : 1;
+    timer->expiry_us = timer->node->localMicros(simulationTime_us) + (int64_t)timer->period_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->armed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    for (size_t i = 0; i < timers.size(); i++)
+    {
+        if (timers[i] == timer)
+        {
+            timers.erase(timers.begin() + i);
+            break;
+        }
+    }
+
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->armed;
+}
@@ -0,0 +1,10 @@
+#ifndef ESP_MAC_SHIM_H
+#define ESP_MAC_SHIM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Factory MAC of the current simulated node
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+
+#endif // ESP_MAC_SHIM_H
@@ -0,0 +1,36 @@
+#ifndef ESP_TIMER_SHIM_H
+#define ESP_TIMER_SHIM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// esp_timer on the simulated clock. Callbacks run from simRunTimers() in the
+// context of the node that created the timer.
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum
+{
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+int64_t esp_timer_get_time();
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+#endif // ESP_TIMER_SHIM_H
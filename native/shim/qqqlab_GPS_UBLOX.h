@@ -0,0 +1,74 @@
+#ifndef QQQLAB_GPS_UBLOX_SHIM_H
+#define QQQLAB_GPS_UBLOX_SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Stand-in for the qqqlab GPS-uBlox parser. Instead of decoding UBX messages
+// from the UART, update() asks a GpsSource for the current fix.
+
+enum GPS_Status
+{
+    NO_GPS = 0,
+    NO_FIX = 1,
+    GPS_OK_FIX_2D = 2,
+    GPS_OK_FIX_3D = 3
+};
+
+// The subset of the parser's state the firmware reads
+struct GPS_State
+{
+    GPS_Status status;
+    int32_t lat;                  // 1e-7 degrees
+    int32_t lng;                  // 1e-7 degrees
+    int32_t alt;                  // mm above MSL
+    uint8_t num_sats;
+    uint32_t horizontal_accuracy; // mm
+    uint32_t vertical_accuracy;   // mm
+    uint16_t time_week;
+    uint32_t time_week_ms;
+    uint32_t last_gps_time_ms;
+};
+
+// Supplies fixes to the shim in place of a GPS receiver
+class GpsSource
+{
+public:
+    virtual ~GpsSource() {}
+
+    virtual void update(GPS_State &state) = 0;
+};
+
+class AP_GPS_UBLOX
+{
+public:
+    GPS_State state = {};
+
+    uint32_t gnss_mode = 0;
+    uint16_t rate_ms = 200;
+    uint8_t save_config = 0;
+
+    // Where fixes come from; without one the receiver never gets a fix
+    GpsSource *source = nullptr;
+
+    virtual ~AP_GPS_UBLOX() {}
+
+    void update()
+    {
+        if (source)
+        {
+            source->update(state);
+        }
+    }
+
+protected:
+    virtual void I_setBaud(int baud) = 0;
+    virtual int I_read(uint8_t *data, size_t len) = 0;
+    virtual int I_write(uint8_t *data, size_t len) = 0;
+    virtual int I_available() = 0;
+    virtual int I_availableForWrite() = 0;
+    virtual uint32_t I_millis() = 0;
+    virtual void I_print(const char *str) = 0;
+};
+
+#endif // QQQLAB_GPS_UBLOX_SHIM_H
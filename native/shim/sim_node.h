@@ -0,0 +1,64 @@
+#ifndef SIM_NODE_H
+#define SIM_NODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// One simulated board.
+//
+// The shim's clock, timer and Serial functions act on the current node, so a
+// sender and a receiver can run in one process with independent clocks and
+// consoles. Time is virtual: it only moves when the simulation driver (or
+// delay()) advances it, so runs are deterministic and as fast as the CPU.
+struct SimNode
+{
+    const char *name;
+    FILE *console;         // Serial output, nullptr to discard
+    int64_t boot_us;       // Simulation time the node booted at
+    double drift_ppm;      // Local oscillator error, positive runs fast
+    int64_t wallOffset_us; // gettimeofday() minus esp_timer_get_time()
+    uint8_t mac[6];        // Factory MAC, 02:00:00:00:00:<n> for the n-th node
+
+    // GPIO interrupts attached with attachInterruptArg()
+    static const int MAX_INTERRUPTS = 4;
+    struct Interrupt
+    {
+        int pin; // -1 if the slot is free
+        void (*handler)(void *);
+        void *arg;
+    } interrupts[MAX_INTERRUPTS];
+
+    SimNode(const char *name, FILE *console, double drift_ppm = 0.0);
+
+    // esp_timer_get_time() of this node at simulation time time_us
+    int64_t localMicros(int64_t time_us) const;
+
+    // Earliest simulation time at which localMicros() reaches local_us
+    int64_t simulationTime(int64_t local_us) const;
+};
+
+// Simulation time: true microseconds since the start of the run
+int64_t simNow();
+
+// Move simulation time forward; earlier times are ignored
+void simAdvanceTo(int64_t time_us);
+
+// Select the node the shim functions act on
+void simSetNode(SimNode *node);
+SimNode *simGetNode();
+
+// Raise a GPIO edge on the current node, running its interrupt handler if
+// one is attached to the pin
+void simRaiseEdge(int pin);
+
+// Earliest pending esp_timer expiry on any node, INT64_MAX if none
+int64_t simNextTimer();
+
+// Fire every esp_timer due at simNow(), each in its owner's node context
+void simRunTimers();
+
+// Unix time (seconds) that simulation time 0 corresponds to, used as the
+// true time reported by replayed GPS fixes
+static const int64_t SIM_EPOCH_UNIX_S = 1735689600; // 2025-01-01 00:00:00 UTC
+
+#endif // SIM_NODE_H
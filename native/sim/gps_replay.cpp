@@ -0,0 +1,139 @@
+#include "gps_replay.h"
+#include <stdio.h>
+#include <Arduino.h>
+#include "util/geo.h"
+
+// Offset between the Unix and GPS epochs, and GPS time ahead of UTC
+static const int64_t GPS_EPOCH_OFFSET_S = 315964800;
+static const int64_t GPS_LEAP_SECONDS = 18;
+static const int64_t SECONDS_PER_WEEK = 7 * 24 * 3600;
+
+GpsReplay::GpsReplay()
+    : satellites(12), horizontalAccuracy_mm(1500), rate_ms(100)
+{
+}
+
+GpsReplay GpsReplay::stationary(double latitude, double longitude, double altitude_m)
+{
+    GpsReplay replay;
+    replay.addWaypoint(0, latitude, longitude, altitude_m);
+    return replay;
+}
+
+GpsReplay GpsReplay::straightLine(double latitude, double longitude, double altitude_m,
+                                  double bearing_deg, double speed_mps, uint32_t duration_s)
+{
+    GpsReplay replay;
+    replay.addWaypoint(0, latitude, longitude, altitude_m);
+
+    double endLatitude, endLongitude;
+    destinationPoint(latitude, longitude, bearing_deg, speed_mps * duration_s, endLatitude, endLongitude);
+    replay.addWaypoint((int64_t)duration_s * 1000, endLatitude, endLongitude, altitude_m);
+
+    return replay;
+}
+
+bool GpsReplay::loadCsv(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        double time_s, latitude, longitude, altitude_m;
+        if (line[0] == '#' || sscanf(line, "%lf,%lf,%lf,%lf", &time_s, &latitude, &longitude, &altitude_m) != 4)
+        {
+            continue; // Comment or header
+        }
+
+        addWaypoint((int64_t)(time_s * 1000.0), latitude, longitude, altitude_m);
+    }
+
+    fclose(file);
+    return !track.empty();
+}
+
+void GpsReplay::addWaypoint(int64_t time_ms, double latitude, double longitude, double altitude_m)
+{
+    Waypoint point = {time_ms, latitude, longitude, altitude_m};
+    track.push_back(point);
+}
+
+void GpsReplay::setSatellites(uint8_t satellites)
+{
+    this->satellites = satellites;
+}
+
+void GpsReplay::setHorizontalAccuracy(uint32_t accuracy_mm)
+{
+    horizontalAccuracy_mm = accuracy_mm;
+}
+
+void GpsReplay::setRate(uint32_t rate_ms)
+{
+    this->rate_ms = rate_ms > 0 ? rate_ms : 1;
+}
+
+void GpsReplay::positionAt(int64_t time_ms, double &latitude, double &longitude, double &altitude_m) const
+{
+    if (track.empty())
+    {
+        latitude = longitude = altitude_m = 0.0;
+        return;
+    }
+
+    // Hold the first and last points outside the track
+    size_t next = 0;
+    while (next < track.size() && track[next].time_ms <= time_ms)
+    {
+        next++;
+    }
+
+    if (next == 0 || next == track.size())
+    {
+        const Waypoint &point = track[next == 0 ? 0 : track.size() - 1];
+        latitude = point.latitude;
+        longitude = point.longitude;
+        altitude_m = point.altitude_m;
+        return;
+    }
+
+    const Waypoint &a = track[next - 1];
+    const Waypoint &b = track[next];
+    double t = (double)(time_ms - a.time_ms) / (double)(b.time_ms - a.time_ms);
+
+    latitude = a.latitude + (b.latitude - a.latitude) * t;
+    longitude = a.longitude + (b.longitude - a.longitude) * t;
+    altitude_m = a.altitude_m + (b.altitude_m - a.altitude_m) * t;
+}
+
+void GpsReplay::currentPosition(double &latitude, double &longitude, double &altitude_m) const
+{
+    positionAt(simNow() / 1000, latitude, longitude, altitude_m);
+}
+
+void GpsReplay::update(GPS_State &state)
+{
+    // The receiver produces a new solution every rate_ms
+    int64_t fix_ms = simNow() / 1000 / rate_ms * rate_ms;
+
+    double latitude, longitude, altitude_m;
+    positionAt(fix_ms, latitude, longitude, altitude_m);
+
+    state.status = GPS_OK_FIX_3D;
+    state.lat = (int32_t)lround(latitude * 1e7);
+    state.lng = (int32_t)lround(longitude * 1e7);
+    state.alt = (int32_t)lround(altitude_m * 1000.0);
+    state.num_sats = satellites;
+    state.horizontal_accuracy = horizontalAccuracy_mm;
+    state.vertical_accuracy = horizontalAccuracy_mm * 2;
+
+    int64_t gps_ms = (SIM_EPOCH_UNIX_S - GPS_EPOCH_OFFSET_S + GPS_LEAP_SECONDS) * 1000 + fix_ms;
+    state.time_week = (uint16_t)(gps_ms / (SECONDS_PER_WEEK * 1000));
+    state.time_week_ms = (uint32_t)(gps_ms % (SECONDS_PER_WEEK * 1000));
+    state.last_gps_time_ms = millis();
+}
@@ -0,0 +1,60 @@
+#ifndef GPS_REPLAY_H
+#define GPS_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <qqqlab_GPS_UBLOX.h>
+
+// GPS source that replays a track of timed waypoints on the simulation clock.
+//
+// Positions are linearly interpolated between waypoints and held at the last
+// one. Like the real receiver, fixes only change every rate_ms, and GPS
+// week/time-of-week are reported from the simulation's true time so the
+// roles' GPS time sync works unchanged.
+class GpsReplay : public GpsSource
+{
+public:
+    struct Waypoint
+    {
+        int64_t time_ms; // Simulation time of this point
+        double latitude;
+        double longitude;
+        double altitude_m;
+    };
+
+    GpsReplay();
+
+    // A receiver that never moves
+    static GpsReplay stationary(double latitude, double longitude, double altitude_m);
+
+    // Start at a point and move along a bearing at constant speed
+    static GpsReplay straightLine(double latitude, double longitude, double altitude_m,
+                                  double bearing_deg, double speed_mps, uint32_t duration_s);
+
+    // Load "time_s,latitude,longitude,altitude_m" lines; '#' starts a comment.
+    // Returns false if the file cannot be read or contains no points.
+    bool loadCsv(const char *path);
+
+    void addWaypoint(int64_t time_ms, double latitude, double longitude, double altitude_m);
+
+    void setSatellites(uint8_t satellites);
+    void setHorizontalAccuracy(uint32_t accuracy_mm);
+    void setRate(uint32_t rate_ms);
+
+    // Position at simulation time time_ms
+    void positionAt(int64_t time_ms, double &latitude, double &longitude, double &altitude_m) const;
+
+    // Current position, in degrees and metres
+    void currentPosition(double &latitude, double &longitude, double &altitude_m) const;
+
+    virtual void update(GPS_State &state) override;
+
+private:
+    std::vector<Waypoint> track;
+    uint8_t satellites;
+    uint32_t horizontalAccuracy_mm;
+    uint32_t rate_ms;
+};
+
+#endif // GPS_REPLAY_H
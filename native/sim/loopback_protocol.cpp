@@ -0,0 +1,419 @@
+#include "loopback_protocol.h"
+#include <esp_timer.h>
+#include <math.h>
+#include <string.h>
+#include "protocol/phy_rate.h"
+#include "util/geo.h"
+
+LoopbackLink::LoopbackLink(const LinkModel &model, uint32_t seed)
+    : model(model), random(seed), nextOrder(0), channelFree_us(0),
+      transmitted(0), lost(0), duplicated(0), delivered(0)
+{
+}
+
+bool LoopbackLink::transmit(LoopbackProtocol *from, const uint8_t *data, size_t length)
+{
+    int64_t sent_us = simNow();
+
+    if (from->emulatedType == Protocol::PROTO_ESPNOW)
+    {
+        if (from->txTracker.inFlight() >= model.txQueueFrames)
+        {
+            return false;
+        }
+
+        Frame completion;
+        completion.order = nextOrder++;
+        completion.destination = from;
+        completion.sendComplete = true;
+        completion.acknowledged = true;
+        completion.length = 0;
+
+        // Unicast: attempts until one is received, each waiting for the channel
+        if (from->peerRegistered)
+        {
+            LoopbackProtocol *destination = endpointFor(from->peer);
+            completion.acknowledged = false;
+            for (uint32_t attempt = 0; attempt <= model.macRetries && !completion.acknowledged; attempt++)
+            {
+                sent_us = occupyChannel(from, length);
+                transmitted++;
+                if (!destination || uniform() < model.lossRate)
+                {
+                    lost++;
+                    continue;
+                }
+                completion.acknowledged = schedule(from, destination, data, length, sent_us);
+            }
+
+            completion.arrival_us = channelFree_us;
+            inFlight.push(completion);
+            return true;
+        }
+
+        // Broadcast: waits for the frames ahead of it, then completes once it is on the air
+        sent_us = occupyChannel(from, length);
+        completion.arrival_us = channelFree_us;
+        inFlight.push(completion);
+    }
+
+    for (LoopbackProtocol *destination : endpoints)
+    {
+        if (destination == from)
+        {
+            continue;
+        }
+
+        transmitted++;
+
+        if (uniform() < model.lossRate)
+        {
+            lost++;
+            continue;
+        }
+
+        schedule(from, destination, data, length, sent_us);
+
+        if (uniform() < model.duplicateRate)
+        {
+            duplicated++;
+            schedule(from, destination, data, length, sent_us);
+        }
+    }
+
+    return true;
+}
+
+int64_t LoopbackLink::nextArrival() const
+{
+    return inFlight.empty() ? INT64_MAX : inFlight.top().arrival_us;
+}
+
+void LoopbackLink::deliverDue()
+{
+    while (!inFlight.empty() && inFlight.top().arrival_us <= simNow())
+    {
+        Frame frame = inFlight.top();
+        inFlight.pop();
+
+        SimNode *previous = simGetNode();
+        simSetNode(frame.destination->node);
+        if (frame.sendComplete)
+        {
+            frame.destination->sendCompleted(frame.acknowledged);
+        }
+        else
+        {
+            delivered++;
+            frame.destination->receiveFrame(frame.data, frame.length, frame.rssi, frame.source);
+        }
+        simSetNode(previous);
+    }
+}
+
+uint32_t LoopbackLink::getTransmitted() const
+{
+    return transmitted;
+}
+
+uint32_t LoopbackLink::getLost() const
+{
+    return lost;
+}
+
+uint32_t LoopbackLink::getDuplicated() const
+{
+    return duplicated;
+}
+
+uint32_t LoopbackLink::getDelivered() const
+{
+    return delivered;
+}
+
+void LoopbackLink::attach(LoopbackProtocol *endpoint)
+{
+    endpoints.push_back(endpoint);
+}
+
+void LoopbackLink::detach(LoopbackProtocol *endpoint)
+{
+    for (size_t i = 0; i < endpoints.size(); i++)
+    {
+        if (endpoints[i] == endpoint)
+        {
+            endpoints.erase(endpoints.begin() + i);
+            break;
+        }
+    }
+
+    // Drop frames still in flight to it
+    std::priority_queue<Frame, std::vector<Frame>, LaterArrival> remaining;
+    while (!inFlight.empty())
+    {
+        if (inFlight.top().destination != endpoint)
+        {
+            remaining.push(inFlight.top());
+        }
+        inFlight.pop();
+    }
+    inFlight.swap(remaining);
+}
+
+int64_t LoopbackLink::occupyChannel(const LoopbackProtocol *from, size_t length)
+{
+    const PhyRate *rate = PhyRate::byRate(from->options.phyRate);
+    double bitrate_bps = rate ? rate->rate_kbps * 1000.0 : model.txBitrate_bps;
+
+    int64_t start_us = channelFree_us > simNow() ? channelFree_us : simNow();
+    channelFree_us = start_us + model.txOverhead_us + (int64_t)(length * 8 * 1e6 / bitrate_bps);
+    return start_us;
+}
+
+LoopbackProtocol *LoopbackLink::endpointFor(const PeerAddress &address) const
+{
+    for (LoopbackProtocol *endpoint : endpoints)
+    {
+        if (PeerAddress::fromMac(endpoint->node->mac) == address)
+        {
+            return endpoint;
+        }
+    }
+    return nullptr;
+}
+
+bool LoopbackLink::schedule(LoopbackProtocol *from, LoopbackProtocol *destination, const uint8_t *data, size_t length,
+                            int64_t sent_us)
+{
+    if (length > Protocol::MAX_FRAME_SIZE)
+    {
+        lost++;
+        return false;
+    }
+
+    // Received power from log-distance path loss with log-normal shadowing
+    std::normal_distribution<double> shadowing(0.0, model.shadowing_dB);
+    double distance = haversineDistance(from->latitude, from->longitude, destination->latitude, destination->longitude);
+    distance = distance > 1.0 ? distance : 1.0;
+    double rssi = model.txPower_dBm - model.pathLossAt1m_dB - 10.0 * model.pathLossExponent * log10(distance) +
+                  shadowing(random);
+
+    // Loss probability rises from 0 to 1 around the receiver sensitivity
+    double lossProbability = 1.0 / (1.0 + exp((rssi - model.sensitivity_dBm) / model.sensitivitySlope_dB));
+    if (uniform() < lossProbability)
+    {
+        lost++;
+        return false;
+    }
+
+    Frame frame;
+    frame.arrival_us = sent_us + model.latency_us;
+    if (model.jitter_us > 0)
+    {
+        std::exponential_distribution<double> jitter(1.0 / model.jitter_us);
+        frame.arrival_us += (int64_t)jitter(random);
+    }
+    if (uniform() < model.reorderRate)
+    {
+        frame.arrival_us += model.reorderDelay_us;
+    }
+
+    frame.order = nextOrder++;
+    frame.destination = destination;
+    frame.sendComplete = false;
+    frame.acknowledged = false;
+    frame.source = PeerAddress::fromMac(from->node->mac);
+    frame.rssi = (int8_t)(rssi < -127.0 ? -127.0 : (rssi > 0.0 ? 0.0 : rssi));
+    frame.length = (uint16_t)length;
+    memcpy(frame.data, data, length);
+
+    inFlight.push(frame);
+    return true;
+}
+
+double LoopbackLink::uniform()
+{
+    return std::uniform_real_distribution<double>(0.0, 1.0)(random);
+}
+
+LoopbackProtocol::LoopbackProtocol(LoopbackLink *link, ProtocolType emulatedType, uint8_t channel, int8_t txPower,
+                                   const LinkOptions &options)
+    : Protocol(channel, txPower), link(link), emulatedType(emulatedType), node(simGetNode()),
+      latitude(0.0), longitude(0.0), options(options), peerRegistered(false), peerDiscovered(false),
+      retryLength(0), retriesLeft(0)
+{
+}
+
+LoopbackProtocol::~LoopbackProtocol()
+{
+    end();
+}
+
+bool LoopbackProtocol::begin()
+{
+    if (!initialized)
+    {
+        txTracker.reset();
+        peerRegistered = false;
+        peerDiscovered = false;
+        link->attach(this);
+        initialized = true;
+    }
+
+    return true;
+}
+
+void LoopbackProtocol::end()
+{
+    if (initialized)
+    {
+        link->detach(this);
+        initialized = false;
+    }
+}
+
+Protocol::ProtocolType LoopbackProtocol::getType() const
+{
+    return emulatedType;
+}
+
+const char *LoopbackProtocol::getProtocolName() const
+{
+    // Sweeps rotate the emulated protocol, so the log shows which one ran
+    switch (emulatedType)
+    {
+    case PROTO_WIFI4:
+        return "Loopback WiFi 4";
+
+    case PROTO_WIFI6:
+        return "Loopback WiFi 6";
+
+    case PROTO_WIFI_LR:
+        return "Loopback WiFi LR";
+
+    default:
+        return "Loopback ESP-NOW";
+    }
+}
+
+TxTracker *LoopbackProtocol::getTxTracker()
+{
+    return emulatedType == PROTO_ESPNOW ? &txTracker : nullptr;
+}
+
+bool LoopbackProtocol::advertises() const
+{
+    return emulatedType == PROTO_ESPNOW && options.unicast && !options.isSender;
+}
+
+void LoopbackProtocol::setPosition(double latitude, double longitude)
+{
+    this->latitude = latitude;
+    this->longitude = longitude;
+}
+
+void LoopbackProtocol::receiveFrame(const uint8_t *data, size_t length, int8_t rssi, const PeerAddress &source)
+{
+    // What the emulated radio's rx_ctrl would report at its default rate
+    RxMetadata rx;
+    rx.rssi_dBm = rssi;
+    rx.noiseFloor_dBm = (int8_t)link->model.noiseFloor_dBm;
+    rx.phyMode = emulatedType == PROTO_ESPNOW ? RX_PHY_11B : (emulatedType == PROTO_WIFI6 ? RX_PHY_HE : RX_PHY_HT);
+    rx.bandwidth_MHz = 20;
+    rx.channel = channel;
+    rx.perFrame = true;
+    rx.radioTimestamp_us = (uint32_t)esp_timer_get_time();
+    rx.source = source;
+
+    deliverFrame(data, length, rx);
+}
+
+bool LoopbackProtocol::sendFrame(const uint8_t *data, size_t length)
+{
+    if (!initialized)
+    {
+        return false;
+    }
+
+    if (emulatedType != PROTO_ESPNOW)
+    {
+        return link->transmit(this, data, length);
+    }
+
+    // Same bookkeeping as ESPNOWProtocol::sendFrame()
+    if (options.unicast && options.isSender && !peerRegistered)
+    {
+        if (!peerDiscovered)
+        {
+            return false;
+        }
+        peer = discovered;
+        peerRegistered = true;
+        peerFound();
+    }
+
+    bool retrying = options.retries > 0 && peerRegistered;
+    if (retrying)
+    {
+        if (txTracker.inFlight() > 0 || length > sizeof(retryFrame))
+        {
+            return false;
+        }
+        memcpy(retryFrame, data, length);
+        retryLength = length;
+    }
+    retriesLeft = retrying ? options.retries : 0;
+
+    PacketView frame = PacketView::ofHeader(data);
+    if (!txTracker.begin(frame.sequenceNumber(), esp_timer_get_time()))
+    {
+        return false;
+    }
+
+    if (!link->transmit(this, data, length))
+    {
+        txTracker.rejected(true);
+        return false;
+    }
+
+    txTracker.accepted();
+    return true;
+}
+
+void LoopbackProtocol::onDiscovery(const PacketView &frame, const RxMetadata &rx)
+{
+    (void)frame;
+
+    if (emulatedType == PROTO_ESPNOW && options.unicast && options.isSender && !peerDiscovered)
+    {
+        discovered = rx.source;
+        peerDiscovered = true;
+    }
+}
+
+void LoopbackProtocol::sendCompleted(bool acknowledged)
+{
+    // As ESPNOWProtocol::onDataSent()
+    if (!acknowledged && retriesLeft > 0 && txTracker.retryLater())
+    {
+        return;
+    }
+
+    txTracker.complete(acknowledged, esp_timer_get_time());
+}
+
+void LoopbackProtocol::retransmit()
+{
+    // As ESPNOWProtocol::retransmit()
+    if (!initialized || !txTracker.takeRetry())
+    {
+        return;
+    }
+
+    retriesLeft--;
+    txTracker.retried();
+    if (!link->transmit(this, retryFrame, retryLength))
+    {
+        txTracker.complete(false, esp_timer_get_time());
+    }
+}
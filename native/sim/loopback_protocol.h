@@ -0,0 +1,200 @@
+#ifndef LOOPBACK_PROTOCOL_H
+#define LOOPBACK_PROTOCOL_H
+
+#include <stdint.h>
+#include <queue>
+#include <random>
+#include <vector>
+#include "protocol/protocol.h"
+
+class LoopbackProtocol;
+
+// Channel model applied to every frame crossing a LoopbackLink
+struct LinkModel
+{
+    // Delay: fixed airtime/stack latency plus exponentially distributed jitter
+    int64_t latency_us = 1500;
+    int64_t jitter_us = 300; // Mean of the random extra delay
+
+    // Independent random loss, duplication and reordering
+    double lossRate = 0.0;
+    double duplicateRate = 0.0;
+    double reorderRate = 0.0;       // Fraction of frames held back by reorderDelay_us
+    int64_t reorderDelay_us = 5000;
+
+    // Log-distance path loss with log-normal shadowing gives the RSSI;
+    // frames become increasingly likely to be lost around the sensitivity
+    double txPower_dBm = 20.0;
+    double pathLossAt1m_dB = 40.0;
+    double pathLossExponent = 2.7;
+    double shadowing_dB = 4.0;
+    double sensitivity_dBm = -96.0;
+    double sensitivitySlope_dB = 1.5;
+    double noiseFloor_dBm = -98.0; // Reported with every frame
+
+    // ESP-NOW transmit path: frames share the channel one at a time at the
+    // default 1 Mbps rate, each completing in the sender's send callback. The
+    // driver refuses a frame while txQueueFrames await completion.
+    int64_t txOverhead_us = 200; // Preamble, DIFS and backoff per frame
+    double txBitrate_bps = 1000000.0;
+    uint32_t txQueueFrames = 16;
+
+    // Unicast frames are acknowledged, and sent up to macRetries more times
+    // until they are; each attempt takes the channel and can be lost
+    uint32_t macRetries = 4;
+};
+
+// In-process radio channel between LoopbackProtocol endpoints.
+//
+// Frames sent by one endpoint are delivered to every other endpoint after the
+// delay drawn from the model, on the simulation clock. The RSSI of each
+// delivery follows the distance between the two endpoints' positions. The simulation driver
+// calls deliverDue() whenever time reaches nextArrival(); each delivery runs
+// in the receiving endpoint's node context, as the radio callback would.
+// Emulated ESP-NOW frames queue for the channel behind each other, and their
+// send completions are delivered to the sender the same way. A unicast frame
+// goes to its peer only, retried by the MAC until one attempt gets through.
+class LoopbackLink
+{
+public:
+    explicit LoopbackLink(const LinkModel &model, uint32_t seed = 1);
+
+    // Queue a frame from one endpoint to all others. False if the sender's
+    // emulated driver queue is full.
+    bool transmit(LoopbackProtocol *from, const uint8_t *data, size_t length);
+
+    // Simulation time of the next frame arrival or send completion, INT64_MAX if none
+    int64_t nextArrival() const;
+
+    // Deliver every frame and send completion due by now
+    void deliverDue();
+
+    uint32_t getTransmitted() const;
+    uint32_t getLost() const;
+    uint32_t getDuplicated() const;
+    uint32_t getDelivered() const;
+
+private:
+    friend class LoopbackProtocol;
+
+    struct Frame
+    {
+        int64_t arrival_us;
+        uint64_t order; // Breaks ties so equal arrivals keep send order
+        LoopbackProtocol *destination;
+        bool sendComplete;  // A send completion for destination, not a frame
+        bool acknowledged;  // Completion: the unicast peer received it (always for broadcast)
+        PeerAddress source; // Sender's node MAC
+        int8_t rssi;
+        uint16_t length;
+        uint8_t data[Protocol::MAX_FRAME_SIZE];
+    };
+
+    struct LaterArrival
+    {
+        bool operator()(const Frame &a, const Frame &b) const
+        {
+            return a.arrival_us != b.arrival_us ? a.arrival_us > b.arrival_us : a.order > b.order;
+        }
+    };
+
+    LinkModel model;
+    std::mt19937 random;
+    std::vector<LoopbackProtocol *> endpoints;
+    std::priority_queue<Frame, std::vector<Frame>, LaterArrival> inFlight;
+    uint64_t nextOrder;
+    int64_t channelFree_us; // When the last queued ESP-NOW frame leaves the air
+
+    uint32_t transmitted;
+    uint32_t lost;
+    uint32_t duplicated;
+    uint32_t delivered;
+
+    void attach(LoopbackProtocol *endpoint);
+    void detach(LoopbackProtocol *endpoint);
+    // Queue the frame's arrival, false if it is lost on the way
+    bool schedule(LoopbackProtocol *from, LoopbackProtocol *destination, const uint8_t *data, size_t length,
+                  int64_t sent_us);
+
+    // Claim the channel for one ESP-NOW frame; returns when it goes on the air
+    int64_t occupyChannel(const LoopbackProtocol *from, size_t length);
+
+    // Endpoint whose node has this MAC, nullptr if none is attached
+    LoopbackProtocol *endpointFor(const PeerAddress &address) const;
+    double uniform();
+};
+
+// Protocol that sends frames over a LoopbackLink instead of a radio. It goes
+// through the same serialize/deliverFrame path as ESP-NOW and Wi-Fi, and
+// reports send completions like ESP-NOW when emulating it.
+class LoopbackProtocol : public Protocol
+{
+public:
+    // ESP-NOW peer settings, as ESPNOWProtocol::LinkOptions
+    struct LinkOptions
+    {
+        bool unicast = false;
+        bool isSender = false;
+        uint8_t phyRate = 0xFF; // Sets the airtime; 0xFF for the model's bitrate
+        uint8_t retries = 0;
+    };
+
+    // Binds to the current simulated node
+    LoopbackProtocol(LoopbackLink *link, ProtocolType emulatedType, uint8_t channel, int8_t txPower,
+                     const LinkOptions &options);
+    virtual ~LoopbackProtocol();
+
+    virtual bool begin() override;
+
+    // Detach from the link, dropping frames still in flight to this endpoint
+    virtual void end() override;
+
+    // Reports the emulated protocol so logs and session headers look real
+    virtual ProtocolType getType() const override;
+    virtual const char *getProtocolName() const override;
+
+    // Send completions when emulating ESP-NOW, nullptr otherwise
+    virtual TxTracker *getTxTracker() override;
+
+    // Resend a frame sendCompleted() handed back, as ESP-NOW
+    virtual void retransmit() override;
+
+    // A unicast ESP-NOW receiver advertises itself
+    virtual bool advertises() const override;
+
+    // Position for the link's path loss model, updated by the simulation
+    void setPosition(double latitude, double longitude);
+
+    // Called by the link with a frame that has arrived
+    void receiveFrame(const uint8_t *data, size_t length, int8_t rssi, const PeerAddress &source);
+
+protected:
+    virtual bool sendFrame(const uint8_t *data, size_t length) override;
+    virtual void onDiscovery(const PacketView &frame, const RxMetadata &rx) override;
+
+private:
+    friend class LoopbackLink;
+
+    // Called by the link when a sent ESP-NOW frame leaves the air
+    void sendCompleted(bool acknowledged);
+
+    LoopbackLink *link;
+    ProtocolType emulatedType;
+    SimNode *node;
+    double latitude;
+    double longitude;
+    TxTracker txTracker;
+
+    const LinkOptions options;
+    bool peerRegistered;       // Unicast sender: frames go to peer
+    PeerAddress peer;
+    bool peerDiscovered;
+    PeerAddress discovered;
+
+    // Unicast frame in flight while retries are on
+    uint8_t retryFrame[Protocol::MAX_FRAME_SIZE];
+    size_t retryLength;
+    uint8_t retriesLeft;
+};
+
+#endif // LOOPBACK_PROTOCOL_H
@@ -0,0 +1,516 @@
+// Run sender roles and a receiver role in one process over a simulated link.
+//
+// Usage: rangesim [options]
+//   --duration <s>     Simulated run time (default 60)
+//   --seed <n>         Random seed for the link model (default 1)
+//   --latency <us>     Fixed one-way latency (default 1500)
+//   --jitter <us>      Mean random extra delay (default 300)
+//   --loss <p>         Random loss probability (default 0)
+//   --duplicate <p>    Duplication probability (default 0)
+//   --reorder <p>      Probability a frame is held back 5 ms (default 0)
+//   --senders <n>      Number of senders (default 1)
+//   --speed <m/s>      Senders move away from the receiver (default 5)
+//   --track <file>     Sender GPS track, "time_s,lat,lon,alt_m" lines
+//   --drift <ppm>      Sender oscillator error (default 10)
+//   --pps-jitter <us>  Maximum PPS interrupt latency (default 2)
+//   --rate <hz>        Sender packet rate (default PACKET_RATE)
+//   --payload <bytes>  Sender payload size (default PACKET_SIZE)
+//   --sweep <s>        Rotate the emulated protocol every s seconds (default SWEEP_SLOT_S)
+//   --aggregate <n>    Packets per frame (default AGGREGATE_RECORDS)
+//   --flush <ms>       Aggregate flush deadline (default AGGREGATE_FLUSH_MS)
+//   --window <n>       ESP-NOW frames in flight before senders wait (default TX_WINDOW)
+//   --peer <mode>      ESP-NOW broadcast or unicast (default ESPNOW_PEER)
+//   --phyrate <rate>   ESP-NOW PHY rate, e.g. 6m or mcs3 (default ESPNOW_RATE)
+//   --retries <n>      Extra sends of unacknowledged unicast frames (default ESPNOW_RETRIES)
+//   --log-dir <dir>    Write each board's log to files in dir/<board>, as on an SD card
+//   --quiet            Discard the receiver console instead of writing stdout
+//
+// Time is simulated, so the run goes as fast as the host allows. The receiver
+// console (CSV or binary log, per LOG_FORMAT) goes to stdout, the senders' to
+// stderr, and a run summary to stderr at the end. With --log-dir the logs go
+// to a new LOGnnnnn.BIN file per board and session instead, one per sweep
+// slot; in binary mode the senders log every packet they send. Several senders head away
+// from the receiver on evenly spread bearings, or all follow --track.
+//
+// When the firmware is built with PPS_PIN set, both boards get a PPS edge at
+// every true UTC second, delayed by a random interrupt latency.
+//
+// A sweep restarts every board's role and protocol together at each slot
+// boundary of true UTC, as the firmware does from GPS time.
+
+#include <Arduino.h>
+#include <errno.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "gps_handler.h"
+#include "log/file_log_sink.h"
+#include "log/log_writer.h"
+#include "role/sender.h"
+#include "role/receiver.h"
+#include "settings/test_config.h"
+#include "settings/sweep_schedule.h"
+#include "timing/host_clock.h"
+#include "gps_replay.h"
+#include "loopback_protocol.h"
+
+// main.cpp runs the role loop every 10 ms
+static const int64_t LOOP_INTERVAL_US = 10000;
+
+// Receiver position for generated tracks
+static const double RECEIVER_LATITUDE = -35.2809;
+static const double RECEIVER_LONGITUDE = 149.1300;
+static const double RECEIVER_ALTITUDE_M = 580.0;
+
+// One simulated board: its clock/console, GPS, protocol and role
+struct SimBoard
+{
+    SimNode node;
+    GpsReplay replay;
+    GPSHandler gps;
+    LoopbackProtocol *protocol;
+    Role *role;
+    LoopbackLink *link;
+    bool sender;
+    int64_t nextPps_us; // Simulation time of the next PPS edge
+
+    // Role log: the console unless logTo() is called. Without a log task,
+    // the role's poll() writes the blocks itself.
+    PrintLogSink consoleLogSink;
+    FileLogSink *fileLogSink;
+    LogSink *logSink;
+    LogWriter *logWriter;
+
+    SimBoard(const char *name, FILE *console, double drift_ppm)
+        : node(name, console, drift_ppm), protocol(nullptr), role(nullptr), link(nullptr), sender(false),
+          nextPps_us(INT64_MAX), consoleLogSink(&Serial), fileLogSink(nullptr), logSink(&consoleLogSink),
+          logWriter(nullptr)
+    {
+    }
+
+    ~SimBoard()
+    {
+        simSetNode(&node);
+        delete role;
+        delete protocol;
+        if (logWriter)
+        {
+            logWriter->flush();
+            delete logWriter;
+        }
+        delete fileLogSink;
+        simSetNode(nullptr);
+    }
+
+    // Write the log to files in directory/<board name>; call before begin()
+    void logTo(const char *directory)
+    {
+        std::string path = std::string(directory) + "/" + node.name;
+        fileLogSink = new FileLogSink(path.c_str());
+        logSink = fileLogSink;
+    }
+
+    bool begin(LoopbackLink *link, bool sender, const TestConfig &config, uint32_t slot)
+    {
+        this->link = link;
+        this->sender = sender;
+
+        simSetNode(&node);
+        gps.source = &replay;
+        gps.begin(&Serial1);
+        bool ok = logSink->begin();
+        if (ok)
+        {
+            logWriter = new LogWriter(logSink);
+            ok = start(config, slot);
+        }
+        simSetNode(nullptr);
+        return ok;
+    }
+
+    // Tear down the role and protocol and start them again, as main.cpp
+    // does at a sweep slot boundary
+    bool restart(const TestConfig &config, uint32_t slot)
+    {
+        simSetNode(&node);
+        role->end();
+        delete role;
+        delete protocol;
+        bool ok = start(config, slot);
+        simSetNode(nullptr);
+        return ok;
+    }
+
+    bool start(const TestConfig &config, uint32_t slot)
+    {
+        LoopbackProtocol::LinkOptions options;
+        options.unicast = config.espnowUnicast;
+        options.isSender = sender;
+        options.phyRate = config.espnowRate;
+        options.retries = config.espnowRetries;
+        protocol = new LoopbackProtocol(link, config.protocol, config.channel, config.txPower, options);
+
+        if (sender)
+        {
+            role = new SenderRole(protocol, &gps, config, logWriter);
+        }
+        else
+        {
+            role = new ReceiverRole(protocol, &gps, config, logWriter);
+        }
+
+        // The GPS task has published a fix by the time a role waits for one
+        gps.update();
+
+        role->setSweepSlot(slot);
+        bool ok = role->begin();
+        updatePosition();
+        return ok;
+    }
+
+    // Raise the PPS edge and schedule the next one at the following true second
+    void pps(std::mt19937 &random, int64_t jitter_us)
+    {
+        simSetNode(&node);
+        simRaiseEdge(PPS_PIN);
+        simSetNode(nullptr);
+
+        std::uniform_int_distribution<int64_t> latency(0, jitter_us);
+        nextPps_us = (nextPps_us / 1000000 + 1) * 1000000 + latency(random);
+    }
+
+    // Move the board's radio to its current replayed position
+    void updatePosition()
+    {
+        double latitude, longitude, altitude;
+        replay.currentPosition(latitude, longitude, altitude);
+        protocol->setPosition(latitude, longitude);
+    }
+
+    void loop()
+    {
+        simSetNode(&node);
+        gps.update();
+        role->loop();
+        simSetNode(nullptr);
+    }
+};
+
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [--duration s] [--seed n] [--latency us] [--jitter us] [--loss p]\n"
+            "          [--duplicate p] [--reorder p] [--senders n] [--speed m/s] [--track file]\n"
+            "          [--drift ppm] [--pps-jitter us] [--rate hz] [--payload bytes] [--sweep s]\n"
+            "          [--aggregate n] [--flush ms] [--window n] [--peer mode] [--phyrate rate]\n"
+            "          [--retries n] [--log-dir dir] [--quiet]\n",
+            program);
+}
+
+int main(int argc, char **argv)
+{
+    LinkModel model;
+    uint32_t duration_s = 60;
+    uint32_t seed = 1;
+    uint32_t senderCount = 1;
+    double speed_mps = 5.0;
+    double drift_ppm = 10.0;
+    int64_t ppsJitter_us = 2;
+    const char *trackPath = nullptr;
+    const char *logDir = nullptr;
+    bool quiet = false;
+    TestConfig config = TestConfig::defaults();
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(option, "--quiet") == 0)
+        {
+            quiet = true;
+            continue;
+        }
+
+        if (!value)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+
+        if (strcmp(option, "--duration") == 0)
+        {
+            duration_s = (uint32_t)atoi(value);
+        }
+        else if (strcmp(option, "--seed") == 0)
+        {
+            seed = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--latency") == 0)
+        {
+            model.latency_us = atoll(value);
+        }
+        else if (strcmp(option, "--jitter") == 0)
+        {
+            model.jitter_us = atoll(value);
+        }
+        else if (strcmp(option, "--loss") == 0)
+        {
+            model.lossRate = atof(value);
+        }
+        else if (strcmp(option, "--duplicate") == 0)
+        {
+            model.duplicateRate = atof(value);
+        }
+        else if (strcmp(option, "--reorder") == 0)
+        {
+            model.reorderRate = atof(value);
+        }
+        else if (strcmp(option, "--senders") == 0)
+        {
+            senderCount = (uint32_t)atoi(value);
+        }
+        else if (strcmp(option, "--speed") == 0)
+        {
+            speed_mps = atof(value);
+        }
+        else if (strcmp(option, "--track") == 0)
+        {
+            trackPath = value;
+        }
+        else if (strcmp(option, "--drift") == 0)
+        {
+            drift_ppm = atof(value);
+        }
+        else if (strcmp(option, "--pps-jitter") == 0)
+        {
+            ppsJitter_us = atoll(value);
+        }
+        else if (strcmp(option, "--log-dir") == 0)
+        {
+            logDir = value;
+        }
+        else if (strcmp(option, "--rate") == 0 || strcmp(option, "--payload") == 0 || strcmp(option, "--sweep") == 0 ||
+                 strcmp(option, "--aggregate") == 0 || strcmp(option, "--flush") == 0 ||
+                 strcmp(option, "--window") == 0 || strcmp(option, "--peer") == 0 ||
+                 strcmp(option, "--phyrate") == 0 || strcmp(option, "--retries") == 0)
+        {
+            // Same validation as the firmware's serial console
+            const char *error = config.set(option + 2, value);
+            if (error)
+            {
+                fprintf(stderr, "%s: %s\n", option, error);
+                return 2;
+            }
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+
+        i++;
+    }
+
+    if (senderCount < 1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char *configError = config.validate();
+    if (configError)
+    {
+        fprintf(stderr, "Invalid test configuration: %s\n", configError);
+        return 2;
+    }
+
+    LoopbackLink link(model, seed);
+
+    if (logDir && mkdir(logDir, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Cannot create %s\n", logDir);
+        return 1;
+    }
+
+    SimBoard receiver("receiver", quiet ? nullptr : stdout, 0.0);
+    receiver.replay = GpsReplay::stationary(RECEIVER_LATITUDE, RECEIVER_LONGITUDE, RECEIVER_ALTITUDE_M);
+    if (logDir)
+    {
+        receiver.logTo(logDir);
+    }
+
+    std::vector<std::string> senderNames;
+    for (uint32_t i = 0; i < senderCount; i++)
+    {
+        senderNames.push_back(senderCount == 1 ? "sender" : "sender" + std::to_string(i + 1));
+    }
+
+    std::vector<SimBoard *> senders;
+    for (uint32_t i = 0; i < senderCount; i++)
+    {
+        SimBoard *sender = new SimBoard(senderNames[i].c_str(), stderr, drift_ppm);
+        senders.push_back(sender);
+        if (logDir)
+        {
+            sender->logTo(logDir);
+        }
+
+        if (trackPath)
+        {
+            if (!sender->replay.loadCsv(trackPath))
+            {
+                fprintf(stderr, "Cannot read track %s\n", trackPath);
+                return 1;
+            }
+        }
+        else
+        {
+            double bearing = 90.0 + 360.0 * i / senderCount;
+            sender->replay = GpsReplay::straightLine(RECEIVER_LATITUDE, RECEIVER_LONGITUDE, RECEIVER_ALTITUDE_M,
+                                                     bearing, speed_mps, duration_s);
+        }
+    }
+
+    // Sweep slots follow true UTC, which the replayed GPS reports
+    SweepSchedule sweep(config.sweepSlot_s);
+    uint32_t slot = SessionLogRecord::NO_SLOT;
+    TestConfig slotConfig = config;
+    if (sweep.isEnabled())
+    {
+        slot = sweep.slotAt(SIM_EPOCH_UNIX_S * 1000000 + simNow());
+        slotConfig = sweep.configFor(slot, config);
+    }
+
+    // Receiver first so its callback is registered before the first packet
+    if (!receiver.begin(&link, false, slotConfig, slot))
+    {
+        fprintf(stderr, logDir && !receiver.logWriter ? "Cannot write logs to %s\n" : "Role initialization failed\n",
+                logDir);
+        return 1;
+    }
+    for (SimBoard *sender : senders)
+    {
+        if (!sender->begin(&link, true, slotConfig, slot))
+        {
+            fprintf(stderr, logDir && !sender->logWriter ? "Cannot write logs to %s\n" : "Role initialization failed\n",
+                    logDir);
+            return 1;
+        }
+    }
+
+    std::mt19937 ppsRandom(seed);
+    if (PPS_PIN >= 0)
+    {
+        receiver.nextPps_us = (simNow() / 1000000 + 1) * 1000000;
+        for (SimBoard *sender : senders)
+        {
+            sender->nextPps_us = receiver.nextPps_us;
+        }
+    }
+
+    HostClock wallClock;
+    int64_t wallStart_us = wallClock.nowMicros();
+
+    int64_t end_us = simNow() + (int64_t)duration_s * 1000000;
+    int64_t nextLoop_us = simNow();
+
+    while (simNow() < end_us)
+    {
+        // Jump straight to the next event
+        int64_t next_us = nextLoop_us;
+        if (simNextTimer() < next_us)
+        {
+            next_us = simNextTimer();
+        }
+        if (link.nextArrival() < next_us)
+        {
+            next_us = link.nextArrival();
+        }
+        if (receiver.nextPps_us < next_us)
+        {
+            next_us = receiver.nextPps_us;
+        }
+        if (sweep.isEnabled() && sweep.slotStart_us(slot + 1) - SIM_EPOCH_UNIX_S * 1000000 < next_us)
+        {
+            next_us = sweep.slotStart_us(slot + 1) - SIM_EPOCH_UNIX_S * 1000000;
+        }
+        for (SimBoard *sender : senders)
+        {
+            if (sender->nextPps_us < next_us)
+            {
+                next_us = sender->nextPps_us;
+            }
+        }
+        simAdvanceTo(next_us);
+
+        if (simNow() >= receiver.nextPps_us)
+        {
+            receiver.pps(ppsRandom, ppsJitter_us);
+        }
+        for (SimBoard *sender : senders)
+        {
+            if (simNow() >= sender->nextPps_us)
+            {
+                sender->pps(ppsRandom, ppsJitter_us);
+            }
+        }
+
+        // All boards switch protocol together at a slot boundary
+        if (sweep.isEnabled() && sweep.slotAt(SIM_EPOCH_UNIX_S * 1000000 + simNow()) > slot)
+        {
+            slot = sweep.slotAt(SIM_EPOCH_UNIX_S * 1000000 + simNow());
+            slotConfig = sweep.configFor(slot, config);
+            bool ok = receiver.restart(slotConfig, slot);
+            for (SimBoard *sender : senders)
+            {
+                ok = sender->restart(slotConfig, slot) && ok;
+            }
+            if (!ok)
+            {
+                fprintf(stderr, "Role initialization failed in sweep slot %u\n", slot);
+                return 1;
+            }
+        }
+
+        simRunTimers();
+
+        receiver.updatePosition();
+        for (SimBoard *sender : senders)
+        {
+            sender->updatePosition();
+        }
+
+        link.deliverDue();
+
+        if (simNow() >= nextLoop_us)
+        {
+            receiver.loop();
+            for (SimBoard *sender : senders)
+            {
+                sender->loop();
+            }
+            nextLoop_us += LOOP_INTERVAL_US;
+        }
+    }
+
+    double wall_s = (wallClock.nowMicros() - wallStart_us) / 1e6;
+    double simulated_s = duration_s;
+
+    fprintf(stderr, "Simulated %.1f s in %.3f s (%.0fx real time)\n",
+            simulated_s, wall_s, wall_s > 0 ? simulated_s / wall_s : 0.0);
+    fprintf(stderr, "Link: transmitted %u, lost %u, duplicated %u, delivered %u (%.0f frames/s host)\n",
+            link.getTransmitted(), link.getLost(), link.getDuplicated(), link.getDelivered(),
+            wall_s > 0 ? link.getDelivered() / wall_s : 0.0);
+
+    for (SimBoard *sender : senders)
+    {
+        delete sender;
+    }
+
+    return 0;
+}
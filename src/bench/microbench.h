@@ -0,0 +1,102 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Platform counters used by MicroBench. Counters that are not available on a
+// platform are left null and reported as not measured.
+struct BenchCounters
+{
+    int64_t (*nowNanos)();         // Monotonic time in nanoseconds
+    uint32_t (*cycleCount)();      // CPU cycle counter, may wrap
+    uint64_t (*allocationCount)(); // Heap allocations made so far
+};
+
+struct BenchResult
+{
+    const char *name;
+    uint32_t iterations;
+    double nsPerOp;
+    double cyclesPerOp; // Negative if not measured
+    double allocsPerOp; // Negative if not measured
+};
+
+// Keep the compiler from optimising away a benchmarked value
+template <typename T>
+inline void benchKeep(const T &value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Minimal microbenchmark runner for the host and the ESP32.
+//
+// Each benchmark body is called with the iteration index, first for a short
+// warm-up and then for the timed iterations. Per-operation time, cycles and
+// allocations are the averages over the timed loop. The cycle counter is
+// 32 bits, so one timed loop must stay under 2^32 cycles (~26 s at 160 MHz).
+//
+// Header-only with no Arduino dependencies.
+class MicroBench
+{
+public:
+    static const size_t MAX_RESULTS = 24;
+
+    MicroBench(const BenchCounters &counters, uint32_t iterations)
+        : counters(counters), iterations(iterations > 0 ? iterations : 1), count(0)
+    {
+    }
+
+    template <typename Body>
+    const BenchResult &run(const char *name, Body body)
+    {
+        for (uint32_t i = 0; i < iterations / 10; i++)
+        {
+            body(i);
+        }
+
+        uint64_t allocations = counters.allocationCount ? counters.allocationCount() : 0;
+        uint32_t cycles = counters.cycleCount ? counters.cycleCount() : 0;
+        int64_t start_ns = counters.nowNanos();
+
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            body(i);
+        }
+
+        int64_t elapsed_ns = counters.nowNanos() - start_ns;
+        uint32_t elapsedCycles = counters.cycleCount ? counters.cycleCount() - cycles : 0;
+        uint64_t allocated = counters.allocationCount ? counters.allocationCount() - allocations : 0;
+
+        BenchResult &result = results[count < MAX_RESULTS ? count++ : MAX_RESULTS - 1];
+        result.name = name;
+        result.iterations = iterations;
+        result.nsPerOp = (double)elapsed_ns / iterations;
+        result.cyclesPerOp = counters.cycleCount ? (double)elapsedCycles / iterations : -1.0;
+        result.allocsPerOp = counters.allocationCount ? (double)allocated / iterations : -1.0;
+        return result;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    const BenchResult &result(size_t index) const
+    {
+        return results[index];
+    }
+
+    uint32_t getIterations() const
+    {
+        return iterations;
+    }
+
+private:
+    BenchCounters counters;
+    uint32_t iterations;
+    BenchResult results[MAX_RESULTS];
+    size_t count;
+};
+
+#endif // MICROBENCH_H
@@ -0,0 +1,327 @@
+#include "receiver_benchmark.h"
+#include <sys/time.h>
+#include "../role/receiver.h"
+
+#if defined(ESP_PLATFORM)
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#endif
+
+// Protocol that is never started; the benchmark feeds packets directly
+class BenchProtocol : public Protocol
+{
+public:
+    BenchProtocol() : Protocol(WIFI_CHANNEL, TX_POWER) {}
+
+    virtual bool begin() override
+    {
+        return true;
+    }
+
+    virtual void end() override
+    {
+    }
+
+    virtual ProtocolType getType() const override
+    {
+        return PROTO_ESPNOW;
+    }
+
+    virtual const char *getProtocolName() const override
+    {
+        return "Benchmark";
+    }
+
+protected:
+    virtual bool sendFrame(const uint8_t *data, size_t length) override
+    {
+        (void)data;
+        (void)length;
+        return true;
+    }
+};
+
+// Sink that accepts everything, for the LogWriter stages
+class NullLogSink : public LogSink
+{
+public:
+    virtual bool begin() override
+    {
+        return true;
+    }
+
+    virtual size_t write(const uint8_t *data, size_t length) override
+    {
+        (void)data;
+        return length;
+    }
+
+    virtual const char *getName() const override
+    {
+        return "null";
+    }
+};
+
+ReceiverBenchmark::ReceiverBenchmark(const BenchCounters &counters, uint32_t iterations)
+    : bench(counters, iterations)
+{
+}
+
+void ReceiverBenchmark::run()
+{
+    // Protocol and role are too large for the loop task stack
+    BenchProtocol *protocol = new BenchProtocol();
+
+    // A plausible fix for both ends, about 1 km apart
+    GPSHandler gps;
+    gps.state.lat = -352809000;
+    gps.state.lng = 1491300000;
+    gps.state.alt = 580000;
+    gps.state.num_sats = 14;
+    gps.state.horizontal_accuracy = 1200;
+    gps.state.status = GPS_Status::GPS_OK_FIX_3D;
+    gps.publishFix();
+
+    NullLogSink nullSink;
+    LogWriter *writer = new LogWriter(&nullSink);
+    ReceiverRole *receiver = new ReceiverRole(protocol, &gps, TestConfig::defaults(), writer);
+
+    // A full frame as the radio delivers it
+    Protocol::TestPacket packet;
+    packet.magic = PacketHeader::MAGIC;
+    packet.version = PacketHeader::VERSION;
+    packet.type = PACKET_TYPE_DATA;
+    packet.satellites = 12;
+    packet.latitude_e7 = -352809000;
+    packet.longitude_e7 = 1491410000;
+    packet.altitude_mm = 610000;
+    packet.horizontalAccuracy_mm = 1500;
+    packet.clockOffset_us = PacketHeader::CLOCK_OFFSET_UNKNOWN;
+    packet.payloadLength = PACKET_SIZE;
+    memset(packet.payload, 0x5A, PACKET_SIZE);
+
+    uint8_t wire[PacketHeader::WIRE_SIZE + PACKET_SIZE];
+    size_t wireLength = packet.serialize(wire, sizeof(wire));
+    memcpy(wire + wireLength, packet.payload, packet.payloadLength);
+    wireLength += packet.payloadLength;
+    PacketView view;
+    if (!view.parse(wire, wireLength))
+    {
+        Serial.println("Receiver benchmark: Test frame rejected");
+        return;
+    }
+
+    ReceiverRole::ReceivedPacket received = {};
+    received.rx.rssi_dBm = -72;
+    received.rx.noiseFloor_dBm = -96;
+    received.rx.phyMode = RX_PHY_11B;
+    received.rx.bandwidth_MHz = 20;
+    received.rx.channel = WIFI_CHANNEL;
+    received.rx.perFrame = true;
+    memcpy(received.header, wire, PacketHeader::WIRE_SIZE);
+
+    // A full peer table, as with MAX_PEERS senders in the air
+    uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x00};
+    PeerAddress addresses[MAX_PEERS];
+    for (size_t i = 0; i < MAX_PEERS; i++)
+    {
+        mac[5] = (uint8_t)i;
+        addresses[i] = PeerAddress::fromMac(mac);
+        received.rx.source = addresses[i];
+        receiver->lookupPeer(received);
+    }
+    received.rx.source = addresses[0];
+    ReceiverRole::PeerState *peer = receiver->lookupPeer(received);
+
+    receiver->session.txPower_dBm = TX_POWER;
+    receiver->session.channel = WIFI_CHANNEL;
+    strncpy(receiver->session.protocolName, protocol->getProtocolName(), SessionLogRecord::NAME_SIZE - 1);
+
+    struct timeval tv_now;
+    gettimeofday(&tv_now, NULL);
+    int64_t now_us = (int64_t)tv_now.tv_sec * 1000000L + tv_now.tv_usec;
+
+    // Sequence numbers keep increasing across stages so every stage sees
+    // in-order packets, as in a loss-free run
+    uint32_t sequence = 0;
+
+    RxLogRecord record;
+    char csvLine[512];
+    uint8_t frame[RxLogRecord::BODY_SIZE + LogFrame::OVERHEAD];
+    size_t frameLength = 0;
+
+    bench.run("timestamp (gettimeofday)", [&](uint32_t)
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        int64_t timestamp_us = (int64_t)tv.tv_sec * 1000000L + tv.tv_usec;
+        benchKeep(timestamp_us);
+    });
+
+    bench.run("frame parse (PacketView)", [&](uint32_t)
+    {
+        PacketView parsed;
+        bool valid = parsed.parse(wire, wireLength);
+        benchKeep(valid);
+    });
+
+    bench.run("radio callback + queue pop", [&](uint32_t)
+    {
+        writeLE32(wire + 4, sequence++);
+        ReceiverRole::onPacketReceived(receiver, view, received.rx);
+        const ReceiverRole::ReceivedPacket *queued = receiver->rxQueue.front();
+        benchKeep(queued);
+        receiver->rxQueue.release();
+    });
+
+    bench.run("log record fill", [&](uint32_t)
+    {
+        writeLE32(received.header + 4, sequence++);
+        writeLE64(received.header + 8, (uint64_t)now_us);
+        received.receiverTimestamp_us = now_us + 1500;
+        receiver->fillRecord(received, record);
+        benchKeep(record);
+    });
+
+    bench.run("peer lookup", [&](uint32_t i)
+    {
+        received.rx.source = addresses[i % MAX_PEERS];
+        ReceiverRole::PeerState *found = receiver->lookupPeer(received);
+        benchKeep(found);
+    });
+    received.rx.source = addresses[0];
+
+    bench.run("sequence tracking", [&](uint32_t)
+    {
+        SequenceTracker<>::Result result = peer->sequenceTracker.add(sequence++);
+        benchKeep(result);
+    });
+
+    bench.run("latency histogram + jitter", [&](uint32_t i)
+    {
+        int64_t latency_us = 1200 + (i * 37) % 2000;
+        receiver->latencyHistogram.record(latency_us);
+        peer->latencyHistogram.record(latency_us);
+        peer->jitter.update(latency_us);
+    });
+
+    bench.run("step statistics", [&](uint32_t i)
+    {
+        StepReport report;
+        now_us += 1000;
+        bool finished = peer->stepStats.add(0, sequence++, PACKET_SIZE, now_us, 1200 + (i * 37) % 2000, report);
+        benchKeep(finished);
+    });
+
+    bench.run("distance (haversine)", [&](uint32_t i)
+    {
+        double distance_m = GPSHandler::calculateDistance(-35.2809, 149.1300, -35.2809, 149.1410 + i * 1e-7);
+        benchKeep(distance_m);
+    });
+
+#if RANGE_PROFILE_BINS > 0
+    // A packet lost every 50 leaves a gap in the profile's sender log; the
+    // stage's own tracker classifies the sequence numbers
+    SequenceTracker<> rangeTracker;
+    bench.run("range profile", [&](uint32_t i)
+    {
+        record.senderLongitude_e7 = 1491410000 + (int32_t)(i / 100); // New sender fix every 100 packets
+        float distance_m = receiver->peerDistance(*peer, record);
+        uint32_t rangeSequence = i + i / 50;
+        SequenceTracker<>::Result result = rangeTracker.add(rangeSequence);
+        receiver->rangeProfile.account(peer->rangeGaps, rangeTracker, result, rangeSequence, distance_m, -70,
+                                       1200 + (i * 37) % 2000);
+        benchKeep(distance_m);
+    });
+#endif
+
+    bench.run("CSV format (snprintf)", [&](uint32_t)
+    {
+        int length = ReceiverRole::formatCsvLine(record, receiver->session, csvLine, sizeof(csvLine));
+        benchKeep(length);
+    });
+
+    bench.run("CSV Serial write", [&](uint32_t)
+    {
+        Serial.println(csvLine);
+    });
+
+    bench.run("binary record encode", [&](uint32_t)
+    {
+        frameLength = ReceiverRole::encodeRxRecord(record, frame, sizeof(frame));
+        benchKeep(frameLength);
+    });
+
+    bench.run("binary LogWriter append", [&](uint32_t)
+    {
+        writer->append(frame, frameLength);
+        writer->poll();
+    });
+
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+    const char *processName = "processPacket (binary log)";
+#elif LOG_FORMAT == LOG_FORMAT_NONE
+    const char *processName = "processPacket (no log)";
+#else
+    const char *processName = "processPacket (CSV log)";
+#endif
+
+    bench.run(processName, [&](uint32_t)
+    {
+        now_us += 1000;
+        writeLE32(received.header + 4, sequence++);
+        writeLE64(received.header + 8, (uint64_t)now_us);
+        received.receiverTimestamp_us = now_us + 1500;
+        receiver->processPacket(received);
+#if LOG_FORMAT != LOG_FORMAT_NONE
+        writer->poll();
+#endif
+    });
+
+    delete receiver;
+    delete writer;
+    delete protocol;
+}
+
+void ReceiverBenchmark::printResults(Print &out) const
+{
+    out.printf("Receiver benchmark: %lu iterations per stage, PACKET_SIZE %d\n",
+               (unsigned long)bench.getIterations(), PACKET_SIZE);
+    out.printf("%-32s %12s %12s %10s\n", "Stage", "ns/op", "cycles/op", "allocs/op");
+
+    for (size_t i = 0; i < bench.size(); i++)
+    {
+        const BenchResult &result = bench.result(i);
+
+        char cycles[16] = "-";
+        char allocs[16] = "-";
+        if (result.cyclesPerOp >= 0)
+        {
+            snprintf(cycles, sizeof(cycles), "%.0f", result.cyclesPerOp);
+        }
+        if (result.allocsPerOp >= 0)
+        {
+            snprintf(allocs, sizeof(allocs), "%.2f", result.allocsPerOp);
+        }
+
+        out.printf("%-32s %12.1f %12s %10s\n", result.name, result.nsPerOp, cycles, allocs);
+    }
+}
+
+#if defined(ESP_PLATFORM)
+static int64_t espNowNanos()
+{
+    return esp_timer_get_time() * 1000;
+}
+
+static uint32_t espCycleCount()
+{
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+
+BenchCounters espBenchCounters()
+{
+    BenchCounters counters = {espNowNanos, espCycleCount, nullptr};
+    return counters;
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef RECEIVER_BENCHMARK_H
+#define RECEIVER_BENCHMARK_H
+
+#include <Arduino.h>
+#include "microbench.h"
+
+// Cost of each stage of the receiver's per-packet path: frame validation,
+// timestamping and queueing in the radio callback, log record fill, peer
+// lookup in a full table, loss/latency/step statistics, distance, CSV
+// formatting and Serial write, binary record encoding and batching, and
+// processPacket() as a whole for the configured LOG_FORMAT.
+//
+// Runs on the host (tools/bench) and on target (RECEIVER_BENCHMARK build),
+// so changes to the receive path can be compared against a baseline.
+class ReceiverBenchmark
+{
+public:
+    ReceiverBenchmark(const BenchCounters &counters, uint32_t iterations);
+
+    // Run every stage. Stages that write to Serial produce log output.
+    void run();
+
+    // Print a table of the results
+    void printResults(Print &out) const;
+
+private:
+    MicroBench bench;
+};
+
+#if defined(ESP_PLATFORM)
+// esp_timer for time and the RISC-V cycle counter; allocations are not counted
+BenchCounters espBenchCounters();
+#endif
+
+#endif // RECEIVER_BENCHMARK_H
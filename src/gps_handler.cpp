@@ -1,11 +1,7 @@
 #include "gps_handler.h"
-#include <cmath>
+#include "util/geo.h"
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-GPSHandler::GPSHandler() : gpsSerial(nullptr) {}
+GPSHandler::GPSHandler() : gpsSerial(nullptr), published() {}
 
 GPSHandler::~GPSHandler()
 {
@@ -25,36 +21,42 @@ void GPSHandler::update()
         return; // Not initialized
 
     AP_GPS_UBLOX::update();
+    publishFix();
+}
+
+void GPSHandler::publishFix()
+{
+    Fix fix;
+    fix.valid = this->state.status >= GPS_Status::GPS_OK_FIX_3D;
+    fix.latitude_e7 = this->state.lat;
+    fix.longitude_e7 = this->state.lng;
+    fix.altitude_mm = this->state.alt;
+    fix.horizontalAccuracy_mm = this->state.horizontal_accuracy;
+    fix.satellites = this->state.num_sats;
+    fix.timeWeek = this->state.time_week;
+    fix.timeWeek_ms = this->state.time_week_ms;
+
+    portENTER_CRITICAL(&fixLock);
+    published = fix;
+    portEXIT_CRITICAL(&fixLock);
+}
+
+GPSHandler::Fix GPSHandler::fix() const
+{
+    portENTER_CRITICAL(&fixLock);
+    Fix copy = published;
+    portEXIT_CRITICAL(&fixLock);
+    return copy;
 }
 
 bool GPSHandler::hasFix() const
 {
-    return this->state.status >= GPS_Status::GPS_OK_FIX_3D;
+    return fix().valid;
 }
 
 double GPSHandler::calculateDistance(double lat1, double lon1, double lat2, double lon2)
 {
-    const double earthRadiusKm = 6371.0;
-
-    // Convert degrees to radians
-    lat1 = lat1 * M_PI / 180.0;
-    lon1 = lon1 * M_PI / 180.0;
-    lat2 = lat2 * M_PI / 180.0;
-    lon2 = lon2 * M_PI / 180.0;
-
-    // Differences
-    double dLat = lat2 - lat1;
-    double dLon = lon2 - lon1;
-
-    // Haversine formula
-    double a = sin(dLat / 2) * sin(dLat / 2) +
-               cos(lat1) * cos(lat2) *
-                   sin(dLon / 2) * sin(dLon / 2);
-    double c = 2 * atan2(sqrt(a), sqrt(1 - a));
-    double distance = earthRadiusKm * c;
-
-    // Convert to meters
-    return distance * 1000.0;
+    return haversineDistance(lat1, lon1, lat2, lon2);
 }
 
 void GPSHandler::I_setBaud(int baud)
@@ -8,12 +8,36 @@
 class GPSHandler : public AP_GPS_UBLOX
 {
 public:
+    // The solution fields the roles use, published after every update() so
+    // other tasks never read the UBX parser's state while it is being written
+    struct Fix
+    {
+        bool valid; // 3D fix or better
+        int32_t latitude_e7;
+        int32_t longitude_e7;
+        int32_t altitude_mm;
+        uint32_t horizontalAccuracy_mm;
+        uint8_t satellites;
+        uint16_t timeWeek; // 0 until the receiver knows GPS time
+        uint32_t timeWeek_ms;
+    };
+
     GPSHandler();
     ~GPSHandler();
 
     void begin(HardwareSerial *serial);
+
+    // Parse the UART and publish the solution. GPS task only; other tasks
+    // read the published fix.
     void update();
 
+    // Latest published solution, from any task
+    Fix fix() const;
+
+    // Copy the parser's state into the published fix. update() does this;
+    // call it directly after filling in state by hand.
+    void publishFix();
+
     // Calculate distance between two GPS points using Haversine formula
     static double calculateDistance(double lat1, double lon1, double lat2, double lon2);
 
@@ -23,6 +47,12 @@ public:
 private:
     HardwareSerial *gpsSerial = nullptr;
 
+    // Published solution, copied in and out under the lock. Readers outrank
+    // the GPS task, so on one core a retrying (seqlock) reader could spin
+    // while the writer it preempted never finishes.
+    Fix published;
+    mutable portMUX_TYPE fixLock = portMUX_INITIALIZER_UNLOCKED;
+
     // Implementation of AP_GPS_UBLOX pure virtual methods
     void I_setBaud(int baud) override;
     int I_read(uint8_t *data, size_t len) override;
@@ -0,0 +1,154 @@
+#include "file_log_sink.h"
+#include <dirent.h>
+#include <errno.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FileLogSink::FileLogSink(const char *directory, uint32_t segmentSize, uint32_t maxFiles)
+    : segmentSize(segmentSize), maxFiles(maxFiles), file(nullptr), fileBytes(0), firstNumber(0), currentNumber(0)
+{
+    strncpy(this->directory, directory, sizeof(this->directory) - 1);
+    this->directory[sizeof(this->directory) - 1] = '\0';
+}
+
+FileLogSink::~FileLogSink()
+{
+    if (file)
+    {
+        sync();
+        fclose(file);
+    }
+}
+
+bool FileLogSink::begin()
+{
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+    {
+        return false;
+    }
+
+    DIR *dir = opendir(directory);
+    if (!dir)
+    {
+        return false;
+    }
+
+    // Pick up numbering after the files a previous run left
+    firstNumber = 0;
+    currentNumber = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        unsigned long number;
+        char suffix[8];
+        if (sscanf(entry->d_name, "LOG%5lu.%3s", &number, suffix) != 2 || number == 0 ||
+            strcasecmp(suffix, "BIN") != 0)
+        {
+            continue;
+        }
+
+        if (firstNumber == 0 || number < firstNumber)
+        {
+            firstNumber = (uint32_t)number;
+        }
+        if (number > currentNumber)
+        {
+            currentNumber = (uint32_t)number;
+        }
+    }
+    closedir(dir);
+
+    return true;
+}
+
+bool FileLogSink::startSession()
+{
+    return openNext();
+}
+
+size_t FileLogSink::write(const uint8_t *data, size_t length)
+{
+    // Records before the first session still need a file; a full segment continues in the next
+    if ((!file || (segmentSize > 0 && fileBytes + length > segmentSize && fileBytes > 0)) && !openNext())
+    {
+        return 0;
+    }
+
+    size_t written = fwrite(data, 1, length, file);
+    fileBytes += written;
+    return written;
+}
+
+bool FileLogSink::sync()
+{
+    if (!file)
+    {
+        return true;
+    }
+
+    return fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+uint32_t FileLogSink::getFileNumber() const
+{
+    return file ? currentNumber : 0;
+}
+
+void FileLogSink::filePath(uint32_t number, char *path, size_t length) const
+{
+    snprintf(path, length, "%s/LOG%05lu.BIN", directory, (unsigned long)number);
+}
+
+void FileLogSink::setLimits(uint32_t segmentSize, uint32_t maxFiles)
+{
+    this->segmentSize = segmentSize;
+    this->maxFiles = maxFiles;
+}
+
+bool FileLogSink::openNext()
+{
+    if (file)
+    {
+        sync();
+        fclose(file);
+        file = nullptr;
+    }
+
+    // Five digits in the name; wrapping would overwrite the oldest captures
+    if (currentNumber >= 99999)
+    {
+        return false;
+    }
+
+    currentNumber++;
+    if (firstNumber == 0)
+    {
+        firstNumber = currentNumber;
+    }
+
+    char path[96];
+    filePath(currentNumber, path, sizeof(path));
+    file = fopen(path, "wb");
+    fileBytes = 0;
+    if (!file)
+    {
+        return false;
+    }
+
+    prune();
+    return true;
+}
+
+void FileLogSink::prune()
+{
+    while (maxFiles > 0 && currentNumber - firstNumber + 1 > maxFiles)
+    {
+        char path[96];
+        filePath(firstNumber, path, sizeof(path));
+        remove(path); // Numbers can have gaps; a missing file is fine
+        firstNumber++;
+    }
+}
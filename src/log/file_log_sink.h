@@ -0,0 +1,65 @@
+#ifndef FILE_LOG_SINK_H
+#define FILE_LOG_SINK_H
+
+#include <stdio.h>
+#include "log_sink.h"
+
+// Sink writing numbered files in a directory through stdio: on the host,
+// and on the ESP32 under an SD card or LittleFS mount point.
+//
+// Every session starts a new file, LOGnnnnn.BIN (8.3 names for FAT), and
+// numbering continues from the highest file already there, so a reboot
+// never overwrites an earlier capture. With a segment size, a file that
+// reaches it continues in the next file. With a file limit, the oldest
+// files are deleted to stay within it, turning the directory into a ring.
+class FileLogSink : public LogSink
+{
+public:
+    // segmentSize 0 keeps a session in one file; maxFiles 0 keeps every file
+    FileLogSink(const char *directory, uint32_t segmentSize = 0, uint32_t maxFiles = 0);
+    virtual ~FileLogSink();
+
+    // Create the directory and find the files already in it
+    virtual bool begin() override;
+
+    virtual bool startSession() override;
+    virtual size_t write(const uint8_t *data, size_t length) override;
+
+    // Flush stdio's buffer and fsync() the file
+    virtual bool sync() override;
+
+    virtual const char *getName() const override
+    {
+        return "file";
+    }
+
+    // Number of the file being written, 0 before the first write
+    uint32_t getFileNumber() const;
+
+    // Full path of file number n
+    void filePath(uint32_t number, char *path, size_t length) const;
+
+protected:
+    // For sinks that learn the medium's size in begin()
+    void setLimits(uint32_t segmentSize, uint32_t maxFiles);
+
+private:
+    char directory[64];
+    uint32_t segmentSize;
+    uint32_t maxFiles;
+
+    FILE *file;
+    uint32_t fileBytes;
+
+    // Oldest file kept and the file being written; both 0 when there are none
+    uint32_t firstNumber;
+    uint32_t currentNumber;
+
+    // Close the current file and open the next number
+    bool openNext();
+
+    // Delete the oldest files beyond maxFiles
+    void prune();
+};
+
+#endif // FILE_LOG_SINK_H
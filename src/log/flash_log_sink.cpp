@@ -0,0 +1,29 @@
+#include "flash_log_sink.h"
+#include <LittleFS.h>
+#include "config.h"
+
+FlashLogSink::FlashLogSink() : FileLogSink("/littlefs/rangetest")
+{
+}
+
+bool FlashLogSink::begin()
+{
+    if (!LittleFS.begin(true, "/littlefs"))
+    {
+        Serial.println("Flash log: Mount failed (is there a LittleFS partition?)");
+        return false;
+    }
+
+    // At least two files, so the one being written is never the only one left
+    uint32_t files = (uint32_t)((uint64_t)LittleFS.totalBytes() * LOG_FLASH_USAGE_PERCENT / 100 / LOG_SEGMENT_SIZE);
+    if (files < 2)
+    {
+        files = 2;
+    }
+    setLimits(LOG_SEGMENT_SIZE, files);
+
+    Serial.printf("Flash log: %lu KB partition, ring of %lu files of %lu KB\n",
+                  (unsigned long)(LittleFS.totalBytes() / 1024), (unsigned long)files,
+                  (unsigned long)(LOG_SEGMENT_SIZE / 1024));
+    return FileLogSink::begin();
+}
@@ -0,0 +1,27 @@
+#ifndef FLASH_LOG_SINK_H
+#define FLASH_LOG_SINK_H
+
+#include "file_log_sink.h"
+
+// Ring log in the internal flash LittleFS partition, mounted at /littlefs.
+//
+// Files are cut at LOG_SEGMENT_SIZE and the oldest is deleted once they
+// would use more than LOG_FLASH_USAGE_PERCENT of the partition, so a long
+// run keeps its most recent records. LittleFS spreads the writes over the
+// whole partition; full blocks and infrequent syncs keep the erase count low.
+class FlashLogSink : public FileLogSink
+{
+public:
+    FlashLogSink();
+
+    // Mount the partition, formatting it if it has never been used, and
+    // size the ring to it
+    virtual bool begin() override;
+
+    virtual const char *getName() const override
+    {
+        return "flash";
+    }
+};
+
+#endif // FLASH_LOG_SINK_H
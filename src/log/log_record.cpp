@@ -0,0 +1,282 @@
+#include "log_record.h"
+#include "../util/byte_order.h"
+#include "../util/crc16.h"
+#include <string.h>
+
+size_t LogFrame::encode(uint8_t type, const uint8_t *body, size_t bodyLength, uint8_t *out, size_t outLength)
+{
+    if (bodyLength > MAX_BODY_SIZE || outLength < bodyLength + OVERHEAD)
+    {
+        return 0;
+    }
+
+    out[0] = SYNC0;
+    out[1] = SYNC1;
+    out[2] = type;
+    out[3] = (uint8_t)bodyLength;
+    if (body != out + HEADER_SIZE)
+    {
+        memcpy(out + HEADER_SIZE, body, bodyLength);
+    }
+
+    // CRC covers type, length and body
+    uint16_t crc = crc16(out + 2, bodyLength + 2);
+    writeLE16(out + HEADER_SIZE + bodyLength, crc);
+
+    return bodyLength + OVERHEAD;
+}
+
+int LogFrame::decode(const uint8_t *data, size_t length, uint8_t &type, const uint8_t *&body, size_t &bodyLength)
+{
+    if (length < 2)
+    {
+        return 0;
+    }
+
+    if (data[0] != SYNC0 || data[1] != SYNC1)
+    {
+        return -1;
+    }
+
+    if (length < HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    size_t frameLength = data[3] + OVERHEAD;
+    if (length < frameLength)
+    {
+        return 0;
+    }
+
+    uint16_t crc = crc16(data + 2, data[3] + 2);
+    if (crc != readLE16(data + HEADER_SIZE + data[3]))
+    {
+        return -1;
+    }
+
+    type = data[2];
+    body = data + HEADER_SIZE;
+    bodyLength = data[3];
+
+    return (int)frameLength;
+}
+
+size_t SessionLogRecord::encode(uint8_t *body) const
+{
+    body[0] = protocolType;
+    body[1] = (uint8_t)txPower_dBm;
+    body[2] = channel;
+    body[3] = aggregateRecords;
+    writeLE16(body + 4, packetSize);
+    writeLE16(body + 6, packetRate);
+    memcpy(body + 8, protocolName, NAME_SIZE);
+    writeLE32(body + 40, sweepSlot);
+    writeLE32(body + 44, protocolStart_ms);
+    writeLE16(body + 48, aggregateFlush_ms);
+    body[50] = espnowUnicast;
+    body[51] = espnowRate;
+    body[52] = espnowRetries;
+
+    return BODY_SIZE;
+}
+
+bool SessionLogRecord::decode(const uint8_t *body, size_t length)
+{
+    if (length != BODY_SIZE)
+    {
+        return false;
+    }
+
+    protocolType = body[0];
+    txPower_dBm = (int8_t)body[1];
+    channel = body[2];
+    aggregateRecords = body[3];
+    packetSize = readLE16(body + 4);
+    packetRate = readLE16(body + 6);
+    memcpy(protocolName, body + 8, NAME_SIZE);
+    protocolName[NAME_SIZE - 1] = '\0';
+    sweepSlot = readLE32(body + 40);
+    protocolStart_ms = readLE32(body + 44);
+    aggregateFlush_ms = readLE16(body + 48);
+    espnowUnicast = body[50];
+    espnowRate = body[51];
+    espnowRetries = body[52];
+
+    return true;
+}
+
+size_t RxLogRecord::encode(uint8_t *body) const
+{
+    writeLE32(body + 0, receiverMillis);
+    writeLE32(body + 4, sequenceNumber);
+    writeLE64(body + 8, (uint64_t)senderTimestamp_us);
+    writeLE64(body + 16, (uint64_t)receiverTimestamp_us);
+    writeLE32(body + 24, (uint32_t)receiverLatitude_e7);
+    writeLE32(body + 28, (uint32_t)receiverLongitude_e7);
+    writeLE32(body + 32, (uint32_t)receiverAltitude_mm);
+    writeLE32(body + 36, receiverHorizontalAccuracy_mm);
+    writeLE32(body + 40, (uint32_t)senderLatitude_e7);
+    writeLE32(body + 44, (uint32_t)senderLongitude_e7);
+    writeLE32(body + 48, (uint32_t)senderAltitude_mm);
+    writeLE32(body + 52, senderHorizontalAccuracy_mm);
+    body[56] = receiverSatellites;
+    body[57] = senderSatellites;
+    body[58] = (uint8_t)rssi_dBm;
+    body[59] = stepId;
+    writeLE32(body + 60, (uint32_t)sendLag_us);
+    writeLE32(body + 64, (uint32_t)clockOffset_us);
+    body[68] = (uint8_t)noiseFloor_dBm;
+    body[69] = phyMode;
+    body[70] = phyRate;
+    body[71] = bandwidth_MHz;
+    writeLE32(body + 72, radioTimestamp_us);
+    writeLE16(body + 76, nodeId);
+    body[78] = aggregateCount;
+    writeLE32(body + 79, (uint32_t)batchDelay_us);
+
+    return BODY_SIZE;
+}
+
+bool RxLogRecord::decode(const uint8_t *body, size_t length)
+{
+    if (length != BODY_SIZE)
+    {
+        return false;
+    }
+
+    receiverMillis = readLE32(body + 0);
+    sequenceNumber = readLE32(body + 4);
+    senderTimestamp_us = (int64_t)readLE64(body + 8);
+    receiverTimestamp_us = (int64_t)readLE64(body + 16);
+    receiverLatitude_e7 = (int32_t)readLE32(body + 24);
+    receiverLongitude_e7 = (int32_t)readLE32(body + 28);
+    receiverAltitude_mm = (int32_t)readLE32(body + 32);
+    receiverHorizontalAccuracy_mm = readLE32(body + 36);
+    senderLatitude_e7 = (int32_t)readLE32(body + 40);
+    senderLongitude_e7 = (int32_t)readLE32(body + 44);
+    senderAltitude_mm = (int32_t)readLE32(body + 48);
+    senderHorizontalAccuracy_mm = readLE32(body + 52);
+    receiverSatellites = body[56];
+    senderSatellites = body[57];
+    rssi_dBm = (int8_t)body[58];
+    stepId = body[59];
+    sendLag_us = (int32_t)readLE32(body + 60);
+    clockOffset_us = (int32_t)readLE32(body + 64);
+    noiseFloor_dBm = (int8_t)body[68];
+    phyMode = body[69];
+    phyRate = body[70];
+    bandwidth_MHz = body[71];
+    radioTimestamp_us = readLE32(body + 72);
+    nodeId = readLE16(body + 76);
+    aggregateCount = body[78];
+    batchDelay_us = (int32_t)readLE32(body + 79);
+
+    return true;
+}
+
+size_t LinkLogRecord::encode(uint8_t *body) const
+{
+    body[0] = type;
+    body[1] = reason;
+    writeLE16(body + 2, 0); // Reserved
+    writeLE32(body + 4, receiverMillis);
+    writeLE32(body + 8, duration_ms);
+
+    return BODY_SIZE;
+}
+
+bool LinkLogRecord::decode(const uint8_t *body, size_t length)
+{
+    if (length != BODY_SIZE)
+    {
+        return false;
+    }
+
+    type = body[0];
+    reason = body[1];
+    receiverMillis = readLE32(body + 4);
+    duration_ms = readLE32(body + 8);
+
+    return true;
+}
+
+size_t TxLogRecord::encode(uint8_t *body) const
+{
+    writeLE32(body + 0, senderMillis);
+    writeLE32(body + 4, sequenceNumber);
+    writeLE64(body + 8, (uint64_t)senderTimestamp_us);
+    writeLE64(body + 16, (uint64_t)scheduled_us);
+    writeLE32(body + 24, (uint32_t)sendLag_us);
+    writeLE32(body + 28, sendDuration_us);
+    writeLE32(body + 32, (uint32_t)latitude_e7);
+    writeLE32(body + 36, (uint32_t)longitude_e7);
+    writeLE32(body + 40, (uint32_t)altitude_mm);
+    writeLE16(body + 44, nodeId);
+    writeLE16(body + 46, payloadLength);
+    body[48] = stepId;
+    body[49] = packetType;
+    body[50] = result;
+    body[51] = satellites;
+    body[52] = inFlight;
+
+    return BODY_SIZE;
+}
+
+bool TxLogRecord::decode(const uint8_t *body, size_t length)
+{
+    if (length != BODY_SIZE)
+    {
+        return false;
+    }
+
+    senderMillis = readLE32(body + 0);
+    sequenceNumber = readLE32(body + 4);
+    senderTimestamp_us = (int64_t)readLE64(body + 8);
+    scheduled_us = (int64_t)readLE64(body + 16);
+    sendLag_us = (int32_t)readLE32(body + 24);
+    sendDuration_us = readLE32(body + 28);
+    latitude_e7 = (int32_t)readLE32(body + 32);
+    longitude_e7 = (int32_t)readLE32(body + 36);
+    altitude_mm = (int32_t)readLE32(body + 40);
+    nodeId = readLE16(body + 44);
+    payloadLength = readLE16(body + 46);
+    stepId = body[48];
+    packetType = body[49];
+    result = body[50];
+    satellites = body[51];
+    inFlight = body[52];
+
+    return true;
+}
+
+size_t TxDoneLogRecord::encode(uint8_t *body) const
+{
+    writeLE32(body + 0, senderMillis);
+    writeLE32(body + 4, sequenceNumber);
+    writeLE64(body + 8, (uint64_t)queued_us);
+    writeLE32(body + 16, latency_us);
+    writeLE16(body + 20, nodeId);
+    body[22] = attempts;
+    body[23] = delivered;
+
+    return BODY_SIZE;
+}
+
+bool TxDoneLogRecord::decode(const uint8_t *body, size_t length)
+{
+    if (length != BODY_SIZE)
+    {
+        return false;
+    }
+
+    senderMillis = readLE32(body + 0);
+    sequenceNumber = readLE32(body + 4);
+    queued_us = (int64_t)readLE64(body + 8);
+    latency_us = readLE32(body + 16);
+    nodeId = readLE16(body + 20);
+    attempts = body[22];
+    delivered = body[23];
+
+    return true;
+}
@@ -0,0 +1,183 @@
+#ifndef LOG_RECORD_H
+#define LOG_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary log records.
+//
+// Every record is framed as:
+//   sync (2 bytes, 0xA5 0x5A) | type (1) | body length (1) | body | CRC-16 (2, LE)
+// The CRC covers type, length and body. Bodies are fixed width per record type
+// and little-endian, so a decoder can resynchronise on the sync bytes after
+// corruption or interleaved console text.
+//
+// This header has no Arduino dependencies so the host decoder can share it.
+
+enum LogRecordType : uint8_t
+{
+    LOG_RECORD_SESSION = 1, // Per-session constants (protocol, channel, TX power)
+    LOG_RECORD_RX = 2,      // One received test packet
+    LOG_RECORD_LINK = 3,    // Link availability: first frame, association lost or restored
+    LOG_RECORD_TX = 4,      // One test packet handed to the protocol (sender)
+    LOG_RECORD_TX_DONE = 5  // Driver's outcome for one sent frame (sender, ESP-NOW)
+};
+
+struct LogFrame
+{
+    static const uint8_t SYNC0 = 0xA5;
+    static const uint8_t SYNC1 = 0x5A;
+    static const size_t HEADER_SIZE = 4;
+    static const size_t TRAILER_SIZE = 2;
+    static const size_t OVERHEAD = HEADER_SIZE + TRAILER_SIZE;
+    static const size_t MAX_BODY_SIZE = 255;
+
+    // Wrap an encoded body into a frame. Returns the frame length, or 0 if
+    // the output buffer is too small. A body already encoded at
+    // out + HEADER_SIZE is framed in place without a copy.
+    static size_t encode(uint8_t type, const uint8_t *body, size_t bodyLength, uint8_t *out, size_t outLength);
+
+    // Try to decode a frame at the start of data. Returns the total frame
+    // length on success, 0 if more bytes are needed, or -1 if the bytes at
+    // data do not start a valid frame (the caller should skip one byte).
+    static int decode(const uint8_t *data, size_t length, uint8_t &type, const uint8_t *&body, size_t &bodyLength);
+};
+
+// Per-session constants, written at session start and repeated periodically
+// so a capture that starts late can still be decoded
+struct SessionLogRecord
+{
+    static const size_t NAME_SIZE = 32;
+    static const size_t BODY_SIZE = 53;
+
+    // Slot of a session that is not part of a protocol sweep
+    static const uint32_t NO_SLOT = 0xFFFFFFFF;
+
+    uint8_t protocolType;
+    int8_t txPower_dBm;
+    uint8_t channel;
+    uint16_t packetSize;
+    uint16_t packetRate;
+    char protocolName[NAME_SIZE]; // NUL-padded
+    uint32_t sweepSlot;           // Slot number since the epoch, NO_SLOT if not sweeping
+    uint32_t protocolStart_ms;    // Time the protocol took to start (association for Wi-Fi)
+    uint8_t aggregateRecords;     // Sender's packets per frame, 1 without aggregation
+    uint16_t aggregateFlush_ms;   // Sender's aggregate flush deadline
+    uint8_t espnowUnicast;        // 1 if ESP-NOW senders unicast to the receiver
+    uint8_t espnowRate;           // ESP-NOW wifi_phy_rate_t, 0xFF for the driver's default
+    uint8_t espnowRetries;        // Extra sends of unacknowledged unicast frames
+
+    size_t encode(uint8_t *body) const;
+    bool decode(const uint8_t *body, size_t length);
+};
+
+// One received packet. Latency and distance are derived by the decoder.
+struct RxLogRecord
+{
+    static const size_t BODY_SIZE = 83;
+
+    uint32_t receiverMillis;
+    uint32_t sequenceNumber;
+    int64_t senderTimestamp_us;
+    int64_t receiverTimestamp_us;
+    int32_t receiverLatitude_e7;
+    int32_t receiverLongitude_e7;
+    int32_t receiverAltitude_mm;
+    uint32_t receiverHorizontalAccuracy_mm;
+    int32_t senderLatitude_e7;
+    int32_t senderLongitude_e7;
+    int32_t senderAltitude_mm;
+    uint32_t senderHorizontalAccuracy_mm;
+    uint8_t receiverSatellites;
+    uint8_t senderSatellites;
+    int8_t rssi_dBm;
+    uint8_t stepId;
+    int32_t sendLag_us;
+    int32_t clockOffset_us; // Sender's estimate, INT32_MIN if none
+    int8_t noiseFloor_dBm;  // 0 if unknown
+    uint8_t phyMode;        // RxPhyMode
+    uint8_t phyRate;
+    uint8_t bandwidth_MHz;
+    uint32_t radioTimestamp_us;
+    uint16_t nodeId;        // Sender's node id
+    uint8_t aggregateCount; // Packets in the frame that carried this one
+    int32_t batchDelay_us;  // Time it waited on the sender for that frame
+
+    // Receiver minus sender timestamp, 0 if either is missing
+    int64_t latency_us() const
+    {
+        return (receiverTimestamp_us != 0 && senderTimestamp_us != 0) ? receiverTimestamp_us - senderTimestamp_us : 0;
+    }
+
+    size_t encode(uint8_t *body) const;
+    bool decode(const uint8_t *body, size_t length);
+};
+
+// One link event, mirroring Protocol::LinkEvent
+struct LinkLogRecord
+{
+    static const size_t BODY_SIZE = 12;
+
+    uint8_t type;          // Protocol::LinkEventType
+    uint8_t reason;        // Driver's disconnect reason, 0 if none
+    uint32_t receiverMillis;
+    uint32_t duration_ms;  // Time to first frame, or the outage a link-up ends
+
+    size_t encode(uint8_t *body) const;
+    bool decode(const uint8_t *body, size_t length);
+};
+
+// One test packet the sender handed to the protocol, whether or not it
+// went out. Joined with the receiver's RX records on node id, sequence
+// number and sender timestamp.
+struct TxLogRecord
+{
+    static const size_t BODY_SIZE = 53;
+
+    enum Result : uint8_t
+    {
+        SENT = 0,   // The driver took the frame
+        QUEUED = 1, // Added to an aggregate frame, which goes out later
+        FAILED = 2  // Refused: driver queue full, error, or too many frames in flight
+    };
+
+    uint32_t senderMillis;
+    uint32_t sequenceNumber;
+    int64_t senderTimestamp_us; // As in the packet header, wall clock
+    int64_t scheduled_us;       // Deadline on the sender's monotonic clock
+    int32_t sendLag_us;         // Actual send time minus the deadline
+    uint32_t sendDuration_us;   // Time the protocol's send call took
+    int32_t latitude_e7;        // Sender position
+    int32_t longitude_e7;
+    int32_t altitude_mm;
+    uint16_t nodeId;
+    uint16_t payloadLength;
+    uint8_t stepId;
+    uint8_t packetType;         // PacketType
+    uint8_t result;             // Result
+    uint8_t satellites;
+    uint8_t inFlight;           // Frames awaiting completion before this one, capped at 255
+
+    size_t encode(uint8_t *body) const;
+    bool decode(const uint8_t *body, size_t length);
+};
+
+// The driver's outcome for one frame, mirroring TxTracker::Completion. An
+// aggregate frame is reported once, under its first packet's sequence number.
+struct TxDoneLogRecord
+{
+    static const size_t BODY_SIZE = 24;
+
+    uint32_t senderMillis;
+    uint32_t sequenceNumber;
+    int64_t queued_us;   // Handed to the driver, sender's monotonic clock
+    uint32_t latency_us; // Until the driver's last report
+    uint16_t nodeId;
+    uint8_t attempts;    // Including retries of unacknowledged unicast frames
+    uint8_t delivered;   // MAC ACK for unicast; broadcast frames always succeed
+
+    size_t encode(uint8_t *body) const;
+    bool decode(const uint8_t *body, size_t length);
+};
+
+#endif // LOG_RECORD_H
@@ -0,0 +1,67 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <Arduino.h>
+
+// Destination for the log writer's blocks: the serial port, a file on an SD
+// card, a ring of files in internal flash, or a file on the host.
+//
+// Only the log writer's consumer calls a sink (the log task, or poll() when
+// there is none), so a sink may block for as long as its medium needs.
+class LogSink
+{
+public:
+    virtual ~LogSink() {}
+
+    // Prepare the medium: mount it, find where the last run stopped. False
+    // if it cannot be written.
+    virtual bool begin() = 0;
+
+    // Start a new file for the next test session; streams ignore it
+    virtual bool startSession()
+    {
+        return true;
+    }
+
+    // Write a block, returning the bytes written
+    virtual size_t write(const uint8_t *data, size_t length) = 0;
+
+    // Commit what has been written to the medium; streams ignore it
+    virtual bool sync()
+    {
+        return true;
+    }
+
+    // Short name for the console: serial, sd, flash or file
+    virtual const char *getName() const = 0;
+};
+
+// Sink that streams to a Print, normally Serial: the default, with the
+// capture taken on the host
+class PrintLogSink : public LogSink
+{
+public:
+    explicit PrintLogSink(Print *output) : output(output)
+    {
+    }
+
+    virtual bool begin() override
+    {
+        return output != nullptr;
+    }
+
+    virtual size_t write(const uint8_t *data, size_t length) override
+    {
+        return output->write(data, length);
+    }
+
+    virtual const char *getName() const override
+    {
+        return "serial";
+    }
+
+private:
+    Print *output;
+};
+
+#endif // LOG_SINK_H
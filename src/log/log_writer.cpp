@@ -0,0 +1,151 @@
+#include "log_writer.h"
+#include <esp_timer.h>
+
+LogWriter::LogWriter(LogSink *sink)
+    : sink(sink), wakeCallback(nullptr), wakeContext(nullptr), filling(nullptr), fillStartMs(0),
+      sessionPending(false), droppedRecords(0), lastSyncMs(0), stats()
+{
+}
+
+LogSink *LogWriter::getSink() const
+{
+    return sink;
+}
+
+void LogWriter::setWakeCallback(WakeCallback callback, void *context)
+{
+    wakeCallback = callback;
+    wakeContext = context;
+}
+
+bool LogWriter::append(const uint8_t *data, size_t length)
+{
+    if (length > LOG_BLOCK_SIZE)
+    {
+        droppedRecords++;
+        return false;
+    }
+
+    // Records never span blocks, so a block always holds whole records
+    if (filling && filling->length + length > LOG_BLOCK_SIZE)
+    {
+        handOver();
+    }
+
+    if (!filling)
+    {
+        filling = blocks.acquire();
+        if (!filling)
+        {
+            droppedRecords++;
+            return false;
+        }
+
+        filling->length = 0;
+        filling->newSession = sessionPending;
+        sessionPending = false;
+        fillStartMs = millis();
+    }
+
+    memcpy(&filling->data[filling->length], data, length);
+    filling->length += length;
+    return true;
+}
+
+void LogWriter::startSession()
+{
+    if (filling)
+    {
+        handOver();
+    }
+    sessionPending = true;
+}
+
+void LogWriter::poll()
+{
+    // Age out a partially filled block so records do not sit in RAM forever
+    if (filling && millis() - fillStartMs >= LOG_FLUSH_INTERVAL_MS)
+    {
+        handOver();
+    }
+
+    if (!wakeCallback)
+    {
+        drain();
+    }
+}
+
+void LogWriter::drain()
+{
+    const Block *block;
+    while ((block = blocks.front()) != nullptr)
+    {
+        int64_t start_us = esp_timer_get_time();
+
+        if (block->newSession)
+        {
+            sink->startSession();
+        }
+
+        if (sink->write(block->data, block->length) != block->length)
+        {
+            stats.writeErrors++;
+        }
+        stats.blocks++;
+        stats.bytes += block->length;
+
+        // Sync on time rather than per block, so a slow medium is not
+        // asked to commit every few hundred bytes at low packet rates
+        if (millis() - lastSyncMs >= LOG_SYNC_INTERVAL_MS)
+        {
+            lastSyncMs = millis();
+            sink->sync();
+            stats.syncs++;
+        }
+
+        uint32_t write_us = (uint32_t)(esp_timer_get_time() - start_us);
+        if (write_us > stats.maxWrite_us)
+        {
+            stats.maxWrite_us = write_us;
+        }
+
+        blocks.release();
+    }
+}
+
+void LogWriter::flush()
+{
+    if (filling)
+    {
+        handOver();
+    }
+
+    if (!wakeCallback)
+    {
+        drain();
+    }
+}
+
+uint32_t LogWriter::getDroppedRecords() const
+{
+    return droppedRecords;
+}
+
+LogWriter::Stats LogWriter::getStats() const
+{
+    Stats snapshot = stats;
+    snapshot.droppedRecords = droppedRecords;
+    snapshot.maxQueued = blocks.highWaterMark();
+    return snapshot;
+}
+
+void LogWriter::handOver()
+{
+    blocks.commit();
+    filling = nullptr;
+
+    if (wakeCallback)
+    {
+        wakeCallback(wakeContext);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "log_sink.h"
+#include "../util/spsc_ring.h"
+
+// Block-buffered writer between the receiver and a LogSink.
+//
+// The producer (the role) appends whole records to a LOG_BLOCK_SIZE block.
+// A full block, or one older than LOG_FLUSH_INTERVAL_MS, is handed to the
+// consumer, which writes it to the sink in one call and syncs the sink every
+// LOG_SYNC_INTERVAL_MS. The consumer is a background task woken through the
+// wake callback; without one, poll() writes the blocks itself. A record that
+// finds all LOG_BLOCK_COUNT blocks waiting for the sink is dropped and
+// counted instead of stalling the caller.
+class LogWriter
+{
+public:
+    // Called from the producer when a block is ready for drain()
+    using WakeCallback = void (*)(void *context);
+
+    struct Stats
+    {
+        uint32_t droppedRecords; // Sink fell behind
+        uint32_t blocks;         // Blocks written
+        uint64_t bytes;
+        uint32_t writeErrors;    // Blocks the sink took only in part
+        uint32_t syncs;
+        uint32_t maxWrite_us;    // Slowest block write, including its sync
+        uint32_t maxQueued;      // Most blocks waiting at once
+    };
+
+    explicit LogWriter(LogSink *sink);
+
+    LogSink *getSink() const;
+
+    // Task to wake when a block is ready; set before the first append()
+    void setWakeCallback(WakeCallback callback, void *context);
+
+    // Producer: queue one encoded record. Returns false if it was dropped.
+    bool append(const uint8_t *data, size_t length);
+
+    // Producer: records from here on go to a new file
+    void startSession();
+
+    // Producer: hand over a block that has waited too long. Without a wake
+    // callback, also drain(). Call regularly.
+    void poll();
+
+    // Producer: hand over the partly filled block now, as at the end of a
+    // run. Without a wake callback, also drain().
+    void flush();
+
+    // Consumer: write every handed-over block to the sink
+    void drain();
+
+    // Number of records dropped because the sink fell behind
+    uint32_t getDroppedRecords() const;
+
+    // Totals since construction; written by the consumer, so approximate
+    // while it runs
+    Stats getStats() const;
+
+private:
+    struct Block
+    {
+        alignas(4) uint8_t data[LOG_BLOCK_SIZE];
+        size_t length;
+        bool newSession; // Start a new file before writing this block
+    };
+
+    LogSink *sink;
+    WakeCallback wakeCallback;
+    void *wakeContext;
+
+    SpscRing<Block, LOG_BLOCK_COUNT> blocks;
+
+    // Block being filled, acquired from the ring but not yet committed
+    Block *filling;
+    unsigned long fillStartMs;
+    bool sessionPending;
+    uint32_t droppedRecords;
+
+    // Consumer state
+    unsigned long lastSyncMs;
+    Stats stats;
+
+    // Commit the block being filled and wake the consumer
+    void handOver();
+};
+
+#endif // LOG_WRITER_H
@@ -0,0 +1,22 @@
+#include "sd_log_sink.h"
+#include <SD.h>
+#include <SPI.h>
+#include "config.h"
+
+SdLogSink::SdLogSink() : FileLogSink("/sd/rangetest")
+{
+}
+
+bool SdLogSink::begin()
+{
+    SPI.begin(SD_SCK_PIN, SD_MISO_PIN, SD_MOSI_PIN, SD_CS_PIN);
+    if (!SD.begin(SD_CS_PIN, SPI, SD_SPI_FREQUENCY, "/sd"))
+    {
+        Serial.println("SD card: Mount failed");
+        return false;
+    }
+
+    Serial.printf("SD card: %llu MB, %llu MB free\n",
+                  SD.totalBytes() / (1024 * 1024), (SD.totalBytes() - SD.usedBytes()) / (1024 * 1024));
+    return FileLogSink::begin();
+}
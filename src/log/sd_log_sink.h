@@ -0,0 +1,22 @@
+#ifndef SD_LOG_SINK_H
+#define SD_LOG_SINK_H
+
+#include "file_log_sink.h"
+
+// FAT-formatted SD card on SPI (SD_*_PIN), mounted at /sd. Each session
+// gets its own file in /sd/rangetest; nothing is ever deleted.
+class SdLogSink : public FileLogSink
+{
+public:
+    SdLogSink();
+
+    // Start SPI and mount the card, then find the existing files
+    virtual bool begin() override;
+
+    virtual const char *getName() const override
+    {
+        return "sd";
+    }
+};
+
+#endif // SD_LOG_SINK_H
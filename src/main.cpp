@@ -1,15 +1,39 @@
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include "config.h"
 #include "gps_handler.h"
 
 // Include protocol headers
-#include "protocol/wifi.h"
-#include "protocol/espnow.h"
+#include "protocol/protocol_factory.h"
 
 // Include role headers
 #include "role/sender.h"
 #include "role/receiver.h"
 
+// Runtime test configuration
+#include "settings/test_config.h"
+#include "settings/config_store.h"
+#include "settings/command_console.h"
+#include "settings/sweep_schedule.h"
+
+// Task CPU and stack report
+#include "tasks/task_monitor.h"
+
+// Log sinks
+#include "log/log_sink.h"
+#include "log/log_writer.h"
+#if LOG_SINK == LOG_SINK_SD
+#include "log/sd_log_sink.h"
+#elif LOG_SINK == LOG_SINK_FLASH
+#include "log/flash_log_sink.h"
+#endif
+
+#if defined(RECEIVER_BENCHMARK)
+#include "bench/receiver_benchmark.h"
+#endif
+
 #define GNSS_GPS 0x00
 #define GNSS_SBAS 0x01
 #define GNSS_GALILEO 0x02
@@ -20,14 +44,397 @@ GPSHandler gpsHandler;
 Protocol *protocol = nullptr;
 Role *role = nullptr;
 
+#if defined(SENDER)
+const bool isSender = true;
+#else
+const bool isSender = false;
+#endif
+
+// Configuration the console edits; the running role keeps its own copy
+TestConfig pendingConfig;
+ConfigStore configStore;
+CommandConsole console(&Serial);
+
+// Protocol sweep: the configuration it rotates, and the slot running now
+SweepSchedule sweep;
+TestConfig sweepBase;
+uint32_t sweepSlot = SessionLogRecord::NO_SLOT;
+
+// The system clock only follows GPS once a role has synced it
+bool systemClockSynced = false;
+
+// Role log: the configured sink, or Serial if it cannot be mounted.
+// Shared by every test so a sweep's slots go through one writer.
+PrintLogSink serialLogSink(&Serial);
+#if LOG_SINK == LOG_SINK_SD
+SdLogSink storageLogSink;
+#elif LOG_SINK == LOG_SINK_FLASH
+FlashLogSink storageLogSink;
+#endif
+LogWriter *logWriter = nullptr;
+
+// Tasks started in setup(); the Arduino loop task runs the console and the sweep
+TaskHandle_t loopTask = nullptr;
+TaskHandle_t roleTask = nullptr;
+TaskHandle_t gpsTask = nullptr;
+TaskHandle_t reportTask = nullptr;
+TaskHandle_t logTask = nullptr;
+TaskMonitor taskMonitor;
+
+// Held by the role task around process(), by the reporter task around the
+// short snapshot(), and by the loop task while it replaces the role, so
+// snapshot() never copies what process() is halfway through writing
+SemaphoreHandle_t roleMutex = nullptr;
+
+// Held by the reporter task for the whole report, and by the loop task
+// before roleMutex while it replaces the role, so report() can print
+// without roleMutex and still never runs on a role being deleted
+SemaphoreHandle_t reportMutex = nullptr;
+
+// Stop the running test and release the role and protocol, leaving the
+// radio off so another protocol can be started without a reboot
+void stopTest()
+{
+    xSemaphoreTake(reportMutex, portMAX_DELAY);
+    xSemaphoreTake(roleMutex, portMAX_DELAY);
+    if (role)
+    {
+        role->end();
+        delete role;
+        role = nullptr;
+    }
+    xSemaphoreGive(roleMutex);
+    xSemaphoreGive(reportMutex);
+
+    if (protocol)
+    {
+        delete protocol;
+        protocol = nullptr;
+    }
+}
+
+// Role wake callback, from the radio and esp_timer tasks
+void wakeRoleTask(void *context)
+{
+    (void)context;
+    xTaskNotifyGive(roleTask);
+}
+
+// Create the protocol and role for config and start them. On failure
+// everything is torn down again and the console stays available.
+bool startTest(const TestConfig &config, uint32_t slot = SessionLogRecord::NO_SLOT)
+{
+    Serial.println();
+    Serial.println("============================================");
+    Serial.println("Drone Mesh Network - Point-to-Point Test");
+    Serial.println("============================================");
+    config.print(Serial);
+    Serial.println("============================================");
+
+    protocol = createProtocol(config, isSender);
+    if (!protocol)
+    {
+        Serial.println("ERROR: Protocol not properly defined!");
+        return false;
+    }
+
+    // Create appropriate role
+    Role *newRole;
+    if (isSender)
+    {
+        newRole = new SenderRole(protocol, &gpsHandler, config, logWriter);
+    }
+    else
+    {
+        newRole = new ReceiverRole(protocol, &gpsHandler, config, logWriter);
+    }
+
+    newRole->setSweepSlot(slot);
+    newRole->setWakeCallback(wakeRoleTask, nullptr);
+
+    // Start role operation. The tasks only see the role once it has started,
+    // so begin() can wait for a GPS fix without holding them up.
+    if (!newRole->begin())
+    {
+        Serial.println("Failed to initialize role. Check connections and settings.");
+        newRole->end();
+        delete newRole;
+        stopTest();
+        return false;
+    }
+
+    xSemaphoreTake(reportMutex, portMAX_DELAY);
+    xSemaphoreTake(roleMutex, portMAX_DELAY);
+    role = newRole;
+    xSemaphoreGive(roleMutex);
+    xSemaphoreGive(reportMutex);
+
+    // Anything the callbacks queued during begin()
+    xTaskNotifyGive(roleTask);
+
+    systemClockSynced = true;
+    return true;
+}
+
+// Run a configuration: start its test now, or arm a sweep that
+// updateSweep() starts in the current slot once GPS time is known
+void runConfiguration(const TestConfig &config)
+{
+    stopTest();
+
+    sweep = SweepSchedule(config.sweepSlot_s);
+    sweepBase = config;
+    sweepSlot = SessionLogRecord::NO_SLOT;
+
+    if (sweep.isEnabled())
+    {
+        Serial.printf("Protocol sweep: %u s per protocol, waiting for GPS time\n", config.sweepSlot_s);
+        return;
+    }
+
+    startTest(config);
+}
+
+// UTC for the sweep schedule: the GPS-synced system clock, or the last GPS
+// solution before any role has synced it. False without GPS time.
+bool currentUtcMicros(int64_t &utc_us)
+{
+    struct timeval tv;
+    if (systemClockSynced)
+    {
+        if (gettimeofday(&tv, NULL) != 0)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        GPSHandler::Fix fix = gpsHandler.fix();
+        if (!fix.valid || fix.timeWeek == 0 || !gps_time_to_timeval(fix.timeWeek, fix.timeWeek_ms, &tv))
+        {
+            return false;
+        }
+    }
+
+    utc_us = (int64_t)tv.tv_sec * 1000000L + tv.tv_usec;
+    return true;
+}
+
+// Switch both the role and protocol to the current slot's protocol whenever
+// a slot boundary passes. Both ends do the same from their own GPS time.
+void updateSweep()
+{
+    int64_t utc_us;
+    if (!sweep.isEnabled() || !currentUtcMicros(utc_us))
+    {
+        return;
+    }
+
+    // Slots only move forward, so a clock adjustment back across a boundary cannot switch twice
+    uint32_t slot = sweep.slotAt(utc_us);
+    if (sweepSlot != SessionLogRecord::NO_SLOT && slot <= sweepSlot)
+    {
+        return;
+    }
+
+    unsigned long start_ms = millis();
+    stopTest();
+    sweepSlot = slot;
+
+    TestConfig config = sweep.configFor(slot, sweepBase);
+    Serial.printf("Sweep slot %lu: %s, %lld ms after the boundary\n",
+                  (unsigned long)slot, config.protocolKey(), (utc_us - sweep.slotStart_us(slot)) / 1000);
+
+    // A slot that fails to start (e.g. no access point) stays idle until the next one
+    if (startTest(config, slot))
+    {
+        Serial.printf("Sweep slot %lu: switched in %lu ms\n", (unsigned long)slot, millis() - start_ms);
+    }
+}
+
+// Ticks until updateSweep() next has work: the next slot boundary, or the
+// next GPS solution while there is no GPS time yet
+TickType_t sweepWaitTicks()
+{
+    int64_t utc_us;
+    if (!sweep.isEnabled())
+    {
+        return portMAX_DELAY;
+    }
+    if (!currentUtcMicros(utc_us))
+    {
+        return pdMS_TO_TICKS(gpsHandler.rate_ms);
+    }
+
+    // One tick more, so the wait ends after the boundary rather than before it
+    int64_t wait_us = sweep.slotStart_us(sweep.slotAt(utc_us) + 1) - utc_us;
+    return pdMS_TO_TICKS(wait_us / 1000) + 1;
+}
+
+// Console wake callback, from the serial driver's event task
+void wakeLoopTask()
+{
+    xTaskNotifyGive(loopTask);
+}
+
+// Act on a completed console command
+void handleConsole()
+{
+    switch (console.poll(pendingConfig))
+    {
+    case CommandConsole::APPLY:
+        Serial.println("Restarting test with the pending configuration...");
+        runConfiguration(pendingConfig);
+        break;
+
+    case CommandConsole::SAVE:
+        Serial.println(configStore.save(pendingConfig) ? "Configuration saved" : "Failed to save configuration");
+        break;
+
+    case CommandConsole::LOAD:
+        if (configStore.load(pendingConfig))
+        {
+            Serial.println("Saved configuration loaded (apply to use)");
+        }
+        else
+        {
+            Serial.println("No valid saved configuration");
+        }
+        break;
+
+    case CommandConsole::CLEAR:
+        Serial.println(configStore.clear() ? "Saved configuration cleared" : "No saved configuration");
+        break;
+
+    case CommandConsole::NONE:
+        break;
+    }
+}
+
+// Role task: woken by the sender's timer, or by every packet the receiver
+// queues, to run process(); the timeout covers the role's periodic work
+void roleTaskMain(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ROLE_TASK_IDLE_MS));
+
+        xSemaphoreTake(roleMutex, portMAX_DELAY);
+        if (role)
+        {
+            role->process();
+        }
+        xSemaphoreGive(roleMutex);
+    }
+}
+
+// GPS task: woken by the UART when bytes arrive, parses them and publishes
+// the fix. The timeout lets the parser send its configuration with no input.
+void gpsTaskMain(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        gpsHandler.update();
+        digitalWrite(LED_BUILTIN, gpsHandler.hasFix() ? HIGH : LOW);
+    }
+}
+
+// Reporter task: the role's report() and the task report, below everything
+// that handles packets. The role task is locked out only while snapshot()
+// copies the statistics; printing them, however long Serial takes, is not.
+void reportTaskMain(void *arg)
+{
+    (void)arg;
+    TickType_t lastWake = xTaskGetTickCount();
+    unsigned long taskReportTimer = millis();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(REPORT_INTERVAL_MS));
+
+        // role only changes under reportMutex
+        xSemaphoreTake(reportMutex, portMAX_DELAY);
+        if (role)
+        {
+            xSemaphoreTake(roleMutex, portMAX_DELAY);
+            role->snapshot();
+            xSemaphoreGive(roleMutex);
+
+            role->report();
+        }
+        xSemaphoreGive(reportMutex);
+
+        if (TASK_REPORT_MS > 0 && millis() - taskReportTimer >= TASK_REPORT_MS)
+        {
+            taskReportTimer = millis();
+            taskMonitor.print(Serial);
+        }
+    }
+}
+
+// Log task: writes each block the receiver fills to the sink, blocking on
+// the medium as long as it needs to
+void logTaskMain(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        logWriter->drain();
+    }
+}
+
+// Log writer wake callback, from the role task
+void wakeLogTask(void *context)
+{
+    (void)context;
+    xTaskNotifyGive(logTask);
+}
+
+// Mount the configured log sink, falling back to Serial
+LogSink *startLogSink()
+{
+#if LOG_SINK != LOG_SINK_SERIAL
+    if (storageLogSink.begin())
+    {
+        Serial.printf("Log sink: %s\n", storageLogSink.getName());
+        return &storageLogSink;
+    }
+    Serial.printf("ERROR: Log sink %s unavailable, logging to Serial\n", storageLogSink.getName());
+#endif
+    serialLogSink.begin();
+    return &serialLogSink;
+}
+
+// Create a task pinned to TASK_CORE and add it to the task report
+TaskHandle_t startTask(TaskFunction_t function, const char *name, uint32_t stack, UBaseType_t priority)
+{
+    TaskHandle_t task = nullptr;
+    if (xTaskCreatePinnedToCore(function, name, stack, nullptr, priority, &task, TASK_CORE) != pdPASS)
+    {
+        Serial.printf("ERROR: Failed to start the %s task\n", name);
+        while (1)
+        {
+            delay(1000);
+        } // Hang
+    }
+
+    taskMonitor.add(task);
+    return task;
+}
+
 void setup()
 {
+    // Statistics are printed while the role is locked; a large buffer takes
+    // them without waiting for the UART
+    Serial.setTxBufferSize(4096);
     Serial.begin(115200);
 
-    bool isSender = false;
-
 #if defined(SENDER)
-    isSender = true;
     Serial.println("Role: Sender");
 #else
     // Wait for Serial port to connect. Needed for native USB port only
@@ -42,57 +449,21 @@ void setup()
     pinMode(LED_BUILTIN, OUTPUT);
     digitalWrite(LED_BUILTIN, LOW);
 
-    Serial.println();
-    Serial.println("============================================");
-    Serial.println("Drone Mesh Network - Point-to-Point Test");
-    Serial.println("============================================");
+#if defined(RECEIVER_BENCHMARK)
+    // Measure the receiver's per-packet path instead of running a role
+    ReceiverBenchmark benchmark(espBenchCounters(), RECEIVER_BENCHMARK_ITERATIONS);
+    benchmark.run();
 
-    Protocol::ProtocolType proto;
-
-#if defined(PROTOCOL) && PROTOCOL == PROTOCOL_WIFI_4
-    Serial.println("Protocol: WiFi 4 (802.11n)");
-    proto = Protocol::ProtocolType::PROTO_WIFI4;
-#elif defined(PROTOCOL) && PROTOCOL == PROTOCOL_WIFI_6
-    Serial.println("Protocol: WiFi 6 (802.11ax)");
-    proto = Protocol::ProtocolType::PROTO_WIFI6;
-#elif defined(PROTOCOL) && PROTOCOL == PROTOCOL_WIFI_LR
-    Serial.println("Protocol: WiFi Long Range");
-    proto = Protocol::ProtocolType::PROTO_WIFI_LR;
-#elif defined(PROTOCOL) && PROTOCOL == PROTOCOL_ESP_NOW
-    Serial.println("Protocol: ESP-NOW");
-    proto = Protocol::ProtocolType::PROTO_ESPNOW;
-#else
-    Serial.println("ERROR: Protocol not properly defined!");
+    Serial.println();
+    benchmark.printResults(Serial);
     while (1)
     {
         delay(1000);
     } // Hang
 #endif
 
-    switch (proto)
-    {
-    case Protocol::ProtocolType::PROTO_WIFI4:
-    case Protocol::ProtocolType::PROTO_WIFI6:
-    case Protocol::ProtocolType::PROTO_WIFI_LR:
-        protocol = new WiFiProtocol(proto, WIFI_CHANNEL, TX_POWER, isSender);
-        break;
-
-    case Protocol::ProtocolType::PROTO_ESPNOW:
-        protocol = new ESPNOWProtocol(WIFI_CHANNEL, TX_POWER);
-        break;
-    }
-
-    Serial.printf("TX Power: %d dBm\n", TX_POWER);
-    Serial.printf("WiFi Channel: %d\n", WIFI_CHANNEL);
-
-    if (isSender)
-    {
-        Serial.printf("Packet Size: %d bytes\n", PACKET_SIZE);
-        Serial.printf("Packet Rate: %d Hz\n", PACKET_RATE);
-    }
-
-    Serial.println("============================================");
-
+    // Room for a few solutions in case the GPS task is kept waiting
+    Serial1.setRxBufferSize(1024);
     Serial1.begin(GPS_BAUD_RATE, SERIAL_8N1, GPS_RX_PIN, GPS_TX_PIN);
 
     gpsHandler.gnss_mode = (1U << GNSS_GPS) |
@@ -106,34 +477,52 @@ void setup()
 
     gpsHandler.begin(&Serial1);
 
-    // Create appropriate role
-    if (isSender)
-    {
-        role = new SenderRole(protocol, &gpsHandler);
-    }
-    else
-    {
-        role = new ReceiverRole(protocol, &gpsHandler);
-    }
+    logWriter = new LogWriter(startLogSink());
+
+    roleMutex = xSemaphoreCreateMutex();
+    reportMutex = xSemaphoreCreateMutex();
+    logTask = startTask(logTaskMain, "log", LOG_TASK_STACK, LOG_TASK_PRIORITY);
+    logWriter->setWakeCallback(wakeLogTask, nullptr);
+    roleTask = startTask(roleTaskMain, "role", ROLE_TASK_STACK, ROLE_TASK_PRIORITY);
+    gpsTask = startTask(gpsTaskMain, "gps", GPS_TASK_STACK, GPS_TASK_PRIORITY);
+    reportTask = startTask(reportTaskMain, "report", REPORT_TASK_STACK, REPORT_TASK_PRIORITY);
+
+    // The driver's event task runs this for every burst the UART receives
+    Serial1.onReceive([]()
+                      { xTaskNotifyGive(gpsTask); });
 
-    // Start role operation
-    if (!role->begin())
+    // Console input wakes loop() the same way
+    loopTask = xTaskGetCurrentTaskHandle();
+#if ARDUINO_USB_CDC_ON_BOOT
+    Serial.onEvent(ARDUINO_HW_CDC_RX_EVENT, [](void *, esp_event_base_t, int32_t, void *)
+                   { wakeLoopTask(); });
+#else
+    Serial.onReceive(wakeLoopTask);
+#endif
+
+    // The tasks the ones above compete with, and what is left idle
+    taskMonitor.add(loopTask);
+    taskMonitor.add(xTaskGetHandle("esp_timer"));
+    taskMonitor.add(xTaskGetIdleTaskHandle());
+
+    // A profile saved from the console overrides the build defaults
+    pendingConfig = TestConfig::defaults();
+    if (configStore.load(pendingConfig))
     {
-        Serial.println("Failed to initialize role. Check connections and settings.");
-        while (1)
-        {
-            delay(1000);
-        } // Hang
+        Serial.println("Using saved test configuration");
     }
+
+    runConfiguration(pendingConfig);
+    Serial.println("Type 'help' for configuration commands");
 }
 
 void loop()
 {
-    gpsHandler.update();
-
-    digitalWrite(LED_BUILTIN, gpsHandler.hasFix() ? HIGH : LOW);
-
-    role->loop();
+    // The role, GPS and reporter tasks do the rest. With no role after a
+    // failed start, the console can still select working settings.
+    handleConsole();
+    updateSweep();
 
-    delay(10);
+    // Sleep until console input arrives or the sweep next needs attention
+    ulTaskNotifyTake(pdTRUE, sweepWaitTicks());
 }
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef TEST_PROFILE_H
+#define TEST_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One step of a sender test profile
+struct ProfileStep
+{
+    uint32_t rateHz;      // Packet rate; 0 = idle (no packets)
+    uint16_t payloadSize; // Payload bytes per packet
+    uint32_t duration_ms; // Step length; 0 = run forever
+};
+
+// Fixed-capacity list of steps the sender walks through. Every packet is
+// tagged with the index of the step it was sent in.
+class TestProfile
+{
+public:
+    static const size_t MAX_STEPS = 32;
+
+    TestProfile() : stepCount(0) {}
+
+    void clear()
+    {
+        stepCount = 0;
+    }
+
+    bool addStep(uint32_t rateHz, uint16_t payloadSize, uint32_t duration_ms)
+    {
+        if (stepCount >= MAX_STEPS)
+        {
+            return false;
+        }
+
+        steps[stepCount].rateHz = rateHz;
+        steps[stepCount].payloadSize = payloadSize;
+        steps[stepCount].duration_ms = duration_ms;
+        stepCount++;
+        return true;
+    }
+
+    size_t size() const
+    {
+        return stepCount;
+    }
+
+    const ProfileStep &step(size_t index) const
+    {
+        return steps[index];
+    }
+
+    // Single step at a constant rate and size, forever
+    static TestProfile fixed(uint32_t rateHz, uint16_t payloadSize)
+    {
+        TestProfile profile;
+        profile.addStep(rateHz, payloadSize, 0);
+        return profile;
+    }
+
+    // Linear ramp of rate and payload size over stepCount steps
+    static TestProfile ramp(uint32_t rateStart, uint32_t rateEnd,
+                            uint16_t sizeStart, uint16_t sizeEnd,
+                            size_t stepCount, uint32_t step_ms)
+    {
+        TestProfile profile;
+        if (stepCount > MAX_STEPS)
+        {
+            stepCount = MAX_STEPS;
+        }
+
+        for (size_t i = 0; i < stepCount; i++)
+        {
+            int64_t span = stepCount > 1 ? (int64_t)(stepCount - 1) : 1;
+            uint32_t rate = (uint32_t)(rateStart + ((int64_t)rateEnd - rateStart) * (int64_t)i / span);
+            uint16_t size = (uint16_t)(sizeStart + ((int64_t)sizeEnd - sizeStart) * (int64_t)i / span);
+            profile.addStep(rate, size, step_ms);
+        }
+
+        return profile;
+    }
+
+    // Alternating bursts at rateHz and idle gaps
+    static TestProfile burst(uint32_t rateHz, uint16_t payloadSize,
+                             uint32_t on_ms, uint32_t off_ms, size_t cycles)
+    {
+        TestProfile profile;
+        for (size_t i = 0; i < cycles && profile.size() + 2 <= MAX_STEPS; i++)
+        {
+            profile.addStep(rateHz, payloadSize, on_ms);
+            profile.addStep(0, payloadSize, off_ms);
+        }
+
+        return profile;
+    }
+
+private:
+    ProfileStep steps[MAX_STEPS];
+    size_t stepCount;
+};
+
+// Tracks which step of a TestProfile is active at a given time. The profile
+// repeats from step 0 after the last step.
+class ProfileSequencer
+{
+public:
+    ProfileSequencer() : profile(nullptr), index(0), stepStart_us(0) {}
+
+    void start(const TestProfile *testProfile, int64_t now_us)
+    {
+        profile = testProfile;
+        index = 0;
+        stepStart_us = now_us;
+    }
+
+    // Advance past any steps that have ended. Returns true if the active step changed.
+    bool update(int64_t now_us)
+    {
+        if (!profile || profile->size() == 0)
+        {
+            return false;
+        }
+
+        bool changed = false;
+        for (size_t i = 0; i < profile->size(); i++)
+        {
+            const ProfileStep &current = profile->step(index);
+            if (current.duration_ms == 0 || now_us < stepStart_us + (int64_t)current.duration_ms * 1000)
+            {
+                break;
+            }
+
+            stepStart_us += (int64_t)current.duration_ms * 1000;
+            index = (index + 1) % profile->size();
+            changed = true;
+        }
+
+        return changed;
+    }
+
+    uint8_t getStepId() const
+    {
+        return (uint8_t)index;
+    }
+
+    const ProfileStep &getStep() const
+    {
+        return profile->step(index);
+    }
+
+    // End of the active step, or INT64_MAX if it runs forever
+    int64_t getStepEnd() const
+    {
+        const ProfileStep &current = profile->step(index);
+        return current.duration_ms == 0 ? INT64_MAX : stepStart_us + (int64_t)current.duration_ms * 1000;
+    }
+
+private:
+    const TestProfile *profile;
+    size_t index;
+    int64_t stepStart_us;
+};
+
+#endif // TEST_PROFILE_H
@@ -1,13 +1,16 @@
 #include "espnow.h"
 #include "esp_wifi.h"
+#include <esp_timer.h>
+#include "rx_capture.h"
 
 const uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
 // Define and initialize the static instance pointer
 ESPNOWProtocol *ESPNOWProtocol::instance = nullptr;
 
-ESPNOWProtocol::ESPNOWProtocol(uint8_t channel, int8_t txPower) // Initializer list order matches declaration order in espnow.h
-    : Protocol(channel, txPower), peerRegistered(false), espnowInitialized(false)
+ESPNOWProtocol::ESPNOWProtocol(uint8_t channel, int8_t txPower, bool longRange, const LinkOptions &options) // Initializer list order matches declaration order in espnow.h
+    : Protocol(channel, txPower), peerRegistered(false), options(options), discoveredMac{}, peerDiscovered(false),
+      retryLength(0), retriesLeft(0), espnowInitialized(false), longRange(longRange)
 {
     // Get local MAC address
     WiFi.macAddress(macAddress);
@@ -15,11 +18,7 @@ ESPNOWProtocol::ESPNOWProtocol(uint8_t channel, int8_t txPower) // Initializer l
 
 ESPNOWProtocol::~ESPNOWProtocol()
 {
-    // Clean up ESP-NOW
-    if (espnowInitialized)
-    {
-        esp_now_deinit();
-    }
+    end();
 }
 
 bool ESPNOWProtocol::begin()
@@ -46,16 +45,17 @@ bool ESPNOWProtocol::begin()
         Serial.println("Error initializing ESP-NOW");
         return false;
     }
+    espnowInitialized = true;
+    txTracker.reset();
 
-#if defined(WIFI_LR)
-    // WiFi Long Range
-    Serial.println("Setting protocol to LR");
-    if (esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_LR) != ESP_OK)
+    // Set explicitly: the driver keeps the previous test's PHY until it is deinitialized
+    Serial.println(longRange ? "Setting protocol to LR" : "Setting protocol to 802.11 B/G/N");
+    uint8_t phy = longRange ? WIFI_PROTOCOL_LR : (WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N);
+    if (esp_wifi_set_protocol(WIFI_IF_STA, phy) != ESP_OK)
     {
         Serial.println("Failed to set protocol");
         return false;
     }
-#endif
 
     // Register callbacks
     esp_now_register_send_cb(ESPNOWProtocol::onDataSent);
@@ -70,10 +70,27 @@ bool ESPNOWProtocol::begin()
     Serial.print("Max TX power set to: ");
     Serial.println(txPower);
 
-    espnowInitialized = true;
+    // Both ends must share the channel; the broadcast peer uses the current one
+    if (esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE) != ESP_OK)
+    {
+        Serial.println("Failed to set channel");
+        return false;
+    }
+    Serial.print("Channel set to: ");
+    Serial.println(channel);
+
     initialized = true;
 
-    registerPeer(broadcastAddress);
+    // A unicast sender registers the receiver once discovery finds it
+    peerDiscovered.store(false);
+    if (options.unicast && options.isSender)
+    {
+        Serial.println("Waiting for a receiver to advertise itself");
+    }
+    else if (!registerPeer(broadcastAddress))
+    {
+        return false;
+    }
 
     // Print local MAC address
     Serial.print("Local MAC Address: ");
@@ -89,6 +106,26 @@ bool ESPNOWProtocol::begin()
     return true;
 }
 
+void ESPNOWProtocol::end()
+{
+    if (espnowInitialized)
+    {
+        esp_now_unregister_recv_cb();
+        esp_now_unregister_send_cb();
+        esp_now_deinit();
+        espnowInitialized = false;
+    }
+
+    if (instance == this)
+    {
+        instance = nullptr;
+    }
+
+    peerRegistered = false;
+    initialized = false;
+    WiFi.mode(WIFI_OFF);
+}
+
 bool ESPNOWProtocol::registerPeer(const uint8_t *peerMac)
 {
     if (!espnowInitialized)
@@ -110,27 +147,99 @@ bool ESPNOWProtocol::registerPeer(const uint8_t *peerMac)
         return false;
     }
 
+    // The rate is set per peer; the LR PHY takes only the LR rates, which validation ensures
+    const PhyRate *rate = PhyRate::byRate(options.phyRate);
+    if (rate)
+    {
+        esp_now_rate_config_t rateConfig = {};
+        switch (rate->family)
+        {
+        case PhyRate::FAMILY_DSSS:
+            rateConfig.phymode = WIFI_PHY_MODE_11B;
+            break;
+
+        case PhyRate::FAMILY_OFDM:
+            rateConfig.phymode = WIFI_PHY_MODE_11G;
+            break;
+
+        case PhyRate::FAMILY_HT:
+            rateConfig.phymode = WIFI_PHY_MODE_HT20;
+            break;
+
+        case PhyRate::FAMILY_LR:
+            rateConfig.phymode = WIFI_PHY_MODE_LR;
+            break;
+        }
+        rateConfig.rate = (wifi_phy_rate_t)rate->rate;
+
+        if (esp_now_set_peer_rate_config(peerMac, &rateConfig) != ESP_OK)
+        {
+            Serial.println("Failed to set peer rate");
+            esp_now_del_peer(peerMac);
+            return false;
+        }
+    }
+
     peerRegistered = true;
-    Serial.println("Peer registered successfully");
+    Serial.printf("Peer %02X:%02X:%02X:%02X:%02X:%02X registered, PHY rate %s\n",
+                  peerMac[0], peerMac[1], peerMac[2], peerMac[3], peerMac[4], peerMac[5], PhyRate::name(options.phyRate));
     return true;
 }
 
-bool ESPNOWProtocol::sendPacket(const TestPacket &packet)
+bool ESPNOWProtocol::sendFrame(const uint8_t *data, size_t length)
 {
-    if (!espnowInitialized || !peerRegistered)
+    if (!espnowInitialized)
     {
         return false;
     }
 
-    // Send packet via ESP-NOW
-    esp_err_t result = esp_now_send(peerMac, (uint8_t *)&packet, sizeof(TestPacket));
+    // Registered here, in the sending task, rather than in the receive callback
+    if (!peerRegistered)
+    {
+        if (!peerDiscovered.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        if (!registerPeer(discoveredMac))
+        {
+            // Try again with the next advertisement rather than on every packet
+            peerDiscovered.store(false);
+            return false;
+        }
+        peerFound();
+    }
 
-    return (result == ESP_OK);
-}
+    // Retries resend from a copy, so a unicast frame must be completed
+    // before the next; the sender's window of 1 keeps to that
+    bool retrying = options.retries > 0 && memcmp(peerMac, broadcastAddress, 6) != 0;
+    if (retrying)
+    {
+        if (txTracker.inFlight() > 0 || length > sizeof(retryFrame))
+        {
+            return false;
+        }
+        memcpy(retryFrame, data, length);
+        retryLength = length;
+    }
+    retriesLeft.store(retrying ? options.retries : 0);
 
-bool ESPNOWProtocol::setPacketCallback(PacketReceivedCallback callback)
-{
-    packetCallback = callback;
+    // Recorded first: the send callback can run before esp_now_send() returns
+    PacketView frame = PacketView::ofHeader(data);
+    if (!txTracker.begin(frame.sequenceNumber(), esp_timer_get_time()))
+    {
+        return false;
+    }
+
+    // Send frame via ESP-NOW
+    esp_err_t result = esp_now_send(peerMac, data, length);
+    if (result != ESP_OK)
+    {
+        // ESP_ERR_ESPNOW_NO_MEM is the driver's queue pushing back
+        txTracker.rejected(result == ESP_ERR_ESPNOW_NO_MEM);
+        return false;
+    }
+
+    txTracker.accepted();
     return true;
 }
 
@@ -141,11 +250,7 @@ Protocol::ProtocolType ESPNOWProtocol::getType() const
 
 const char *ESPNOWProtocol::getProtocolName() const
 {
-#if defined(WIFI_LR)
-    return "ESP-NOW (WiFi Long Range)";
-#else
-    return "ESP-NOW";
-#endif
+    return longRange ? "ESP-NOW (WiFi Long Range)" : "ESP-NOW";
 }
 
 const uint8_t *ESPNOWProtocol::getMacAddress() const
@@ -153,15 +258,65 @@ const uint8_t *ESPNOWProtocol::getMacAddress() const
     return macAddress;
 }
 
+TxTracker *ESPNOWProtocol::getTxTracker()
+{
+    return &txTracker;
+}
+
+void ESPNOWProtocol::retransmit()
+{
+    if (!espnowInitialized || !txTracker.takeRetry())
+    {
+        return;
+    }
+
+    retriesLeft--;
+    txTracker.retried();
+    if (esp_now_send(peerMac, retryFrame, retryLength) != ESP_OK)
+    {
+        // Nothing is in the driver, so the frame completes from here
+        txTracker.complete(false, esp_timer_get_time());
+    }
+}
+
+bool ESPNOWProtocol::advertises() const
+{
+    return options.unicast && !options.isSender;
+}
+
+void ESPNOWProtocol::onDiscovery(const PacketView &frame, const RxMetadata &rx)
+{
+    (void)frame;
+
+    // The first receiver heard wins; the sending task registers it
+    if (!options.unicast || !options.isSender || peerDiscovered.load() || rx.source.kind != PeerAddress::MAC)
+    {
+        return;
+    }
+
+    memcpy(discoveredMac, rx.source.bytes, 6);
+    peerDiscovered.store(true, std::memory_order_release);
+}
+
 // Static member function implementation for data sent callback
 void ESPNOWProtocol::onDataSent(const uint8_t *macAddr, esp_now_send_status_t status)
 {
-    // Handle send callback (for debugging)
-    if (status != ESP_NOW_SEND_SUCCESS)
+    // Runs in the Wi-Fi task once per accepted frame, in send order. Failures
+    // are counted rather than printed, which would stall the task at high rates.
+    if (!instance)
+    {
+        return;
+    }
+
+    // An unacknowledged frame with retries left is sent again by the sending
+    // task, not from this callback; its completion is still to come
+    bool delivered = status == ESP_NOW_SEND_SUCCESS;
+    if (!delivered && instance->retriesLeft.load() > 0 && instance->txTracker.retryLater())
     {
-        Serial.println("ESP-NOW send failed");
+        return;
     }
-    // Can access instance via instance_ if needed, e.g., instance_->someMethod();
+
+    instance->txTracker.complete(delivered, esp_timer_get_time());
 }
 
 // Static member function implementation for data received callback
@@ -173,19 +328,22 @@ void ESPNOWProtocol::onDataReceived(const esp_now_recv_info_t *info, const uint8
         return;
     }
 
-    // Check if packet is a test packet or a sync packet
-    if (dataLen == sizeof(Protocol::TestPacket))
+    if (dataLen <= 0)
     {
-        // It's a test packet
-        const Protocol::TestPacket *packet = reinterpret_cast<const Protocol::TestPacket *>(data);
-
-        // Get RSSI from the recv_info struct
-        int8_t rssi = (info && info->rx_ctrl) ? info->rx_ctrl->rssi : -127; // Default to low value if info is null
+        return;
+    }
 
-        // Call the packet callback if registered
-        if (instance->packetCallback)
-        {
-            instance->packetCallback(*packet, rssi);
-        }
+    // Full per-frame radio metadata comes with the recv_info struct
+    RxMetadata rx;
+    if (info && info->rx_ctrl)
+    {
+        RxCapture::fromRxCtrl(*info->rx_ctrl, rx);
     }
+    if (info && info->src_addr)
+    {
+        rx.source = PeerAddress::fromMac(info->src_addr);
+    }
+
+    // Frames with a foreign magic/version or a bad length are rejected here
+    instance->deliverFrame(data, (size_t)dataLen, rx);
 }
\ No newline at end of file
@@ -2,23 +2,32 @@
 #define ESPNOW_H
 
 #include "protocol.h"
+#include <atomic>
 #include <esp_now.h>
 #include <WiFi.h>
+#include "phy_rate.h"
 
 class ESPNOWProtocol : public Protocol
 {
 public:
-    ESPNOWProtocol(uint8_t channel, int8_t txPower);
+    // Peer, rate and retransmission settings
+    struct LinkOptions
+    {
+        bool unicast = false;  // Send to a discovered receiver instead of broadcasting
+        bool isSender = false; // With unicast: discovers the receiver, or else advertises
+        uint8_t phyRate = PhyRate::DRIVER_DEFAULT; // wifi_phy_rate_t for every peer
+        uint8_t retries = 0;   // Extra sends of an unacknowledged unicast frame
+    };
+
+    // longRange selects the LR PHY
+    ESPNOWProtocol(uint8_t channel, int8_t txPower, bool longRange, const LinkOptions &options);
     virtual ~ESPNOWProtocol();
 
     // Initialize the ESP-NOW protocol
     virtual bool begin() override;
 
-    // Send a test packet via ESP-NOW
-    virtual bool sendPacket(const TestPacket &packet) override;
-
-    // Set callback for packet reception
-    virtual bool setPacketCallback(PacketReceivedCallback callback) override;
+    // Unregister the callbacks, deinitialize ESP-NOW and turn Wi-Fi off
+    virtual void end() override;
 
     // Get protocol type
     virtual ProtocolType getType() const override;
@@ -26,12 +35,29 @@ public:
     // Get protocol name as string
     virtual const char *getProtocolName() const override;
 
-    // Register peer MAC address
+    // Register a peer at the configured PHY rate and send to it from now on
     bool registerPeer(const uint8_t *peerMac);
 
     // Get local MAC address
     const uint8_t *getMacAddress() const;
 
+    // Completions reported by the send callback
+    virtual TxTracker *getTxTracker() override;
+
+    // Resend the unacknowledged unicast frame the send callback handed back
+    virtual void retransmit() override;
+
+    // A unicast receiver advertises itself to senders
+    virtual bool advertises() const override;
+
+protected:
+    // Send a serialized frame via ESP-NOW. A unicast sender sends nothing
+    // until it has heard a receiver advertise itself.
+    virtual bool sendFrame(const uint8_t *data, size_t length) override;
+
+    // Note the first advertising receiver for the sending task to register
+    virtual void onDiscovery(const PacketView &frame, const RxMetadata &rx) override;
+
 private:
     // Static instance pointer (assumes only one instance)
     static ESPNOWProtocol *instance;
@@ -40,18 +66,34 @@ private:
     static void onDataSent(const uint8_t *macAddr, esp_now_send_status_t status);
     static void onDataReceived(const esp_now_recv_info_t *info, const uint8_t *data, int dataLen);
 
-    // Packet callback function pointer
-    PacketReceivedCallback packetCallback = nullptr; // Instance member
-
     // Local MAC address
     uint8_t macAddress[6];
 
-    // Peer MAC address
+    // Peer frames are sent to, owned by the sending task
     uint8_t peerMac[6];
     bool peerRegistered;
 
+    const LinkOptions options;
+
+    // Receiver heard by a unicast sender, handed from the receive callback
+    // to the sending task
+    uint8_t discoveredMac[6];
+    std::atomic<bool> peerDiscovered;
+
+    // Unicast frame in flight while retries are on, for retransmit() to send
+    // again. sendFrame() only writes it while nothing is in flight.
+    uint8_t retryFrame[ESP_NOW_MAX_DATA_LEN];
+    size_t retryLength;
+    std::atomic<uint8_t> retriesLeft;
+
     // ESP-NOW initialization status
     bool espnowInitialized;
+
+    // Use the LR PHY instead of 802.11b/g/n
+    const bool longRange;
+
+    // Frames handed to esp_now_send() awaiting the send callback
+    TxTracker txTracker;
 };
 
 #endif // ESPNOW_H
\ No newline at end of file
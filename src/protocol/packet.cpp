@@ -0,0 +1,114 @@
+#include "packet.h"
+#include "../util/byte_order.h"
+
+size_t PacketHeader::serialize(uint8_t *buffer, size_t length) const
+{
+    if (!buffer || length < WIRE_SIZE)
+    {
+        return 0;
+    }
+
+    buffer[0] = MAGIC;
+    buffer[1] = VERSION;
+    buffer[2] = type;
+    buffer[3] = satellites;
+    writeLE32(buffer + 4, sequenceNumber);
+    writeLE64(buffer + 8, (uint64_t)senderTimestamp_us);
+    writeLE32(buffer + 16, (uint32_t)latitude_e7);
+    writeLE32(buffer + 20, (uint32_t)longitude_e7);
+    writeLE32(buffer + 24, (uint32_t)altitude_mm);
+    writeLE32(buffer + 28, horizontalAccuracy_mm);
+    writeLE32(buffer + 32, (uint32_t)sendLag_us);
+    writeLE32(buffer + 36, (uint32_t)clockOffset_us);
+    buffer[40] = stepId;
+    writeLE16(buffer + 41, payloadLength);
+    writeLE16(buffer + 43, nodeId);
+
+    return WIRE_SIZE;
+}
+
+bool PacketHeader::deserialize(const uint8_t *buffer, size_t length)
+{
+    // Reject frames that are not ours, or from an incompatible firmware
+    PacketView view;
+    if (!view.parse(buffer, length))
+    {
+        return false;
+    }
+
+    magic = MAGIC;
+    version = VERSION;
+    type = view.type();
+    satellites = view.satellites();
+    sequenceNumber = view.sequenceNumber();
+    senderTimestamp_us = view.senderTimestamp_us();
+    latitude_e7 = view.latitude_e7();
+    longitude_e7 = view.longitude_e7();
+    altitude_mm = view.altitude_mm();
+    horizontalAccuracy_mm = view.horizontalAccuracy_mm();
+    sendLag_us = view.sendLag_us();
+    clockOffset_us = view.clockOffset_us();
+    stepId = view.stepId();
+    payloadLength = view.payloadLength();
+    nodeId = view.nodeId();
+
+    return true;
+}
+
+size_t EchoTimestamps::serialize(uint8_t *buffer, size_t length) const
+{
+    if (!buffer || length < WIRE_SIZE)
+    {
+        return 0;
+    }
+
+    writeLE64(buffer, (uint64_t)receive_us);
+    writeLE64(buffer + 8, (uint64_t)transmit_us);
+
+    return WIRE_SIZE;
+}
+
+bool EchoTimestamps::deserialize(const uint8_t *buffer, size_t length)
+{
+    if (!buffer || length < WIRE_SIZE)
+    {
+        return false;
+    }
+
+    receive_us = (int64_t)readLE64(buffer);
+    transmit_us = (int64_t)readLE64(buffer + 8);
+
+    return true;
+}
+
+size_t AggregateRecord::serialize(uint8_t *buffer, size_t length) const
+{
+    if (!buffer || length < WIRE_SIZE)
+    {
+        return 0;
+    }
+
+    buffer[0] = type;
+    writeLE32(buffer + 1, sequenceNumber);
+    writeLE64(buffer + 5, (uint64_t)senderTimestamp_us);
+    writeLE32(buffer + 13, (uint32_t)sendLag_us);
+    writeLE16(buffer + 17, payloadLength);
+
+    return WIRE_SIZE;
+}
+
+bool AggregateRecord::deserialize(const uint8_t *buffer, size_t length)
+{
+    if (!buffer || length < WIRE_SIZE)
+    {
+        return false;
+    }
+
+    type = buffer[0];
+    sequenceNumber = readLE32(buffer + 1);
+    senderTimestamp_us = (int64_t)readLE64(buffer + 5);
+    sendLag_us = (int32_t)readLE32(buffer + 13);
+    payloadLength = readLE16(buffer + 17);
+
+    return WIRE_SIZE + payloadLength <= length;
+}
@@ -0,0 +1,221 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../util/byte_order.h"
+
+// Frame types carried in PacketHeader::type
+enum PacketType : uint8_t
+{
+    PACKET_TYPE_DATA = 0,         // Test packet sent by the sender role
+    PACKET_TYPE_ECHO_REQUEST = 1, // Test packet the receiver should reflect
+    PACKET_TYPE_ECHO_REPLY = 2,   // Receiver's reflection, EchoTimestamps payload
+    PACKET_TYPE_AGGREGATE = 3,    // Several test packets, AggregateRecord payload
+    PACKET_TYPE_DISCOVERY = 4,    // Receiver advertising itself for unicast, no payload
+    PACKET_TYPE_COUNT             // Number of known types
+};
+
+// Header that precedes the payload of every test packet on the air.
+//
+// The in-memory struct is packed so its size matches the wire, but the wire
+// encoding is produced field by field in little-endian order by serialize(),
+// so it does not depend on the compiler or target byte order.
+struct __attribute__((packed)) PacketHeader
+{
+    static const uint8_t MAGIC = 0xD7;
+    static const uint8_t VERSION = 5;
+    static const size_t WIRE_SIZE = 45;
+
+    // clockOffset_us value when the sender has no estimate
+    static const int32_t CLOCK_OFFSET_UNKNOWN = INT32_MIN;
+
+    uint8_t magic;                  // Always MAGIC
+    uint8_t version;                // Wire format version, VERSION
+    uint8_t type;                   // PacketType
+    uint8_t satellites;             // Sender satellites in use
+    uint32_t sequenceNumber;        // Incrementing sequence number
+    int64_t senderTimestamp_us;     // High-resolution sender timestamp (microseconds)
+    int32_t latitude_e7;            // Sender latitude (1e-7 degrees)
+    int32_t longitude_e7;           // Sender longitude (1e-7 degrees)
+    int32_t altitude_mm;            // Sender altitude (millimetres)
+    uint32_t horizontalAccuracy_mm; // Sender horizontal accuracy (millimetres)
+    int32_t sendLag_us;             // Actual minus scheduled send time on the sender
+    int32_t clockOffset_us;         // Sender's estimate of receiver minus sender clock
+    uint8_t stepId;                 // Test profile step the packet was sent in
+    uint16_t payloadLength;         // Number of payload bytes following the header
+    uint16_t nodeId;                // Sender node; echo replies carry the requester's
+
+    // Write the header in wire order. Returns the number of bytes written,
+    // or 0 if the buffer is too small.
+    size_t serialize(uint8_t *buffer, size_t length) const;
+
+    // Parse a header from the start of a frame. Returns false if PacketView
+    // would reject the frame.
+    bool deserialize(const uint8_t *buffer, size_t length);
+};
+
+static_assert(sizeof(PacketHeader) == PacketHeader::WIRE_SIZE, "PacketHeader must match its wire size");
+
+// Read-only view of a test packet in a received buffer.
+//
+// parse() validates the frame once; the accessors then decode fields in
+// place with byte-wise little-endian loads, so the receive path needs no
+// aligned copy of the header and never copies the payload. The buffer must
+// outlive the view, which for a radio callback means the callback.
+class PacketView
+{
+public:
+    PacketView() : frame(nullptr), length(0) {}
+
+    // Check the magic, version and type, and that the frame carries exactly
+    // the advertised payload
+    bool parse(const uint8_t *buffer, size_t bufferLength)
+    {
+        if (!buffer || bufferLength < PacketHeader::WIRE_SIZE ||
+            buffer[0] != PacketHeader::MAGIC || buffer[1] != PacketHeader::VERSION ||
+            buffer[2] >= PACKET_TYPE_COUNT ||
+            bufferLength != PacketHeader::WIRE_SIZE + readLE16(buffer + 41))
+        {
+            return false;
+        }
+
+        frame = buffer;
+        length = bufferLength;
+        return true;
+    }
+
+    // View a header that passed parse() earlier and was kept without its
+    // payload; payload() is null
+    static PacketView ofHeader(const uint8_t *header)
+    {
+        PacketView view;
+        view.frame = header;
+        view.length = PacketHeader::WIRE_SIZE;
+        return view;
+    }
+
+    // The raw frame, header first
+    const uint8_t *data() const
+    {
+        return frame;
+    }
+
+    uint8_t type() const
+    {
+        return frame[2];
+    }
+
+    uint8_t satellites() const
+    {
+        return frame[3];
+    }
+
+    uint32_t sequenceNumber() const
+    {
+        return readLE32(frame + 4);
+    }
+
+    int64_t senderTimestamp_us() const
+    {
+        return (int64_t)readLE64(frame + 8);
+    }
+
+    int32_t latitude_e7() const
+    {
+        return (int32_t)readLE32(frame + 16);
+    }
+
+    int32_t longitude_e7() const
+    {
+        return (int32_t)readLE32(frame + 20);
+    }
+
+    int32_t altitude_mm() const
+    {
+        return (int32_t)readLE32(frame + 24);
+    }
+
+    uint32_t horizontalAccuracy_mm() const
+    {
+        return readLE32(frame + 28);
+    }
+
+    int32_t sendLag_us() const
+    {
+        return (int32_t)readLE32(frame + 32);
+    }
+
+    int32_t clockOffset_us() const
+    {
+        return (int32_t)readLE32(frame + 36);
+    }
+
+    uint8_t stepId() const
+    {
+        return frame[40];
+    }
+
+    uint16_t payloadLength() const
+    {
+        return readLE16(frame + 41);
+    }
+
+    uint16_t nodeId() const
+    {
+        return readLE16(frame + 43);
+    }
+
+    const uint8_t *payload() const
+    {
+        return length > PacketHeader::WIRE_SIZE ? frame + PacketHeader::WIRE_SIZE : nullptr;
+    }
+
+private:
+    const uint8_t *frame;
+    size_t length;
+};
+
+// Payload of an echo reply: the receiver's clock when the request arrived and
+// when the reply left. With the request's senderTimestamp_us (echoed back in
+// the reply header) and the reply's arrival time on the sender, these are the
+// four timestamps of an NTP-style exchange.
+struct EchoTimestamps
+{
+    static const size_t WIRE_SIZE = 16;
+
+    int64_t receive_us;  // Request arrival, receiver clock
+    int64_t transmit_us; // Reply departure, receiver clock
+
+    // Returns the number of bytes written, or 0 if the buffer is too small
+    size_t serialize(uint8_t *buffer, size_t length) const;
+
+    // Returns false if the payload is too short
+    bool deserialize(const uint8_t *buffer, size_t length);
+};
+
+// One test packet inside an aggregate frame.
+//
+// An aggregate is a PacketHeader of type PACKET_TYPE_AGGREGATE whose payload
+// is a run of these records, each followed by its own payload. The outer
+// header carries the fields the records share (GPS, clock offset, step, node)
+// and the time the frame was sent; a record keeps only what differs per
+// packet, so several packets share one header's worth of overhead.
+struct AggregateRecord
+{
+    static const size_t WIRE_SIZE = 19;
+
+    uint8_t type;               // PACKET_TYPE_DATA; never an aggregate
+    uint32_t sequenceNumber;
+    int64_t senderTimestamp_us; // When the packet was created, not when the frame left
+    int32_t sendLag_us;
+    uint16_t payloadLength;     // Payload bytes following this record
+
+    // Returns the number of bytes written, or 0 if the buffer is too small
+    size_t serialize(uint8_t *buffer, size_t length) const;
+
+    // Returns false if the record or its payload runs past length
+    bool deserialize(const uint8_t *buffer, size_t length);
+};
+
+#endif // PACKET_H
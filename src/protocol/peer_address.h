@@ -0,0 +1,85 @@
+#ifndef PEER_ADDRESS_H
+#define PEER_ADDRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Link-layer or network source of a received frame: the sender's MAC for
+// ESP-NOW, its IPv4 address and UDP port for Wi-Fi.
+//
+// Fixed size and trivially copyable so it can be queued with a packet and
+// used as a hash table key. No Arduino dependencies.
+struct PeerAddress
+{
+    enum Kind : uint8_t
+    {
+        NONE = 0, // Source not reported
+        MAC = 1,
+        IPV4 = 2 // bytes: address (network order), then port (big-endian)
+    };
+
+    uint8_t kind = NONE;
+    uint8_t bytes[6] = {};
+
+    static PeerAddress fromMac(const uint8_t *mac)
+    {
+        PeerAddress address;
+        address.kind = MAC;
+        memcpy(address.bytes, mac, 6);
+        return address;
+    }
+
+    static PeerAddress fromIPv4(const uint8_t *ip, uint16_t port)
+    {
+        PeerAddress address;
+        address.kind = IPV4;
+        memcpy(address.bytes, ip, 4);
+        address.bytes[4] = (uint8_t)(port >> 8);
+        address.bytes[5] = (uint8_t)port;
+        return address;
+    }
+
+    bool operator==(const PeerAddress &other) const
+    {
+        return kind == other.kind && memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+    }
+
+    bool operator!=(const PeerAddress &other) const
+    {
+        return !(*this == other);
+    }
+
+    // Kind and bytes packed into one integer, for hashing
+    uint64_t pack() const
+    {
+        uint64_t value = kind;
+        for (size_t i = 0; i < sizeof(bytes); i++)
+        {
+            value = (value << 8) | bytes[i];
+        }
+        return value;
+    }
+
+    // "aa:bb:cc:dd:ee:ff", "192.168.4.2:44444" or "unknown". Returns the
+    // snprintf() result.
+    int format(char *buffer, size_t length) const
+    {
+        switch (kind)
+        {
+        case MAC:
+            return snprintf(buffer, length, "%02x:%02x:%02x:%02x:%02x:%02x",
+                            bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5]);
+
+        case IPV4:
+            return snprintf(buffer, length, "%u.%u.%u.%u:%u",
+                            bytes[0], bytes[1], bytes[2], bytes[3], (unsigned)((bytes[4] << 8) | bytes[5]));
+
+        default:
+            return snprintf(buffer, length, "unknown");
+        }
+    }
+};
+
+#endif // PEER_ADDRESS_H
@@ -0,0 +1,105 @@
+#ifndef PHY_RATE_H
+#define PHY_RATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ESP-NOW transmit rates by console name, as wifi_phy_rate_t values.
+//
+// The values are the driver's, so they can be stored in TestConfig and the
+// session log and passed to esp_now_set_peer_rate_config() unchanged.
+// DRIVER_DEFAULT leaves the driver's choice: 1 Mbps, or 250 kbps on LR.
+//
+// Header-only with no Arduino dependencies so the host tools can share it.
+struct PhyRate
+{
+    static const uint8_t DRIVER_DEFAULT = 0xFF;
+
+    const char *key;
+    uint8_t rate;      // wifi_phy_rate_t
+    uint16_t rate_kbps;
+
+    // PHY the rate belongs to, which selects the peer's wifi_phy_mode_t
+    enum Family : uint8_t
+    {
+        FAMILY_DSSS, // 802.11b
+        FAMILY_OFDM, // 802.11g
+        FAMILY_HT,   // 802.11n MCS, long guard interval
+        FAMILY_LR    // Espressif Long Range
+    };
+    Family family;
+
+    static const PhyRate *table(size_t &count)
+    {
+        static const PhyRate RATES[] = {
+            {"1m", 0x00, 1000, FAMILY_DSSS},
+            {"2m", 0x01, 2000, FAMILY_DSSS},
+            {"5.5m", 0x02, 5500, FAMILY_DSSS},
+            {"11m", 0x03, 11000, FAMILY_DSSS},
+            {"6m", 0x0B, 6000, FAMILY_OFDM},
+            {"9m", 0x0F, 9000, FAMILY_OFDM},
+            {"12m", 0x0A, 12000, FAMILY_OFDM},
+            {"18m", 0x0E, 18000, FAMILY_OFDM},
+            {"24m", 0x09, 24000, FAMILY_OFDM},
+            {"36m", 0x0D, 36000, FAMILY_OFDM},
+            {"48m", 0x08, 48000, FAMILY_OFDM},
+            {"54m", 0x0C, 54000, FAMILY_OFDM},
+            {"mcs0", 0x10, 6500, FAMILY_HT},
+            {"mcs1", 0x11, 13000, FAMILY_HT},
+            {"mcs2", 0x12, 19500, FAMILY_HT},
+            {"mcs3", 0x13, 26000, FAMILY_HT},
+            {"mcs4", 0x14, 39000, FAMILY_HT},
+            {"mcs5", 0x15, 52000, FAMILY_HT},
+            {"mcs6", 0x16, 58500, FAMILY_HT},
+            {"mcs7", 0x17, 65000, FAMILY_HT},
+            {"lr250k", 0x29, 250, FAMILY_LR},
+            {"lr500k", 0x2A, 500, FAMILY_LR},
+        };
+        count = sizeof(RATES) / sizeof(RATES[0]);
+        return RATES;
+    }
+
+    // Entry for a wifi_phy_rate_t value, nullptr for DRIVER_DEFAULT or an unknown value
+    static const PhyRate *byRate(uint8_t rate)
+    {
+        size_t count;
+        const PhyRate *rates = table(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (rates[i].rate == rate)
+            {
+                return &rates[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Entry for a console name, nullptr if there is none
+    static const PhyRate *byKey(const char *key)
+    {
+        size_t count;
+        const PhyRate *rates = table(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (strcmp(rates[i].key, key) == 0)
+            {
+                return &rates[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Console name of a rate: "default" for DRIVER_DEFAULT, "unknown" if not in the table
+    static const char *name(uint8_t rate)
+    {
+        if (rate == DRIVER_DEFAULT)
+        {
+            return "default";
+        }
+        const PhyRate *entry = byRate(rate);
+        return entry ? entry->key : "unknown";
+    }
+};
+
+#endif // PHY_RATE_H
@@ -1,7 +1,7 @@
 #include "protocol.h"
 
 Protocol::Protocol(uint8_t channel, int8_t txPower)
-    : channel(channel), txPower(txPower), initialized(false)
+    : channel(channel), txPower(txPower), initialized(false), createdAt_ms(millis())
 {
 
     // Ensure TX power is within regulatory limits
@@ -30,4 +30,315 @@ int8_t Protocol::getTransmitPower() const
 uint8_t Protocol::getChannel() const
 {
     return channel;
-}
\ No newline at end of file
+}
+
+bool Protocol::sendPacket(const TestPacket &packet)
+{
+    if (packet.payloadLength > MAX_PACKET_SIZE)
+    {
+        return false;
+    }
+
+    size_t headerLength = packet.serialize(txFrame, sizeof(txFrame));
+    memcpy(txFrame + headerLength, packet.payload, packet.payloadLength);
+
+    return sendFrame(txFrame, headerLength + packet.payloadLength);
+}
+
+size_t Protocol::maxFrameSize(ProtocolType type)
+{
+    // ESP-NOW v1 frames carry ESP_NOW_MAX_DATA_LEN bytes; UDP fits a 1500-byte MTU
+    size_t limit = type == PROTO_ESPNOW ? 250 : 1472;
+    return limit < MAX_FRAME_SIZE ? limit : MAX_FRAME_SIZE;
+}
+
+void Protocol::setAggregation(uint8_t maxRecords, uint32_t flushDeadline_us)
+{
+    aggregateMaxRecords = maxRecords > 0 ? maxRecords : 1;
+    aggregateFlush_us = flushDeadline_us;
+    aggregateLength = 0;
+    aggregateCount = 0;
+    aggregateDeadline_us = INT64_MAX;
+}
+
+bool Protocol::aggregatePacket(const TestPacket &packet, int64_t now_us)
+{
+    const size_t frameLimit = maxFrameSize(getType());
+    const size_t recordLength = AggregateRecord::WIRE_SIZE + packet.payloadLength;
+    if (packet.type == PACKET_TYPE_AGGREGATE || PacketHeader::WIRE_SIZE + recordLength > frameLimit)
+    {
+        return false;
+    }
+
+    bool sent = true;
+    if (aggregateCount > 0 && aggregateLength + recordLength > frameLimit)
+    {
+        sent = flushAggregate(now_us);
+    }
+
+    if (aggregateCount == 0)
+    {
+        aggregateLength = PacketHeader::WIRE_SIZE; // Header written by flushAggregate()
+        aggregateFirstSequence = packet.sequenceNumber;
+        aggregateFirstTimestamp_us = packet.senderTimestamp_us;
+        aggregateFirstAdded_us = now_us;
+        aggregateDeadline_us = now_us + aggregateFlush_us;
+    }
+
+    AggregateRecord record;
+    record.type = packet.type;
+    record.sequenceNumber = packet.sequenceNumber;
+    record.senderTimestamp_us = packet.senderTimestamp_us;
+    record.sendLag_us = packet.sendLag_us;
+    record.payloadLength = packet.payloadLength;
+    aggregateLength += record.serialize(aggregateFrame + aggregateLength, sizeof(aggregateFrame) - aggregateLength);
+    memcpy(aggregateFrame + aggregateLength, packet.payload, packet.payloadLength);
+    aggregateLength += packet.payloadLength;
+    aggregateCount++;
+
+    // GPS, clock offset and step go out with the latest values
+    aggregateHeader = packet;
+
+    if (aggregateCount >= aggregateMaxRecords)
+    {
+        sent = flushAggregate(now_us) && sent;
+    }
+
+    return sent;
+}
+
+bool Protocol::flushAggregate(int64_t now_us)
+{
+    if (aggregateCount == 0)
+    {
+        return true;
+    }
+
+    // Send time on the wall clock of the packet timestamps, measured from
+    // the first packet on the monotonic clock so a clock adjustment while
+    // the frame fills does not show up as batching delay
+    PacketHeader header = aggregateHeader;
+    header.type = PACKET_TYPE_AGGREGATE;
+    header.sequenceNumber = aggregateFirstSequence;
+    header.senderTimestamp_us = aggregateFirstTimestamp_us != 0 ? aggregateFirstTimestamp_us + (now_us - aggregateFirstAdded_us) : 0;
+    header.sendLag_us = 0;
+    header.payloadLength = (uint16_t)(aggregateLength - PacketHeader::WIRE_SIZE);
+    header.serialize(aggregateFrame, PacketHeader::WIRE_SIZE);
+
+    aggregateFrames++;
+    aggregateRecords += aggregateCount;
+
+    size_t length = aggregateLength;
+    aggregateLength = 0;
+    aggregateCount = 0;
+    aggregateDeadline_us = INT64_MAX;
+
+    return sendFrame(aggregateFrame, length);
+}
+
+int64_t Protocol::getFlushDeadline() const
+{
+    return aggregateDeadline_us;
+}
+
+uint32_t Protocol::getAggregateFrames() const
+{
+    return aggregateFrames;
+}
+
+uint32_t Protocol::getAggregateRecords() const
+{
+    return aggregateRecords;
+}
+
+bool Protocol::setPacketCallback(PacketReceivedCallback callback, void *context)
+{
+    packetCallback = callback;
+    packetCallbackContext = context;
+    return true;
+}
+
+uint32_t Protocol::getRejectedFrames() const
+{
+    return rejectedFrames;
+}
+
+TxTracker *Protocol::getTxTracker()
+{
+    return nullptr;
+}
+
+void Protocol::retransmit()
+{
+}
+
+bool Protocol::advertises() const
+{
+    return false;
+}
+
+void Protocol::onDiscovery(const PacketView &frame, const RxMetadata &rx)
+{
+    (void)frame;
+    (void)rx;
+}
+
+bool Protocol::pollLinkEvent(LinkEvent &event)
+{
+    if (!firstFrameReported && firstFrameSeen.load(std::memory_order_acquire))
+    {
+        firstFrameReported = true;
+        event.type = LINK_FIRST_FRAME;
+        event.reason = 0;
+        event.at_ms = firstFrameAt_ms;
+        event.duration_ms = firstFrameAt_ms - createdAt_ms;
+        return true;
+    }
+
+    return linkEvents.tryPop(event);
+}
+
+void Protocol::linkDown(uint8_t reason)
+{
+    if (linkIsDown)
+    {
+        return;
+    }
+
+    linkIsDown = true;
+    linkDownAt_ms = millis();
+    linkEvents.tryPush({LINK_DOWN, reason, linkDownAt_ms, 0});
+}
+
+void Protocol::linkUp()
+{
+    if (!linkIsDown)
+    {
+        return;
+    }
+
+    linkIsDown = false;
+    uint32_t now_ms = millis();
+    linkEvents.tryPush({LINK_UP, 0, now_ms, now_ms - linkDownAt_ms});
+}
+
+void Protocol::peerFound()
+{
+    uint32_t now_ms = millis();
+    linkEvents.tryPush({LINK_PEER_FOUND, 0, now_ms, now_ms - createdAt_ms});
+}
+
+bool Protocol::deliverFrame(const uint8_t *data, size_t length, const RxMetadata &rx)
+{
+    // Validated once; fields are read in place from the driver's buffer
+    PacketView packet;
+    if (!packet.parse(data, length) || packet.payloadLength() > MAX_PACKET_SIZE)
+    {
+        rejectedFrames++;
+        return false;
+    }
+
+    if (packet.type() == PACKET_TYPE_AGGREGATE)
+    {
+        return deliverAggregate(packet, rx);
+    }
+
+    noteFrameReceived();
+
+    if (packet.type() == PACKET_TYPE_DISCOVERY)
+    {
+        onDiscovery(packet, rx);
+        return true;
+    }
+
+    RxMetadata framed = rx;
+    framed.frameLength = (uint16_t)length;
+
+    // Call the packet callback if registered
+    if (packetCallback)
+    {
+        packetCallback(packetCallbackContext, packet, framed);
+    }
+
+    return true;
+}
+
+bool Protocol::deliverAggregate(const PacketView &frame, const RxMetadata &rx)
+{
+    const uint8_t *records = frame.payload();
+    size_t recordsLength = frame.payloadLength();
+
+    // Walk the records once to validate them and count them for the metadata
+    size_t count = 0;
+    for (size_t offset = 0; offset < recordsLength; count++)
+    {
+        AggregateRecord record;
+        if (!record.deserialize(records + offset, recordsLength - offset) ||
+            record.type >= PACKET_TYPE_COUNT || record.type == PACKET_TYPE_AGGREGATE ||
+            record.type == PACKET_TYPE_DISCOVERY)
+        {
+            rejectedFrames++;
+            return false;
+        }
+        offset += AggregateRecord::WIRE_SIZE + record.payloadLength;
+    }
+
+    // The outer header already passed PacketView::parse()
+    PacketHeader shared;
+    if (count == 0 || count > UINT8_MAX || !shared.deserialize(frame.data(), PacketHeader::WIRE_SIZE + recordsLength))
+    {
+        rejectedFrames++;
+        return false;
+    }
+
+    noteFrameReceived();
+
+    RxMetadata framed = rx;
+    framed.frameLength = (uint16_t)(PacketHeader::WIRE_SIZE + recordsLength);
+    framed.aggregateCount = (uint8_t)count;
+
+    const int64_t frameSent_us = shared.senderTimestamp_us;
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        AggregateRecord record;
+        record.deserialize(records + offset, recordsLength - offset);
+        const uint8_t *payload = records + offset + AggregateRecord::WIRE_SIZE;
+        offset += AggregateRecord::WIRE_SIZE + record.payloadLength;
+
+        // Rebuild the packet as if it had been sent alone, so the callback
+        // sees the same view either way
+        shared.type = record.type;
+        shared.sequenceNumber = record.sequenceNumber;
+        shared.senderTimestamp_us = record.senderTimestamp_us;
+        shared.sendLag_us = record.sendLag_us;
+        shared.payloadLength = record.payloadLength;
+        size_t headerLength = shared.serialize(rxRecordFrame, sizeof(rxRecordFrame));
+        memcpy(rxRecordFrame + headerLength, payload, record.payloadLength);
+
+        PacketView packet;
+        packet.parse(rxRecordFrame, headerLength + record.payloadLength);
+
+        // Both timestamps are on the sender's clock; 0 if it had no time
+        int64_t batchDelay_us = (frameSent_us != 0 && record.senderTimestamp_us != 0) ? frameSent_us - record.senderTimestamp_us : 0;
+        framed.aggregateIndex = (uint8_t)i;
+        framed.batchDelay_us = batchDelay_us > INT32_MAX ? INT32_MAX : (int32_t)batchDelay_us;
+
+        if (packetCallback)
+        {
+            packetCallback(packetCallbackContext, packet, framed);
+        }
+    }
+
+    return true;
+}
+
+void Protocol::noteFrameReceived()
+{
+    // Only the receiving task writes it, before publishing the flag
+    if (!firstFrameSeen.load(std::memory_order_relaxed))
+    {
+        firstFrameAt_ms = millis();
+        firstFrameSeen.store(true, std::memory_order_release);
+    }
+}
@@ -2,7 +2,49 @@
 #define PROTOCOL_BASE_H
 
 #include <Arduino.h>
+#include <atomic>
 #include "config.h"
+#include "packet.h"
+#include "peer_address.h"
+#include "tx_tracker.h"
+#include "../util/spsc_ring.h"
+
+// PHY format of a received frame
+enum RxPhyMode : uint8_t
+{
+    RX_PHY_UNKNOWN = 0,
+    RX_PHY_11B = 1, // DSSS/CCK
+    RX_PHY_11G = 2, // Legacy OFDM
+    RX_PHY_HT = 3,  // 802.11n
+    RX_PHY_HE = 4   // 802.11ax
+};
+
+// Radio metadata for one received frame, from the driver's rx_ctrl.
+// Fields the radio did not report keep their defaults.
+struct RxMetadata
+{
+    int8_t rssi_dBm = -127;
+    int8_t noiseFloor_dBm = 0;       // 0 if unknown
+    uint8_t phyMode = RX_PHY_UNKNOWN; // RxPhyMode
+    uint8_t rate = 0;                 // wifi_phy_rate_t for 11b/g, MCS for HE
+    uint8_t bandwidth_MHz = 0;        // 0 if unknown
+    uint8_t channel = 0;
+    bool perFrame = false;            // false if RSSI is an averaged estimate
+    uint32_t radioTimestamp_us = 0;   // Radio's local time at reception
+    PeerAddress source;               // Sender's MAC or IP address and port
+
+    // Framing, filled in by Protocol::deliverFrame()
+    uint16_t frameLength = 0;   // Bytes of the frame that carried the packet
+    uint8_t aggregateCount = 1; // Packets in that frame
+    uint8_t aggregateIndex = 0; // Position of this packet in it
+    int32_t batchDelay_us = 0;  // Time the packet waited on the sender for its frame
+
+    // Signal-to-noise ratio, 0 if the noise floor is unknown
+    int snr_dB() const
+    {
+        return noiseFloor_dBm != 0 ? rssi_dBm - noiseFloor_dBm : 0;
+    }
+};
 
 class Protocol
 {
@@ -16,20 +58,39 @@ public:
         PROTO_ESPNOW = 4
     };
 
-    // Data structure for test packets
-    struct TestPacket
+    // Data structure for test packets: wire header followed by the payload
+    struct TestPacket : PacketHeader
+    {
+        uint8_t payload[MAX_PACKET_SIZE]; // payloadLength bytes go on the air
+    };
+
+    // Largest frame produced by a TestPacket
+    static const size_t MAX_FRAME_SIZE = PacketHeader::WIRE_SIZE + MAX_PACKET_SIZE;
+
+    static_assert(PACKET_SIZE >= EchoTimestamps::WIRE_SIZE, "Echo replies need PACKET_SIZE >= 16");
+    static_assert(MAX_PACKET_SIZE >= PACKET_SIZE, "MAX_PACKET_SIZE must cover the default PACKET_SIZE");
+
+    // Change in a protocol's ability to carry packets
+    enum LinkEventType : uint8_t
+    {
+        LINK_FIRST_FRAME = 1, // First valid frame since the protocol was created
+        LINK_DOWN = 2,        // Association lost
+        LINK_UP = 3,          // Association restored
+        LINK_PEER_FOUND = 4   // Unicast peer discovered
+    };
+
+    struct LinkEvent
     {
-        uint32_t sequenceNumber;    // Incrementing sequence number
-        int64_t senderTimestamp_us; // High-resolution sender timestamp (microseconds)
-        double latitude;
-        double longitude;
-        double altitude_mm;
-        int satellites;
-        uint32_t horizontalAccuracy_mm;
-        uint8_t payload[PACKET_SIZE]; // Fixed payload of 75 bytes
+        uint8_t type;         // LinkEventType
+        uint8_t reason;       // Driver's disconnect reason for LINK_DOWN, else 0
+        uint32_t at_ms;       // millis() when it happened
+        uint32_t duration_ms; // Time to first frame or peer, or the outage a LINK_UP ends
     };
 
-    using PacketReceivedCallback = void (*)(const TestPacket &packet, int8_t rssi);
+    // Called from the radio/network task with the context given to
+    // setPacketCallback() and a view into the driver's buffer, valid only
+    // for the duration of the call
+    using PacketReceivedCallback = void (*)(void *context, const PacketView &packet, const RxMetadata &rx);
 
     Protocol(uint8_t channel, int8_t txPower);
     virtual ~Protocol();
@@ -37,11 +98,62 @@ public:
     // Initialize the protocol
     virtual bool begin() = 0;
 
-    // For sender: send a test packet
-    virtual bool sendPacket(const TestPacket &packet) = 0;
+    // Stop the radio and release everything begin() set up, so another
+    // protocol can be started without a reboot. Safe after a failed begin().
+    virtual void end() = 0;
+
+    // Serialize and send a test packet. Frames are built in a member buffer,
+    // so packets must be sent from one task at a time.
+    bool sendPacket(const TestPacket &packet);
+
+    // Largest frame a protocol can carry in one transmission, at most MAX_FRAME_SIZE
+    static size_t maxFrameSize(ProtocolType type);
+
+    // Pack up to maxRecords test packets per frame with aggregatePacket().
+    // A partly filled frame is due flushDeadline_us after its first packet
+    // was added. Drops anything pending.
+    void setAggregation(uint8_t maxRecords, uint32_t flushDeadline_us);
+
+    // Add a test packet to the pending aggregate frame. The frame is sent
+    // first if the packet does not fit, and once it holds maxRecords. now_us
+    // is the caller's monotonic clock, for the flush deadline. Returns false
+    // if a frame could not be sent or the packet can never fit. Packets must
+    // be added from one task at a time, like sendPacket().
+    bool aggregatePacket(const TestPacket &packet, int64_t now_us);
+
+    // Send the pending aggregate frame. now_us is on the same clock as for
+    // aggregatePacket(). True if nothing was pending.
+    bool flushAggregate(int64_t now_us);
+
+    // When the pending aggregate must be sent by, INT64_MAX if none is pending
+    int64_t getFlushDeadline() const;
 
-    // For receiver: set callback for packet reception
-    virtual bool setPacketCallback(PacketReceivedCallback callback) = 0;
+    // Aggregate frames sent and the packets they carried, since creation
+    uint32_t getAggregateFrames() const;
+    uint32_t getAggregateRecords() const;
+
+    // Set callback for packet reception, with a context pointer passed back
+    // to it (usually the role)
+    bool setPacketCallback(PacketReceivedCallback callback, void *context);
+
+    // Number of received frames rejected by magic, version, type or length
+    uint32_t getRejectedFrames() const;
+
+    // Take the next link event, from report() only. False if there is none.
+    bool pollLinkEvent(LinkEvent &event);
+
+    // Completions of sent frames, for protocols whose driver reports them
+    // (ESP-NOW); nullptr otherwise
+    virtual TxTracker *getTxTracker();
+
+    // Send again a unicast frame the driver reported unacknowledged, from
+    // the sending task once the TxTracker's ready callback has woken it.
+    // Protocols without driver retries have nothing to do.
+    virtual void retransmit();
+
+    // True if senders find this end from its PACKET_TYPE_DISCOVERY frames
+    // (unicast ESP-NOW receiver). The role sends them from process().
+    virtual bool advertises() const;
 
     // Check if the protocol has been successfully initialized
     bool isInitialized() const;
@@ -62,6 +174,72 @@ protected:
     uint8_t channel;
     int8_t txPower;
     bool initialized;
+
+    // Packet callback function pointer
+    PacketReceivedCallback packetCallback = nullptr;
+    void *packetCallbackContext = nullptr;
+
+    // Frames dropped by deliverFrame()
+    uint32_t rejectedFrames = 0;
+
+    // Serialized frame for sendPacket(), too large for the esp_timer task's stack
+    uint8_t txFrame[MAX_FRAME_SIZE];
+
+    // Aggregate frame being filled by aggregatePacket(); records start after the header
+    uint8_t aggregateFrame[MAX_FRAME_SIZE];
+    size_t aggregateLength = 0;
+    uint8_t aggregateCount = 0;
+    uint8_t aggregateMaxRecords = 1;
+    uint32_t aggregateFlush_us = 0;
+    int64_t aggregateDeadline_us = INT64_MAX;
+    PacketHeader aggregateHeader; // Shared fields, from the latest packet
+    uint32_t aggregateFirstSequence = 0;
+    int64_t aggregateFirstTimestamp_us = 0; // First packet's senderTimestamp_us
+    int64_t aggregateFirstAdded_us = 0;     // and when it was added, on the caller's clock
+    std::atomic<uint32_t> aggregateFrames{0};
+    std::atomic<uint32_t> aggregateRecords{0};
+
+    // Test packet rebuilt from an aggregate record, only touched by the receiving task
+    uint8_t rxRecordFrame[MAX_FRAME_SIZE];
+
+    // Transmit one serialized frame
+    virtual bool sendFrame(const uint8_t *data, size_t length) = 0;
+
+    // Validate a received frame and pass it to the packet callback, once
+    // per packet for an aggregate
+    bool deliverFrame(const uint8_t *data, size_t length, const RxMetadata &rx);
+
+    // Unpack a parsed aggregate frame. Rejected whole if any record is malformed.
+    bool deliverAggregate(const PacketView &frame, const RxMetadata &rx);
+
+    // A receiver advertised itself, from the receiving task. Discovery
+    // frames go here instead of to the packet callback.
+    virtual void onDiscovery(const PacketView &frame, const RxMetadata &rx);
+
+    // Report association changes, from one event task only. Repeated
+    // reports of the same state are ignored.
+    void linkDown(uint8_t reason);
+    void linkUp();
+
+    // Report that frames now go to a discovered peer, from the same task
+    void peerFound();
+
+private:
+    // Record the time of the first valid frame, from the receiving task
+    void noteFrameReceived();
+
+    // Link events from the event task (producer) to report() (consumer)
+    SpscRing<LinkEvent, 8> linkEvents;
+
+    // Outage in progress, owned by the event task
+    bool linkIsDown = false;
+    uint32_t linkDownAt_ms = 0;
+
+    // Time to first frame: set once by the receive path, reported once by pollLinkEvent()
+    uint32_t createdAt_ms;
+    std::atomic<bool> firstFrameSeen{false};
+    uint32_t firstFrameAt_ms = 0;
+    bool firstFrameReported = false;
 };
 
 #endif // PROTOCOL_BASE_H
\ No newline at end of file
@@ -0,0 +1,27 @@
+#include "protocol_factory.h"
+#include "wifi.h"
+#include "espnow.h"
+
+Protocol *createProtocol(const TestConfig &config, bool isSender)
+{
+    switch (config.protocol)
+    {
+    case Protocol::ProtocolType::PROTO_WIFI4:
+    case Protocol::ProtocolType::PROTO_WIFI6:
+    case Protocol::ProtocolType::PROTO_WIFI_LR:
+        return new WiFiProtocol(config.protocol, config.channel, config.txPower, isSender);
+
+    case Protocol::ProtocolType::PROTO_ESPNOW:
+    {
+        // Unicast senders discover the receiver, which advertises itself
+        ESPNOWProtocol::LinkOptions options;
+        options.unicast = config.espnowUnicast;
+        options.isSender = isSender;
+        options.phyRate = config.espnowRate;
+        options.retries = config.espnowRetries;
+        return new ESPNOWProtocol(config.channel, config.txPower, config.longRange, options);
+    }
+    }
+
+    return nullptr;
+}
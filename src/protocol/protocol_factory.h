@@ -0,0 +1,11 @@
+#ifndef PROTOCOL_FACTORY_H
+#define PROTOCOL_FACTORY_H
+
+#include "protocol.h"
+#include "../settings/test_config.h"
+
+// Construct the protocol a test configuration selects; the caller owns it.
+// Wi-Fi runs the sender as the access point and the receiver as a station.
+Protocol *createProtocol(const TestConfig &config, bool isSender);
+
+#endif // PROTOCOL_FACTORY_H
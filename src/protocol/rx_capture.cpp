@@ -0,0 +1,215 @@
+#include "rx_capture.h"
+#include <esp_timer.h>
+
+// Baseband formats reported in rx_ctrl.cur_bb_format
+static const uint8_t BB_FORMAT_11B = 0;
+static const uint8_t BB_FORMAT_11G = 1;
+static const uint8_t BB_FORMAT_HT = 2;
+static const uint8_t BB_FORMAT_HE_SU = 4;
+static const uint8_t BB_FORMAT_HE_MU = 5;
+static const uint8_t BB_FORMAT_HE_ERSU = 6;
+static const uint8_t BB_FORMAT_HE_TB = 7;
+
+// Bytes between the 802.11 header and the UDP payload, plus the FCS
+static const size_t LLC_SNAP_SIZE = 8;
+static const size_t IPV4_HEADER_SIZE = 20;
+static const size_t UDP_HEADER_SIZE = 8;
+static const size_t FCS_SIZE = 4;
+static const size_t CCMP_OVERHEAD = 16; // CCMP header and MIC
+
+// Define and initialize the static instance pointer
+RxCapture *RxCapture::instance = nullptr;
+
+RxCapture::RxCapture()
+    : localMac{}, lastSequenceControl(0xFFFF), capturing(false), matched(0), unmatched(0)
+{
+}
+
+RxCapture::~RxCapture()
+{
+    end();
+}
+
+bool RxCapture::begin(wifi_interface_t interface)
+{
+    if (esp_wifi_get_mac(interface, localMac) != ESP_OK)
+    {
+        Serial.println("RX capture: Failed to read MAC address");
+        return false;
+    }
+
+    instance = this;
+
+    wifi_promiscuous_filter_t filter = {};
+    filter.filter_mask = WIFI_PROMIS_FILTER_MASK_DATA;
+
+    if (esp_wifi_set_promiscuous_filter(&filter) != ESP_OK ||
+        esp_wifi_set_promiscuous_rx_cb(&RxCapture::onPromiscuousFrame) != ESP_OK ||
+        esp_wifi_set_promiscuous(true) != ESP_OK)
+    {
+        Serial.println("RX capture: Failed to enable promiscuous mode");
+        instance = nullptr;
+        return false;
+    }
+
+    capturing = true;
+    Serial.println("RX capture: Per-frame radio metadata enabled");
+    return true;
+}
+
+void RxCapture::end()
+{
+    if (!capturing)
+    {
+        return;
+    }
+
+    esp_wifi_set_promiscuous(false);
+    esp_wifi_set_promiscuous_rx_cb(nullptr);
+    capturing = false;
+    instance = nullptr;
+}
+
+void RxCapture::onPromiscuousFrame(void *buffer, wifi_promiscuous_pkt_type_t type)
+{
+    // Runs in the Wi-Fi task for every data frame on the channel: keep it short
+    if (!instance || type != WIFI_PKT_DATA)
+    {
+        return;
+    }
+
+    const wifi_promiscuous_pkt_t *packet = static_cast<const wifi_promiscuous_pkt_t *>(buffer);
+    const uint8_t *frame = packet->payload;
+    size_t length = packet->rx_ctrl.sig_len; // Includes the FCS
+
+    if (length < 24 + FCS_SIZE)
+    {
+        return;
+    }
+
+    // Only Data and QoS Data frames carry a body
+    uint8_t subtype = (frame[0] >> 4) & 0x0F;
+    uint8_t flags = frame[1];
+    if (subtype != 0 && subtype != 8)
+    {
+        return;
+    }
+
+    // Address 1 is the receiver
+    if (memcmp(frame + 4, instance->localMac, 6) != 0)
+    {
+        return;
+    }
+
+    // Skip retransmissions of a frame already queued
+    uint16_t sequenceControl = frame[22] | (frame[23] << 8);
+    if ((flags & 0x08) && sequenceControl == instance->lastSequenceControl)
+    {
+        return;
+    }
+    instance->lastSequenceControl = sequenceControl;
+
+    size_t overhead = 24 + LLC_SNAP_SIZE + IPV4_HEADER_SIZE + UDP_HEADER_SIZE + FCS_SIZE;
+    if ((flags & 0x03) == 0x03)
+    {
+        overhead += 6; // Address 4
+    }
+    if (subtype == 8)
+    {
+        overhead += 2; // QoS control
+        if (flags & 0x80)
+        {
+            overhead += 4; // HT control
+        }
+    }
+    if (flags & 0x40)
+    {
+        overhead += CCMP_OVERHEAD;
+    }
+
+    if (length <= overhead)
+    {
+        return;
+    }
+
+    CapturedFrame *slot = instance->frames.acquire();
+    if (!slot)
+    {
+        return; // Queue full, counted as an overflow
+    }
+
+    slot->captured_us = esp_timer_get_time();
+    slot->udpPayloadLength = (uint16_t)(length - overhead);
+    slot->rx = RxMetadata();
+    fromRxCtrl(packet->rx_ctrl, slot->rx);
+
+    instance->frames.commit();
+}
+
+bool RxCapture::match(size_t udpPayloadLength, RxMetadata &rx)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    // Frames ahead of the match were not UDP datagrams for us
+    const CapturedFrame *frame;
+    while ((frame = frames.front()) != nullptr)
+    {
+        bool found = frame->udpPayloadLength == udpPayloadLength && now_us - frame->captured_us <= MAX_AGE_US;
+        if (found)
+        {
+            rx = frame->rx;
+        }
+        frames.release();
+
+        if (found)
+        {
+            matched++;
+            return true;
+        }
+    }
+
+    unmatched++;
+    return false;
+}
+
+void RxCapture::fromRxCtrl(const wifi_pkt_rx_ctrl_t &ctrl, RxMetadata &rx)
+{
+    rx.rssi_dBm = ctrl.rssi;
+    rx.noiseFloor_dBm = ctrl.noise_floor;
+    rx.channel = ctrl.channel;
+    rx.bandwidth_MHz = ctrl.second ? 40 : 20;
+    rx.rate = ctrl.rate;
+    rx.radioTimestamp_us = ctrl.timestamp;
+    rx.perFrame = true;
+
+    switch (ctrl.cur_bb_format)
+    {
+    case BB_FORMAT_11B:
+        rx.phyMode = RX_PHY_11B;
+        break;
+
+    case BB_FORMAT_11G:
+        rx.phyMode = RX_PHY_11G;
+        break;
+
+    case BB_FORMAT_HT:
+        rx.phyMode = RX_PHY_HT;
+        break;
+
+    case BB_FORMAT_HE_SU:
+    case BB_FORMAT_HE_ERSU:
+        // MCS is in HE-SIG-A1 bits 3-6; rate only covers legacy frames
+        rx.phyMode = RX_PHY_HE;
+        rx.rate = (ctrl.he_siga1 >> 3) & 0x0F;
+        break;
+
+    case BB_FORMAT_HE_MU:
+    case BB_FORMAT_HE_TB:
+        rx.phyMode = RX_PHY_HE;
+        break;
+
+    default:
+        rx.phyMode = RX_PHY_UNKNOWN;
+        break;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef RX_CAPTURE_H
+#define RX_CAPTURE_H
+
+#include "protocol.h"
+#include <esp_wifi.h>
+#include "../util/spsc_ring.h"
+
+// Per-frame radio metadata for packets received through the IP stack.
+//
+// ESP-NOW hands rx_ctrl to its receive callback, but UDP packets reach
+// AsyncUDP without it. RxCapture runs a promiscuous-mode callback on data
+// frames addressed to this device and queues each frame's rx_ctrl with the
+// UDP payload length reconstructed from the 802.11 length. With WPA2 the
+// payload is encrypted, so frames cannot be matched by test sequence number.
+// The UDP handler instead takes the oldest captured frame whose length
+// matches its datagram. Frames are delivered to lwIP in the order they were
+// received, so intervening frames (ARP, DHCP, retries) are skipped.
+//
+// The promiscuous callback runs in the Wi-Fi task and the UDP handler in the
+// AsyncUDP task: one producer and one consumer.
+class RxCapture
+{
+public:
+    RxCapture();
+    ~RxCapture();
+
+    // Start capturing frames sent to the interface's MAC address
+    bool begin(wifi_interface_t interface);
+
+    // Stop capturing
+    void end();
+
+    // Find the metadata of the frame that carried a UDP payload of the given
+    // length. Returns false, leaving rx unchanged, if none was captured.
+    bool match(size_t udpPayloadLength, RxMetadata &rx);
+
+    uint32_t getMatched() const
+    {
+        return matched;
+    }
+
+    uint32_t getUnmatched() const
+    {
+        return unmatched;
+    }
+
+    // Convert the driver's rx_ctrl (ESP32-C6 layout) into RxMetadata
+    static void fromRxCtrl(const wifi_pkt_rx_ctrl_t &ctrl, RxMetadata &rx);
+
+private:
+    // Captured frames older than this no longer belong to a pending datagram
+    static const int64_t MAX_AGE_US = 100000;
+
+    struct CapturedFrame
+    {
+        int64_t captured_us;
+        uint16_t udpPayloadLength;
+        RxMetadata rx;
+    };
+
+    static RxCapture *instance;
+
+    SpscRing<CapturedFrame, 32> frames;
+    uint8_t localMac[6];
+    uint16_t lastSequenceControl;
+    bool capturing;
+
+    uint32_t matched;
+    uint32_t unmatched;
+
+    static void onPromiscuousFrame(void *buffer, wifi_promiscuous_pkt_type_t type);
+};
+
+#endif // RX_CAPTURE_H
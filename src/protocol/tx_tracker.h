@@ -0,0 +1,278 @@
+#ifndef TX_TRACKER_H
+#define TX_TRACKER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "../util/spsc_ring.h"
+
+// Transmit completions for a driver that reports the outcome of every
+// accepted frame in send order, without saying which frame it was (ESP-NOW).
+//
+// The sending task records each frame with begin() before handing it to the
+// driver, because the completion callback can run before the driver call
+// returns, then calls accepted() or rejected() with the driver's answer. The
+// callback's complete() matches the oldest accepted frame, so every
+// completion carries the frame's sequence number and its time in the driver.
+// A frame to be sent again is handed back with retryLater() in place of
+// complete(), which wakes the sending task to resend it and report
+// retried(); this works while only one frame is in flight. Completions are
+// queued for the role's process(); counters are kept for the whole run.
+class TxTracker
+{
+public:
+    // Frames that can await completion at once; begin() refuses more
+    static const uint32_t CAPACITY = 64;
+
+    struct Completion
+    {
+        uint32_t sequenceNumber; // First packet in the frame
+        int64_t queued_us;       // When begin() was called, on the caller's clock
+        uint32_t latency_us;     // From begin() to the driver's last report
+        uint8_t attempts;        // Times the frame was handed to the driver
+        bool delivered;          // MAC ACK for unicast; broadcast frames always succeed
+    };
+
+    struct Counters
+    {
+        uint32_t sent = 0;      // Accepted by the driver
+        uint32_t delivered = 0;
+        uint32_t failed = 0;    // Unicast frames the peer never acknowledged
+        uint32_t queueFull = 0; // Refused by the driver for lack of buffers
+        uint32_t errors = 0;    // Refused by the driver for any other reason
+        uint32_t refused = 0;   // Not handed to the driver: CAPACITY frames in flight
+        uint32_t retries = 0;   // Unacknowledged frames sent again
+
+        Counters operator-(const Counters &other) const
+        {
+            Counters d;
+            d.sent = sent - other.sent;
+            d.delivered = delivered - other.delivered;
+            d.failed = failed - other.failed;
+            d.queueFull = queueFull - other.queueFull;
+            d.errors = errors - other.errors;
+            d.refused = refused - other.refused;
+            d.retries = retries - other.retries;
+            return d;
+        }
+    };
+
+    // Called from the completion callback's task when a flow-controlled
+    // sender may send again, or has a frame to send again
+    using ReadyCallback = void (*)(void *context);
+
+    TxTracker()
+        : sentCount(0), completedCount(0), maxInFlight(0), readyWaiting(false), retryDue(false),
+          readyCallback(nullptr), readyContext(nullptr), retryCount(0)
+    {
+    }
+
+    // Forget frames in flight, before the driver is (re)started
+    void reset()
+    {
+        sentCount.store(0);
+        completedCount.store(0);
+        maxInFlight.store(0);
+        readyWaiting.store(false);
+        retryDue.store(false);
+        retryCount = 0;
+    }
+
+    void setReadyCallback(ReadyCallback callback, void *context)
+    {
+        readyCallback.store(nullptr);
+        readyContext = context;
+        readyCallback.store(callback);
+    }
+
+    // Sending task: record the next frame. False, and counted as refused, if
+    // CAPACITY frames are already in flight.
+    bool begin(uint32_t sequenceNumber, int64_t now_us)
+    {
+        if (inFlight() >= CAPACITY)
+        {
+            increment(counters.refused);
+            return false;
+        }
+
+        Pending &pending = frames[sentCount.load(std::memory_order_relaxed) % CAPACITY];
+        pending.sequenceNumber = sequenceNumber;
+        pending.queued_us = now_us;
+        return true;
+    }
+
+    // Sending task: the driver took the frame recorded by begin()
+    void accepted()
+    {
+        sentCount.fetch_add(1, std::memory_order_release);
+        increment(counters.sent);
+
+        uint32_t depth = inFlight();
+        if (depth > maxInFlight.load(std::memory_order_relaxed))
+        {
+            maxInFlight.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    // Sending task: the driver refused the frame recorded by begin()
+    void rejected(bool queueFull)
+    {
+        increment(queueFull ? counters.queueFull : counters.errors);
+    }
+
+    // Completion callback: the oldest accepted frame failed and is to be
+    // sent again. Wakes the sending task through the ready callback; false
+    // if there is none, and the frame must be completed instead.
+    bool retryLater()
+    {
+        ReadyCallback callback = readyCallback.load();
+        if (!callback)
+        {
+            return false;
+        }
+
+        retryDue.store(true, std::memory_order_release);
+        callback(readyContext);
+        return true;
+    }
+
+    // Sending task: true, once, if a frame handed back by retryLater() is
+    // waiting to be sent again
+    bool takeRetry()
+    {
+        return retryDue.exchange(false, std::memory_order_acquire);
+    }
+
+    // Sending task: the frame from takeRetry() is about to go back to the
+    // driver, so its completion is still to come. If the driver refuses it,
+    // nothing is in flight and the sending task completes it as failed.
+    void retried()
+    {
+        retryCount++;
+        increment(counters.retries);
+    }
+
+    // Completion callback (or the sending task, for a resend the driver
+    // refused): the driver finished the oldest accepted frame
+    void complete(bool delivered, int64_t now_us)
+    {
+        uint32_t completed = completedCount.load(std::memory_order_relaxed);
+        const Pending &pending = frames[completed % CAPACITY];
+
+        Completion *completion = completions.acquire();
+        if (completion)
+        {
+            completion->sequenceNumber = pending.sequenceNumber;
+            completion->queued_us = pending.queued_us;
+            completion->latency_us = (uint32_t)(now_us - pending.queued_us);
+            completion->attempts = (uint8_t)(1 + retryCount);
+            completion->delivered = delivered;
+            completions.commit();
+        }
+
+        increment(delivered ? counters.delivered : counters.failed);
+        retryCount = 0;
+        completedCount.store(completed + 1, std::memory_order_release);
+
+        if (readyWaiting.exchange(false))
+        {
+            ReadyCallback callback = readyCallback.load();
+            if (callback)
+            {
+                callback(readyContext);
+            }
+        }
+    }
+
+    // Sending task, for flow control: true if fewer than window frames are
+    // in flight. Otherwise the ready callback runs at the next completion.
+    bool windowOpen(uint32_t window)
+    {
+        if (inFlight() < window)
+        {
+            return true;
+        }
+
+        readyWaiting.store(true);
+
+        // A completion between the check and the flag would not call back
+        return inFlight() < window;
+    }
+
+    // process(): take the next completion
+    bool poll(Completion &completion)
+    {
+        return completions.tryPop(completion);
+    }
+
+    // Frames accepted by the driver and not yet completed
+    uint32_t inFlight() const
+    {
+        // A completion can be counted before its frame's accepted()
+        int32_t depth = (int32_t)(sentCount.load(std::memory_order_acquire) - completedCount.load(std::memory_order_acquire));
+        return depth > 0 ? (uint32_t)depth : 0;
+    }
+
+    // Deepest in-flight count since the last call
+    uint32_t takeMaxInFlight()
+    {
+        return maxInFlight.exchange(0);
+    }
+
+    Counters getCounters() const
+    {
+        Counters snapshot;
+        snapshot.sent = counters.sent.load(std::memory_order_relaxed);
+        snapshot.delivered = counters.delivered.load(std::memory_order_relaxed);
+        snapshot.failed = counters.failed.load(std::memory_order_relaxed);
+        snapshot.queueFull = counters.queueFull.load(std::memory_order_relaxed);
+        snapshot.errors = counters.errors.load(std::memory_order_relaxed);
+        snapshot.refused = counters.refused.load(std::memory_order_relaxed);
+        snapshot.retries = counters.retries.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    // Completions dropped because process() did not take them in time
+    uint32_t getCompletionOverflows() const
+    {
+        return completions.overflowCount();
+    }
+
+private:
+    struct Pending
+    {
+        uint32_t sequenceNumber;
+        int64_t queued_us;
+    };
+
+    // Each counter has one writer: the sending task or the completion callback
+    struct AtomicCounters
+    {
+        std::atomic<uint32_t> sent{0};
+        std::atomic<uint32_t> delivered{0};
+        std::atomic<uint32_t> failed{0};
+        std::atomic<uint32_t> queueFull{0};
+        std::atomic<uint32_t> errors{0};
+        std::atomic<uint32_t> refused{0};
+        std::atomic<uint32_t> retries{0};
+    };
+
+    Pending frames[CAPACITY];
+    std::atomic<uint32_t> sentCount;
+    std::atomic<uint32_t> completedCount;
+    std::atomic<uint32_t> maxInFlight;
+    std::atomic<bool> readyWaiting;
+    std::atomic<bool> retryDue; // Set by the completion callback, taken by the sending task
+    std::atomic<ReadyCallback> readyCallback;
+    void *readyContext;
+    uint32_t retryCount; // Of the oldest frame; written only while nothing is in the driver
+    AtomicCounters counters;
+    SpscRing<Completion, CAPACITY> completions;
+
+    static void increment(std::atomic<uint32_t> &counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+#endif // TX_TRACKER_H
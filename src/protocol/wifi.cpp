@@ -1,24 +1,53 @@
 #include "wifi.h"
 #include "esp_wifi.h"
+#include <mbedtls/pkcs5.h>
+
+uint8_t WiFiProtocol::cachedBssid[6];
+bool WiFiProtocol::bssidCached = false;
+char WiFiProtocol::cachedPsk[65];
 
 // Static callback pointers
 WiFiProtocol::WiFiProtocol(ProtocolType proto, uint8_t channel, int8_t txPower, bool isAccessPoint)
-    : Protocol(channel, txPower), proto(proto), isAP(isAccessPoint)
+    : Protocol(channel, txPower), proto(proto), isAP(isAccessPoint),
+      eventHandlerId(0), eventHandlerRegistered(false), reconnectTimer(nullptr),
+      reconnectEnabled(false), stationUp(false), reconnectBackoff_ms(RECONNECT_BACKOFF_MIN_MS)
 {
     // Set peer IP - will be updated during initialization
     peerIP = IPAddress(0, 0, 0, 0);
+
+    connectionEvents = xEventGroupCreate();
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = onReconnectTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "wifi_reconnect";
+    esp_timer_create(&timerArgs, &reconnectTimer);
 }
 
 WiFiProtocol::~WiFiProtocol()
 {
-    // Clean up WiFi
-    WiFi.disconnect();
+    end();
+
+    if (reconnectTimer)
+    {
+        esp_timer_delete(reconnectTimer);
+    }
+    if (connectionEvents)
+    {
+        vEventGroupDelete(connectionEvents);
+    }
 }
 
 bool WiFiProtocol::begin()
 {
     Serial.println("Initializing WiFi ...");
 
+    // Association changes arrive as events rather than by polling WiFi.status()
+    eventHandlerId = WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info)
+                                  { onWiFiEvent(event, info); });
+    eventHandlerRegistered = true;
+
     // Set WiFi mode first (AP or STA)
     WiFi.mode(isAP ? WIFI_AP : WIFI_STA);
     Serial.println(isAP ? "Configuring as Access Point..." : "Configuring as Station...");
@@ -55,6 +84,27 @@ bool WiFiProtocol::begin()
     Serial.print("Max TX power set to: ");
     Serial.println(txPower);
 
+#if WIFI_RX_CAPTURE
+    // Without capture, received packets fall back to the averaged RSSI
+    rxCapture.begin(isAP ? WIFI_IF_AP : WIFI_IF_STA);
+#endif
+
+    // Both ends listen: the receiver for test packets, the sender for echo replies
+    if (udp.listen(DATA_PORT))
+    {
+        Serial.print("UDP listening on port ");
+        Serial.println(DATA_PORT);
+
+        // Set up callback for incoming packets
+        udp.onPacket([this](AsyncUDPPacket packet)
+                     { handleUDPPacket(packet); });
+    }
+    else
+    {
+        Serial.println("Failed to start UDP listener");
+        return false;
+    }
+
     // Print connection details
     if (isAP)
     {
@@ -65,22 +115,6 @@ bool WiFiProtocol::begin()
     }
     else
     {
-        // Begin listening for UDP packets
-        if (udp.listen(DATA_PORT))
-        {
-            Serial.print("UDP listening on port ");
-            Serial.println(DATA_PORT);
-
-            // Set up callback for incoming packets
-            udp.onPacket([this](AsyncUDPPacket packet)
-                         { handleUDPPacket(packet); });
-        }
-        else
-        {
-            Serial.println("Failed to start UDP listener");
-            return false;
-        }
-
         Serial.print("Station IP address: ");
         Serial.println(WiFi.localIP());
 
@@ -94,6 +128,41 @@ bool WiFiProtocol::begin()
     return true;
 }
 
+void WiFiProtocol::end()
+{
+    // No reconnects or link events from the disconnect below
+    reconnectEnabled = false;
+    if (eventHandlerRegistered)
+    {
+        WiFi.removeEvent(eventHandlerId);
+        eventHandlerRegistered = false;
+    }
+    if (reconnectTimer)
+    {
+        esp_timer_stop(reconnectTimer);
+    }
+
+#if WIFI_RX_CAPTURE
+    rxCapture.end();
+#endif
+
+    udp.close();
+
+    // Drop the association and stop the driver so the next protocol starts from scratch
+    if (isAP)
+    {
+        WiFi.softAPdisconnect(true);
+    }
+    else
+    {
+        WiFi.disconnect(true);
+    }
+    WiFi.mode(WIFI_OFF);
+
+    peerIP = IPAddress(0, 0, 0, 0);
+    initialized = false;
+}
+
 bool WiFiProtocol::initAsAP()
 {
     IPAddress apIP;
@@ -131,24 +200,29 @@ bool WiFiProtocol::initAsStation()
     // Configure static IP
     WiFi.config(staticIP, gateway, subnet);
 
-    // Connect to AP
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, channel);
-
-    // Wait for connection
-    int timeout = 20; // 10 seconds timeout
-    while (WiFi.status() != WL_CONNECTED && timeout > 0)
-    {
-        delay(500);
-        Serial.print(".");
-        timeout--;
-    }
-
-    if (WiFi.status() != WL_CONNECTED)
+    // Reconnects are ours, with backoff, so an outage at range ends as soon
+    // as the access point is heard again. They also retry the first connect.
+    WiFi.setAutoReconnect(false);
+    reconnectBackoff_ms = RECONNECT_BACKOFF_MIN_MS;
+    reconnectEnabled = true;
+    xEventGroupClearBits(connectionEvents, CONNECTED_BIT);
+
+    // With the channel and a known BSSID the driver probes one channel for
+    // one access point instead of scanning, and the hex PSK skips PBKDF2
+    unsigned long start_ms = millis();
+    const uint8_t *bssid = bssidCached ? cachedBssid : nullptr;
+    WiFi.begin(WIFI_SSID, stationPsk(), channel, bssid);
+
+    EventBits_t bits = xEventGroupWaitBits(connectionEvents, CONNECTED_BIT, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(CONNECT_TIMEOUT_MS));
+    if (!(bits & CONNECTED_BIT))
     {
-        Serial.println("\nFailed to connect to WiFi AP");
+        // The access point may have been replaced; scan for it next time
+        bssidCached = false;
+        Serial.println("Failed to connect to WiFi AP");
         return false;
     }
-    Serial.println("\nConnected to WiFi AP");
+    Serial.printf("Connected to WiFi AP in %lu ms%s\n", millis() - start_ms, bssid ? " (cached BSSID)" : "");
 
     if (!WiFi.setSleep(false))
     {
@@ -188,21 +262,100 @@ bool WiFiProtocol::configureWiFiProtocol()
     }
 }
 
-bool WiFiProtocol::sendPacket(const TestPacket &packet)
+void WiFiProtocol::onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info)
 {
-    if (!initialized || peerIP == IPAddress(0, 0, 0, 0))
+    switch (event)
     {
-        return false;
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+        // Pin this access point for later connects
+        memcpy(cachedBssid, info.wifi_sta_connected.bssid, sizeof(cachedBssid));
+        bssidCached = true;
+        break;
+
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+        stationUp = true;
+        reconnectBackoff_ms = RECONNECT_BACKOFF_MIN_MS;
+        linkUp();
+        xEventGroupSetBits(connectionEvents, CONNECTED_BIT);
+        break;
+
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+        xEventGroupClearBits(connectionEvents, CONNECTED_BIT);
+
+        // Failed attempts while already down are not new outages
+        if (stationUp)
+        {
+            stationUp = false;
+            linkDown(info.wifi_sta_disconnected.reason);
+        }
+
+        if (reconnectEnabled)
+        {
+            esp_timer_start_once(reconnectTimer, (uint64_t)reconnectBackoff_ms * 1000);
+            reconnectBackoff_ms *= 2;
+            if (reconnectBackoff_ms > RECONNECT_BACKOFF_MAX_MS)
+            {
+                reconnectBackoff_ms = RECONNECT_BACKOFF_MAX_MS;
+            }
+        }
+        break;
+
+    case ARDUINO_EVENT_WIFI_AP_STACONNECTED:
+        linkUp();
+        break;
+
+    case ARDUINO_EVENT_WIFI_AP_STADISCONNECTED:
+        linkDown(info.wifi_ap_stadisconnected.reason);
+        break;
+
+    default:
+        break;
     }
+}
 
-    // Send packet via UDP
-    return udp.writeTo((uint8_t *)&packet, sizeof(TestPacket), peerIP, DATA_PORT) > 0;
+void WiFiProtocol::onReconnectTimer(void *arg)
+{
+    WiFiProtocol *wifi = static_cast<WiFiProtocol *>(arg);
+    if (wifi->reconnectEnabled)
+    {
+        esp_wifi_connect();
+    }
 }
 
-bool WiFiProtocol::setPacketCallback(PacketReceivedCallback callback)
+const char *WiFiProtocol::stationPsk()
 {
-    this->packetCallback = callback; // Assign to instance member
-    return true;
+    if (cachedPsk[0] != '\0')
+    {
+        return cachedPsk;
+    }
+
+    // WPA2 PMK: PBKDF2-HMAC-SHA1 of the passphrase salted with the SSID
+    uint8_t pmk[32];
+    if (mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1,
+                                      (const unsigned char *)WIFI_PASSWORD, strlen(WIFI_PASSWORD),
+                                      (const unsigned char *)WIFI_SSID, strlen(WIFI_SSID),
+                                      4096, sizeof(pmk), pmk) != 0)
+    {
+        // Let the driver derive it
+        return WIFI_PASSWORD;
+    }
+
+    for (size_t i = 0; i < sizeof(pmk); i++)
+    {
+        snprintf(cachedPsk + 2 * i, 3, "%02x", pmk[i]);
+    }
+    return cachedPsk;
+}
+
+bool WiFiProtocol::sendFrame(const uint8_t *data, size_t length)
+{
+    if (!initialized || peerIP == IPAddress(0, 0, 0, 0))
+    {
+        return false;
+    }
+
+    // Send frame via UDP
+    return udp.writeTo(data, length, peerIP, DATA_PORT) > 0;
 }
 
 Protocol::ProtocolType WiFiProtocol::getType() const
@@ -231,19 +384,21 @@ const char *WiFiProtocol::getProtocolName() const
 
 void WiFiProtocol::handleUDPPacket(AsyncUDPPacket packet)
 {
-    // Check packet type based on size
-    if (packet.length() == sizeof(TestPacket))
+    RxMetadata rx;
+#if WIFI_RX_CAPTURE
+    if (!rxCapture.match(packet.length(), rx))
+#endif
     {
-        // It's a test packet
-        const TestPacket *testPacket = reinterpret_cast<const TestPacket *>(packet.data());
+        // No per-frame metadata: the station's averaged beacon RSSI is the
+        // best available, and the AP has nothing comparable
+        rx.rssi_dBm = isAP ? -127 : WiFi.RSSI();
+        rx.channel = channel;
+    }
 
-        // Get RSSI
-        int8_t rssi = WiFi.RSSI();
+    IPAddress remoteIP = packet.remoteIP();
+    uint8_t ip[4] = {remoteIP[0], remoteIP[1], remoteIP[2], remoteIP[3]};
+    rx.source = PeerAddress::fromIPv4(ip, packet.remotePort());
 
-        // Call the packet callback if registered
-        if (this->packetCallback) // Use instance member
-        {
-            packetCallback(*testPacket, rssi);
-        }
-    }
+    // Frames with a foreign magic/version or a bad length are rejected here
+    deliverFrame(packet.data(), packet.length(), rx);
 }
\ No newline at end of file
@@ -2,8 +2,13 @@
 #define WIFI_PROTOCOL_H
 
 #include "protocol.h"
+#include <atomic>
 #include <WiFi.h>
 #include <AsyncUDP.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include "rx_capture.h"
 
 class WiFiProtocol : public Protocol
 {
@@ -14,11 +19,8 @@ public:
     // Initialize the WiFi 4 protocol
     virtual bool begin() override;
 
-    // Send a test packet via WiFi
-    virtual bool sendPacket(const TestPacket &packet) override;
-
-    // Set callback for packet reception
-    virtual bool setPacketCallback(PacketReceivedCallback callback) override;
+    // Stop reconnecting, close the socket and turn Wi-Fi off
+    virtual void end() override;
 
     // Get protocol type
     virtual ProtocolType getType() const override;
@@ -26,13 +28,32 @@ public:
     // Get protocol name as string
     virtual const char *getProtocolName() const override;
 
+protected:
+    // Send a serialized frame via UDP
+    virtual bool sendFrame(const uint8_t *data, size_t length) override;
+
 private:
+    // Give up on associating with the access point after this long
+    static const unsigned long CONNECT_TIMEOUT_MS = 10000;
+
+    // Delay before reconnecting after a lost association, doubling on each
+    // failed attempt up to the maximum
+    static const uint32_t RECONNECT_BACKOFF_MIN_MS = 100;
+    static const uint32_t RECONNECT_BACKOFF_MAX_MS = 2000;
+
+    // Set in connectionEvents once the station has its IP
+    static const EventBits_t CONNECTED_BIT = BIT0;
+
+    // Access point BSSID from the last association, and the PSK derived from
+    // WIFI_PASSWORD. Shared by all instances so the connects after a sweep
+    // switch or a console restart skip the scan and the PBKDF2 derivation.
+    static uint8_t cachedBssid[6];
+    static bool bssidCached;
+    static char cachedPsk[65];
+
     // WiFi protocol mode
     ProtocolType proto;
 
-    // Packet callback function pointer
-    PacketReceivedCallback packetCallback = nullptr; // Instance member
-
     // UDP socket for data transmission
     AsyncUDP udp;
 
@@ -42,6 +63,26 @@ private:
     // IP address of the peer
     IPAddress peerIP;
 
+#if WIFI_RX_CAPTURE
+    // rx_ctrl metadata for received datagrams
+    RxCapture rxCapture;
+#endif
+
+    // Handler registered with WiFi.onEvent() between begin() and end()
+    wifi_event_id_t eventHandlerId;
+    bool eventHandlerRegistered;
+
+    // Station association, signalled by the event handler
+    EventGroupHandle_t connectionEvents;
+
+    // One-shot reconnect after a lost association
+    esp_timer_handle_t reconnectTimer;
+    std::atomic<bool> reconnectEnabled;
+
+    // Owned by the Wi-Fi event task
+    bool stationUp;
+    uint32_t reconnectBackoff_ms;
+
     // Initialize as Access Point
     bool initAsAP();
 
@@ -51,6 +92,15 @@ private:
     // Configure WiFi protocol based on selected mode
     bool configureWiFiProtocol();
 
+    // Track association and schedule reconnects, in the Wi-Fi event task
+    void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info);
+
+    // Reconnect timer callback, in the esp_timer task
+    static void onReconnectTimer(void *arg);
+
+    // WIFI_PASSWORD as the 64-digit hex PSK the driver would derive from it
+    static const char *stationPsk();
+
     // Handle incoming UDP packet
     void handleUDPPacket(AsyncUDPPacket packet);
 };
@@ -1,25 +1,34 @@
 #include "receiver.h"
 #include <sys/time.h>
 
-// Initialize static member
-ReceiverRole *ReceiverRole::instance = nullptr;
-
-ReceiverRole::ReceiverRole(Protocol *protocol, GPSHandler *gpsHandler)
-    : Role(protocol, gpsHandler),
-      lastSequenceNumber(0),
-      packetCounter(0),
-      lostPackets(0),
-      statisticsTimer(0)
+ReceiverRole::ReceiverRole(Protocol *protocol, GPSHandler *gpsHandler, const TestConfig &config, LogWriter *logWriter)
+    : Role(protocol, gpsHandler, config, logWriter),
+      lastQueueOverflows(0),
+      untrackedPackets(0),
+      statisticsTimer(0),
+#if RANGE_PROFILE_BINS > 0
+      rangeProfile(RANGE_PROFILE_BIN_M),
+      rangeProfileTimer(0),
+#endif
+      frameStats(),
+      echoReplies(0),
+      echoReplyFailures(0),
+      periodReport(),
+      periodReportDue(false),
+#if RANGE_PROFILE_BINS > 0
+      rangeRows(),
+      rangeRowCount(0),
+      rangeUnplaced(0),
+      rangeProfileDue(false),
+#endif
+      discoverySequence(0),
+      discoveryTimer(0)
 {
-
-    // Set static instance pointer
-    instance = this;
 }
 
 ReceiverRole::~ReceiverRole()
 {
-    // Clear instance pointer
-    instance = nullptr;
+    protocol->setPacketCallback(nullptr, nullptr);
 }
 
 bool ReceiverRole::begin()
@@ -27,36 +36,80 @@ bool ReceiverRole::begin()
     Serial.println("Initializing receiver role...");
 
     // Initialize the protocol
-    if (!protocol->begin())
+    if (!startProtocol())
     {
         Serial.println("Failed to initialize protocol.");
         return false;
     }
 
-    // Wait for GPS fix before continuing
+    // Wait for the GPS task to publish a fix before continuing
     Serial.println("Waiting for GPS fix...");
     while (!gpsHandler->hasFix())
     {
-        gpsHandler->update();
         delay(100);
     }
     Serial.println("GPS fix acquired!");
 
+    // Not forced: the first sync after boot steps the clock anyway, and a
+    // test restarted for a sweep slot must not step the clock it is timed from
     Serial.println("Performing initial time sync with GPS...");
-    syncTimeWithGPS(true); // Force sync
+    syncTimeWithGPS();
+
+    // PPS edges are labelled from the system clock, so attach after the first sync
+    ppsClock.begin(PPS_PIN);
 
     // Set callback for packet reception
-    protocol->setPacketCallback(onPacketReceived);
+    protocol->setPacketCallback(onPacketReceived, this);
 
     // Reset statistics timer
     statisticsTimer = millis();
+#if RANGE_PROFILE_BINS > 0
+    rangeProfileTimer = statisticsTimer;
+#endif
+
+    startLogSession();
+
+    // Senders wait for this before sending anything
+    if (protocol->advertises())
+    {
+        sendDiscovery();
+    }
 
     initialized = true;
     Serial.println("Receiver role initialized successfully!");
     return true;
 }
 
-void ReceiverRole::loop()
+void ReceiverRole::process()
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    // Process packets queued by the radio callback
+    processQueue();
+
+    // Time to first packet and association outages
+    processLinkEvents();
+    logDueSessionHeader();
+
+#if LOG_FORMAT != LOG_FORMAT_NONE
+    // Hand batched log records to the log task
+    logWriter->poll();
+#endif
+
+    // Discipline the PPS clock to any new edge
+    ppsClock.update();
+
+    // Keep advertising for senders that start or restart later
+    if (protocol->advertises() && millis() - discoveryTimer >= DISCOVERY_INTERVAL_MS)
+    {
+        sendDiscovery();
+    }
+}
+
+void ReceiverRole::snapshot()
 {
     if (!initialized)
     {
@@ -65,6 +118,56 @@ void ReceiverRole::loop()
 
     unsigned long currentTime = millis();
 
+    if (currentTime - statisticsTimer >= 10000)
+    {
+        PeriodReport &period = periodReport;
+        period.period_ms = currentTime - statisticsTimer;
+        statisticsTimer = currentTime;
+
+        // Packets dropped on the receiver because the queue was full, not lost over the air
+        period.queueOverflows = rxQueue.overflowCount();
+        period.queueDropped = period.queueOverflows - lastQueueOverflows;
+        period.queueHighWater = rxQueue.highWaterMark();
+        lastQueueOverflows = period.queueOverflows;
+
+        period.latency = latencyHistogram;
+        latencyHistogram.reset();
+
+        // Sums the senders' counters into period.sequence
+        snapshotPeerStatistics();
+
+        period.frames = frameStats;
+        frameStats = FrameStats();
+
+        period.echoReplies = echoReplies;
+        period.echoReplyFailures = echoReplyFailures;
+        echoReplies = 0;
+        echoReplyFailures = 0;
+
+        snapshotStatus();
+        periodReportDue = true;
+    }
+
+#if RANGE_PROFILE_BINS > 0
+    if (RANGE_PROFILE_INTERVAL_MS > 0 && currentTime - rangeProfileTimer >= RANGE_PROFILE_INTERVAL_MS)
+    {
+        rangeProfileTimer = currentTime;
+        snapshotRangeProfile();
+    }
+#endif
+}
+
+void ReceiverRole::report()
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    printLinkEvents();
+
+    unsigned long currentTime = millis();
+
     // Periodically synchronize time with GPS
     if (currentTime - lastSyncTimeMs >= SYNC_INTERVAL_MS)
     {
@@ -73,132 +176,633 @@ void ReceiverRole::loop()
     }
 
     // Print packet loss statistics every 10 seconds
-    if (currentTime - statisticsTimer >= 10000)
+    if (periodReportDue)
     {
-        statisticsTimer = currentTime;
+        periodReportDue = false;
+        const PeriodReport &period = periodReport;
+
+        // Loss is charged when a gap opens and taken back when a late packet
+        // fills it; Pending is the part still inside the window, which may
+        // yet arrive
+        if (period.sequence.received > 0)
+        {
+            uint32_t lost = period.sequence.netLost();
+            float lossRate = (float)lost / (float)(lost + period.sequence.received) * 100.0f;
+            Serial.printf("Packet statistics: Received %lu, Lost %lu, Loss rate %.2f%%, Pending %lu\n",
+                          period.sequence.received, lost, lossRate, period.pendingMissing);
+
+            if (period.sequence.reordered > 0 || period.sequence.duplicates > 0 || period.sequence.recovered > 0 ||
+                period.sequence.restarts > 0)
+            {
+                Serial.printf("Sequence: Reordered %lu, Duplicates %lu, Recovered %lu, Sender restarts %lu\n",
+                              period.sequence.reordered, period.sequence.duplicates, period.sequence.recovered,
+                              period.sequence.restarts);
+            }
+
+            Serial.printf("Latency: p50 %lld us, p90 %lld us, p99 %lld us, p99.9 %lld us, max %lld us\n",
+                          period.latency.percentile(0.50), period.latency.percentile(0.90),
+                          period.latency.percentile(0.99), period.latency.percentile(0.999),
+                          period.latency.getMax());
+
+            if (period.latency.getNegativeCount() > 0)
+            {
+                Serial.printf("Latency: %llu negative samples (clock offset), min %lld us\n",
+                              period.latency.getNegativeCount(), period.latency.getMin());
+            }
+        }
+
+        printPeerStatistics();
+        printFrameStatistics();
 
-        if (packetCounter > 0)
+        if (period.echoReplies > 0 || period.echoReplyFailures > 0)
         {
-            float lossRate = (float)lostPackets / (float)(lostPackets + packetCounter) * 100.0f;
-            Serial.printf("Packet statistics: Received %lu, Lost %lu, Loss rate %.2f%%\n",
-                          packetCounter, lostPackets, lossRate);
+            Serial.printf("Echo: Replied %lu, Failed %lu\n", period.echoReplies, period.echoReplyFailures);
+        }
 
-            // Reset counters
-            packetCounter = 0;
-            lostPackets = 0;
+        if (period.queueDropped > 0)
+        {
+            Serial.printf("Receive queue: Dropped %lu (total %lu), High-water %lu/%u\n",
+                          period.queueDropped, period.queueOverflows, period.queueHighWater,
+                          (unsigned)rxQueue.capacity());
         }
+
+#if LOG_FORMAT != LOG_FORMAT_NONE
+        printLogStatistics();
+#endif
+
+        printLinkStatistics();
+        PpsClock::printStatus(reportedPpsStatus, Serial);
+    }
+
+#if RANGE_PROFILE_BINS > 0
+    if (rangeProfileDue)
+    {
+        rangeProfileDue = false;
+        printRangeProfile();
     }
+#endif
 }
 
-void ReceiverRole::onPacketReceived(const Protocol::TestPacket &packet, int8_t rssi)
+void ReceiverRole::onPacketReceived(void *context, const PacketView &packet, const RxMetadata &rx)
 {
-    // Forward to instance method
-    if (instance)
+    ReceiverRole *receiver = static_cast<ReceiverRole *>(context);
+
+    // Runs in the Wi-Fi/lwIP task: capture the timestamp and queue the header, nothing else
+    if (!receiver || packet.type() == PACKET_TYPE_ECHO_REPLY)
+    {
+        return;
+    }
+
+    ReceivedPacket *slot = receiver->rxQueue.acquire();
+    if (!slot)
     {
-        instance->processPacket(packet, rssi);
+        return; // Queue full, counted as an overflow
     }
+
+    slot->receiverTimestamp_us = receiver->wallClockMicros();
+    slot->rx = rx;
+    memcpy(slot->header, packet.data(), PacketHeader::WIRE_SIZE);
+
+    receiver->rxQueue.commit();
+    receiver->wake();
 }
 
-void ReceiverRole::processPacket(const Protocol::TestPacket &packet, int8_t rssi)
+void ReceiverRole::processQueue()
 {
-    // Record receive timestamp
-    int64_t receiverTimestamp_us;
-    struct timeval tv_now;
-    if (gettimeofday(&tv_now, NULL) == 0)
+    // Bounded to one ring's worth so a packet flood cannot hold off snapshot()
+    for (size_t i = 0; i < rxQueue.capacity(); i++)
     {
-        receiverTimestamp_us = (int64_t)tv_now.tv_sec * 1000000L + tv_now.tv_usec;
+        const ReceivedPacket *received = rxQueue.front();
+        if (!received)
+        {
+            break;
+        }
+
+        processPacket(*received);
+        rxQueue.release();
     }
-    else
+}
+
+void ReceiverRole::processPacket(const ReceivedPacket &received)
+{
+    PacketView packet = received.packet();
+
+    if (received.receiverTimestamp_us == 0)
     {
         Serial.println("Receiver: Failed to get time of day for packet timestamp!");
-        receiverTimestamp_us = 0; // Indicate error or invalid time
-    }
-
-    // Calculate raw and corrected latency
-    int64_t latency_us = (receiverTimestamp_us != 0 && packet.senderTimestamp_us != 0) ? (receiverTimestamp_us - packet.senderTimestamp_us) : 0;
-
-    // Create log entry
-    LogEntry entry;
-
-    entry.protocolName = protocol->getProtocolName();
-    entry.sequenceNumber = packet.sequenceNumber;
-    entry.senderTimestamp_us = packet.senderTimestamp_us;
-    entry.receiverTimestamp_us = receiverTimestamp_us;
-    entry.latency_us = latency_us; // Use the calculated latency
-    entry.rssi_dBm = rssi;         // Store the RSSI
-    entry.configuredTxPower_dBm = protocol->getTransmitPower();
-    entry.configuredChannel = protocol->getChannel();
-    entry.receiverGPS_latitude = gpsHandler->state.lat / 1e7;
-    entry.receiverGPS_longitude = gpsHandler->state.lng / 1e7;
-    entry.receiverGPS_altitude_mm = gpsHandler->state.alt;
-    entry.receiverGPS_satellites = gpsHandler->state.num_sats;
-    entry.receiverGPS_horizontalAccuracy_mm = gpsHandler->state.horizontal_accuracy;
-    entry.senderGPS_latitude = packet.latitude;
-    entry.senderGPS_longitude = packet.longitude;
-    entry.senderGPS_altitude_mm = packet.altitude_mm;
-    entry.senderGPS_satellites = packet.satellites;
-    entry.senderGPS_horizontalAccuracy_mm = packet.horizontalAccuracy_mm;
-
-    // Log entry data
-    logPacketData(entry);
+    }
+
+    // Reply before logging so the sender's round trip does not include our logging time
+    if (packet.type() == PACKET_TYPE_ECHO_REQUEST)
+    {
+        sendEchoReply(received);
+    }
+
+    // Per-packet fields only; protocol, channel and TX power are in the session
+    RxLogRecord record;
+    fillRecord(received, record);
+
+    // Packets share their frame's bytes, so the frame is counted with its first packet
+    frameStats.packets++;
+    frameStats.payloadBytes += packet.payloadLength();
+    frameStats.batchDelaySum_us += received.rx.batchDelay_us;
+    if (received.rx.batchDelay_us > frameStats.batchDelayMax_us)
+    {
+        frameStats.batchDelayMax_us = received.rx.batchDelay_us;
+    }
+    if (received.rx.aggregateIndex == 0)
+    {
+        frameStats.frames++;
+        frameStats.frameBytes += received.rx.frameLength;
+    }
 
     // Calculate packet loss statistics
-    calculatePacketLoss(packet.sequenceNumber);
+    PeerState *peer = lookupPeer(received);
+    SequenceTracker<>::Result sequenceResult = peer ? trackSequence(*peer, record.sequenceNumber, record.senderTimestamp_us) : SequenceTracker<>::NEW;
+
+#if LOG_FORMAT != LOG_FORMAT_NONE
+    // Log record data
+    logPacketData(record);
+#endif
+
+    // Senders beyond MAX_PEERS are logged but have no statistics
+    if (!peer)
+    {
+        untrackedPackets++;
+        return;
+    }
+
+    if (record.clockOffset_us != PacketHeader::CLOCK_OFFSET_UNKNOWN)
+    {
+        peer->clockOffset_us = record.clockOffset_us;
+    }
+
+    peer->latitude_e7 = record.senderLatitude_e7;
+    peer->longitude_e7 = record.senderLongitude_e7;
+    peer->altitude_mm = record.senderAltitude_mm;
+    peer->satellites = record.senderSatellites;
+
+    // -127 means the radio reported no RSSI for this packet
+    if (record.rssi_dBm != -127)
+    {
+        peer->rssiAverage_dBm += (record.rssi_dBm - peer->rssiAverage_dBm) / 8.0f;
+    }
+
+    // Duplicates are logged but must not skew the latency or step statistics
+    if (sequenceResult == SequenceTracker<>::DUPLICATE)
+    {
+        return;
+    }
+
+    // Streaming latency statistics, O(1) per packet
+    int64_t latency_us = record.latency_us();
+    if (latency_us != 0)
+    {
+        latencyHistogram.record(latency_us);
+        peer->latencyHistogram.record(latency_us);
+        peer->jitter.update(latency_us);
+    }
+
+#if RANGE_PROFILE_BINS > 0
+    // Loss goes to the bin where the link came back, and back out of it
+    rangeProfile.account(peer->rangeGaps, peer->sequenceTracker, sequenceResult, record.sequenceNumber,
+                         peerDistance(*peer, record), record.rssi_dBm, latency_us);
+#endif
+
+    // Per-step throughput statistics; a new step id closes the previous step
+    // and a sender restart closes it where the old sequence stopped
+    StepReport report;
+    if (sequenceResult == SequenceTracker<>::RESTART && peer->stepStats.flush(report))
+    {
+        printStepReport(*peer, report);
+    }
+    if (peer->stepStats.add(record.stepId, record.sequenceNumber, packet.payloadLength(), record.receiverTimestamp_us, latency_us, report))
+    {
+        printStepReport(*peer, report);
+    }
+}
+
+void ReceiverRole::sendEchoReply(const ReceivedPacket &received)
+{
+    PacketView request = received.packet();
+
+    // The header echoes the request's sequence number and send time (t1);
+    // GPS fields carry the receiver's position
+    Protocol::TestPacket reply;
+    reply.type = PACKET_TYPE_ECHO_REPLY;
+    reply.sequenceNumber = request.sequenceNumber();
+    reply.senderTimestamp_us = request.senderTimestamp_us();
+    GPSHandler::Fix fix = gpsHandler->fix();
+    reply.latitude_e7 = fix.latitude_e7;
+    reply.longitude_e7 = fix.longitude_e7;
+    reply.altitude_mm = fix.altitude_mm;
+    reply.satellites = fix.satellites;
+    reply.horizontalAccuracy_mm = fix.horizontalAccuracy_mm;
+    reply.sendLag_us = 0;
+    reply.clockOffset_us = PacketHeader::CLOCK_OFFSET_UNKNOWN;
+    reply.stepId = request.stepId();
+    reply.nodeId = request.nodeId(); // Lets the requester ignore other senders' replies
+
+    // t2 is the radio callback timestamp, t3 is taken as late as possible
+    EchoTimestamps timestamps;
+    timestamps.receive_us = received.receiverTimestamp_us;
+    timestamps.transmit_us = wallClockMicros();
+    reply.payloadLength = (uint16_t)timestamps.serialize(reply.payload, sizeof(reply.payload));
+
+    if (protocol->sendPacket(reply))
+    {
+        echoReplies++;
+    }
+    else
+    {
+        echoReplyFailures++;
+    }
+}
+
+void ReceiverRole::sendDiscovery()
+{
+    discoveryTimer = millis();
+
+    // Senders only need the source address; the header carries our position and node id
+    Protocol::TestPacket advertisement;
+    advertisement.type = PACKET_TYPE_DISCOVERY;
+    advertisement.sequenceNumber = discoverySequence++;
+    advertisement.senderTimestamp_us = wallClockMicros();
+    GPSHandler::Fix fix = gpsHandler->fix();
+    advertisement.latitude_e7 = fix.latitude_e7;
+    advertisement.longitude_e7 = fix.longitude_e7;
+    advertisement.altitude_mm = fix.altitude_mm;
+    advertisement.satellites = fix.satellites;
+    advertisement.horizontalAccuracy_mm = fix.horizontalAccuracy_mm;
+    advertisement.sendLag_us = 0;
+    advertisement.clockOffset_us = PacketHeader::CLOCK_OFFSET_UNKNOWN;
+    advertisement.stepId = 0;
+    advertisement.nodeId = localNodeId();
+    advertisement.payloadLength = 0;
+
+    protocol->sendPacket(advertisement);
+}
+
+void ReceiverRole::fillRecord(const ReceivedPacket &received, RxLogRecord &record) const
+{
+    PacketView packet = received.packet();
+
+    record.receiverMillis = millis();
+    record.sequenceNumber = packet.sequenceNumber();
+    record.senderTimestamp_us = packet.senderTimestamp_us();
+    record.receiverTimestamp_us = received.receiverTimestamp_us;
+
+    GPSHandler::Fix fix = gpsHandler->fix();
+    record.receiverLatitude_e7 = fix.latitude_e7;
+    record.receiverLongitude_e7 = fix.longitude_e7;
+    record.receiverAltitude_mm = fix.altitude_mm;
+    record.receiverHorizontalAccuracy_mm = fix.horizontalAccuracy_mm;
+    record.senderLatitude_e7 = packet.latitude_e7();
+    record.senderLongitude_e7 = packet.longitude_e7();
+    record.senderAltitude_mm = packet.altitude_mm();
+    record.senderHorizontalAccuracy_mm = packet.horizontalAccuracy_mm();
+    record.receiverSatellites = fix.satellites;
+    record.senderSatellites = packet.satellites();
+    record.rssi_dBm = received.rx.rssi_dBm;
+    record.stepId = packet.stepId();
+    record.sendLag_us = packet.sendLag_us();
+    record.clockOffset_us = packet.clockOffset_us();
+    record.noiseFloor_dBm = received.rx.noiseFloor_dBm;
+    record.phyMode = received.rx.phyMode;
+    record.phyRate = received.rx.rate;
+    record.bandwidth_MHz = received.rx.bandwidth_MHz;
+    record.radioTimestamp_us = received.rx.radioTimestamp_us;
+    record.nodeId = packet.nodeId();
+    record.aggregateCount = received.rx.aggregateCount;
+    record.batchDelay_us = received.rx.batchDelay_us;
+}
+
+ReceiverRole::PeerState *ReceiverRole::lookupPeer(const ReceivedPacket &received)
+{
+    bool inserted;
+    PeerState *peer = peers.insert(received.rx.source, inserted);
+    if (!peer)
+    {
+        return nullptr;
+    }
+
+    if (inserted)
+    {
+        peer->nodeId = received.packet().nodeId();
+        peer->rssiAverage_dBm = received.rx.rssi_dBm;
+
+        char address[24];
+        received.rx.source.format(address, sizeof(address));
+        Serial.printf("New sender: Node %u (%s), %u of %u tracked\n",
+                      peer->nodeId, address, (unsigned)peers.size(), (unsigned)peers.capacity());
+    }
+
+    return peer;
+}
+
+SequenceTracker<>::Result ReceiverRole::trackSequence(PeerState &peer, uint32_t sequenceNumber, int64_t sent_us)
+{
+    SequenceTracker<> &tracker = peer.sequenceTracker;
+    uint32_t previousHighest = tracker.getHighest();
+    SequenceTracker<>::Result result = tracker.add(sequenceNumber, sent_us);
+
+    if (result == SequenceTracker<>::NEW && tracker.getLastGap() > 0)
+    {
+        Serial.printf("Node %u: Detected %lu missing packets (seq %lu -> %lu)\n",
+                      peer.nodeId, tracker.getLastGap(), previousHighest, sequenceNumber);
+    }
+    else if (result == SequenceTracker<>::RESTART)
+    {
+        Serial.printf("Node %u: Detected sender restart (seq %lu -> %lu)\n", peer.nodeId, previousHighest, sequenceNumber);
+    }
+
+    return result;
+}
+
+void ReceiverRole::snapshotPeerStatistics()
+{
+    PeriodReport &period = periodReport;
+    period.sequence = SequenceTracker<>::Counters();
+    period.pendingMissing = 0;
+    period.peerCount = peers.size();
+
+    for (size_t i = 0; i < peers.size(); i++)
+    {
+        PeerState &peer = peers.valueAt(i);
+        PeerReport &row = period.peers[i];
+
+        SequenceTracker<>::Counters counters = peer.sequenceTracker.getCounters();
+        row.period = counters - peer.lastCounters;
+        peer.lastCounters = counters;
+        period.sequence += row.period;
+        period.pendingMissing += peer.sequenceTracker.getPendingMissing();
+
+        row.nodeId = peer.nodeId;
+        row.address = peers.addressAt(i);
+        row.latencyP50_us = peer.latencyHistogram.percentile(0.50);
+        row.latencyP99_us = peer.latencyHistogram.percentile(0.99);
+        row.jitter_us = peer.jitter.getJitter_us();
+        row.rssiAverage_dBm = peer.rssiAverage_dBm;
+        row.clockOffset_us = peer.clockOffset_us;
+        row.latitude_e7 = peer.latitude_e7;
+        row.longitude_e7 = peer.longitude_e7;
+        row.satellites = peer.satellites;
+
+        // Jitter is a running estimate and carries over between periods
+        peer.latencyHistogram.reset();
+    }
+
+    period.untrackedPackets = untrackedPackets;
+    untrackedPackets = 0;
+}
+
+void ReceiverRole::printPeerStatistics()
+{
+    GPSHandler::Fix fix = gpsHandler->fix();
+    const PeriodReport &period = periodReport;
+
+    for (size_t i = 0; i < period.peerCount; i++)
+    {
+        const PeerReport &peer = period.peers[i];
+
+        char address[24];
+        peer.address.format(address, sizeof(address));
+
+        if (peer.period.received == 0)
+        {
+            Serial.printf("Node %u (%s): No packets\n", peer.nodeId, address);
+            continue;
+        }
+
+        double distance_m = GPSHandler::calculateDistance(
+            fix.latitude_e7 / 1e7, fix.longitude_e7 / 1e7,
+            peer.latitude_e7 / 1e7, peer.longitude_e7 / 1e7);
+
+        uint32_t lost = peer.period.netLost();
+        float lossRate = (float)lost / (float)(lost + peer.period.received) * 100.0f;
+        Serial.printf("Node %u (%s): Received %lu, Lost %lu (%.2f%%), Latency p50 %lld us, p99 %lld us, "
+                      "Jitter %.1f us, RSSI %.1f dBm, Distance %.1f m, Sats %u",
+                      peer.nodeId, address, peer.period.received, lost, lossRate,
+                      peer.latencyP50_us, peer.latencyP99_us,
+                      peer.jitter_us, peer.rssiAverage_dBm, distance_m, peer.satellites);
+
+        if (peer.clockOffset_us != PacketHeader::CLOCK_OFFSET_UNKNOWN)
+        {
+            Serial.printf(", Clock offset %ld us", (long)peer.clockOffset_us);
+        }
+        Serial.println();
+    }
+
+    if (period.untrackedPackets > 0)
+    {
+        Serial.printf("Peers: %u tracked, %lu packets from untracked senders\n", (unsigned)period.peerCount,
+                      period.untrackedPackets);
+    }
+}
+
+#if RANGE_PROFILE_BINS > 0
+float ReceiverRole::peerDistance(PeerState &peer, const RxLogRecord &record)
+{
+    // Haversine is soft float on the C6; positions change at the GPS rate, not the packet rate
+    int32_t from_e7[4] = {record.receiverLatitude_e7, record.receiverLongitude_e7,
+                          record.senderLatitude_e7, record.senderLongitude_e7};
+    if (memcmp(from_e7, peer.distanceFrom_e7, sizeof(from_e7)) != 0)
+    {
+        memcpy(peer.distanceFrom_e7, from_e7, sizeof(from_e7));
 
-    // Update last sequence number
-    lastSequenceNumber = packet.sequenceNumber;
+        bool placed = (from_e7[0] != 0 || from_e7[1] != 0) && (from_e7[2] != 0 || from_e7[3] != 0);
+        peer.distance_m = placed ? (float)GPSHandler::calculateDistance(from_e7[0] / 1e7, from_e7[1] / 1e7,
+                                                                        from_e7[2] / 1e7, from_e7[3] / 1e7)
+                                 : -1.0f;
+    }
 
-    // Increment packet counter
-    packetCounter++;
+    return peer.distance_m;
 }
 
-void ReceiverRole::calculatePacketLoss(uint32_t sequenceNumber)
+void ReceiverRole::snapshotRangeProfile()
 {
-    // Only check for packet loss if we have received at least one packet
-    if (packetCounter > 0)
+    // Percentiles are taken here so the bins' histograms need not be copied
+    rangeRowCount = 0;
+    for (uint32_t i = 0; i < rangeProfile.binCount(); i++)
     {
-        // Check for dropped packets
-        if (sequenceNumber > lastSequenceNumber + 1)
+        const RangeProfile<RANGE_PROFILE_BINS>::Bin &bin = rangeProfile.bin(i);
+        if (bin.isEmpty())
         {
-            uint32_t dropped = sequenceNumber - lastSequenceNumber - 1;
-            lostPackets += dropped;
+            continue;
+        }
+
+        RangeRow &row = rangeRows[rangeRowCount++];
+        row.bin = i;
+        row.received = bin.received;
+        row.lost = bin.lost;
+        row.lossRate = bin.lossRate();
+        row.rssiMean = bin.rssiMean();
+        row.rssiMin = bin.rssiMin;
+        row.latencyP50_us = bin.latency.percentile(0.50);
+        row.latencyP90_us = bin.latency.percentile(0.90);
+    }
+
+    const RangeProfile<RANGE_PROFILE_BINS>::Bin &unplaced = rangeProfile.getUnplaced();
+    rangeUnplaced = unplaced.received;
+    rangeProfileDue = rangeRowCount > 0 || !unplaced.isEmpty();
+}
+
+void ReceiverRole::printRangeProfile()
+{
+    uint32_t binSize_m = rangeProfile.getBinSize_m();
+    Serial.printf("Range profile: %lu m bins, %lu packets without a position\n", binSize_m, rangeUnplaced);
+    Serial.println("  Distance m  Received     Lost  Loss %  RSSI avg  RSSI min  p50 us  p90 us");
+
+    for (uint32_t r = 0; r < rangeRowCount; r++)
+    {
+        const RangeRow &row = rangeRows[r];
+        uint32_t i = row.bin;
 
-            Serial.printf("Detected %lu dropped packets (seq %lu -> %lu)\n",
-                          dropped, lastSequenceNumber, sequenceNumber);
+        // The last bin is open-ended
+        char range[24];
+        if (i + 1 < rangeProfile.binCount())
+        {
+            snprintf(range, sizeof(range), "%lu-%lu", i * binSize_m, (i + 1) * binSize_m);
+        }
+        else
+        {
+            snprintf(range, sizeof(range), "%lu+", i * binSize_m);
         }
+
+        Serial.printf("  %10s %9lu %8lu %7.2f %9.1f %9d %7lld %7lld\n", range, row.received, row.lost,
+                      row.lossRate, row.rssiMean, row.rssiMin, row.latencyP50_us, row.latencyP90_us);
+    }
+}
+#endif
+
+void ReceiverRole::printFrameStatistics()
+{
+    const FrameStats &frames = periodReport.frames;
+    uint32_t period_ms = periodReport.period_ms;
+    if (frames.frames == 0 || period_ms == 0)
+    {
+        return;
+    }
+
+    float goodput_kbps = frames.payloadBytes * 8.0f / period_ms;
+    float frame_kbps = frames.frameBytes * 8.0f / period_ms;
+    Serial.printf("Frames: Received %lu carrying %lu packets (%.2f per frame), Goodput %.1f kbit/s of %.1f kbit/s (%.1f%%)",
+                  frames.frames, frames.packets, (float)frames.packets / frames.frames,
+                  goodput_kbps, frame_kbps, frame_kbps > 0 ? goodput_kbps / frame_kbps * 100.0f : 0.0f);
+
+    if (frames.batchDelayMax_us > 0)
+    {
+        Serial.printf(", Batching delay avg %lld us, max %ld us",
+                      frames.batchDelaySum_us / frames.packets, (long)frames.batchDelayMax_us);
     }
+    Serial.println();
 }
 
-void ReceiverRole::logPacketData(const LogEntry &entry)
+void ReceiverRole::printStepReport(const PeerState &peer, const StepReport &report)
 {
+    Serial.printf("Node %u step %u: Received %lu, Lost %lu (%.2f%%), Size %u bytes, Rate %.1f Hz, Goodput %.1f kbit/s, "
+                  "Latency p50 %lld us, p90 %lld us, p99 %lld us, max %lld us\n",
+                  peer.nodeId, report.stepId, report.received, report.lost, report.lossRate(), report.payloadSize,
+                  report.rxRateHz(), report.goodputKbps(),
+                  report.latencyP50_us, report.latencyP90_us, report.latencyP99_us, report.latencyMax_us);
+}
+
+void ReceiverRole::logPacketData(const RxLogRecord &record)
+{
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+    // Latency and distance are derived by the host decoder
+    uint8_t frame[RxLogRecord::BODY_SIZE + LogFrame::OVERHEAD];
+    logWriter->append(frame, encodeRxRecord(record, frame, sizeof(frame)));
+#else
+    // Room for the line ending; a truncated line is still terminated
+    char csvLine[512];
+    int length = formatCsvLine(record, session, csvLine, sizeof(csvLine) - 2);
+    if (length < 0)
+    {
+        return;
+    }
+    if ((size_t)length > sizeof(csvLine) - 3)
+    {
+        length = sizeof(csvLine) - 3;
+    }
+    csvLine[length++] = '\r';
+    csvLine[length++] = '\n';
+
+    logWriter->append((const uint8_t *)csvLine, length);
+#endif
+}
+
+size_t ReceiverRole::encodeRxRecord(const RxLogRecord &record, uint8_t *frame, size_t length)
+{
+    if (length < RxLogRecord::BODY_SIZE + LogFrame::OVERHEAD)
+    {
+        return 0;
+    }
+
+    // Encode straight into the frame so LogFrame only adds the header and CRC
+    uint8_t *body = frame + LogFrame::HEADER_SIZE;
+    return LogFrame::encode(LOG_RECORD_RX, body, record.encode(body), frame, length);
+}
+
+int ReceiverRole::formatCsvLine(const RxLogRecord &record, const SessionLogRecord &session, char *buffer, size_t length)
+{
+    double receiverLatitude = record.receiverLatitude_e7 / 1e7;
+    double receiverLongitude = record.receiverLongitude_e7 / 1e7;
+    double senderLatitude = record.senderLatitude_e7 / 1e7;
+    double senderLongitude = record.senderLongitude_e7 / 1e7;
+
     // Calculate distance between sender and receiver
     double distance_m = GPSHandler::calculateDistance(
-        entry.receiverGPS_latitude, entry.receiverGPS_longitude,
-        entry.senderGPS_latitude, entry.senderGPS_longitude);
+        receiverLatitude, receiverLongitude,
+        senderLatitude, senderLongitude);
+
+    // Empty column when the sender has no clock offset estimate
+    char clockOffset[12] = "";
+    if (record.clockOffset_us != PacketHeader::CLOCK_OFFSET_UNKNOWN)
+    {
+        snprintf(clockOffset, sizeof(clockOffset), "%ld", (long)record.clockOffset_us);
+    }
+
+    // Empty column outside a protocol sweep
+    char sweepSlot[12] = "";
+    if (session.sweepSlot != SessionLogRecord::NO_SLOT)
+    {
+        snprintf(sweepSlot, sizeof(sweepSlot), "%lu", (unsigned long)session.sweepSlot);
+    }
+
+    return snprintf(buffer, length, "%lu,%s,%lu,%lld,%lld,%lld,%d,%d,%d,%.6f,%.6f,%.2f,%u,%.2f,%.6f,%.6f,%.2f,%u,%.2f,%.2f,%ld,%u,%s,%d,%d,%u,%u,%u,%lu,%u,%s,%u,%ld",
+                    record.receiverMillis, // Receiver local ms timestamp (useful for ordering)
+                    session.protocolName,
+                    record.sequenceNumber,
+                    record.senderTimestamp_us,
+                    record.receiverTimestamp_us,
+                    record.latency_us(),
+                    record.rssi_dBm,
+                    session.txPower_dBm,
+                    session.channel,
+                    receiverLatitude,
+                    receiverLongitude,
+                    record.receiverAltitude_mm / 1000.0f,
+                    record.receiverSatellites,
+                    record.receiverHorizontalAccuracy_mm / 1000.0f,
+                    senderLatitude,
+                    senderLongitude,
+                    record.senderAltitude_mm / 1000.0f,
+                    record.senderSatellites,
+                    record.senderHorizontalAccuracy_mm / 1000.0f,
+                    distance_m,
+                    (long)record.sendLag_us,
+                    record.stepId,
+                    clockOffset,
+                    record.noiseFloor_dBm,
+                    record.noiseFloor_dBm != 0 ? record.rssi_dBm - record.noiseFloor_dBm : 0, // SNR
+                    record.phyMode,
+                    record.phyRate,
+                    record.bandwidth_MHz,
+                    record.radioTimestamp_us,
+                    record.nodeId,
+                    sweepSlot,
+                    record.aggregateCount,
+                    (long)record.batchDelay_us);
+}
 
-    char csvLine[512];
-    sprintf(csvLine, "%lu,%s,%lu,%lld,%lld,%lld,%d,%d,%d,%.6f,%.6f,%.2f,%u,%.2f,%.6f,%.6f,%.2f,%u,%.2f,%.2f",
-            millis(), // Receiver local ms timestamp (useful for ordering)
-            entry.protocolName,
-            entry.sequenceNumber,
-            entry.senderTimestamp_us,
-            entry.receiverTimestamp_us,
-            entry.latency_us,
-            entry.rssi_dBm,
-            entry.configuredTxPower_dBm,
-            entry.configuredChannel,
-            entry.receiverGPS_latitude,
-            entry.receiverGPS_longitude,
-            entry.receiverGPS_altitude_mm / 1000.0f,
-            entry.receiverGPS_satellites,
-            entry.receiverGPS_horizontalAccuracy_mm / 1000.0f,
-            entry.senderGPS_latitude,
-            entry.senderGPS_longitude,
-            entry.senderGPS_altitude_mm / 1000.0f,
-            entry.senderGPS_satellites,
-            entry.senderGPS_horizontalAccuracy_mm / 1000.0f,
-            distance_m);
-
-    // Log to Serial (even if SD card logging failed)
-    Serial.println(csvLine);
-}
\ No newline at end of file
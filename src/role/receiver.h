@@ -2,42 +2,257 @@
 #define RECEIVER_H
 
 #include "role.h"
+#include "../util/spsc_ring.h"
+#include "../stats/step_stats.h"
+#include "../stats/latency_histogram.h"
+#include "../stats/sequence_tracker.h"
+#include "../stats/peer_table.h"
+#include "../stats/range_profile.h"
 
 class ReceiverRole : public Role
 {
+    // Measures the per-packet stages below on the host and on target
+    friend class ReceiverBenchmark;
+
 public:
-    ReceiverRole(Protocol *protocol, GPSHandler *gpsHandler);
+    ReceiverRole(Protocol *protocol, GPSHandler *gpsHandler, const TestConfig &config, LogWriter *logWriter);
     virtual ~ReceiverRole();
 
     // Initialize the receiver role
     virtual bool begin() override;
 
-    // Execute receiver operations in main loop
-    virtual void loop() override;
+    // Drain the receive queue, take link events, advertise and feed the
+    // log writer
+    virtual void process() override;
+
+    // Copy the statistics every 10 seconds, and the range profile every
+    // RANGE_PROFILE_INTERVAL_MS
+    virtual void snapshot() override;
+
+    // Time sync, link events and the statistics snapshot() took
+    virtual void report() override;
 
 private:
-    // Last received sequence number
-    uint32_t lastSequenceNumber;
+    // Packet captured in the radio callback, processed later in process().
+    // Only the wire header is kept: the payload is a test pattern that
+    // nothing downstream reads.
+    struct ReceivedPacket
+    {
+        uint8_t header[PacketHeader::WIRE_SIZE];
+        int64_t receiverTimestamp_us;
+        RxMetadata rx;
+
+        PacketView packet() const
+        {
+            return PacketView::ofHeader(header);
+        }
+    };
+
+    // Everything tracked per sender, keyed by its source address
+    struct PeerState
+    {
+        uint16_t nodeId;
+
+        // Reorder-, duplicate- and restart-aware loss accounting, and the
+        // counters at the last statistics report
+        SequenceTracker<> sequenceTracker;
+        SequenceTracker<>::Counters lastCounters;
+
+        // Latency distribution for the statistics period and RFC 3550 jitter
+        PeerLatencyHistogram latencyHistogram;
+        InterarrivalJitter jitter;
+
+        // Per-step goodput/loss/latency for ramp and burst test profiles
+        StepStatsTracker stepStats;
+
+#if RANGE_PROFILE_BINS > 0
+        // Range profile bins the latest gaps were charged to
+        ChargedGaps<> rangeGaps;
+#endif
+
+        // Exponentially weighted RSSI, 1/8 weight per packet
+        float rssiAverage_dBm;
 
-    // Rolling window packet loss statistics
-    uint32_t packetCounter;
-    uint32_t lostPackets;
+        // Sender's latest estimate of our clock minus its clock
+        int32_t clockOffset_us;
+
+        // Sender's latest GPS fix
+        int32_t latitude_e7;
+        int32_t longitude_e7;
+        int32_t altitude_mm;
+        uint8_t satellites;
+
+        // Distance to the sender, and the sender and receiver positions it
+        // was computed from; negative without a position at either end
+        float distance_m;
+        int32_t distanceFrom_e7[4];
+
+        PeerState()
+            : nodeId(0), lastCounters(), rssiAverage_dBm(0.0f), clockOffset_us(PacketHeader::CLOCK_OFFSET_UNKNOWN),
+              latitude_e7(0), longitude_e7(0), altitude_mm(0), satellites(0), distance_m(-1.0f), distanceFrom_e7()
+        {
+        }
+    };
+
+    // Queue between the Wi-Fi/lwIP callback (producer) and process() (consumer)
+    SpscRing<ReceivedPacket, RX_QUEUE_SIZE> rxQueue;
+
+    // Queue overflow count at the last statistics report
+    uint32_t lastQueueOverflows;
+
+    // Per-sender state, and packets from senders that did not fit
+    PeerTable<PeerState, MAX_PEERS> peers;
+    uint32_t untrackedPackets;
     unsigned long statisticsTimer;
 
+    // Latency distribution across all senders for the statistics period
+    ReceiverLatencyHistogram latencyHistogram;
+
+#if RANGE_PROFILE_BINS > 0
+    // Loss, RSSI and latency by sender distance over the whole test
+    RangeProfile<RANGE_PROFILE_BINS> rangeProfile;
+    unsigned long rangeProfileTimer;
+#endif
+
+    // Frames behind the period's packets, to weigh aggregation's airtime
+    // saving against the batching delay it adds
+    struct FrameStats
+    {
+        uint32_t frames;
+        uint32_t packets;
+        uint64_t frameBytes;   // Whole frames above the transport
+        uint64_t payloadBytes; // Test payload the packets carried
+        int64_t batchDelaySum_us;
+        int32_t batchDelayMax_us;
+    };
+    FrameStats frameStats;
+
+    // Echo replies sent and failed since the last statistics report
+    uint32_t echoReplies;
+    uint32_t echoReplyFailures;
+
+    // One sender's line of the statistics report
+    struct PeerReport
+    {
+        uint16_t nodeId;
+        PeerAddress address;
+        SequenceTracker<>::Counters period;
+        int64_t latencyP50_us;
+        int64_t latencyP99_us;
+        double jitter_us;
+        float rssiAverage_dBm;
+        int32_t clockOffset_us;
+        int32_t latitude_e7;
+        int32_t longitude_e7;
+        uint8_t satellites;
+    };
+
+    // One statistics period, copied by snapshot() and printed by report()
+    struct PeriodReport
+    {
+        uint32_t period_ms;
+        SequenceTracker<>::Counters sequence; // All senders
+        uint32_t pendingMissing;
+        ReceiverLatencyHistogram latency;
+        PeerReport peers[MAX_PEERS];
+        size_t peerCount;
+        uint32_t untrackedPackets;
+        FrameStats frames;
+        uint32_t echoReplies;
+        uint32_t echoReplyFailures;
+        uint32_t queueDropped;
+        uint32_t queueOverflows;
+        uint32_t queueHighWater;
+    };
+
+    // The last period snapshot() took, and whether report() has printed it
+    PeriodReport periodReport;
+    bool periodReportDue;
+
+#if RANGE_PROFILE_BINS > 0
+    // One range profile bin with packets, copied by snapshot()
+    struct RangeRow
+    {
+        uint32_t bin;
+        uint32_t received;
+        uint32_t lost;
+        float lossRate;
+        float rssiMean;
+        int8_t rssiMin;
+        int64_t latencyP50_us;
+        int64_t latencyP90_us;
+    };
+
+    // The range profile as of the last snapshot, and whether report() has printed it
+    RangeRow rangeRows[RANGE_PROFILE_BINS];
+    uint32_t rangeRowCount;
+    uint32_t rangeUnplaced;
+    bool rangeProfileDue;
+#endif
+
+    // Unicast discovery: advertisements sent, and when the last one was
+    uint32_t discoverySequence;
+    unsigned long discoveryTimer;
+
     // Packet reception callback
-    static void onPacketReceived(const Protocol::TestPacket &packet, int8_t rssi);
+    static void onPacketReceived(void *context, const PacketView &packet, const RxMetadata &rx);
 
-    // Pointer to the receiver instance (for static callbacks)
-    static ReceiverRole *instance;
+    // Drain queued packets
+    void processQueue();
 
     // Process received packet
-    void processPacket(const Protocol::TestPacket &packet, int8_t rssi);
+    void processPacket(const ReceivedPacket &received);
+
+    // Reflect an echo request with our receive and transmit timestamps
+    void sendEchoReply(const ReceivedPacket &received);
+
+    // Advertise this receiver to unicast senders
+    void sendDiscovery();
+
+    // Copy packet fields, receiver GPS and radio metadata into a log record
+    void fillRecord(const ReceivedPacket &received, RxLogRecord &record) const;
+
+    // State for the packet's sender, nullptr if the peer table is full
+    PeerState *lookupPeer(const ReceivedPacket &received);
 
-    // Calculate packet loss statistics
-    void calculatePacketLoss(uint32_t sequenceNumber);
+    // Account the sequence number for loss statistics; the sender's
+    // timestamp tells a restarted sender from a late packet
+    SequenceTracker<>::Result trackSequence(PeerState &peer, uint32_t sequenceNumber, int64_t sent_us);
+
+    // Copy loss, latency, RSSI and position for each sender into
+    // periodReport, and start a new statistics period
+    void snapshotPeerStatistics();
+
+    // Print the per-sender lines in periodReport
+    void printPeerStatistics();
+
+#if RANGE_PROFILE_BINS > 0
+    // Distance to the packet's sender, recomputed only when either position
+    // changed. Negative without a position at either end.
+    float peerDistance(PeerState &peer, const RxLogRecord &record);
+
+    // Copy the bins with packets into rangeRows
+    void snapshotRangeProfile();
+
+    // Print the range profile table from rangeRows
+    void printRangeProfile();
+#endif
+
+    // Print goodput against frame bytes and the batching delay in periodReport
+    void printFrameStatistics();
+
+    // Print the summary of a finished profile step
+    void printStepReport(const PeerState &peer, const StepReport &report);
 
     // Log packet data to file
-    void logPacketData(const LogEntry &entry);
+    void logPacketData(const RxLogRecord &record);
+
+    // Encode a framed binary RX record. Returns the frame length.
+    static size_t encodeRxRecord(const RxLogRecord &record, uint8_t *frame, size_t length);
+
+    // Format the CSV log line, taking protocol, TX power and channel from the
+    // session. Returns the snprintf() result.
+    static int formatCsvLine(const RxLogRecord &record, const SessionLogRecord &session, char *buffer, size_t length);
 };
 
 #endif // RECEIVER_H
\ No newline at end of file
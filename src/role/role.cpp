@@ -2,6 +2,7 @@
 #include <sys/time.h> // Required for gettimeofday, settimeofday, adjtime
 #include <cmath>      // Required for fabs
 #include <inttypes.h> // Required for PRIdMAX
+#include <esp_mac.h>  // Required for esp_efuse_mac_get_default
 
 // Offset between Unix epoch (1/1/1970) and GPS epoch (6/1/1980) in seconds
 const uint64_t GPS_EPOCH_OFFSET_SECONDS = 315964800UL;
@@ -35,9 +36,12 @@ bool gps_time_to_timeval(uint16_t time_week, uint32_t time_week_ms, struct timev
     return true; // Indicate success
 }
 
-Role::Role(Protocol *protocol, GPSHandler *gpsHandler)
-    : protocol(protocol), gpsHandler(gpsHandler),
-      lastSyncTimeMs(0), initialized(false)
+Role::Role(Protocol *protocol, GPSHandler *gpsHandler, const TestConfig &config, LogWriter *logWriter)
+    : protocol(protocol), gpsHandler(gpsHandler), config(config),
+      sweepSlot(SessionLogRecord::NO_SLOT), protocolStart_ms(0),
+      lastSyncTimeMs(0), initialized(false), reportedPpsStatus(), sessionHeaderDue(false), session(),
+      logWriter(logWriter),
+      wakeCallback(nullptr), wakeContext(nullptr)
 {
 }
 
@@ -46,17 +50,222 @@ Role::~Role()
     // Base class destructor
 }
 
+void Role::loop()
+{
+    process();
+    snapshot();
+    report();
+}
+
+void Role::setWakeCallback(WakeCallback callback, void *context)
+{
+    wakeCallback = callback;
+    wakeContext = context;
+}
+
+void Role::setSweepSlot(uint32_t slot)
+{
+    sweepSlot = slot;
+}
+
+void Role::wake()
+{
+    if (wakeCallback)
+    {
+        wakeCallback(wakeContext);
+    }
+}
+
+bool Role::startProtocol()
+{
+    unsigned long start_ms = millis();
+    bool started = protocol->begin();
+    protocolStart_ms = millis() - start_ms;
+
+    if (started)
+    {
+        Serial.printf("Protocol started in %lu ms\n", (unsigned long)protocolStart_ms);
+    }
+    return started;
+}
+
+void Role::end()
+{
+    // No more radio callbacks into the role once the protocol has stopped
+    protocol->end();
+    protocol->setPacketCallback(nullptr, nullptr);
+    initialized = false;
+}
+
+void Role::processLinkEvents()
+{
+    Protocol::LinkEvent event;
+    while (protocol->pollLinkEvent(event))
+    {
+        switch (event.type)
+        {
+        case Protocol::LINK_FIRST_FRAME:
+            linkStats.firstFrameSeen = true;
+            linkStats.timeToFirstFrame_ms = event.duration_ms;
+            break;
+
+        case Protocol::LINK_DOWN:
+            linkStats.outages++;
+            linkStats.down = true;
+            break;
+
+        case Protocol::LINK_UP:
+            linkStats.down = false;
+            linkStats.lastOutage_ms = event.duration_ms;
+            linkStats.totalOutage_ms += event.duration_ms;
+            if (event.duration_ms > linkStats.maxOutage_ms)
+            {
+                linkStats.maxOutage_ms = event.duration_ms;
+            }
+            break;
+        }
+
+        logLinkEvent(event);
+
+        // Printed by the reporter; if it falls this far behind, only the line is lost
+        linkEventLog.tryPush(event);
+    }
+}
+
+void Role::printLinkEvents()
+{
+    Protocol::LinkEvent event;
+    while (linkEventLog.tryPop(event))
+    {
+        switch (event.type)
+        {
+        case Protocol::LINK_FIRST_FRAME:
+            Serial.printf("Link: First frame %lu ms after start\n", (unsigned long)event.duration_ms);
+            break;
+
+        case Protocol::LINK_DOWN:
+            Serial.printf("Link: Down, reason %u\n", event.reason);
+            break;
+
+        case Protocol::LINK_UP:
+            Serial.printf("Link: Up after %lu ms outage\n", (unsigned long)event.duration_ms);
+            break;
+
+        case Protocol::LINK_PEER_FOUND:
+            Serial.printf("Link: Unicast peer found %lu ms after start\n", (unsigned long)event.duration_ms);
+            break;
+        }
+    }
+}
+
+void Role::logLinkEvent(const Protocol::LinkEvent &event)
+{
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+    LinkLogRecord record;
+    record.type = event.type;
+    record.reason = event.reason;
+    record.receiverMillis = event.at_ms;
+    record.duration_ms = event.duration_ms;
+
+    uint8_t frame[LinkLogRecord::BODY_SIZE + LogFrame::OVERHEAD];
+    uint8_t *body = frame + LogFrame::HEADER_SIZE;
+    size_t length = LogFrame::encode(LOG_RECORD_LINK, body, record.encode(body), frame, sizeof(frame));
+    logWriter->append(frame, length);
+#else
+    (void)event;
+#endif
+}
+
+void Role::startLogSession()
+{
+    session.protocolType = protocol->getType();
+    session.txPower_dBm = protocol->getTransmitPower();
+    session.channel = protocol->getChannel();
+    session.packetSize = config.payloadSize;
+    session.packetRate = config.packetRate;
+    strncpy(session.protocolName, protocol->getProtocolName(), SessionLogRecord::NAME_SIZE - 1);
+    session.sweepSlot = sweepSlot;
+    session.protocolStart_ms = protocolStart_ms;
+    session.aggregateRecords = config.aggregateRecords;
+    session.aggregateFlush_ms = config.aggregateFlush_ms;
+    session.espnowUnicast = config.espnowUnicast;
+    session.espnowRate = config.espnowRate;
+    session.espnowRetries = config.espnowRetries;
+
+    // Every test, sweep slots included, starts a new file on storage sinks
+    logWriter->startSession();
+    logSessionHeader();
+}
+
+void Role::logSessionHeader()
+{
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+    uint8_t frame[SessionLogRecord::BODY_SIZE + LogFrame::OVERHEAD];
+    uint8_t *body = frame + LogFrame::HEADER_SIZE;
+    size_t length = LogFrame::encode(LOG_RECORD_SESSION, body, session.encode(body), frame, sizeof(frame));
+    logWriter->append(frame, length);
+#endif
+}
+
+void Role::logDueSessionHeader()
+{
+    if (sessionHeaderDue)
+    {
+        sessionHeaderDue = false;
+        logSessionHeader();
+    }
+}
+
+void Role::snapshotStatus()
+{
+    reportedLinkStats = linkStats;
+    reportedPpsStatus = ppsClock.takeStatus();
+    sessionHeaderDue = true;
+}
+
+void Role::printLogStatistics()
+{
+    LogWriter::Stats stats = logWriter->getStats();
+    Serial.printf("Log %s: Written %llu KB in %lu blocks, Slowest write %lu us, Queued max %lu/%u blocks, "
+                  "Errors %lu, Dropped %lu records\n",
+                  logWriter->getSink()->getName(), stats.bytes / 1024, stats.blocks, stats.maxWrite_us,
+                  stats.maxQueued, (unsigned)LOG_BLOCK_COUNT, stats.writeErrors, stats.droppedRecords);
+}
+
+void Role::printLinkStatistics()
+{
+    if (!reportedLinkStats.firstFrameSeen && reportedLinkStats.outages == 0)
+    {
+        return;
+    }
+
+    Serial.printf("Link statistics: First frame %lu ms, Outages %lu%s, Last %lu ms, Max %lu ms, Total %lu ms\n",
+                  (unsigned long)reportedLinkStats.timeToFirstFrame_ms, (unsigned long)reportedLinkStats.outages,
+                  reportedLinkStats.down ? " (down now)" : "",
+                  (unsigned long)reportedLinkStats.lastOutage_ms, (unsigned long)reportedLinkStats.maxOutage_ms,
+                  (unsigned long)reportedLinkStats.totalOutage_ms);
+}
+
 void Role::syncTimeWithGPS(bool force)
 {
     // Check if GPS handler is valid, has a fix, and a valid week number
-    if (!gpsHandler || !gpsHandler->hasFix() || gpsHandler->state.time_week == 0)
+    GPSHandler::Fix fix = gpsHandler ? gpsHandler->fix() : GPSHandler::Fix();
+    if (!fix.valid || fix.timeWeek == 0)
     {
         // Serial.println("Time Sync: No GPS fix, skipping.");
         return;
     }
 
+    // A locked PPS clock is a far better reference than the GPS message time,
+    // which is only as fresh as the last parsed solution
     struct timeval gps_tv;
-    if (!gps_time_to_timeval(gpsHandler->state.time_week, gpsHandler->state.time_week_ms, &gps_tv))
+    int64_t pps_us;
+    if (ppsClock.now(pps_us))
+    {
+        gps_tv.tv_sec = (time_t)(pps_us / 1000000);
+        gps_tv.tv_usec = (suseconds_t)(pps_us % 1000000);
+    }
+    else if (!gps_time_to_timeval(fix.timeWeek, fix.timeWeek_ms, &gps_tv))
     {
         Serial.println("Time Sync: Failed to convert GPS time to timeval.");
         return;
@@ -133,4 +342,29 @@ void Role::syncTimeWithGPS(bool force)
     char buffer[64];
     strftime(buffer, sizeof(buffer), "%a %b %d, %Y %T", &timeinfo);
     Serial.printf("Time after sync: %s.%03ld UTC\n", buffer, esp_tv.tv_usec / 1000);
-}
\ No newline at end of file
+}
+int64_t Role::wallClockMicros() const
+{
+    int64_t now_us;
+    if (ppsClock.now(now_us))
+    {
+        return now_us;
+    }
+
+    struct timeval tv_now;
+    return (gettimeofday(&tv_now, NULL) == 0) ? (int64_t)tv_now.tv_sec * 1000000L + tv_now.tv_usec : 0;
+}
+
+uint16_t Role::localNodeId()
+{
+#if NODE_ID != 0
+    return NODE_ID;
+#else
+    uint8_t mac[6];
+    if (esp_efuse_mac_get_default(mac) != ESP_OK)
+    {
+        return 0;
+    }
+    return (uint16_t)((mac[4] << 8) | mac[5]);
+#endif
+}
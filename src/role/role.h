@@ -2,49 +2,86 @@
 #define ROLE_BASE_H
 
 #include <Arduino.h>
+#include <sys/time.h>
 #include "config.h"
 #include "../gps_handler.h"
 #include "../protocol/protocol.h"
+#include "../timing/pps_clock.h"
+#include "../settings/test_config.h"
+#include "../log/log_record.h"
+#include "../log/log_writer.h"
+#include "../util/spsc_ring.h"
+
+// UTC from a GPS week number and time of week, for time sync and the sweep schedule
+bool gps_time_to_timeval(uint16_t time_week, uint32_t time_week_ms, struct timeval *tv_out);
 
 class Role
 {
 public:
-    // Structure for logging data on the receiver
-    struct LogEntry
-    {
-        const char *protocolName;
-        uint32_t sequenceNumber;
-        int64_t senderTimestamp_us;
-        int64_t receiverTimestamp_us;
-        int64_t latency_us;
-        int8_t rssi_dBm;
-        int8_t configuredTxPower_dBm;
-        uint8_t configuredChannel;
-        double receiverGPS_latitude;
-        double receiverGPS_longitude;
-        double receiverGPS_altitude_mm;
-        uint8_t receiverGPS_satellites;
-        uint32_t receiverGPS_horizontalAccuracy_mm;
-        double senderGPS_latitude;
-        double senderGPS_longitude;
-        double senderGPS_altitude_mm;
-        uint8_t senderGPS_satellites;
-        uint32_t senderGPS_horizontalAccuracy_mm;
-    };
+    // Called from the radio or timer task that queued work for process()
+    using WakeCallback = void (*)(void *context);
 
-    Role(Protocol *protocol, GPSHandler *gpsHandler);
+    // Log records go to logWriter, which outlives the role
+    Role(Protocol *protocol, GPSHandler *gpsHandler, const TestConfig &config, LogWriter *logWriter);
     virtual ~Role();
 
     // Initialize the role
     virtual bool begin() = 0;
 
-    // Execute role operations in main loop
-    virtual void loop() = 0;
+    // Stop the role and the protocol begin() started, so the test can be
+    // restarted with another configuration. The role is deleted afterwards.
+    virtual void end();
+
+    // Work that has to keep up with the radio: sending, and draining what
+    // the radio callbacks queued. Runs in the role task, woken through the
+    // wake callback and at least every ROLE_TASK_IDLE_MS.
+    virtual void process() = 0;
+
+    // Copy the statistics that are due for report() and start a new
+    // period. Runs in the reporter task with process() locked out, so it
+    // only copies and resets.
+    virtual void snapshot() = 0;
+
+    // Time sync, link events and printing what snapshot() took. Runs in the
+    // low-priority reporter task alongside process(), with no lock held, so
+    // a slow Serial port never holds up the radio.
+    virtual void report() = 0;
+
+    // process(), snapshot() then report(), for a single polling loop (the simulator)
+    void loop();
+
+    // Task to wake when there is work for process(); set before begin().
+    // Without one, the sender sends from its timer callback.
+    void setWakeCallback(WakeCallback callback, void *context);
+
+    // Sweep slot this run belongs to, logged with the session; set before begin()
+    void setSweepSlot(uint32_t slot);
 
 protected:
+    // Link availability since the protocol started
+    struct LinkStats
+    {
+        bool firstFrameSeen = false;
+        uint32_t timeToFirstFrame_ms = 0; // From protocol creation, so including start-up
+        uint32_t outages = 0;             // Associations lost
+        uint32_t lastOutage_ms = 0;       // Length of the last outage that ended
+        uint32_t maxOutage_ms = 0;
+        uint32_t totalOutage_ms = 0;
+        bool down = false;                // An outage is in progress
+    };
+
     Protocol *protocol;
     GPSHandler *gpsHandler;
 
+    // Test parameters the protocol was created with
+    const TestConfig config;
+
+    // SessionLogRecord::NO_SLOT unless the run is one slot of a sweep
+    uint32_t sweepSlot;
+
+    // How long protocol->begin() took, including Wi-Fi association
+    uint32_t protocolStart_ms;
+
     // Interval for checking/syncing time with GPS (milliseconds)
     static const uint32_t SYNC_INTERVAL_MS = 30000; // Sync every 30 seconds
 
@@ -57,8 +94,76 @@ protected:
     // Flag to indicate if the role is initialized
     bool initialized;
 
+    // Wall clock disciplined to GPS PPS, when PPS_PIN is set
+    PpsClock ppsClock;
+
+    // Updated by process(), and copied for report() by snapshotStatus()
+    LinkStats linkStats;
+    LinkStats reportedLinkStats;
+    PpsClock::Status reportedPpsStatus;
+
+    // Link events process() took from the protocol, for report() to print
+    SpscRing<Protocol::LinkEvent, 8> linkEventLog;
+
+    // Set by snapshotStatus() for process() to repeat the session header
+    bool sessionHeaderDue;
+
+    // Per-session constants, logged once per header rather than per record
+    SessionLogRecord session;
+
+    // Batches log records to the log sink
+    LogWriter *logWriter;
+
+    WakeCallback wakeCallback;
+    void *wakeContext;
+
+    // Start the protocol and measure how long it takes
+    bool startProtocol();
+
+    // Run the wake callback, if there is one
+    void wake();
+
+    // Take the protocol's link events: add each one to linkStats, pass it
+    // to logLinkEvent() and queue it for printLinkEvents(). Called from process().
+    void processLinkEvents();
+
+    // Print the link events processLinkEvents() queued. Called from report().
+    void printLinkEvents();
+
+    // Log a link event (binary log format only)
+    void logLinkEvent(const Protocol::LinkEvent &event);
+
+    // Fill the session record from the running protocol and start a new
+    // log session with its header. Called from begin().
+    void startLogSession();
+
+    // Log the per-session constants (binary log format only)
+    void logSessionHeader();
+
+    // Repeat the session header once snapshotStatus() asked for it, so
+    // captures started mid-run can be decoded. Called from process(), which
+    // keeps the log writer to one producer.
+    void logDueSessionHeader();
+
+    // Copy linkStats and the PPS clock status for report(), and ask for the
+    // session header. Called from snapshot().
+    void snapshotStatus();
+
+    // Print what the log writer has written and dropped so far
+    void printLogStatistics();
+
+    // Print time to first frame and the outage summary as of the last snapshot
+    void printLinkStatistics();
+
     // Attempt to synchronize ESP32 time with GPS time
     void syncTimeWithGPS(bool force = false);
+
+    // Microseconds since the Unix epoch for packet timestamps: the PPS clock
+    // while it is locked, otherwise the system clock. 0 on failure.
+    int64_t wallClockMicros() const;
+
+    // NODE_ID, or the low 16 bits of the factory MAC address if it is 0
+    static uint16_t localNodeId();
 };
 
 #endif // ROLE_BASE_H
\ No newline at end of file
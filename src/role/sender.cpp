@@ -1,14 +1,58 @@
 #include "sender.h"
 #include <sys/time.h> // Include for gettimeofday and timeval
 
-SenderRole::SenderRole(Protocol *protocol, GPSHandler *gpsHandler)
-    : Role(protocol, gpsHandler), sequenceNumber(0), lastPacketTime(0)
+SenderRole::SenderRole(Protocol *protocol, GPSHandler *gpsHandler, const TestConfig &config, LogWriter *logWriter)
+    : Role(protocol, gpsHandler, config, logWriter),
+      nodeId(localNodeId()),
+      sequenceNumber(0),
+      scheduler(&clock),
+      payloadSize(config.payloadSize),
+      sendTimer(nullptr),
+      sendDue(false),
+      packetsSent(0),
+      sendFailures(0),
+      lagSum_us(0),
+      lagMax_us(0),
+      statisticsTimer(0),
+      lastAggregateFrames(0),
+      lastAggregateRecords(0),
+      periodReport(),
+      periodReportDue(false),
+      txTracker(nullptr),
+      txCompletions(0),
+      flowControlWaits(0),
+      clockOffset_us(PacketHeader::CLOCK_OFFSET_UNKNOWN),
+      echoRequests(0),
+      echoReplies(0),
+      echoDiscarded(0)
 {
 }
 
 SenderRole::~SenderRole()
 {
-    // Sender destructor
+    protocol->setPacketCallback(nullptr, nullptr);
+
+    if (sendTimer)
+    {
+        esp_timer_stop(sendTimer);
+        esp_timer_delete(sendTimer);
+    }
+}
+
+void SenderRole::end()
+{
+    // Stopped before the protocol so no packet is sent into a torn-down driver,
+    // and the send callback can no longer restart the timer
+    if (txTracker)
+    {
+        txTracker->setReadyCallback(nullptr, nullptr);
+    }
+    if (sendTimer)
+    {
+        esp_timer_stop(sendTimer);
+    }
+
+    Role::end();
 }
 
 bool SenderRole::begin()
@@ -16,30 +60,153 @@ bool SenderRole::begin()
     Serial.println("Initializing sender role...");
 
     // Initialize the protocol
-    if (!protocol->begin())
+    if (!startProtocol())
     {
         Serial.println("Failed to initialize protocol.");
         return false;
     }
 
-    // Wait for GPS fix before continuing
+    // Wait for the GPS task to publish a fix before continuing
     Serial.println("Waiting for GPS fix...");
     while (!gpsHandler->hasFix())
     {
-        gpsHandler->update();
         delay(100);
     }
     Serial.println("GPS fix acquired!");
 
+    // Not forced: the first sync after boot steps the clock anyway, and a
+    // test restarted for a sweep slot must not step the clock it is timed from
     Serial.println("Performing initial time sync with GPS...");
-    syncTimeWithGPS(true); // Force sync
+    syncTimeWithGPS();
+
+    // PPS edges are labelled from the system clock, so attach after the first sync
+    ppsClock.begin(PPS_PIN);
+
+    protocol->setAggregation(config.aggregateRecords, (uint32_t)config.aggregateFlush_ms * 1000);
+    if (config.aggregateRecords > 1)
+    {
+        Serial.printf("Aggregation: up to %u packets per frame, flushed after %u ms\n",
+                      config.aggregateRecords, config.aggregateFlush_ms);
+    }
+
+    // Echo replies come back over the same protocol
+    protocol->setPacketCallback(onPacketReceived, this);
+
+    txTracker = protocol->getTxTracker();
+    if (txTracker)
+    {
+        lastTxCounters = txTracker->getCounters();
+        txTracker->setReadyCallback(onTxReady, this);
+        if (config.sendWindow() > 0)
+        {
+            Serial.printf("Flow control: up to %u frames in flight\n", config.sendWindow());
+        }
+    }
+
+    // Every packet is logged from here on, so the log starts with the session
+    startLogSession();
+
+    // Packets are sent on a high-resolution timer, independent of report() timing
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = &SenderRole::onSendTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "sender";
+
+    if (esp_timer_create(&timerArgs, &sendTimer) != ESP_OK)
+    {
+        Serial.println("Failed to create send timer.");
+        return false;
+    }
+
+    buildProfile();
+    sequencer.start(&profile, clock.nowMicros());
+    applyStep();
+
+    if (esp_timer_start_once(sendTimer, 0) != ESP_OK)
+    {
+        Serial.println("Failed to start send timer.");
+        return false;
+    }
+
+    statisticsTimer = millis();
 
     initialized = true;
+    Serial.printf("Node id: %u\n", nodeId);
     Serial.println("Sender role initialized successfully!");
     return true;
 }
 
-void SenderRole::loop()
+void SenderRole::process()
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    // Woken by the send timer
+    if (sendDue.exchange(false))
+    {
+        sendDuePackets();
+    }
+
+    // Discipline the PPS clock to any new edge
+    ppsClock.update();
+
+    // Process echo replies queued by the radio callback
+    const EchoExchange *exchange;
+    while ((exchange = echoQueue.front()) != nullptr)
+    {
+        processEchoExchange(*exchange);
+        echoQueue.release();
+    }
+
+    processTxCompletions();
+
+    // Time to first echo reply and association outages
+    processLinkEvents();
+    logDueSessionHeader();
+
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+    // Hand batched log records to the log task
+    logWriter->poll();
+#endif
+}
+
+void SenderRole::snapshot()
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    unsigned long currentTime = millis();
+    if (currentTime - statisticsTimer < 10000)
+    {
+        return;
+    }
+    statisticsTimer = currentTime;
+
+    periodReport.sent = packetsSent.exchange(0);
+    periodReport.failed = sendFailures.exchange(0);
+    periodReport.lagSum_us = lagSum_us.exchange(0);
+    periodReport.lagMax_us = lagMax_us.exchange(0);
+    periodReport.missedDeadlines = scheduler.getMissedDeadlines();
+
+    uint32_t frames = protocol->getAggregateFrames();
+    uint32_t records = protocol->getAggregateRecords();
+    periodReport.aggregateFrames = frames - lastAggregateFrames;
+    periodReport.aggregateRecords = records - lastAggregateRecords;
+    lastAggregateFrames = frames;
+    lastAggregateRecords = records;
+
+    snapshotTxStatistics();
+    snapshotEchoStatistics();
+    snapshotStatus();
+    periodReportDue = true;
+}
+
+void SenderRole::report()
 {
     if (!initialized)
     {
@@ -55,52 +222,479 @@ void SenderRole::loop()
         syncTimeWithGPS();
     }
 
-    // Send test packets at the configured rate
-    if (currentTime - lastPacketTime >= (1000 / PACKET_RATE))
+    printLinkEvents();
+
+    // Print send timing statistics every 10 seconds
+    if (!periodReportDue)
+    {
+        return;
+    }
+    periodReportDue = false;
+
+    const PeriodReport &period = periodReport;
+    Serial.printf("Send statistics: Sent %lu, Failed %lu, Lag avg %lu us, max %lu us, Missed deadlines %lu\n",
+                  period.sent, period.failed, period.sent > 0 ? period.lagSum_us / period.sent : 0, period.lagMax_us,
+                  period.missedDeadlines);
+
+    if (period.aggregateFrames > 0)
+    {
+        Serial.printf("Aggregation: Frames %lu, Packets per frame %.2f\n", period.aggregateFrames,
+                      (float)period.aggregateRecords / period.aggregateFrames);
+    }
+
+    printTxStatistics();
+    printEchoStatistics();
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+    printLogStatistics();
+#endif
+    printLinkStatistics();
+    PpsClock::printStatus(reportedPpsStatus, Serial);
+}
+
+void SenderRole::onPacketReceived(void *context, const PacketView &packet, const RxMetadata &rx)
+{
+    (void)rx;
+    SenderRole *sender = static_cast<SenderRole *>(context);
+
+    // Runs in the Wi-Fi/lwIP task: timestamp the reply and queue it, nothing else.
+    // Replies are broadcast, so skip those to other senders' requests.
+    if (!sender || packet.type() != PACKET_TYPE_ECHO_REPLY || packet.nodeId() != sender->nodeId)
+    {
+        return;
+    }
+
+    int64_t now_us = sender->wallClockMicros();
+
+    EchoTimestamps timestamps;
+    if (!timestamps.deserialize(packet.payload(), packet.payloadLength()))
+    {
+        return;
+    }
+
+    EchoExchange *slot = sender->echoQueue.acquire();
+    if (!slot)
+    {
+        return; // Queue full, counted as an overflow
+    }
+
+    slot->requestSent_us = packet.senderTimestamp_us();
+    slot->requestReceived_us = timestamps.receive_us;
+    slot->replySent_us = timestamps.transmit_us;
+    slot->replyReceived_us = now_us;
+
+    sender->echoQueue.commit();
+    sender->wake();
+}
+
+void SenderRole::processEchoExchange(const EchoExchange &exchange)
+{
+    ClockOffsetEstimator<SYNC_PING_COUNT>::Sample sample;
+    if (!ClockOffsetEstimator<SYNC_PING_COUNT>::compute(exchange.requestSent_us, exchange.requestReceived_us,
+                                                        exchange.replySent_us, exchange.replyReceived_us, sample) ||
+        sample.delay_us > (int64_t)SYNC_TIMEOUT * 1000)
+    {
+        // Stale reply, or a clock was stepped during the exchange
+        echoDiscarded++;
+        return;
+    }
+
+    echoReplies++;
+    rttHistogram.record(sample.delay_us);
+    offsetEstimator.add(sample);
+
+    // Clamp to the header field; anything near the limit means the clocks are not synced at all
+    int64_t offset_us = offsetEstimator.getOffset_us();
+    if (offset_us > INT32_MAX)
+    {
+        offset_us = INT32_MAX;
+    }
+    else if (offset_us <= INT32_MIN)
+    {
+        offset_us = INT32_MIN + 1;
+    }
+    clockOffset_us.store((int32_t)offset_us);
+}
+
+void SenderRole::snapshotEchoStatistics()
+{
+    periodReport.echoRequests = echoRequests.exchange(0);
+    periodReport.echoReplies = echoReplies;
+    periodReport.echoDiscarded = echoDiscarded;
+    periodReport.echoQueueDrops = echoQueue.overflowCount();
+    periodReport.rtt = rttHistogram;
+
+    periodReport.hasOffset = offsetEstimator.hasEstimate();
+    if (periodReport.hasOffset)
+    {
+        periodReport.offset_us = offsetEstimator.getOffset_us();
+        periodReport.offsetError_us = offsetEstimator.getError_us();
+        periodReport.offsetSamples = offsetEstimator.getSampleCount();
+    }
+
+    echoReplies = 0;
+    echoDiscarded = 0;
+    rttHistogram.reset();
+}
+
+void SenderRole::printEchoStatistics()
+{
+    const PeriodReport &period = periodReport;
+    if (period.echoRequests == 0 && period.echoReplies == 0)
+    {
+        return;
+    }
+
+    Serial.printf("Echo statistics: Requests %lu, Replies %lu, Discarded %lu, Queue drops %lu\n",
+                  period.echoRequests, period.echoReplies, period.echoDiscarded, period.echoQueueDrops);
+
+    if (period.rtt.getCount() > 0)
+    {
+        Serial.printf("Round trip: p50 %lld us, p90 %lld us, p99 %lld us, min %lld us, max %lld us\n",
+                      period.rtt.percentile(0.50), period.rtt.percentile(0.90), period.rtt.percentile(0.99),
+                      period.rtt.getMin(), period.rtt.getMax());
+    }
+
+    if (period.hasOffset)
+    {
+        Serial.printf("Clock offset (receiver - sender): %lld us +/- %lld us, from %lu exchanges\n",
+                      period.offset_us, period.offsetError_us, period.offsetSamples);
+    }
+}
+
+void SenderRole::processTxCompletions()
+{
+    if (!txTracker)
+    {
+        return;
+    }
+
+    TxTracker::Completion completion;
+    while (txTracker->poll(completion))
+    {
+        txCompletions++;
+        txLatencyHistogram.record(completion.latency_us);
+        logTxCompletion(completion);
+    }
+}
+
+void SenderRole::snapshotTxStatistics()
+{
+    if (!txTracker)
+    {
+        return;
+    }
+
+    TxTracker::Counters counters = txTracker->getCounters();
+    periodReport.tx = counters - lastTxCounters;
+    lastTxCounters = counters;
+
+    periodReport.inFlight = txTracker->inFlight();
+    periodReport.maxInFlight = txTracker->takeMaxInFlight();
+    periodReport.flowControlWaits = flowControlWaits.exchange(0);
+    periodReport.txCompletions = txCompletions;
+    periodReport.txCompletionOverflows = txTracker->getCompletionOverflows();
+    periodReport.txLatency = txLatencyHistogram;
+
+    txCompletions = 0;
+    txLatencyHistogram.reset();
+}
+
+void SenderRole::printTxStatistics()
+{
+    if (!txTracker)
+    {
+        return;
+    }
+
+    const PeriodReport &period = periodReport;
+    Serial.printf("TX completion: Sent %lu, Delivered %lu, Failed %lu, Retries %lu, Queue full %lu, Errors %lu, "
+                  "Refused %lu, In flight %lu (max %lu), Flow control waits %lu\n",
+                  period.tx.sent, period.tx.delivered, period.tx.failed, period.tx.retries, period.tx.queueFull,
+                  period.tx.errors, period.tx.refused, period.inFlight, period.maxInFlight, period.flowControlWaits);
+
+    if (period.txLatency.getCount() > 0)
+    {
+        Serial.printf("TX latency: p50 %lld us, p99 %lld us, max %lld us, from %lu completions (%lu dropped)\n",
+                      period.txLatency.percentile(0.50), period.txLatency.percentile(0.99),
+                      period.txLatency.getMax(), period.txCompletions, period.txCompletionOverflows);
+    }
+}
+
+void SenderRole::onTxReady(void *arg)
+{
+    // Run the send timer now to resend a frame, or send the packets held
+    // back by flow control
+    SenderRole *sender = static_cast<SenderRole *>(arg);
+    esp_timer_stop(sender->sendTimer);
+    esp_timer_start_once(sender->sendTimer, 0);
+}
+
+bool SenderRole::txWindowOpen()
+{
+    return config.sendWindow() == 0 || !txTracker || txTracker->windowOpen(config.sendWindow());
+}
+
+void SenderRole::onSendTimer(void *arg)
+{
+    SenderRole *sender = static_cast<SenderRole *>(arg);
+    if (!sender->wakeCallback)
+    {
+        sender->sendDuePackets();
+        return;
+    }
+
+    sender->sendDue.store(true);
+    sender->wake();
+}
+
+void SenderRole::sendDuePackets()
+{
+    // An unacknowledged frame the send callback handed back goes first
+    protocol->retransmit();
+
+    if (sequencer.update(clock.nowMicros()))
+    {
+        applyStep();
+    }
+
+    // Catch up on any deadlines that passed while the sending task was busy.
+    // With flow control, due packets wait until the driver completes a frame;
+    // the wait shows up as send lag and, if long, as missed deadlines.
+    bool windowClosed = false;
+    int64_t scheduled_us;
+    for (uint32_t i = 0; i <= PeriodicScheduler::MAX_CATCH_UP; i++)
+    {
+        if (scheduler.isRunning() && scheduler.getNextDeadline() <= clock.nowMicros() && !txWindowOpen())
+        {
+            windowClosed = true;
+            break;
+        }
+        if (!scheduler.nextDue(scheduled_us))
+        {
+            break;
+        }
+        sendPacket(scheduled_us);
+    }
+
+    // A partly filled aggregate goes out once its first packet has waited long enough
+    if (protocol->getFlushDeadline() <= clock.nowMicros() && !windowClosed)
+    {
+        if (!txWindowOpen())
+        {
+            windowClosed = true;
+        }
+        else if (!protocol->flushAggregate(clock.nowMicros()))
+        {
+            sendFailures++;
+        }
+    }
+
+    if (windowClosed)
+    {
+        flowControlWaits++;
+    }
+
+    // Re-arm for the next absolute deadline, the end of an idle step, or
+    // the pending aggregate's flush. Deadlines already due wait for the
+    // completion that reopens the window, which runs the timer at once.
+    int64_t next_us = scheduler.isRunning() && !windowClosed ? scheduler.getNextDeadline() : INT64_MAX;
+    if (sequencer.getStepEnd() < next_us)
+    {
+        next_us = sequencer.getStepEnd();
+    }
+    if (protocol->getFlushDeadline() < next_us && !windowClosed)
+    {
+        next_us = protocol->getFlushDeadline();
+    }
+
+    if (next_us == INT64_MAX)
     {
-        lastPacketTime = currentTime;
+        return; // Idle forever
+    }
+
+    int64_t wait_us = next_us - clock.nowMicros();
+    esp_timer_start_once(sendTimer, wait_us > 0 ? (uint64_t)wait_us : 0);
+}
 
-        // Prepare and send test packet
-        Protocol::TestPacket packet;
-        prepareTestPacket(packet);
+void SenderRole::buildProfile()
+{
+#if TEST_PROFILE == TEST_PROFILE_RAMP
+    profile = TestProfile::ramp(RAMP_RATE_START, RAMP_RATE_END, RAMP_SIZE_START, RAMP_SIZE_END, RAMP_STEPS, RAMP_STEP_MS);
+    Serial.println("Test profile: Ramp");
+#elif TEST_PROFILE == TEST_PROFILE_BURST
+    profile = TestProfile::burst(BURST_RATE, config.payloadSize, BURST_ON_MS, BURST_OFF_MS, BURST_CYCLES);
+    Serial.println("Test profile: Burst");
+#else
+    profile = TestProfile::fixed(config.packetRate, config.payloadSize);
+#endif
 
-        if (!protocol->sendPacket(packet))
+    if (profile.size() > 1)
+    {
+        for (size_t i = 0; i < profile.size(); i++)
         {
-            Serial.println("Failed to send test packet.");
+            const ProfileStep &step = profile.step(i);
+            Serial.printf("  Step %u: %lu Hz, %u bytes, %lu ms\n",
+                          (unsigned)i, step.rateHz, step.payloadSize, step.duration_ms);
         }
+    }
+}
+
+void SenderRole::applyStep()
+{
+    const ProfileStep &step = sequencer.getStep();
+
+    // Ramp steps may ask for more than the protocol can carry
+    size_t maxPayload = config.maxPayloadSize();
+    payloadSize = step.payloadSize < maxPayload ? step.payloadSize : (uint16_t)maxPayload;
 
-        // Increment sequence number
-        sequenceNumber++;
+    if (step.rateHz == 0)
+    {
+        scheduler.stop();
+    }
+    else if (scheduler.isRunning())
+    {
+        scheduler.setRate(step.rateHz);
+    }
+    else
+    {
+        scheduler.start(step.rateHz);
     }
 }
 
-void SenderRole::prepareTestPacket(Protocol::TestPacket &packet)
+void SenderRole::sendPacket(int64_t scheduled_us)
 {
-    // Set sequence number
-    packet.sequenceNumber = sequenceNumber;
+    Protocol::TestPacket &packet = txPacket;
+    prepareTestPacket(packet);
+
+    // Scheduled-vs-actual send time goes on the air so the receiver can log jitter
+    int64_t send_us = clock.nowMicros();
+    int64_t lag_us = send_us - scheduled_us;
+    packet.sendLag_us = (int32_t)lag_us;
 
-    // Set sender timestamp using wall-clock time (microseconds since epoch)
-    struct timeval tv_now;
-    if (gettimeofday(&tv_now, NULL) == 0)
+    // Echo requests go alone, after anything pending, so round trips and
+    // clock offsets do not include batching delay
+    bool sent;
+    bool aggregated = config.aggregateRecords > 1 && packet.type != PACKET_TYPE_ECHO_REQUEST;
+    if (aggregated)
     {
-        packet.senderTimestamp_us = (int64_t)tv_now.tv_sec * 1000000L + tv_now.tv_usec;
+        sent = protocol->aggregatePacket(packet, send_us);
     }
     else
     {
-        Serial.println("Sender: Failed to get time of day for packet timestamp!");
-        packet.senderTimestamp_us = 0; // Indicate error or invalid time
+        sent = protocol->flushAggregate(send_us);
+        sent = protocol->sendPacket(packet) && sent;
     }
 
-    // Populate sender GPS data
-    packet.latitude = gpsHandler->state.lat / 1e7;
-    packet.longitude = gpsHandler->state.lng / 1e7;
-    packet.altitude_mm = gpsHandler->state.alt;
-    packet.satellites = gpsHandler->state.num_sats;
-    packet.horizontalAccuracy_mm = gpsHandler->state.horizontal_accuracy;
+    uint8_t result = !sent ? TxLogRecord::FAILED : aggregated ? TxLogRecord::QUEUED : TxLogRecord::SENT;
+    logTxRecord(packet, scheduled_us, (int32_t)lag_us, (uint32_t)(clock.nowMicros() - send_us), result);
+
+    if (sent)
+    {
+        packetsSent++;
+        if (packet.type == PACKET_TYPE_ECHO_REQUEST)
+        {
+            echoRequests++;
+        }
+    }
+    else
+    {
+        sendFailures++;
+    }
+
+    lagSum_us += (uint32_t)lag_us;
+    uint32_t lagMax = lagMax_us.load();
+    while ((uint32_t)lag_us > lagMax && !lagMax_us.compare_exchange_weak(lagMax, (uint32_t)lag_us))
+    {
+    }
+
+    // Increment sequence number
+    sequenceNumber++;
+}
+
+void SenderRole::logTxRecord(const Protocol::TestPacket &packet, int64_t scheduled_us, int32_t lag_us,
+                             uint32_t duration_us, uint8_t result)
+{
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+    TxLogRecord record;
+    record.senderMillis = millis();
+    record.sequenceNumber = packet.sequenceNumber;
+    record.senderTimestamp_us = packet.senderTimestamp_us;
+    record.scheduled_us = scheduled_us;
+    record.sendLag_us = lag_us;
+    record.sendDuration_us = duration_us;
+    record.latitude_e7 = packet.latitude_e7;
+    record.longitude_e7 = packet.longitude_e7;
+    record.altitude_mm = packet.altitude_mm;
+    record.nodeId = packet.nodeId;
+    record.payloadLength = packet.payloadLength;
+    record.stepId = packet.stepId;
+    record.packetType = packet.type;
+    record.result = result;
+    record.satellites = packet.satellites;
+
+    // Depth of the driver's queue when this packet was sent; includes its own frame if it went out
+    uint32_t inFlight = txTracker ? txTracker->inFlight() : 0;
+    record.inFlight = inFlight < 255 ? (uint8_t)inFlight : 255;
+
+    uint8_t frame[TxLogRecord::BODY_SIZE + LogFrame::OVERHEAD];
+    uint8_t *body = frame + LogFrame::HEADER_SIZE;
+    logWriter->append(frame, LogFrame::encode(LOG_RECORD_TX, body, record.encode(body), frame, sizeof(frame)));
+#else
+    (void)packet;
+    (void)scheduled_us;
+    (void)lag_us;
+    (void)duration_us;
+    (void)result;
+#endif
+}
+
+void SenderRole::logTxCompletion(const TxTracker::Completion &completion)
+{
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+    TxDoneLogRecord record;
+    record.senderMillis = millis();
+    record.sequenceNumber = completion.sequenceNumber;
+    record.queued_us = completion.queued_us;
+    record.latency_us = completion.latency_us;
+    record.nodeId = nodeId;
+    record.attempts = completion.attempts;
+    record.delivered = completion.delivered ? 1 : 0;
+
+    uint8_t frame[TxDoneLogRecord::BODY_SIZE + LogFrame::OVERHEAD];
+    uint8_t *body = frame + LogFrame::HEADER_SIZE;
+    logWriter->append(frame, LogFrame::encode(LOG_RECORD_TX_DONE, body, record.encode(body), frame, sizeof(frame)));
+#else
+    (void)completion;
+#endif
+}
+
+void SenderRole::prepareTestPacket(Protocol::TestPacket &packet)
+{
+    // Every ECHO_INTERVAL-th packet is also an echo request
+    packet.type = (ECHO_INTERVAL > 0 && sequenceNumber % ECHO_INTERVAL == 0) ? PACKET_TYPE_ECHO_REQUEST : PACKET_TYPE_DATA;
+
+    // Set sequence number
+    packet.sequenceNumber = sequenceNumber;
+
+    // Set sender timestamp using wall-clock time (microseconds since epoch, 0 on error)
+    packet.senderTimestamp_us = wallClockMicros();
+
+    // Populate sender GPS data in the receiver's native units (1e-7 deg, mm)
+    GPSHandler::Fix fix = gpsHandler->fix();
+    packet.latitude_e7 = fix.latitude_e7;
+    packet.longitude_e7 = fix.longitude_e7;
+    packet.altitude_mm = fix.altitude_mm;
+    packet.satellites = fix.satellites;
+    packet.horizontalAccuracy_mm = fix.horizontalAccuracy_mm;
+    packet.sendLag_us = 0;
+    packet.clockOffset_us = clockOffset_us.load();
+    packet.stepId = sequencer.getStepId();
+    packet.nodeId = nodeId;
 
     // Fill payload with non-repeating pattern (simulating MAVLink telemetry)
-    for (int i = 0; i < PACKET_SIZE; i++)
+    packet.payloadLength = payloadSize;
+    for (int i = 0; i < payloadSize; i++)
     {
         packet.payload[i] = (uint8_t)((i + sequenceNumber) % 256);
     }
-}
\ No newline at end of file
+}
@@ -2,28 +2,186 @@
 #define SENDER_H
 
 #include "role.h"
+#include <atomic>
+#include <esp_timer.h>
+#include "../timing/esp_timer_clock.h"
+#include "../timing/periodic_scheduler.h"
+#include "../timing/clock_offset.h"
+#include "../profile/test_profile.h"
+#include "../stats/latency_histogram.h"
+#include "../util/spsc_ring.h"
 
 class SenderRole : public Role
 {
 public:
-    SenderRole(Protocol *protocol, GPSHandler *gpsHandler);
+    SenderRole(Protocol *protocol, GPSHandler *gpsHandler, const TestConfig &config, LogWriter *logWriter);
     virtual ~SenderRole();
 
     // Initialize the sender role
     virtual bool begin() override;
 
-    // Execute sender operations in main loop
-    virtual void loop() override;
+    // Stop sending, then stop the protocol
+    virtual void end() override;
+
+    // Send the packets that are due, then take echo replies, send
+    // completions and link events and feed the log writer
+    virtual void process() override;
+
+    // Copy the send, completion and echo statistics every 10 seconds
+    virtual void snapshot() override;
+
+    // Time sync, link events and the statistics snapshot() took
+    virtual void report() override;
 
 private:
+    // Timestamps of one echo exchange, captured in the radio callback
+    struct EchoExchange
+    {
+        int64_t requestSent_us;     // t1, sender clock
+        int64_t requestReceived_us; // t2, receiver clock
+        int64_t replySent_us;       // t3, receiver clock
+        int64_t replyReceived_us;   // t4, sender clock
+    };
+
+    // One statistics period, copied by snapshot() and printed by report()
+    struct PeriodReport
+    {
+        uint32_t sent;
+        uint32_t failed;
+        uint32_t lagSum_us;
+        uint32_t lagMax_us;
+        uint32_t missedDeadlines;
+        uint32_t aggregateFrames;
+        uint32_t aggregateRecords;
+
+        TxTracker::Counters tx;
+        uint32_t inFlight;
+        uint32_t maxInFlight;
+        uint32_t flowControlWaits;
+        uint32_t txCompletions;
+        uint32_t txCompletionOverflows;
+        ReceiverLatencyHistogram txLatency;
+
+        uint32_t echoRequests;
+        uint32_t echoReplies;
+        uint32_t echoDiscarded;
+        uint32_t echoQueueDrops;
+        ReceiverLatencyHistogram rtt;
+        bool hasOffset;
+        int64_t offset_us;
+        int64_t offsetError_us;
+        uint32_t offsetSamples;
+    };
+
+    // Sent in every packet so the receiver can tell senders apart
+    const uint16_t nodeId;
+
     // Sequence number for packets
     uint32_t sequenceNumber;
 
-    // Timestamp of last packet sent
-    unsigned long lastPacketTime;
+    // Monotonic microsecond clock and drift-free deadlines for the packet rate
+    EspTimerClock clock;
+    PeriodicScheduler scheduler;
+
+    // Steps of rate/payload size, and the step currently being sent
+    TestProfile profile;
+    ProfileSequencer sequencer;
+    uint16_t payloadSize;
+
+    // One-shot timer re-armed at each absolute deadline. With a wake
+    // callback it only sets sendDue and wakes the role task to send.
+    esp_timer_handle_t sendTimer;
+    std::atomic<bool> sendDue;
+
+    // Packet being sent, only touched by the sending task. Sized for
+    // MAX_PACKET_SIZE, so kept off that task's stack.
+    Protocol::TestPacket txPacket;
+
+    // Send timing statistics, updated by the sending task and reset by snapshot()
+    std::atomic<uint32_t> packetsSent;
+    std::atomic<uint32_t> sendFailures;
+    std::atomic<uint32_t> lagSum_us;
+    std::atomic<uint32_t> lagMax_us;
+    unsigned long statisticsTimer;
+
+    // Protocol's aggregate counters at the last statistics report
+    uint32_t lastAggregateFrames;
+    uint32_t lastAggregateRecords;
+
+    // The last period snapshot() took, and whether report() has printed it
+    PeriodReport periodReport;
+    bool periodReportDue;
+
+    // Send completions, nullptr unless the protocol reports them (ESP-NOW)
+    TxTracker *txTracker;
+    TxTracker::Counters lastTxCounters;
+    ReceiverLatencyHistogram txLatencyHistogram;
+    uint32_t txCompletions;
+    std::atomic<uint32_t> flowControlWaits; // Timer runs that found the window full
+
+    // Echo replies queued by the radio callback for process()
+    SpscRing<EchoExchange, 16> echoQueue;
+
+    // Round-trip time and receiver clock offset from echo exchanges
+    ClockOffsetEstimator<SYNC_PING_COUNT> offsetEstimator;
+    ReceiverLatencyHistogram rttHistogram;
+    std::atomic<int32_t> clockOffset_us; // Sent in every packet header
+    std::atomic<uint32_t> echoRequests;
+    uint32_t echoReplies;
+    uint32_t echoDiscarded;
+
+    // Echo reply callback (runs in the Wi-Fi/lwIP task)
+    static void onPacketReceived(void *context, const PacketView &packet, const RxMetadata &rx);
+
+    // Update RTT and clock offset from one echo exchange
+    void processEchoExchange(const EchoExchange &exchange);
+
+    // Copy the period's echo statistics into periodReport and start a new period
+    void snapshotEchoStatistics();
+
+    // Print the echo statistics in periodReport
+    void printEchoStatistics();
+
+    // Take the send completions queued by the driver callback
+    void processTxCompletions();
+
+    // Copy the period's send completion statistics into periodReport and
+    // start a new period
+    void snapshotTxStatistics();
+
+    // Print the send completion statistics in periodReport
+    void printTxStatistics();
+
+    // Flow-control window reopened (runs in the Wi-Fi task)
+    static void onTxReady(void *arg);
+
+    // True if flow control allows another frame now
+    bool txWindowOpen();
+
+    // esp_timer callback (runs in the esp_timer task): send, or wake the role task to
+    static void onSendTimer(void *arg);
+
+    // Send every packet whose deadline has passed and re-arm the timer
+    void sendDuePackets();
+
+    // Build the profile selected by TEST_PROFILE from the test configuration
+    void buildProfile();
+
+    // Switch the scheduler to the active profile step
+    void applyStep();
+
+    // Prepare and send one packet scheduled at scheduled_us
+    void sendPacket(int64_t scheduled_us);
+
+    // Log a packet handed to the protocol (binary log format only)
+    void logTxRecord(const Protocol::TestPacket &packet, int64_t scheduled_us, int32_t lag_us,
+                     uint32_t duration_us, uint8_t result);
+
+    // Log the driver's outcome for one frame (binary log format only)
+    void logTxCompletion(const TxTracker::Completion &completion);
 
     // Prepare test packet
     void prepareTestPacket(Protocol::TestPacket &packet);
 };
 
-#endif // SENDER_H
\ No newline at end of file
+#endif // SENDER_H
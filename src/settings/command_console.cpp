@@ -0,0 +1,147 @@
+#include "command_console.h"
+#include <string.h>
+
+CommandConsole::CommandConsole(Stream *stream)
+    : stream(stream), line{}, length(0), overflowed(false)
+{
+}
+
+CommandConsole::Action CommandConsole::poll(TestConfig &pending)
+{
+    while (stream->available() > 0)
+    {
+        int c = stream->read();
+        if (c < 0)
+        {
+            break;
+        }
+
+        if (c != '\n' && c != '\r')
+        {
+            if (length < MAX_LINE - 1)
+            {
+                line[length++] = (char)c;
+            }
+            else
+            {
+                overflowed = true;
+            }
+            continue;
+        }
+
+        // End of line; CR LF gives an empty second line, which is ignored
+        line[length] = '\0';
+        bool tooLong = overflowed;
+        length = 0;
+        overflowed = false;
+
+        if (tooLong)
+        {
+            stream->println("Command too long");
+            continue;
+        }
+
+        Action action = execute(line, pending);
+        if (action != NONE)
+        {
+            return action;
+        }
+    }
+
+    return NONE;
+}
+
+CommandConsole::Action CommandConsole::execute(char *command, TestConfig &pending)
+{
+    const char *separators = " \t";
+    char *save;
+    char *name = strtok_r(command, separators, &save);
+    if (!name)
+    {
+        return NONE;
+    }
+
+    if (strcmp(name, "show") == 0)
+    {
+        pending.print(*stream);
+        const char *error = pending.validate();
+        if (error)
+        {
+            stream->printf("Not valid: %s\n", error);
+        }
+        return NONE;
+    }
+
+    if (strcmp(name, "set") == 0)
+    {
+        char *key = strtok_r(nullptr, separators, &save);
+        char *value = strtok_r(nullptr, separators, &save);
+        if (!key || !value)
+        {
+            stream->println("Usage: set <protocol|channel|power|payload|rate|sweep|aggregate|flush|window|peer|phyrate|retries> <value>");
+            return NONE;
+        }
+
+        const char *error = pending.set(key, value);
+        if (error)
+        {
+            stream->printf("Error: %s\n", error);
+        }
+        else
+        {
+            stream->printf("%s = %s (apply to use)\n", key, value);
+        }
+        return NONE;
+    }
+
+    if (strcmp(name, "apply") == 0 || strcmp(name, "save") == 0)
+    {
+        const char *error = pending.validate();
+        if (error)
+        {
+            stream->printf("Error: %s\n", error);
+            return NONE;
+        }
+        return strcmp(name, "apply") == 0 ? APPLY : SAVE;
+    }
+
+    if (strcmp(name, "load") == 0)
+    {
+        return LOAD;
+    }
+
+    if (strcmp(name, "clear") == 0)
+    {
+        return CLEAR;
+    }
+
+    if (strcmp(name, "reset") == 0)
+    {
+        pending = TestConfig::defaults();
+        stream->println("Pending configuration reset to build defaults (apply to use)");
+        return NONE;
+    }
+
+    if (strcmp(name, "help") != 0)
+    {
+        stream->printf("Unknown command: %s\n", name);
+    }
+    printHelp();
+    return NONE;
+}
+
+void CommandConsole::printHelp()
+{
+    stream->println("Commands:");
+    stream->println("  show                  Print the pending configuration");
+    stream->println("  set <name> <value>    protocol (wifi4|wifi6|wifi-lr|espnow|espnow-lr),");
+    stream->println("                        channel, power, payload (bytes), rate (Hz),");
+    stream->println("                        sweep (s per protocol, or off),");
+    stream->println("                        aggregate (packets per frame), flush (ms),");
+    stream->println("                        window (ESP-NOW frames in flight, or off),");
+    stream->println("                        peer (broadcast|unicast), phyrate (default|1m..54m|");
+    stream->println("                        mcs0..mcs7|lr250k|lr500k), retries (0-7)");
+    stream->println("  apply                 Restart the test with the pending configuration");
+    stream->println("  save | load | clear   Store, restore or forget the saved profile");
+    stream->println("  reset                 Pending configuration back to the build defaults");
+}
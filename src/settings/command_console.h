@@ -0,0 +1,50 @@
+#ifndef COMMAND_CONSOLE_H
+#define COMMAND_CONSOLE_H
+
+#include <Arduino.h>
+#include "test_config.h"
+
+// Line-based serial commands for changing the test configuration without
+// reflashing:
+//
+//   show                  Print the pending configuration
+//   set <name> <value>    Change protocol, channel, power, payload, rate or sweep
+//   apply                 Restart the test with the pending configuration
+//   save / load / clear   Store, restore or forget the NVS profile
+//   reset                 Return the pending configuration to the build defaults
+//
+// Commands edit a pending copy; the caller acts on the returned action, so
+// the console itself never touches the radio or NVS.
+class CommandConsole
+{
+public:
+    enum Action
+    {
+        NONE,
+        APPLY, // Tear down the running test and start it with pending
+        SAVE,  // Save pending to NVS
+        LOAD,  // Load the NVS profile into pending
+        CLEAR  // Erase the NVS profile
+    };
+
+    explicit CommandConsole(Stream *stream);
+
+    // Read the characters available without blocking. Returns the action of
+    // a completed command, NONE otherwise.
+    Action poll(TestConfig &pending);
+
+private:
+    static const size_t MAX_LINE = 64;
+
+    Stream *stream;
+    char line[MAX_LINE];
+    size_t length;
+    bool overflowed;
+
+    // Run one command line, in place
+    Action execute(char *command, TestConfig &pending);
+
+    void printHelp();
+};
+
+#endif // COMMAND_CONSOLE_H
@@ -0,0 +1,54 @@
+#include "config_store.h"
+
+static const char *NVS_NAMESPACE = "rangetest";
+static const char *NVS_KEY = "config";
+
+bool ConfigStore::load(TestConfig &config)
+{
+    if (!preferences.begin(NVS_NAMESPACE, true))
+    {
+        return false; // Nothing saved yet
+    }
+
+    StoredConfig stored;
+    size_t length = preferences.getBytesLength(NVS_KEY) == sizeof(stored)
+                        ? preferences.getBytes(NVS_KEY, &stored, sizeof(stored))
+                        : 0;
+    preferences.end();
+
+    if (length != sizeof(stored) || stored.version != LAYOUT_VERSION || stored.config.validate() != nullptr)
+    {
+        return false;
+    }
+
+    config = stored.config;
+    return true;
+}
+
+bool ConfigStore::save(const TestConfig &config)
+{
+    if (!preferences.begin(NVS_NAMESPACE, false))
+    {
+        return false;
+    }
+
+    StoredConfig stored = {};
+    stored.version = LAYOUT_VERSION;
+    stored.config = config;
+
+    size_t written = preferences.putBytes(NVS_KEY, &stored, sizeof(stored));
+    preferences.end();
+    return written == sizeof(stored);
+}
+
+bool ConfigStore::clear()
+{
+    if (!preferences.begin(NVS_NAMESPACE, false))
+    {
+        return false;
+    }
+
+    bool removed = preferences.remove(NVS_KEY);
+    preferences.end();
+    return removed;
+}
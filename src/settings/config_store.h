@@ -0,0 +1,35 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Preferences.h>
+#include "test_config.h"
+
+// Test configuration saved in NVS, so a board comes back up with the last
+// saved profile instead of the build defaults.
+class ConfigStore
+{
+public:
+    // Read the saved configuration into config. Returns false, leaving
+    // config unchanged, if none is saved or it is from another layout or invalid.
+    bool load(TestConfig &config);
+
+    // Save config for the next boot
+    bool save(const TestConfig &config);
+
+    // Forget the saved configuration, so the next boot uses the build defaults
+    bool clear();
+
+private:
+    // Bumped whenever TestConfig's layout changes
+    static const uint8_t LAYOUT_VERSION = 5;
+
+    struct StoredConfig
+    {
+        uint8_t version;
+        TestConfig config;
+    };
+
+    Preferences preferences;
+};
+
+#endif // CONFIG_STORE_H
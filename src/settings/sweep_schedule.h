@@ -0,0 +1,60 @@
+#ifndef SWEEP_SCHEDULE_H
+#define SWEEP_SCHEDULE_H
+
+#include <stdint.h>
+#include "test_config.h"
+
+// GPS-time-aligned protocol rotation for a sweep.
+//
+// Slots are numbered from the Unix epoch, so every board that knows UTC
+// from its GPS computes the same slot at the same moment without any
+// exchange over the air. Slot boundaries fall on whole UTC seconds, which
+// are the PPS edges. Each slot runs the base configuration with the next
+// protocol in the rotation.
+class SweepSchedule
+{
+public:
+    static const uint32_t SLOT_COUNT = 4;
+
+    explicit SweepSchedule(uint32_t slot_s = 0) : slot_us((int64_t)slot_s * 1000000)
+    {
+    }
+
+    bool isEnabled() const
+    {
+        return slot_us > 0;
+    }
+
+    // Slot containing a UTC time (microseconds since the Unix epoch)
+    uint32_t slotAt(int64_t utc_us) const
+    {
+        return (uint32_t)(utc_us / slot_us);
+    }
+
+    // UTC time the slot starts at
+    int64_t slotStart_us(uint32_t slot) const
+    {
+        return (int64_t)slot * slot_us;
+    }
+
+    // Base configuration with the slot's protocol
+    TestConfig configFor(uint32_t slot, const TestConfig &base) const
+    {
+        static const Protocol::ProtocolType ROTATION[SLOT_COUNT] = {
+            Protocol::PROTO_ESPNOW,
+            Protocol::PROTO_WIFI4,
+            Protocol::PROTO_WIFI6,
+            Protocol::PROTO_WIFI_LR,
+        };
+
+        TestConfig config = base;
+        config.protocol = ROTATION[slot % SLOT_COUNT];
+        config.longRange = false;
+        return config;
+    }
+
+private:
+    int64_t slot_us;
+};
+
+#endif // SWEEP_SCHEDULE_H
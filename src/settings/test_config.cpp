@@ -0,0 +1,377 @@
+#include "test_config.h"
+#include <stdlib.h>
+#include <string.h>
+#include "../protocol/phy_rate.h"
+
+// Console protocol names and the settings they select
+struct ProtocolName
+{
+    const char *key;
+    Protocol::ProtocolType protocol;
+    bool longRange;
+};
+
+static const ProtocolName PROTOCOL_NAMES[] = {
+    {"wifi4", Protocol::PROTO_WIFI4, false},
+    {"wifi6", Protocol::PROTO_WIFI6, false},
+    {"wifi-lr", Protocol::PROTO_WIFI_LR, false},
+    {"espnow", Protocol::PROTO_ESPNOW, false},
+    {"espnow-lr", Protocol::PROTO_ESPNOW, true},
+};
+
+static const size_t PROTOCOL_NAME_COUNT = sizeof(PROTOCOL_NAMES) / sizeof(PROTOCOL_NAMES[0]);
+
+// Channels allowed in the AU regulatory domain set by the protocols
+static const uint8_t MAX_CHANNEL = 13;
+
+// esp_wifi_set_max_tx_power() rejects values below this
+static const int8_t MIN_TX_POWER = 8;
+
+static const uint16_t MAX_PACKET_RATE = 10000; // Hz
+
+// Sweep slots must leave time to associate and measure after a switch
+static const uint16_t MIN_SWEEP_SLOT_S = 10;
+static const uint16_t MAX_SWEEP_SLOT_S = 3600;
+
+// The record count goes in a byte of the receiver's metadata
+static const uint8_t MAX_AGGREGATE_RECORDS = 64;
+static const uint16_t MAX_AGGREGATE_FLUSH_MS = 1000;
+
+// Frames TxTracker can follow at once
+static const uint8_t MAX_TX_WINDOW = TxTracker::CAPACITY;
+
+// Each retry is another full airtime for the frame
+static const uint8_t MAX_ESPNOW_RETRIES = 7;
+
+// Parse a whole decimal string into value. False if it is not a number or out of range.
+static bool parseInteger(const char *text, long min, long max, long &value)
+{
+    char *end;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < min || parsed > max)
+    {
+        return false;
+    }
+
+    value = parsed;
+    return true;
+}
+
+TestConfig TestConfig::defaults()
+{
+    TestConfig config;
+
+#if PROTOCOL == PROTOCOL_WIFI_4
+    config.protocol = Protocol::PROTO_WIFI4;
+#elif PROTOCOL == PROTOCOL_WIFI_6
+    config.protocol = Protocol::PROTO_WIFI6;
+#elif PROTOCOL == PROTOCOL_WIFI_LR
+    config.protocol = Protocol::PROTO_WIFI_LR;
+#elif PROTOCOL == PROTOCOL_ESP_NOW
+    config.protocol = Protocol::PROTO_ESPNOW;
+#else
+#error "PROTOCOL must be one of the PROTOCOL_* values"
+#endif
+
+#if defined(WIFI_LR)
+    config.longRange = config.protocol == Protocol::PROTO_ESPNOW;
+#else
+    config.longRange = false;
+#endif
+
+    config.channel = WIFI_CHANNEL;
+    config.txPower = TX_POWER;
+    config.payloadSize = PACKET_SIZE;
+    config.packetRate = PACKET_RATE;
+    config.sweepSlot_s = SWEEP_SLOT_S;
+    config.aggregateRecords = AGGREGATE_RECORDS;
+    config.aggregateFlush_ms = AGGREGATE_FLUSH_MS;
+    config.txWindow = TX_WINDOW;
+    config.espnowUnicast = ESPNOW_PEER == ESPNOW_PEER_UNICAST;
+    config.espnowRate = ESPNOW_RATE;
+    config.espnowRetries = ESPNOW_RETRIES;
+    return config;
+}
+
+const char *TestConfig::validate() const
+{
+    if (channel < 1 || channel > MAX_CHANNEL)
+    {
+        return "channel must be 1-13";
+    }
+
+    if (txPower < MIN_TX_POWER || txPower > TX_POWER)
+    {
+        return "power is outside the driver and regulatory limits";
+    }
+
+    // Echo replies carry their timestamps in the payload
+    if (payloadSize < EchoTimestamps::WIRE_SIZE)
+    {
+        return "payload must be at least 16 bytes";
+    }
+
+    if (payloadSize > maxPayloadSize())
+    {
+        return "payload is too large for the protocol";
+    }
+
+    if (packetRate < 1 || packetRate > MAX_PACKET_RATE)
+    {
+        return "rate must be 1-10000 Hz";
+    }
+
+    if (sweepSlot_s != 0 && (sweepSlot_s < MIN_SWEEP_SLOT_S || sweepSlot_s > MAX_SWEEP_SLOT_S))
+    {
+        return "sweep must be off or 10-3600 s";
+    }
+
+    if (aggregateRecords < 1 || aggregateRecords > MAX_AGGREGATE_RECORDS)
+    {
+        return "aggregate must be 1-64 packets";
+    }
+
+    if (aggregateFlush_ms < 1 || aggregateFlush_ms > MAX_AGGREGATE_FLUSH_MS)
+    {
+        return "flush must be 1-1000 ms";
+    }
+
+    if (txWindow > MAX_TX_WINDOW)
+    {
+        return "window must be off or 1-64 frames";
+    }
+
+    // LR rates need the LR PHY and the LR PHY carries nothing else. A sweep
+    // runs plain ESP-NOW, so it cannot use them.
+    const PhyRate *rate = PhyRate::byRate(espnowRate);
+    if (espnowRate != PhyRate::DRIVER_DEFAULT && !rate)
+    {
+        return "phyrate is not a known rate";
+    }
+    bool lrPhy = longRange && sweepSlot_s == 0;
+    if (rate && (rate->family == PhyRate::FAMILY_LR) != lrPhy)
+    {
+        return "phyrate lr250k and lr500k go with espnow-lr, and only they do";
+    }
+
+    // Broadcast frames are never acknowledged, so there is nothing to retry
+    if (espnowRetries > 0 && !espnowUnicast)
+    {
+        return "retries need peer unicast";
+    }
+
+    if (espnowRetries > MAX_ESPNOW_RETRIES)
+    {
+        return "retries must be 0-7";
+    }
+
+    // An echo request goes right after the aggregate it flushes, two frames at once
+    if (espnowRetries > 0 && aggregateRecords > 1)
+    {
+        return "retries need aggregate 1";
+    }
+
+    return nullptr;
+}
+
+const char *TestConfig::set(const char *key, const char *value)
+{
+    long number;
+
+    if (strcmp(key, "protocol") == 0)
+    {
+        for (size_t i = 0; i < PROTOCOL_NAME_COUNT; i++)
+        {
+            if (strcmp(value, PROTOCOL_NAMES[i].key) == 0)
+            {
+                protocol = PROTOCOL_NAMES[i].protocol;
+                longRange = PROTOCOL_NAMES[i].longRange;
+                return nullptr;
+            }
+        }
+        return "protocol must be wifi4, wifi6, wifi-lr, espnow or espnow-lr";
+    }
+
+    if (strcmp(key, "channel") == 0)
+    {
+        if (!parseInteger(value, 1, MAX_CHANNEL, number))
+        {
+            return "channel must be 1-13";
+        }
+        channel = (uint8_t)number;
+        return nullptr;
+    }
+
+    if (strcmp(key, "power") == 0)
+    {
+        if (!parseInteger(value, MIN_TX_POWER, TX_POWER, number))
+        {
+            return "power is outside the driver and regulatory limits";
+        }
+        txPower = (int8_t)number;
+        return nullptr;
+    }
+
+    if (strcmp(key, "payload") == 0)
+    {
+        // Checked against the protocol by validate(), so the order of set commands does not matter
+        if (!parseInteger(value, EchoTimestamps::WIRE_SIZE, MAX_PACKET_SIZE, number))
+        {
+            return "payload is outside 16 to MAX_PACKET_SIZE bytes";
+        }
+        payloadSize = (uint16_t)number;
+        return nullptr;
+    }
+
+    if (strcmp(key, "rate") == 0)
+    {
+        if (!parseInteger(value, 1, MAX_PACKET_RATE, number))
+        {
+            return "rate must be 1-10000 Hz";
+        }
+        packetRate = (uint16_t)number;
+        return nullptr;
+    }
+
+    if (strcmp(key, "sweep") == 0)
+    {
+        if (strcmp(value, "off") == 0)
+        {
+            sweepSlot_s = 0;
+            return nullptr;
+        }
+        if (!parseInteger(value, MIN_SWEEP_SLOT_S, MAX_SWEEP_SLOT_S, number))
+        {
+            return "sweep must be off or 10-3600 s";
+        }
+        sweepSlot_s = (uint16_t)number;
+        return nullptr;
+    }
+
+    if (strcmp(key, "aggregate") == 0)
+    {
+        // Checked against the payload by validate(), via maxPayloadSize()
+        if (!parseInteger(value, 1, MAX_AGGREGATE_RECORDS, number))
+        {
+            return "aggregate must be 1-64 packets";
+        }
+        aggregateRecords = (uint8_t)number;
+        return nullptr;
+    }
+
+    if (strcmp(key, "flush") == 0)
+    {
+        if (!parseInteger(value, 1, MAX_AGGREGATE_FLUSH_MS, number))
+        {
+            return "flush must be 1-1000 ms";
+        }
+        aggregateFlush_ms = (uint16_t)number;
+        return nullptr;
+    }
+
+    if (strcmp(key, "window") == 0)
+    {
+        if (strcmp(value, "off") == 0)
+        {
+            txWindow = 0;
+            return nullptr;
+        }
+        if (!parseInteger(value, 1, MAX_TX_WINDOW, number))
+        {
+            return "window must be off or 1-64 frames";
+        }
+        txWindow = (uint8_t)number;
+        return nullptr;
+    }
+
+    if (strcmp(key, "peer") == 0)
+    {
+        if (strcmp(value, "broadcast") == 0 || strcmp(value, "unicast") == 0)
+        {
+            espnowUnicast = strcmp(value, "unicast") == 0;
+            return nullptr;
+        }
+        return "peer must be broadcast or unicast";
+    }
+
+    if (strcmp(key, "phyrate") == 0)
+    {
+        // Checked against the protocol by validate()
+        if (strcmp(value, "default") == 0)
+        {
+            espnowRate = PhyRate::DRIVER_DEFAULT;
+            return nullptr;
+        }
+        const PhyRate *rate = PhyRate::byKey(value);
+        if (!rate)
+        {
+            return "phyrate must be default, 1m-54m, mcs0-mcs7, lr250k or lr500k";
+        }
+        espnowRate = rate->rate;
+        return nullptr;
+    }
+
+    if (strcmp(key, "retries") == 0)
+    {
+        if (!parseInteger(value, 0, MAX_ESPNOW_RETRIES, number))
+        {
+            return "retries must be 0-7";
+        }
+        espnowRetries = (uint8_t)number;
+        return nullptr;
+    }
+
+    return "unknown setting";
+}
+
+const char *TestConfig::protocolKey() const
+{
+    for (size_t i = 0; i < PROTOCOL_NAME_COUNT; i++)
+    {
+        if (PROTOCOL_NAMES[i].protocol == protocol && PROTOCOL_NAMES[i].longRange == longRange)
+        {
+            return PROTOCOL_NAMES[i].key;
+        }
+    }
+    return "unknown";
+}
+
+size_t TestConfig::maxPayloadSize() const
+{
+    // A sweep includes ESP-NOW, the smallest frame
+    Protocol::ProtocolType limiting = sweepSlot_s != 0 ? Protocol::PROTO_ESPNOW : protocol;
+    size_t recordHeader = aggregateRecords > 1 ? AggregateRecord::WIRE_SIZE : 0;
+    return Protocol::maxFrameSize(limiting) - PacketHeader::WIRE_SIZE - recordHeader;
+}
+
+uint8_t TestConfig::sendWindow() const
+{
+    return espnowRetries > 0 ? 1 : txWindow;
+}
+
+void TestConfig::print(Print &out) const
+{
+    out.printf("Protocol: %s\n", protocolKey());
+    out.printf("WiFi Channel: %u\n", channel);
+    out.printf("TX Power: %d (%.2f dBm)\n", txPower, txPower * 0.25);
+    out.printf("Packet Size: %u bytes (+%u byte header, max %u)\n",
+               payloadSize, (unsigned)PacketHeader::WIRE_SIZE, (unsigned)maxPayloadSize());
+    out.printf("Packet Rate: %u Hz\n", packetRate);
+    if (sweepSlot_s != 0)
+    {
+        out.printf("Sweep: %u s per protocol (espnow, wifi4, wifi6, wifi-lr)\n", sweepSlot_s);
+    }
+    if (aggregateRecords > 1)
+    {
+        out.printf("Aggregation: up to %u packets per frame, flushed after %u ms\n", aggregateRecords, aggregateFlush_ms);
+    }
+    if (txWindow != 0)
+    {
+        out.printf("Flow Control: up to %u ESP-NOW frames in flight\n", txWindow);
+    }
+    if (protocol == Protocol::PROTO_ESPNOW || sweepSlot_s != 0)
+    {
+        out.printf("ESP-NOW Peer: %s, PHY rate %s, %u retries\n", espnowUnicast ? "unicast" : "broadcast",
+                   PhyRate::name(espnowRate), espnowRetries);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef TEST_CONFIG_H
+#define TEST_CONFIG_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "../protocol/protocol.h"
+
+// Test parameters chosen at runtime, so one firmware image per role covers
+// every protocol, channel, power and payload combination. Starts from the
+// build's config.h values; changed over the serial console and saved to NVS.
+// Both ends of a test must be configured alike.
+struct TestConfig
+{
+    Protocol::ProtocolType protocol;
+    bool longRange;       // ESP-NOW over the LR PHY
+    uint8_t channel;
+    int8_t txPower;       // esp_wifi_set_max_tx_power() units, capped at TX_POWER
+    uint16_t payloadSize; // Bytes after the header
+    uint16_t packetRate;  // Hz
+    uint16_t sweepSlot_s; // Seconds per protocol in a sweep, 0 for no sweep
+    uint8_t aggregateRecords;   // Packets per frame, 1 for no aggregation
+    uint16_t aggregateFlush_ms; // Longest a packet waits for its frame to fill
+    uint8_t txWindow;           // ESP-NOW frames in flight before the sender waits, 0 for no limit
+    bool espnowUnicast;         // Send to a discovered receiver instead of broadcasting
+    uint8_t espnowRate;         // wifi_phy_rate_t, PhyRate::DRIVER_DEFAULT for the driver's
+    uint8_t espnowRetries;      // Extra sends of unacknowledged unicast frames
+
+    // Build defaults: PROTOCOL, WIFI_CHANNEL, TX_POWER, PACKET_SIZE,
+    // PACKET_RATE, SWEEP_SLOT_S, AGGREGATE_RECORDS, AGGREGATE_FLUSH_MS,
+    // TX_WINDOW, ESPNOW_PEER, ESPNOW_RATE, ESPNOW_RETRIES
+    static TestConfig defaults();
+
+    // nullptr if the combination can run, otherwise what is wrong with it
+    const char *validate() const;
+
+    // Set one field by its console name ("protocol", "channel", "power",
+    // "payload", "rate", "sweep", "aggregate", "flush", "window", "peer",
+    // "phyrate" or "retries"). Returns nullptr on success, otherwise an
+    // error; the field is unchanged on error.
+    const char *set(const char *key, const char *value);
+
+    // Console name of the protocol: wifi4, wifi6, wifi-lr, espnow or espnow-lr
+    const char *protocolKey() const;
+
+    // Largest payload the protocol can carry after the header, and after a
+    // record header when aggregating; the smallest over the sweep's
+    // protocols when sweeping
+    size_t maxPayloadSize() const;
+
+    // Frames the sender may have in flight, 0 for no limit. Retries send
+    // one frame at a time whatever the window.
+    uint8_t sendWindow() const;
+
+    void print(Print &out) const;
+};
+
+#endif // TEST_CONFIG_H
@@ -0,0 +1,297 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Fixed-memory, allocation-free streaming histogram with HDR-style
+// log-linear buckets.
+//
+// Values below 2^SubBucketBits are counted exactly. Above that, every power of
+// two is split into 2^(SubBucketBits - 1) equal buckets, so the relative error
+// of any reported value is at most 2^-(SubBucketBits - 1). Magnitudes sets the
+// number of powers of two covered above the linear range; larger values are
+// counted in the last bucket. record() is O(1); percentile() walks the buckets.
+//
+// Negative values (e.g. one-way latency with a clock offset) are counted in
+// the first bucket and reported by getNegativeCount(). A narrow Counter
+// saturates rather than wraps; getSaturatedCount() reports the samples a
+// full bucket could not take, which the percentiles leave out.
+template <unsigned SubBucketBits, unsigned Magnitudes, typename Counter = uint32_t>
+class LatencyHistogram
+{
+    static_assert(SubBucketBits >= 2 && SubBucketBits <= 16, "SubBucketBits out of range");
+    static_assert(Magnitudes >= 1 && SubBucketBits + Magnitudes < 63, "Magnitudes out of range");
+
+public:
+    static const uint32_t SUB_BUCKETS = 1u << SubBucketBits;
+    static const uint32_t HALF_BUCKETS = SUB_BUCKETS / 2;
+    static const size_t BUCKET_COUNT = SUB_BUCKETS + (size_t)Magnitudes * HALF_BUCKETS;
+    static const Counter COUNTER_MAX = (Counter)~(Counter)0;
+
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        negatives = 0;
+        overflows = 0;
+        saturated = 0;
+        sum = 0;
+        minValue = INT64_MAX;
+        maxValue = INT64_MIN;
+    }
+
+    void record(int64_t value)
+    {
+        total++;
+        sum += value;
+
+        if (value < minValue)
+        {
+            minValue = value;
+        }
+        if (value > maxValue)
+        {
+            maxValue = value;
+        }
+
+        if (value < 0)
+        {
+            negatives++;
+            value = 0;
+        }
+
+        size_t index = bucketIndex((uint64_t)value);
+        if (index >= BUCKET_COUNT)
+        {
+            overflows++;
+            index = BUCKET_COUNT - 1;
+        }
+
+        if (counts[index] == COUNTER_MAX)
+        {
+            saturated++;
+            return;
+        }
+        counts[index]++;
+    }
+
+    // Value at or below which the given fraction (0..1) of samples fall.
+    // Reported as the highest value of the containing bucket, capped at the
+    // observed maximum.
+    int64_t percentile(double fraction) const
+    {
+        uint64_t counted = total - saturated;
+        if (counted == 0)
+        {
+            return 0;
+        }
+
+        uint64_t rank = (uint64_t)(fraction * counted + 0.5);
+        if (rank < 1)
+        {
+            rank = 1;
+        }
+        if (rank > counted)
+        {
+            rank = counted;
+        }
+
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; i++)
+        {
+            cumulative += counts[i];
+            if (cumulative >= rank)
+            {
+                int64_t value = (int64_t)bucketHighest(i);
+                if (value > maxValue)
+                {
+                    value = maxValue;
+                }
+                if (value < minValue)
+                {
+                    value = minValue;
+                }
+                return value;
+            }
+        }
+
+        return maxValue;
+    }
+
+    // Add another histogram's samples to this one
+    void merge(const LatencyHistogram &other)
+    {
+        for (size_t i = 0; i < BUCKET_COUNT; i++)
+        {
+            uint64_t count = (uint64_t)counts[i] + other.counts[i];
+            if (count > COUNTER_MAX)
+            {
+                saturated += count - COUNTER_MAX;
+                count = COUNTER_MAX;
+            }
+            counts[i] = (Counter)count;
+        }
+
+        total += other.total;
+        negatives += other.negatives;
+        overflows += other.overflows;
+        saturated += other.saturated;
+        sum += other.sum;
+        if (other.minValue < minValue)
+        {
+            minValue = other.minValue;
+        }
+        if (other.maxValue > maxValue)
+        {
+            maxValue = other.maxValue;
+        }
+    }
+
+    uint64_t getCount() const
+    {
+        return total;
+    }
+
+    int64_t getMin() const
+    {
+        return total ? minValue : 0;
+    }
+
+    int64_t getMax() const
+    {
+        return total ? maxValue : 0;
+    }
+
+    double getMean() const
+    {
+        return total ? (double)sum / total : 0.0;
+    }
+
+    uint64_t getNegativeCount() const
+    {
+        return negatives;
+    }
+
+    // Samples larger than the histogram range, counted in the last bucket
+    uint64_t getOverflowCount() const
+    {
+        return overflows;
+    }
+
+    // Samples dropped because their bucket count was at its maximum
+    uint64_t getSaturatedCount() const
+    {
+        return saturated;
+    }
+
+    // Bucket layout, exposed for tests and for tools that dump histograms
+    static size_t bucketIndex(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+        {
+            return (size_t)value;
+        }
+
+        unsigned msb = 63 - __builtin_clzll(value);
+        unsigned shift = msb - (SubBucketBits - 1);
+        uint64_t sub = value >> shift; // In [HALF_BUCKETS, SUB_BUCKETS)
+        return SUB_BUCKETS + (size_t)(shift - 1) * HALF_BUCKETS + (size_t)(sub - HALF_BUCKETS);
+    }
+
+    static uint64_t bucketLowest(size_t index)
+    {
+        if (index < SUB_BUCKETS)
+        {
+            return index;
+        }
+
+        size_t offset = index - SUB_BUCKETS;
+        unsigned shift = (unsigned)(offset / HALF_BUCKETS) + 1;
+        uint64_t sub = HALF_BUCKETS + offset % HALF_BUCKETS;
+        return sub << shift;
+    }
+
+    static uint64_t bucketHighest(size_t index)
+    {
+        if (index < SUB_BUCKETS)
+        {
+            return index;
+        }
+
+        unsigned shift = (unsigned)((index - SUB_BUCKETS) / HALF_BUCKETS) + 1;
+        return bucketLowest(index) + ((uint64_t)1 << shift) - 1;
+    }
+
+    Counter bucketCount(size_t index) const
+    {
+        return counts[index];
+    }
+
+private:
+    Counter counts[BUCKET_COUNT];
+    uint64_t total;
+    uint64_t negatives;
+    uint64_t overflows;
+    uint64_t saturated;
+    int64_t sum;
+    int64_t minValue;
+    int64_t maxValue;
+};
+
+// Receiver latency histogram: ~3% resolution, exact below 64 us, up to ~67 s
+typedef LatencyHistogram<6, 20> ReceiverLatencyHistogram;
+
+// Per-sender histogram on a multi-sender receiver: ~12% resolution in 704
+// bytes. 16-bit counts would fill within one 10 s period at kHz rates.
+typedef LatencyHistogram<4, 20> PeerLatencyHistogram;
+
+// RFC 3550 interarrival jitter: J += (|D| - J) / 16, where D is the change in
+// transit time (receive minus send timestamp) between consecutive packets.
+// Kept in 1/16 us fixed point as in the RFC's reference code.
+class InterarrivalJitter
+{
+public:
+    InterarrivalJitter() : jitter_q4(0), lastTransit_us(0), hasLast(false) {}
+
+    void reset()
+    {
+        jitter_q4 = 0;
+        hasLast = false;
+    }
+
+    void update(int64_t transit_us)
+    {
+        if (hasLast)
+        {
+            int64_t d = transit_us - lastTransit_us;
+            if (d < 0)
+            {
+                d = -d;
+            }
+            jitter_q4 += d - ((jitter_q4 + 8) >> 4);
+        }
+
+        lastTransit_us = transit_us;
+        hasLast = true;
+    }
+
+    // Current jitter estimate in microseconds
+    double getJitter_us() const
+    {
+        return jitter_q4 / 16.0;
+    }
+
+private:
+    int64_t jitter_q4;
+    int64_t lastTransit_us;
+    bool hasLast;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,133 @@
+#ifndef PEER_TABLE_H
+#define PEER_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../protocol/peer_address.h"
+
+// Fixed-capacity hash table from PeerAddress to per-peer state.
+//
+// Open addressing with linear probing over a power-of-two slot array at
+// most half full. The slots hold only the key and an index into a dense
+// array of values, so a probe scans a few contiguous bytes rather than
+// striding over large value structs, and reports iterate the values in
+// insertion order. Nothing is allocated after construction and peers are
+// never removed, which suits a test with a known, small set of senders.
+template <typename Value, size_t Capacity>
+class PeerTable
+{
+    static_assert(Capacity >= 1 && Capacity < 0xFFFF, "Capacity out of range");
+
+    // Smallest power of two with room for twice the capacity
+    static constexpr size_t slotCount(size_t slots = 2)
+    {
+        return slots >= 2 * Capacity ? slots : slotCount(slots * 2);
+    }
+
+    static const size_t SLOTS = slotCount();
+    static const uint16_t EMPTY = 0xFFFF;
+
+public:
+    PeerTable() : count(0)
+    {
+        for (size_t i = 0; i < SLOTS; i++)
+        {
+            slots[i].index = EMPTY;
+        }
+    }
+
+    // State for the peer, nullptr if it has not been inserted
+    Value *find(const PeerAddress &key)
+    {
+        size_t slot;
+        return probe(key, slot) ? &values[slots[slot].index] : nullptr;
+    }
+
+    // State for the peer, inserting it if it is new. A new peer's value is
+    // default-constructed and inserted is set. Returns nullptr if the peer
+    // is new and the table is full.
+    Value *insert(const PeerAddress &key, bool &inserted)
+    {
+        size_t slot;
+        inserted = false;
+
+        if (probe(key, slot))
+        {
+            return &values[slots[slot].index];
+        }
+
+        if (count == Capacity)
+        {
+            return nullptr;
+        }
+
+        // probe() stopped at the free slot that ends the key's run
+        slots[slot].key = key;
+        slots[slot].index = (uint16_t)count;
+        addresses[count] = key;
+        inserted = true;
+        return &values[count++];
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+    // Peers in insertion order, i < size()
+    const PeerAddress &addressAt(size_t i) const
+    {
+        return addresses[i];
+    }
+
+    Value &valueAt(size_t i)
+    {
+        return values[i];
+    }
+
+    const Value &valueAt(size_t i) const
+    {
+        return values[i];
+    }
+
+private:
+    struct Slot
+    {
+        PeerAddress key;
+        uint16_t index; // Into values, EMPTY if unused
+    };
+
+    Slot slots[SLOTS];
+    size_t count;
+    PeerAddress addresses[Capacity];
+    Value values[Capacity];
+
+    // Fibonacci hashing spreads MACs that differ only in their last byte
+    static size_t home(const PeerAddress &key)
+    {
+        return (size_t)((key.pack() * 0x9E3779B97F4A7C15ull) >> 40) & (SLOTS - 1);
+    }
+
+    // Find the key's slot, or the free slot that ends its probe run. The
+    // table is never more than half full, so a free slot always exists.
+    bool probe(const PeerAddress &key, size_t &slot) const
+    {
+        slot = home(key);
+        while (slots[slot].index != EMPTY)
+        {
+            if (slots[slot].key == key)
+            {
+                return true;
+            }
+            slot = (slot + 1) & (SLOTS - 1);
+        }
+        return false;
+    }
+};
+
+#endif // PEER_TABLE_H
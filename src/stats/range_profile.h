@@ -0,0 +1,267 @@
+#ifndef RANGE_PROFILE_H
+#define RANGE_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "latency_histogram.h"
+#include "sequence_tracker.h"
+
+// Per-bin latency: ~25% resolution up to ~1 s in 304 bytes, enough to see it
+// grow with distance. 32-bit counts hold a whole test.
+typedef LatencyHistogram<3, 17> RangeLatencyHistogram;
+
+// One sender's most recent gaps and the RangeProfile bin each was charged
+// to, so a late packet takes its loss back from that bin rather than its
+// own. Gaps older than the last Entries stay charged if filled, and each
+// gap gives back at most the sequence numbers it charged.
+template <uint32_t Entries = 8>
+class ChargedGaps
+{
+    static_assert(Entries >= 1, "ChargedGaps needs at least one entry");
+
+public:
+    ChargedGaps()
+    {
+        reset();
+    }
+
+    // Forget every gap, e.g. when the sender restarts its sequence
+    void reset()
+    {
+        for (uint32_t i = 0; i < Entries; i++)
+        {
+            gaps[i].remaining = 0;
+        }
+        next = 0;
+    }
+
+    // count sequence numbers from first on were charged to bin index
+    void add(uint32_t first, uint32_t count, uint32_t index)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        Gap &gap = gaps[next];
+        gap.first = first;
+        gap.count = count;
+        gap.remaining = count;
+        gap.bin = index;
+        next = (next + 1) % Entries;
+    }
+
+    // A late sequence number arrived: true, with the bin it was charged to,
+    // if it falls in a remembered gap with loss left to give back
+    bool fill(uint32_t sequence, uint32_t &index)
+    {
+        // Newest first: a restarted gap's range can overlap an older one
+        for (uint32_t i = 1; i <= Entries; i++)
+        {
+            Gap &gap = gaps[(next + Entries - i) % Entries];
+            if (gap.remaining > 0 && sequence - gap.first < gap.count)
+            {
+                gap.remaining--;
+                index = gap.bin;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Gap
+    {
+        uint32_t first;
+        uint32_t count;
+        uint32_t remaining; // Charged and not yet taken back; 0 if unused
+        uint32_t bin;
+    };
+
+    Gap gaps[Entries];
+    uint32_t next; // Slot the next gap overwrites
+};
+
+// Received, lost, RSSI and latency by distance between sender and receiver,
+// accumulated over a whole test in fixed memory.
+//
+// BinCount bins of binSize_m metres; the last one also takes everything
+// beyond. Sequence numbers a packet skipped are charged to that packet's bin,
+// where the sender was when the link came back; a ChargedGaps per sender
+// remembers the bin, so a packet that fills a hole later takes the loss back
+// from the bin that was charged. Packets without a position at either end
+// are counted apart, under index UNPLACED. test/test_range_profile.cpp
+// covers the accounting on the host.
+template <uint32_t BinCount>
+class RangeProfile
+{
+    static_assert(BinCount >= 1, "RangeProfile needs at least one bin");
+
+public:
+    // RSSI the radio reports when it has none for a packet
+    static const int8_t NO_RSSI = -127;
+
+    // Bin index add() returns for packets without a position
+    static const uint32_t UNPLACED = BinCount;
+
+    struct Bin
+    {
+        uint32_t received;
+        uint32_t lost;
+        int32_t rssiSum;
+        uint32_t rssiCount; // Packets with an RSSI
+        int8_t rssiMin;
+        RangeLatencyHistogram latency;
+
+        void reset()
+        {
+            received = 0;
+            lost = 0;
+            rssiSum = 0;
+            rssiCount = 0;
+            rssiMin = 0;
+            latency.reset();
+        }
+
+        bool isEmpty() const
+        {
+            return received == 0 && lost == 0;
+        }
+
+        float lossRate() const
+        {
+            return received + lost > 0 ? lost * 100.0f / (received + lost) : 0.0f;
+        }
+
+        float rssiMean() const
+        {
+            return rssiCount > 0 ? (float)rssiSum / rssiCount : 0.0f;
+        }
+    };
+
+    explicit RangeProfile(uint16_t binSize_m) : binSize_m(binSize_m > 0 ? binSize_m : 1)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (uint32_t i = 0; i < BinCount; i++)
+        {
+            bins[i].reset();
+        }
+        unplaced.reset();
+    }
+
+    // Account one unique packet from distance_m, negative if either end has
+    // no position, and the sequence numbers it skipped. Returns the index
+    // of the bin charged, for takeBack().
+    uint32_t add(float distance_m, int8_t rssi_dBm, int64_t latency_us, uint32_t skipped)
+    {
+        uint32_t index = distance_m < 0 ? UNPLACED : binIndex(distance_m);
+        Bin &bin = binAt(index);
+
+        bin.received++;
+        bin.lost += skipped;
+
+        if (rssi_dBm != NO_RSSI)
+        {
+            if (bin.rssiCount == 0 || rssi_dBm < bin.rssiMin)
+            {
+                bin.rssiMin = rssi_dBm;
+            }
+            bin.rssiSum += rssi_dBm;
+            bin.rssiCount++;
+        }
+
+        // 0 means no latency: a clock was missing at either end
+        if (latency_us != 0)
+        {
+            bin.latency.record(latency_us);
+        }
+
+        return index;
+    }
+
+    // A sequence number charged to bin index arrived after all
+    void takeBack(uint32_t index)
+    {
+        Bin &bin = binAt(index);
+        if (bin.lost > 0)
+        {
+            bin.lost--;
+        }
+    }
+
+    // Account one packet from a sender as the tracker classified it: the
+    // sequence numbers it skipped are charged to its bin and remembered in
+    // the sender's gaps, and a late packet takes its loss back from the bin
+    // its gap was charged to. Packets from before the first one, or from
+    // before a restart, were never charged and match no gap.
+    template <uint32_t WindowSize, uint32_t Entries>
+    void account(ChargedGaps<Entries> &gaps, const SequenceTracker<WindowSize> &tracker,
+                 typename SequenceTracker<WindowSize>::Result result, uint32_t sequence,
+                 float distance_m, int8_t rssi_dBm, int64_t latency_us)
+    {
+        typedef SequenceTracker<WindowSize> Tracker;
+
+        if (result == Tracker::DUPLICATE)
+        {
+            return;
+        }
+        if (result == Tracker::RESTART)
+        {
+            gaps.reset();
+        }
+
+        uint32_t skipped = result == Tracker::NEW ? tracker.getLastGap() : 0;
+        uint32_t index = add(distance_m, rssi_dBm, latency_us, skipped);
+        if (skipped > 0)
+        {
+            gaps.add(sequence - skipped, skipped, index);
+        }
+        else if ((result == Tracker::REORDERED || result == Tracker::RECOVERED) && gaps.fill(sequence, index))
+        {
+            takeBack(index);
+        }
+    }
+
+    uint32_t binIndex(float distance_m) const
+    {
+        uint32_t index = (uint32_t)(distance_m / binSize_m);
+        return index < BinCount ? index : BinCount - 1;
+    }
+
+    const Bin &bin(uint32_t index) const
+    {
+        return bins[index];
+    }
+
+    // Packets without a position at either end
+    const Bin &getUnplaced() const
+    {
+        return unplaced;
+    }
+
+    uint16_t getBinSize_m() const
+    {
+        return binSize_m;
+    }
+
+    static uint32_t binCount()
+    {
+        return BinCount;
+    }
+
+private:
+    uint16_t binSize_m;
+    Bin bins[BinCount];
+    Bin unplaced;
+
+    Bin &binAt(uint32_t index)
+    {
+        return index < BinCount ? bins[index] : unplaced;
+    }
+};
+
+#endif // RANGE_PROFILE_H
@@ -0,0 +1,332 @@
+#ifndef SEQUENCE_TRACKER_H
+#define SEQUENCE_TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Sliding-window sequence number tracker for loss accounting, in the style
+// of the IPsec/DTLS anti-replay window.
+//
+// Sequence numbers a packet skips are charged as lost as soon as the gap is
+// seen, so reports show loss in the period it happened. A bitmap of the last
+// WindowSize sequence numbers below the highest one seen records which have
+// arrived; a late packet that fills a charged hole is counted as recovered
+// and takes its loss back. Sequence arithmetic is serial (RFC 1982 style),
+// so 32-bit wrap-around is handled.
+//
+// Classification of each packet:
+//   new        - ahead of everything seen so far
+//   reordered  - behind the highest sequence but inside the window, first copy
+//   duplicate  - already seen inside the window
+//   recovered  - older than the window; it cannot be told from a duplicate
+//                any more, so it is taken to fill a hole
+//   restart    - the sender appears to have restarted (see below); the window
+//                is reset and accounting continues from the new sequence
+//
+// A restart is assumed when a packet is more than RESTART_GAP behind the
+// highest sequence. A sequence number below RESTART_SEQUENCE arriving at
+// least RESTART_SEQUENCE behind (senders count from 0 after boot) may also be
+// a late or duplicate packet, so it only restarts the window when a late
+// packet could not look the same: it was sent after the highest packet, or,
+// without send times, it is the second such sequence number in a row. Until
+// then it is classified as any other late packet. A sender that reboots
+// within its first RESTART_SEQUENCE packets shows up as duplicates until it
+// passes its old highest sequence.
+//
+// Constant memory (WindowSize / 8 bytes of bitmap) and amortised O(1) per
+// packet. test/test_sequence_tracker.cpp feeds it synthetic sequences.
+template <uint32_t WindowSize = 1024>
+class SequenceTracker
+{
+    static_assert(WindowSize >= 64 && (WindowSize & (WindowSize - 1)) == 0,
+                  "WindowSize must be a power of two, at least 64");
+
+public:
+    static const uint32_t RESTART_GAP = 4 * WindowSize;
+    static const uint32_t RESTART_SEQUENCE = 16;
+
+    enum Result
+    {
+        NEW,
+        REORDERED,
+        DUPLICATE,
+        RECOVERED,
+        RESTART
+    };
+
+    // Cumulative counters; subtract two snapshots for per-period figures
+    struct Counters
+    {
+        uint32_t received;   // Unique packets accepted
+        uint32_t lost;       // Sequence numbers skipped, charged when the gap opened
+        uint32_t reordered;  // Arrived behind a higher sequence, inside the window
+        uint32_t duplicates; // Already seen
+        uint32_t recovered;  // Arrived after being charged as lost
+        uint32_t restarts;   // Sender restarts detected
+
+        // Charged and not recovered since. Over a period in which more late
+        // packets arrived than sequence numbers were skipped this is 0.
+        uint32_t netLost() const
+        {
+            return lost > recovered ? lost - recovered : 0;
+        }
+
+        Counters operator-(const Counters &other) const
+        {
+            Counters d;
+            d.received = received - other.received;
+            d.lost = lost - other.lost;
+            d.reordered = reordered - other.reordered;
+            d.duplicates = duplicates - other.duplicates;
+            d.recovered = recovered - other.recovered;
+            d.restarts = restarts - other.restarts;
+            return d;
+        }
+
+        Counters &operator+=(const Counters &other)
+        {
+            received += other.received;
+            lost += other.lost;
+            reordered += other.reordered;
+            duplicates += other.duplicates;
+            recovered += other.recovered;
+            restarts += other.restarts;
+            return *this;
+        }
+    };
+
+    SequenceTracker()
+    {
+        reset();
+    }
+
+    // Forget all state and counters
+    void reset()
+    {
+        memset(&counters, 0, sizeof(counters));
+        started = false;
+        highest = 0;
+        first = 0;
+        lastGap = 0;
+        highestSent_us = 0;
+        lowPending = false;
+        pendingLow = 0;
+    }
+
+    // Account one received sequence number; sent_us is the sender's send
+    // time on a clock that keeps running across its reboots, 0 if unknown
+    Result add(uint32_t sequence, int64_t sent_us = 0)
+    {
+        lastGap = 0;
+        bool afterLowSequence = lowPending;
+        lowPending = false;
+
+        if (!started)
+        {
+            restartAt(sequence, sent_us);
+            counters.received++;
+            return NEW;
+        }
+
+        int32_t diff = (int32_t)(sequence - highest);
+
+        if (diff > 0)
+        {
+            // Sequence numbers skipped over are lost unless they turn up later
+            lastGap = (uint32_t)diff - 1;
+            counters.lost += lastGap;
+            advance((uint32_t)diff);
+            setBit(sequence);
+            highest = sequence;
+            highestSent_us = sent_us;
+            counters.received++;
+            return NEW;
+        }
+
+        if (diff == 0)
+        {
+            counters.duplicates++;
+            return DUPLICATE;
+        }
+
+        uint32_t behind = (uint32_t)(-(int64_t)diff);
+
+        // Sent before the first packet after a (re)start: never charged
+        bool early = (int32_t)(sequence - first) < 0;
+
+        // A low sequence number well behind needs a second signal to be a
+        // restart: the send time when both ends of the comparison have one
+        bool lowSequence = sequence < RESTART_SEQUENCE && behind >= RESTART_SEQUENCE;
+        bool confirmed = (sent_us != 0 && highestSent_us != 0) ? sent_us > highestSent_us
+                                                               : afterLowSequence && sequence > pendingLow;
+        if (behind > RESTART_GAP || (lowSequence && confirmed))
+        {
+            counters.restarts++;
+            restartAt(sequence, sent_us);
+            counters.received++;
+            return RESTART;
+        }
+
+        if (lowSequence)
+        {
+            lowPending = true;
+            pendingLow = sequence;
+        }
+
+        if (behind >= WindowSize)
+        {
+            counters.received++;
+            if (early)
+            {
+                counters.reordered++;
+                return REORDERED;
+            }
+
+            // Charged as lost when the gap opened
+            counters.recovered++;
+            return RECOVERED;
+        }
+
+        if (testBit(sequence))
+        {
+            counters.duplicates++;
+            return DUPLICATE;
+        }
+
+        setBit(sequence);
+        counters.reordered++;
+        counters.received++;
+        if (!early)
+        {
+            counters.recovered++;
+        }
+        return REORDERED;
+    }
+
+    const Counters &getCounters() const
+    {
+        return counters;
+    }
+
+    // Charged holes still inside the window, which a late packet may fill
+    uint32_t getPendingMissing() const
+    {
+        if (!started)
+        {
+            return 0;
+        }
+
+        // Positions from the first packet up to the highest one
+        uint32_t span = highest - first + 1;
+        if (span == 0 || span > WindowSize)
+        {
+            span = WindowSize;
+        }
+
+        return span - countRange(highest - span + 1, span);
+    }
+
+    // Number of sequence numbers skipped by the last NEW packet
+    uint32_t getLastGap() const
+    {
+        return lastGap;
+    }
+
+    uint32_t getHighest() const
+    {
+        return highest;
+    }
+
+private:
+    static const uint32_t WORDS = WindowSize / 32;
+
+    uint32_t bitmap[WORDS]; // Bit (seq % WindowSize) set if seq arrived
+    uint32_t highest;
+    uint32_t first; // Sequence the window was (re)started at
+    bool started;
+    uint32_t lastGap;
+    int64_t highestSent_us; // Send time of the highest sequence, 0 if unknown
+    bool lowPending;        // The last packet was a low sequence number that may be a restart
+    uint32_t pendingLow;    // Its sequence number
+    Counters counters;
+
+    void restartAt(uint32_t sequence, int64_t sent_us)
+    {
+        // Positions before the first packet were never charged; a packet
+        // from there is one that overtook the first arrival
+        memset(bitmap, 0, sizeof(bitmap));
+        highest = sequence;
+        highestSent_us = sent_us;
+        first = sequence;
+        started = true;
+        setBit(sequence);
+    }
+
+    bool testBit(uint32_t sequence) const
+    {
+        uint32_t bit = sequence & (WindowSize - 1);
+        return (bitmap[bit / 32] >> (bit % 32)) & 1;
+    }
+
+    void setBit(uint32_t sequence)
+    {
+        uint32_t bit = sequence & (WindowSize - 1);
+        bitmap[bit / 32] |= 1u << (bit % 32);
+    }
+
+    // Slide the window forward by distance positions. The oldest positions
+    // leave the window and their slots are cleared for the new ones.
+    void advance(uint32_t distance)
+    {
+        if (distance >= WindowSize)
+        {
+            memset(bitmap, 0, sizeof(bitmap));
+            return;
+        }
+
+        // The leaving positions share their slots with the new sequence numbers
+        uint32_t bit = (highest + 1) & (WindowSize - 1);
+        uint32_t remaining = distance;
+
+        while (remaining > 0)
+        {
+            uint32_t mask;
+            uint32_t length = wordSpan(bit, remaining, mask);
+            bitmap[bit / 32] &= ~mask;
+            remaining -= length;
+            bit = (bit + length) & (WindowSize - 1);
+        }
+    }
+
+    // Arrived positions among count sequence numbers from sequence on
+    uint32_t countRange(uint32_t sequence, uint32_t count) const
+    {
+        uint32_t set = 0;
+        uint32_t bit = sequence & (WindowSize - 1);
+        uint32_t remaining = count;
+
+        while (remaining > 0)
+        {
+            uint32_t mask;
+            uint32_t length = wordSpan(bit, remaining, mask);
+            set += __builtin_popcount(bitmap[bit / 32] & mask);
+            remaining -= length;
+            bit = (bit + length) & (WindowSize - 1);
+        }
+
+        return set;
+    }
+
+    // Bits from bit up to the end of its word, at most count of them: the
+    // number of bits, and their mask within the word
+    static uint32_t wordSpan(uint32_t bit, uint32_t count, uint32_t &mask)
+    {
+        uint32_t offset = bit % 32;
+        uint32_t length = 32 - offset < count ? 32 - offset : count;
+        mask = (length == 32) ? 0xFFFFFFFFu : (((1u << length) - 1) << offset);
+        return length;
+    }
+};
+
+#endif // SEQUENCE_TRACKER_H
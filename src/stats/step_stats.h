@@ -0,0 +1,163 @@
+#ifndef STEP_STATS_H
+#define STEP_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "latency_histogram.h"
+
+// Summary of one finished test profile step as seen by the receiver
+struct StepReport
+{
+    uint8_t stepId;
+    uint32_t received;
+    uint32_t lost;
+    uint16_t payloadSize;
+    uint64_t payloadBytes;
+    int64_t span_us; // First to last receive time
+    int64_t latencyP50_us;
+    int64_t latencyP90_us;
+    int64_t latencyP99_us;
+    int64_t latencyMax_us;
+
+    // Received packets per second over the step
+    double rxRateHz() const
+    {
+        return span_us > 0 ? (received - 1) * 1e6 / span_us : 0.0;
+    }
+
+    // Payload goodput in kbit/s over the step
+    double goodputKbps() const
+    {
+        return (span_us > 0 && received > 1) ? payloadBytes * (received - 1) / (double)received * 8e3 / span_us : 0.0;
+    }
+
+    double lossRate() const
+    {
+        return (received + lost) > 0 ? lost * 100.0 / (received + lost) : 0.0;
+    }
+};
+
+// Per-step receive bookkeeping for throughput tests.
+//
+// The sender walks the profile steps in order, so only the current step is
+// accumulated; when a packet with a new step id arrives the previous step is
+// finalised. Packets missing between the last packet of one step and the
+// first packet of the next are charged to the earlier step. A packet sent
+// before the current step's first packet is a straggler of a closed step,
+// whatever its step id, so profiles that repeat or alternate steps are not
+// confused by reordering. After a sender restart the caller flushes the step
+// so the sequence numbers start over. Latency percentiles come from a
+// streaming histogram, so memory is constant however long a step runs.
+class StepStatsTracker
+{
+public:
+    StepStatsTracker() : active(false), latePackets(0)
+    {
+        reset(0, 0, 0);
+    }
+
+    // Account one packet. Returns true and fills finished when the packet
+    // starts a new step.
+    bool add(uint8_t packetStepId, uint32_t sequenceNumber, uint16_t payloadLength,
+             int64_t receiveTime_us, int64_t latency_us, StepReport &finished)
+    {
+        bool completed = false;
+
+        if (!active)
+        {
+            reset(packetStepId, sequenceNumber, receiveTime_us);
+            active = true;
+        }
+        else if ((int32_t)(sequenceNumber - firstSeq) < 0)
+        {
+            // Sent before this step began: a straggler of a closed step
+            latePackets++;
+            return false;
+        }
+        else if (packetStepId != stepId)
+        {
+            finish(sequenceNumber, finished);
+            completed = true;
+            reset(packetStepId, sequenceNumber, receiveTime_us);
+        }
+
+        received++;
+        payloadSize = payloadLength;
+        payloadBytes += payloadLength;
+        lastRx_us = receiveTime_us;
+        if ((int32_t)(sequenceNumber - lastSeq) > 0)
+        {
+            lastSeq = sequenceNumber;
+        }
+
+        latency.record(latency_us);
+        return completed;
+    }
+
+    // Finalise the current step without waiting for the next one
+    bool flush(StepReport &finished)
+    {
+        if (!active || received == 0)
+        {
+            return false;
+        }
+
+        finish(lastSeq + 1, finished);
+        active = false;
+        return true;
+    }
+
+    // Packets of an already reported step that arrived after it was closed
+    uint32_t getLatePackets() const
+    {
+        return latePackets;
+    }
+
+private:
+    bool active;
+    uint32_t latePackets;
+
+    uint8_t stepId;
+    uint32_t firstSeq;
+    uint32_t lastSeq;
+    uint32_t received;
+    uint16_t payloadSize;
+    uint64_t payloadBytes;
+    int64_t firstRx_us;
+    int64_t lastRx_us;
+
+    // Coarser than the receiver's 10 s histogram: ~6% resolution, up to ~67 s
+    LatencyHistogram<5, 21> latency;
+
+    void reset(uint8_t id, uint32_t sequenceNumber, int64_t receiveTime_us)
+    {
+        stepId = id;
+        firstSeq = sequenceNumber;
+        lastSeq = sequenceNumber;
+        received = 0;
+        payloadSize = 0;
+        payloadBytes = 0;
+        firstRx_us = receiveTime_us;
+        lastRx_us = receiveTime_us;
+        latency.reset();
+    }
+
+    void finish(uint32_t nextStepFirstSeq, StepReport &report)
+    {
+        uint32_t expected = nextStepFirstSeq - firstSeq;
+
+        report.stepId = stepId;
+        report.received = received;
+        report.lost = expected > received ? expected - received : 0;
+        report.payloadSize = payloadSize;
+        report.payloadBytes = payloadBytes;
+        report.span_us = lastRx_us - firstRx_us;
+
+        report.latencyP50_us = latency.percentile(0.50);
+        report.latencyP90_us = latency.percentile(0.90);
+        report.latencyP99_us = latency.percentile(0.99);
+        report.latencyMax_us = latency.getMax();
+    }
+};
+
+#endif // STEP_STATS_H
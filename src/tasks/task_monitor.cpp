@@ -0,0 +1,46 @@
+#include "task_monitor.h"
+
+TaskMonitor::TaskMonitor() : entries(), count(0), lastTotalRunTime(0)
+{
+}
+
+bool TaskMonitor::add(TaskHandle_t task)
+{
+    if (!task || count >= MAX_TASKS)
+    {
+        return false;
+    }
+
+    entries[count].task = task;
+    entries[count].lastRunTime = 0;
+    count++;
+    return true;
+}
+
+void TaskMonitor::print(Print &out)
+{
+#if configGENERATE_RUN_TIME_STATS
+    // The counters wrap; differences stay right while prints are closer together than that
+    uint32_t totalRunTime = (uint32_t)portGET_RUN_TIME_COUNTER_VALUE();
+    uint32_t period = totalRunTime - lastTotalRunTime;
+    lastTotalRunTime = totalRunTime;
+#endif
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Entry &entry = entries[i];
+
+        // ESP-IDF stacks are sized in bytes, so the high-water mark is too
+        out.printf("Task %-10s priority %2u, ", pcTaskGetName(entry.task), (unsigned)uxTaskPriorityGet(entry.task));
+
+#if configGENERATE_RUN_TIME_STATS
+        uint32_t runTime = (uint32_t)ulTaskGetRunTimeCounter(entry.task);
+        out.printf("CPU %5.1f%%, ", period > 0 ? (runTime - entry.lastRunTime) * 100.0f / period : 0.0f);
+        entry.lastRunTime = runTime;
+#else
+        out.print("CPU n/a, ");
+#endif
+
+        out.printf("Stack %lu bytes free at least\n", (unsigned long)uxTaskGetStackHighWaterMark(entry.task));
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// CPU share and stack headroom of a fixed set of FreeRTOS tasks.
+//
+// CPU time comes from the FreeRTOS run-time counters, so it is only
+// reported when the build enables configGENERATE_RUN_TIME_STATS; the stack
+// high-water mark is always available. With one core, the shares of the
+// watched tasks and the idle task show what is left for everything else.
+class TaskMonitor
+{
+public:
+    static const size_t MAX_TASKS = 8;
+
+    TaskMonitor();
+
+    // Watch a task; false for nullptr or when MAX_TASKS are watched
+    bool add(TaskHandle_t task);
+
+    // One line per task: priority, CPU share since the last print and the
+    // least free stack it has had
+    void print(Print &out);
+
+private:
+    struct Entry
+    {
+        TaskHandle_t task;
+        uint32_t lastRunTime;
+    };
+
+    Entry entries[MAX_TASKS];
+    size_t count;
+    uint32_t lastTotalRunTime;
+};
+
+#endif // TASK_MONITOR_H
@@ -0,0 +1,112 @@
+#ifndef CLOCK_OFFSET_H
+#define CLOCK_OFFSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// NTP-style clock offset estimation from four-timestamp exchanges:
+//   t1 request sent (local clock)      t2 request received (remote clock)
+//   t3 reply sent (remote clock)       t4 reply received (local clock)
+// The round-trip delay (t4 - t1) - (t3 - t2) needs only the local clock and
+// excludes the remote turnaround. The offset ((t2 - t1) + (t3 - t4)) / 2 is
+// the remote clock minus the local clock, exact when both directions take
+// the same time and off by at most delay / 2 otherwise.
+//
+// Queueing only ever adds delay, so as in NTP's clock filter the estimate is
+// the offset of the lowest-delay sample among the last Window exchanges.
+template <size_t Window>
+class ClockOffsetEstimator
+{
+public:
+    struct Sample
+    {
+        int64_t offset_us;
+        int64_t delay_us;
+    };
+
+    ClockOffsetEstimator()
+    {
+        reset();
+    }
+
+    // Compute one exchange. Returns false if the timestamps are inconsistent
+    // (negative delay, e.g. a clock was stepped mid-exchange).
+    static bool compute(int64_t t1, int64_t t2, int64_t t3, int64_t t4, Sample &sample)
+    {
+        if (t1 == 0 || t2 == 0 || t3 == 0 || t4 == 0)
+        {
+            return false;
+        }
+
+        sample.delay_us = (t4 - t1) - (t3 - t2);
+        sample.offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+        return sample.delay_us >= 0;
+    }
+
+    void add(const Sample &sample)
+    {
+        samples[next] = sample;
+        next = (next + 1) % Window;
+        if (count < Window)
+        {
+            count++;
+        }
+        total++;
+
+        best = 0;
+        for (size_t i = 1; i < count; i++)
+        {
+            if (samples[i].delay_us < samples[best].delay_us)
+            {
+                best = i;
+            }
+        }
+    }
+
+    bool hasEstimate() const
+    {
+        return count > 0;
+    }
+
+    // Remote minus local clock, from the lowest-delay recent sample
+    int64_t getOffset_us() const
+    {
+        return count > 0 ? samples[best].offset_us : 0;
+    }
+
+    // Round-trip delay of the sample behind the estimate
+    int64_t getDelay_us() const
+    {
+        return count > 0 ? samples[best].delay_us : 0;
+    }
+
+    // Worst-case error of the estimate from path asymmetry
+    int64_t getError_us() const
+    {
+        return getDelay_us() / 2;
+    }
+
+    uint32_t getSampleCount() const
+    {
+        return total;
+    }
+
+    void reset()
+    {
+        next = 0;
+        count = 0;
+        best = 0;
+        total = 0;
+    }
+
+private:
+    static_assert(Window > 0, "Window must not be empty");
+
+    Sample samples[Window];
+    size_t next;
+    size_t count;
+    size_t best;
+    uint32_t total;
+};
+
+#endif // CLOCK_OFFSET_H
@@ -0,0 +1,17 @@
+#ifndef ESP_TIMER_CLOCK_H
+#define ESP_TIMER_CLOCK_H
+
+#include <esp_timer.h>
+#include "monotonic_clock.h"
+
+// Monotonic clock backed by the 64-bit esp_timer counter (microseconds since boot)
+class EspTimerClock : public MonotonicClock
+{
+public:
+    virtual int64_t nowMicros() const override
+    {
+        return esp_timer_get_time();
+    }
+};
+
+#endif // ESP_TIMER_CLOCK_H
@@ -0,0 +1,19 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <chrono>
+#include "monotonic_clock.h"
+
+// Monotonic clock backed by std::chrono::steady_clock, for host builds
+class HostClock : public MonotonicClock
+{
+public:
+    virtual int64_t nowMicros() const override
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+};
+
+#endif // HOST_CLOCK_H
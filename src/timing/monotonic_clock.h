@@ -0,0 +1,17 @@
+#ifndef MONOTONIC_CLOCK_H
+#define MONOTONIC_CLOCK_H
+
+#include <stdint.h>
+
+// Source of monotonic time in microseconds. The firmware uses
+// EspTimerClock; HostClock runs the same scheduling code on Linux.
+class MonotonicClock
+{
+public:
+    virtual ~MonotonicClock() {}
+
+    // Microseconds since an arbitrary, fixed origin
+    virtual int64_t nowMicros() const = 0;
+};
+
+#endif // MONOTONIC_CLOCK_H
@@ -0,0 +1,123 @@
+#ifndef PERIODIC_SCHEDULER_H
+#define PERIODIC_SCHEDULER_H
+
+#include <stdint.h>
+#include "monotonic_clock.h"
+
+// Drift-free periodic deadline generator.
+//
+// Deadline n is computed as epoch + n * 1e6 / rate in 64-bit integer
+// microseconds, so rates that do not divide a second (e.g. 30 Hz) do not
+// accumulate truncation error and late sends do not push later deadlines
+// back. If the caller falls more than MAX_CATCH_UP periods behind, the
+// intervening deadlines are skipped and counted instead of being sent in a
+// burst.
+//
+// Clock-agnostic: test/test_periodic_scheduler.cpp drives it from a stepped
+// clock, and tools/bench/schedulerbench paces it in real time on HostClock.
+class PeriodicScheduler
+{
+public:
+    static const uint32_t MAX_CATCH_UP = 4;
+
+    explicit PeriodicScheduler(const MonotonicClock *clock)
+        : clock(clock), rateHz(0), epoch_us(0), index(0), missedDeadlines(0)
+    {
+    }
+
+    // Start with the first deadline at the current time
+    void start(uint32_t rate)
+    {
+        rateHz = rate;
+        epoch_us = clock->nowMicros();
+        index = 0;
+    }
+
+    // Change the rate, keeping the next pending deadline as the new phase
+    void setRate(uint32_t rate)
+    {
+        if (rateHz == 0)
+        {
+            start(rate);
+            return;
+        }
+
+        epoch_us = deadlineAt(index);
+        index = 0;
+        rateHz = rate;
+    }
+
+    void stop()
+    {
+        rateHz = 0;
+    }
+
+    bool isRunning() const
+    {
+        return rateHz != 0;
+    }
+
+    uint32_t getRate() const
+    {
+        return rateHz;
+    }
+
+    // If the next deadline has passed, consume it and return its scheduled
+    // time. Returns false if nothing is due yet.
+    bool nextDue(int64_t &scheduled_us)
+    {
+        if (rateHz == 0)
+        {
+            return false;
+        }
+
+        int64_t now = clock->nowMicros();
+        if (now < deadlineAt(index))
+        {
+            return false;
+        }
+
+        // Index of the latest deadline at or before now
+        uint64_t latest = (uint64_t)(now - epoch_us) * rateHz / 1000000ULL;
+        if (latest > index + MAX_CATCH_UP)
+        {
+            missedDeadlines += (uint32_t)(latest - index);
+            index = latest;
+        }
+
+        scheduled_us = deadlineAt(index);
+        index++;
+        return true;
+    }
+
+    // Absolute monotonic time of the next pending deadline
+    int64_t getNextDeadline() const
+    {
+        return deadlineAt(index);
+    }
+
+    // Deadlines skipped because the caller fell too far behind
+    uint32_t getMissedDeadlines() const
+    {
+        return missedDeadlines;
+    }
+
+private:
+    const MonotonicClock *clock;
+    uint32_t rateHz;
+    int64_t epoch_us;
+    uint64_t index; // Deadlines consumed since epoch
+    uint32_t missedDeadlines;
+
+    int64_t deadlineAt(uint64_t n) const
+    {
+        if (rateHz == 0)
+        {
+            return epoch_us;
+        }
+
+        return epoch_us + (int64_t)(n * 1000000ULL / rateHz);
+    }
+};
+
+#endif // PERIODIC_SCHEDULER_H
@@ -0,0 +1,177 @@
+#include "pps_clock.h"
+#include <sys/time.h>
+#include <esp_timer.h>
+
+PpsClock::PpsClock()
+    : pin(-1),
+      servo(0.7, 0.3, PPS_STEP_THRESHOLD_US),
+      edgeLocal_us(0),
+      edgeCount(0),
+      processedEdges(0),
+      mappings{},
+      mappingIndex(0),
+      periodEdges(0),
+      periodMaxOffset_us(0),
+      periodSumSquares(0.0)
+{
+}
+
+PpsClock::~PpsClock()
+{
+    if (pin >= 0)
+    {
+        detachInterrupt(digitalPinToInterrupt(pin));
+    }
+}
+
+bool PpsClock::begin(int ppsPin)
+{
+    if (ppsPin < 0)
+    {
+        return true;
+    }
+
+    pin = ppsPin;
+    pinMode(pin, INPUT);
+    attachInterruptArg(digitalPinToInterrupt(pin), &PpsClock::onEdge, this, RISING);
+
+    Serial.printf("PPS input on GPIO %d\n", pin);
+    return true;
+}
+
+void IRAM_ATTR PpsClock::onEdge(void *arg)
+{
+    PpsClock *clock = static_cast<PpsClock *>(arg);
+    clock->edgeLocal_us = esp_timer_get_time();
+    clock->edgeCount.fetch_add(1, std::memory_order_release);
+}
+
+void PpsClock::update()
+{
+    if (pin < 0)
+    {
+        return;
+    }
+
+    // Read the latest edge; retry if another edge lands mid-read
+    uint32_t count;
+    int64_t local_us;
+    do
+    {
+        count = edgeCount.load(std::memory_order_acquire);
+        local_us = edgeLocal_us;
+    } while (count != edgeCount.load(std::memory_order_acquire));
+
+    if (count == processedEdges)
+    {
+        return;
+    }
+    processedEdges = count;
+
+    // The edge marks the UTC second nearest to the system clock's reading at the edge
+    struct timeval tv_now;
+    if (gettimeofday(&tv_now, NULL) != 0)
+    {
+        return;
+    }
+    int64_t system_us = (int64_t)tv_now.tv_sec * 1000000L + tv_now.tv_usec;
+    int64_t edgeSystem_us = system_us - (esp_timer_get_time() - local_us);
+    int64_t edgeUtc_us = (edgeSystem_us + 500000) / 1000000 * 1000000;
+
+    PpsServo::Result result = servo.update(local_us, edgeUtc_us);
+    if (result == PpsServo::REJECTED)
+    {
+        return;
+    }
+
+    if (result == PpsServo::ADJUSTED)
+    {
+        int64_t offset_us = servo.getLastOffset_us();
+        periodEdges++;
+        periodSumSquares += (double)offset_us * offset_us;
+        if (llabs(offset_us) > periodMaxOffset_us)
+        {
+            periodMaxOffset_us = llabs(offset_us);
+        }
+    }
+
+    publish();
+}
+
+bool PpsClock::now(int64_t &utc_us) const
+{
+    const Mapping &mapping = mappings[mappingIndex.load()];
+    int64_t local_us = esp_timer_get_time();
+
+    // Exclusive, so a mapping never published (valid until 0) is refused at time 0 too
+    if (local_us >= mapping.validUntilLocal_us)
+    {
+        return false;
+    }
+
+    utc_us = mapping.anchorUtc_us + (int64_t)llround((double)(local_us - mapping.anchorLocal_us) * mapping.rate);
+    return true;
+}
+
+void PpsClock::publish()
+{
+    Mapping &mapping = mappings[mappingIndex.load() ^ 1];
+
+    mapping.anchorLocal_us = servo.getAnchorLocal_us();
+    mapping.anchorUtc_us = servo.getAnchorUtc_us();
+    mapping.rate = servo.getRate();
+
+    // Only a locked servo is good enough for timestamps
+    mapping.validUntilLocal_us = servo.getState() == PpsServo::LOCKED
+                                     ? mapping.anchorLocal_us + (int64_t)PPS_HOLDOVER_MS * 1000
+                                     : 0;
+
+    mappingIndex.store(mappingIndex.load() ^ 1);
+}
+
+PpsClock::Status PpsClock::takeStatus()
+{
+    Status status = {};
+    status.enabled = pin >= 0;
+    if (!status.enabled)
+    {
+        return status;
+    }
+
+    int64_t utc_us;
+    status.state = "Unlocked";
+    if (servo.getState() == PpsServo::ACQUIRING)
+    {
+        status.state = "Acquiring";
+    }
+    else if (servo.getState() == PpsServo::LOCKED)
+    {
+        status.state = now(utc_us) ? "Locked" : "Holdover expired";
+    }
+
+    status.offset_us = servo.getLastOffset_us();
+    status.maxOffset_us = periodMaxOffset_us;
+    status.rmsOffset_us = periodEdges > 0 ? sqrt(periodSumSquares / periodEdges) : 0.0;
+    status.oscillatorError_ppm = servo.getOscillatorError_ppm();
+    status.edges = servo.getEdges();
+    status.rejected = servo.getRejected();
+    status.steps = servo.getSteps();
+
+    periodEdges = 0;
+    periodMaxOffset_us = 0;
+    periodSumSquares = 0.0;
+    return status;
+}
+
+void PpsClock::printStatus(const Status &status, Print &out)
+{
+    if (!status.enabled)
+    {
+        return;
+    }
+
+    out.printf("PPS clock: %s, Offset %lld us (max %lld us, rms %.1f us), Oscillator error %+.3f ppm, "
+               "Edges %lu, Rejected %lu, Steps %lu\n",
+               status.state, status.offset_us, status.maxOffset_us, status.rmsOffset_us,
+               status.oscillatorError_ppm, status.edges, status.rejected, status.steps);
+}
@@ -0,0 +1,97 @@
+#ifndef PPS_CLOCK_H
+#define PPS_CLOCK_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "pps_servo.h"
+
+// Wall clock disciplined to the GPS PPS output.
+//
+// A GPIO interrupt timestamps each rising PPS edge with esp_timer. The role
+// task labels the edge with the UTC second it marks and runs the PpsServo.
+// The system clock only has to be right to within half a second for the
+// label, which the GPS time sync guarantees. The resulting clock mapping is
+// double-buffered so the send timer and the radio callbacks can read the
+// time from their own tasks.
+class PpsClock
+{
+public:
+    // Servo state and the period's offset statistics, taken by takeStatus()
+    struct Status
+    {
+        bool enabled;
+        const char *state;
+        int64_t offset_us;
+        int64_t maxOffset_us;
+        double rmsOffset_us;
+        double oscillatorError_ppm;
+        uint32_t edges;
+        uint32_t rejected;
+        uint32_t steps;
+    };
+
+    PpsClock();
+    ~PpsClock();
+
+    // Attach the PPS interrupt. A negative pin leaves the clock disabled.
+    bool begin(int pin);
+
+    // Feed new PPS edges to the servo; call from the role task
+    void update();
+
+    // Disciplined UTC time in microseconds since the Unix epoch. Returns
+    // false while unlocked or once PPS has been missing for PPS_HOLDOVER_MS.
+    // Safe to call from any task.
+    bool now(int64_t &utc_us) const;
+
+    bool isEnabled() const
+    {
+        return pin >= 0;
+    }
+
+    const PpsServo &getServo() const
+    {
+        return servo;
+    }
+
+    // Copy the servo state and the period's offset statistics, and reset
+    // the statistics. Call from the role task, or with it locked out.
+    Status takeStatus();
+
+    // Print a status from takeStatus(), from any task; nothing while the
+    // clock is disabled
+    static void printStatus(const Status &status, Print &out);
+
+private:
+    // Local-to-UTC mapping published for readers
+    struct Mapping
+    {
+        int64_t anchorLocal_us;
+        int64_t anchorUtc_us;
+        double rate;
+        int64_t validUntilLocal_us;
+    };
+
+    int pin;
+    PpsServo servo;
+
+    // Written by the interrupt: timestamp of the latest edge, then the count
+    volatile int64_t edgeLocal_us;
+    std::atomic<uint32_t> edgeCount;
+    uint32_t processedEdges;
+
+    Mapping mappings[2];
+    std::atomic<uint8_t> mappingIndex;
+
+    // Offset statistics for the reporting period
+    uint32_t periodEdges;
+    int64_t periodMaxOffset_us;
+    double periodSumSquares;
+
+    static void IRAM_ATTR onEdge(void *arg);
+
+    void publish();
+};
+
+#endif // PPS_CLOCK_H
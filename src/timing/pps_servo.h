@@ -0,0 +1,229 @@
+#ifndef PPS_SERVO_H
+#define PPS_SERVO_H
+
+#include <stdint.h>
+#include <math.h>
+
+// PI servo that disciplines a software clock to GPS PPS edges.
+//
+// The clock maps a local monotonic counter (esp_timer) to UTC as
+//   utc = anchorUtc + (local - anchorLocal) * (1 + frequency)
+// Each PPS edge gives a local timestamp and the UTC second it marks. The
+// first edge sets the phase and the second measures the oscillator's
+// frequency error. After that, a PI controller steers the frequency so the
+// offset at the next edge goes to zero. The clock re-anchors at every edge
+// where it currently reads, so it never jumps.
+//
+// An edge whose offset exceeds the step threshold is rejected as a glitch.
+// If STEP_AFTER_OUTLIERS edges in a row are rejected, the clock has really
+// moved and is stepped instead.
+//
+// No Arduino dependencies: test/test_pps_servo.cpp runs it against a
+// simulated oscillator with drift and interrupt jitter, and rangesim feeds
+// it PPS edges with PPS_PIN set.
+class PpsServo
+{
+public:
+    enum State
+    {
+        UNLOCKED,  // No edge yet
+        ACQUIRING, // Phase set, waiting for a second edge to measure frequency
+        LOCKED     // PI control
+    };
+
+    enum Result
+    {
+        REJECTED, // Edge ignored
+        STEPPED,  // Phase set directly from the edge
+        ADJUSTED  // Frequency steered by the PI controller
+    };
+
+    static const uint32_t STEP_AFTER_OUTLIERS = 3;
+
+    // kp/ki act on the offset as a fraction of the edge interval. The
+    // defaults settle in a few seconds and suit 1 Hz PPS with µs-level
+    // timestamp jitter.
+    explicit PpsServo(double kp = 0.7, double ki = 0.3, int64_t stepThreshold_us = 1000, double maxFrequency_ppm = 500.0)
+        : kp(kp), ki(ki), stepThreshold_us(stepThreshold_us), maxFrequency(maxFrequency_ppm * 1e-6)
+    {
+        reset();
+    }
+
+    // Feed one edge: its local timestamp and the UTC time it marks
+    Result update(int64_t edgeLocal_us, int64_t edgeUtc_us)
+    {
+        edges++;
+
+        if (state == UNLOCKED)
+        {
+            step(edgeLocal_us, edgeUtc_us);
+            state = ACQUIRING;
+            return STEPPED;
+        }
+
+        int64_t localInterval_us = edgeLocal_us - anchorLocal_us;
+        int64_t utcInterval_us = edgeUtc_us - lastEdgeUtc_us;
+        if (localInterval_us <= 0 || utcInterval_us <= 0)
+        {
+            rejected++;
+            return REJECTED;
+        }
+
+        if (state == ACQUIRING)
+        {
+            // Oscillator error from two edges; restart from this edge if implausible
+            double measured = (double)utcInterval_us / (double)localInterval_us - 1.0;
+            if (fabs(measured) > maxFrequency)
+            {
+                rejected++;
+                step(edgeLocal_us, edgeUtc_us);
+                return REJECTED;
+            }
+
+            frequency = measured;
+            integral = measured;
+            step(edgeLocal_us, edgeUtc_us);
+            state = LOCKED;
+            return STEPPED;
+        }
+
+        int64_t offset_us = toUtc(edgeLocal_us) - edgeUtc_us;
+
+        if (llabs(offset_us) > stepThreshold_us)
+        {
+            rejected++;
+            if (++outliers < STEP_AFTER_OUTLIERS)
+            {
+                return REJECTED;
+            }
+
+            steps++;
+            lastOffset_us = offset_us;
+            step(edgeLocal_us, edgeUtc_us);
+            return STEPPED;
+        }
+
+        outliers = 0;
+        lastOffset_us = offset_us;
+
+        double error = (double)offset_us / (double)utcInterval_us;
+        integral -= ki * error;
+        integral = clamp(integral);
+        frequency = clamp(integral - kp * error);
+
+        // Continue from the current reading; the new frequency removes the offset
+        anchorUtc_us = edgeUtc_us + offset_us;
+        anchorLocal_us = edgeLocal_us;
+        lastEdgeUtc_us = edgeUtc_us;
+        return ADJUSTED;
+    }
+
+    // Disciplined time at a local timestamp (meaningless while UNLOCKED)
+    int64_t toUtc(int64_t local_us) const
+    {
+        return anchorUtc_us + (int64_t)llround((double)(local_us - anchorLocal_us) * (1.0 + frequency));
+    }
+
+    State getState() const
+    {
+        return state;
+    }
+
+    // Clock minus PPS at the last accepted edge
+    int64_t getLastOffset_us() const
+    {
+        return lastOffset_us;
+    }
+
+    // Rate correction currently applied, including the proportional term
+    double getFrequency_ppm() const
+    {
+        return frequency * 1e6;
+    }
+
+    // Oscillator frequency error estimated by the integral term, positive
+    // when the local oscillator runs fast
+    double getOscillatorError_ppm() const
+    {
+        return -integral * 1e6;
+    }
+
+    int64_t getAnchorLocal_us() const
+    {
+        return anchorLocal_us;
+    }
+
+    int64_t getAnchorUtc_us() const
+    {
+        return anchorUtc_us;
+    }
+
+    double getRate() const
+    {
+        return 1.0 + frequency;
+    }
+
+    uint32_t getEdges() const
+    {
+        return edges;
+    }
+
+    uint32_t getRejected() const
+    {
+        return rejected;
+    }
+
+    uint32_t getSteps() const
+    {
+        return steps;
+    }
+
+    void reset()
+    {
+        state = UNLOCKED;
+        anchorLocal_us = 0;
+        anchorUtc_us = 0;
+        lastEdgeUtc_us = 0;
+        frequency = 0.0;
+        integral = 0.0;
+        lastOffset_us = 0;
+        outliers = 0;
+        edges = 0;
+        rejected = 0;
+        steps = 0;
+    }
+
+private:
+    double kp;
+    double ki;
+    int64_t stepThreshold_us;
+    double maxFrequency;
+
+    State state;
+    int64_t anchorLocal_us;
+    int64_t anchorUtc_us;
+    int64_t lastEdgeUtc_us;
+    double frequency;
+    double integral;
+    int64_t lastOffset_us;
+    uint32_t outliers;
+
+    uint32_t edges;
+    uint32_t rejected;
+    uint32_t steps;
+
+    void step(int64_t edgeLocal_us, int64_t edgeUtc_us)
+    {
+        anchorLocal_us = edgeLocal_us;
+        anchorUtc_us = edgeUtc_us;
+        lastEdgeUtc_us = edgeUtc_us;
+        outliers = 0;
+    }
+
+    double clamp(double value) const
+    {
+        return value > maxFrequency ? maxFrequency : (value < -maxFrequency ? -maxFrequency : value);
+    }
+};
+
+#endif // PPS_SERVO_H
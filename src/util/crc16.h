@@ -0,0 +1,81 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), nibble-table variant so it
+// stays cheap on the receiver without a 512-byte table. Host tools that scan
+// large captures define CRC16_LARGE_TABLES for a slice-by-4 variant, four
+// bytes per step from 2 KB of tables.
+#ifdef CRC16_LARGE_TABLES
+struct Crc16Tables
+{
+    // entries[k][i]: byte i followed by k zero bytes
+    uint16_t entries[4][256];
+
+    Crc16Tables()
+    {
+        for (unsigned i = 0; i < 256; i++)
+        {
+            uint16_t crc = (uint16_t)(i << 8);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+            }
+            entries[0][i] = crc;
+        }
+
+        for (unsigned k = 1; k < 4; k++)
+        {
+            for (unsigned i = 0; i < 256; i++)
+            {
+                uint16_t previous = entries[k - 1][i];
+                entries[k][i] = (uint16_t)((previous << 8) ^ entries[0][previous >> 8]);
+            }
+        }
+    }
+};
+
+inline uint16_t crc16Update(uint16_t crc, const uint8_t *data, size_t length)
+{
+    static const Crc16Tables tables;
+    const uint16_t(*t)[256] = tables.entries;
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        crc = (uint16_t)(t[3][(crc >> 8) ^ data[i]] ^ t[2][(crc & 0xFF) ^ data[i + 1]] ^ t[1][data[i + 2]] ^
+                         t[0][data[i + 3]]);
+    }
+
+    for (; i < length; i++)
+    {
+        crc = (uint16_t)((crc << 8) ^ t[0][(crc >> 8) ^ data[i]]);
+    }
+
+    return crc;
+}
+#else
+inline uint16_t crc16Update(uint16_t crc, const uint8_t *data, size_t length)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (uint16_t)((crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)]);
+    }
+
+    return crc;
+}
+#endif
+
+inline uint16_t crc16(const uint8_t *data, size_t length)
+{
+    return crc16Update(0xFFFF, data, length);
+}
+
+#endif // CRC16_H
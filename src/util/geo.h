@@ -0,0 +1,55 @@
+#ifndef GEO_H
+#define GEO_H
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Great-circle distance in metres between two points given in degrees,
+// using the Haversine formula
+inline double haversineDistance(double lat1, double lon1, double lat2, double lon2)
+{
+    const double earthRadiusKm = 6371.0;
+
+    // Convert degrees to radians
+    lat1 = lat1 * M_PI / 180.0;
+    lon1 = lon1 * M_PI / 180.0;
+    lat2 = lat2 * M_PI / 180.0;
+    lon2 = lon2 * M_PI / 180.0;
+
+    // Differences
+    double dLat = lat2 - lat1;
+    double dLon = lon2 - lon1;
+
+    // Haversine formula
+    double a = sin(dLat / 2) * sin(dLat / 2) +
+               cos(lat1) * cos(lat2) *
+                   sin(dLon / 2) * sin(dLon / 2);
+    double c = 2 * atan2(sqrt(a), sqrt(1 - a));
+    double distance = earthRadiusKm * c;
+
+    // Convert to meters
+    return distance * 1000.0;
+}
+
+// Point reached by travelling distance metres from (lat, lon) along the
+// initial bearing (degrees clockwise from north), on a spherical Earth
+inline void destinationPoint(double lat, double lon, double bearing, double distance, double &latOut, double &lonOut)
+{
+    const double earthRadiusM = 6371000.0;
+
+    double phi1 = lat * M_PI / 180.0;
+    double lambda1 = lon * M_PI / 180.0;
+    double theta = bearing * M_PI / 180.0;
+    double delta = distance / earthRadiusM;
+
+    double phi2 = asin(sin(phi1) * cos(delta) + cos(phi1) * sin(delta) * cos(theta));
+    double lambda2 = lambda1 + atan2(sin(theta) * sin(delta) * cos(phi1), cos(delta) - sin(phi1) * sin(phi2));
+
+    latOut = phi2 * 180.0 / M_PI;
+    lonOut = lambda2 * 180.0 / M_PI;
+}
+
+#endif // GEO_H
@@ -0,0 +1,140 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer ring buffer with fixed capacity.
+//
+// The producer (e.g. a Wi-Fi driver callback) only calls acquire()/commit() or
+// tryPush(); the consumer only calls front()/release() or tryPop(). Items are
+// written and read in place, so no allocation or extra copy happens on either
+// side. Capacity must be a power of two.
+//
+// No Arduino dependencies; test/test_spsc_ring.cpp covers it on the host,
+// and test/test_spsc_ring_threads.cpp between two threads.
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0), overflows(0), highWater(0) {}
+
+    // Producer: reserve the next free slot, or nullptr if the ring is full.
+    // A full ring counts as an overflow.
+    T *acquire()
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);
+
+        if (h - t >= Capacity)
+        {
+            overflows.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        return &slots[h & (Capacity - 1)];
+    }
+
+    // Producer: publish the slot returned by the last acquire()
+    void commit()
+    {
+        uint32_t h = head.load(std::memory_order_relaxed) + 1;
+        head.store(h, std::memory_order_release);
+
+        uint32_t depth = h - tail.load(std::memory_order_relaxed);
+        if (depth > highWater.load(std::memory_order_relaxed))
+        {
+            highWater.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    // Producer: copy an item into the ring
+    bool tryPush(const T &item)
+    {
+        T *slot = acquire();
+        if (!slot)
+        {
+            return false;
+        }
+
+        *slot = item;
+        commit();
+        return true;
+    }
+
+    // Consumer: oldest published item, or nullptr if the ring is empty
+    const T *front() const
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        return &slots[t & (Capacity - 1)];
+    }
+
+    // Consumer: free the slot returned by front()
+    void release()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: copy the oldest item out of the ring
+    bool tryPop(T &out)
+    {
+        const T *item = front();
+        if (!item)
+        {
+            return false;
+        }
+
+        out = *item;
+        release();
+        return true;
+    }
+
+    // Number of items currently queued (approximate when read concurrently)
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+    // Number of items rejected because the ring was full
+    uint32_t overflowCount() const
+    {
+        return overflows.load(std::memory_order_relaxed);
+    }
+
+    // Deepest queue depth observed since construction
+    uint32_t highWaterMark() const
+    {
+        return highWater.load(std::memory_order_relaxed);
+    }
+
+private:
+    T slots[Capacity];
+
+    // Free-running indices; only the low bits select a slot
+    std::atomic<uint32_t> head; // Written by the producer
+    std::atomic<uint32_t> tail; // Written by the consumer
+
+    std::atomic<uint32_t> overflows; // Written by the producer
+    std::atomic<uint32_t> highWater; // Written by the producer
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,290 @@
+// Host tests for LatencyHistogram: percentiles against a sort-based
+// reference, bucket layout, negatives, overflow, merge and saturation.
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "test_support.h"
+#include "stats/latency_histogram.h"
+
+// Deterministic generator so failures reproduce
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t nextRandom()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (uint32_t)(rngState >> 32);
+}
+
+static double uniform()
+{
+    return (nextRandom() + 0.5) / 4294967296.0;
+}
+
+// Nearest-rank percentile with the histogram's rounding of the rank
+static int64_t referencePercentile(const std::vector<int64_t> &sorted, double fraction)
+{
+    uint64_t rank = (uint64_t)(fraction * sorted.size() + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    if (rank > sorted.size())
+    {
+        rank = sorted.size();
+    }
+    return sorted[rank - 1];
+}
+
+// Every percentile is the top of the reference value's bucket: never below
+// it, and above it by less than one bucket width
+template <typename Histogram>
+static void checkAgainstReference(const Histogram &histogram, std::vector<int64_t> values)
+{
+    static const double FRACTIONS[] = {0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 1.0};
+
+    std::sort(values.begin(), values.end());
+    CHECK_EQ(histogram.getCount(), values.size());
+    CHECK_EQ(histogram.getMin(), values.front());
+    CHECK_EQ(histogram.getMax(), values.back());
+
+    for (double fraction : FRACTIONS)
+    {
+        int64_t expected = referencePercentile(values, fraction);
+        int64_t actual = histogram.percentile(fraction);
+        int64_t bound = expected < (int64_t)Histogram::SUB_BUCKETS ? 0 : expected / Histogram::HALF_BUCKETS;
+
+        CHECK(actual >= expected);
+        CHECK(actual - expected <= bound);
+        if (actual < expected || actual - expected > bound)
+        {
+            std::printf("  p%g: %lld, reference %lld\n", fraction * 100, (long long)actual, (long long)expected);
+        }
+    }
+}
+
+template <typename Histogram>
+static void checkDistribution(double (*generate)())
+{
+    Histogram histogram;
+    std::vector<int64_t> values;
+
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        int64_t value = (int64_t)generate();
+        histogram.record(value);
+        values.push_back(value);
+    }
+
+    checkAgainstReference(histogram, values);
+}
+
+static double uniformLatency()
+{
+    return 500 + uniform() * 20000;
+}
+
+// Log-normal around 2 ms with a long tail, as over a congested link
+static double logNormalLatency()
+{
+    double u1 = uniform();
+    double u2 = uniform();
+    double normal = std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+    return 2000 * std::exp(normal * 1.2);
+}
+
+static double smallValues()
+{
+    return nextRandom() % 100;
+}
+
+static void testPercentilesAgainstSort()
+{
+    checkDistribution<ReceiverLatencyHistogram>(uniformLatency);
+    checkDistribution<ReceiverLatencyHistogram>(logNormalLatency);
+    checkDistribution<ReceiverLatencyHistogram>(smallValues);
+    checkDistribution<PeerLatencyHistogram>(uniformLatency);
+    checkDistribution<PeerLatencyHistogram>(logNormalLatency);
+    checkDistribution<LatencyHistogram<3, 17>>(logNormalLatency);
+}
+
+static void testFewSamples()
+{
+    ReceiverLatencyHistogram histogram;
+    CHECK_EQ(histogram.percentile(0.5), 0);
+    CHECK_EQ(histogram.getCount(), 0);
+
+    std::vector<int64_t> values = {12345};
+    histogram.record(12345);
+    checkAgainstReference(histogram, values);
+
+    // The top of a bucket is capped at the observed maximum
+    CHECK_EQ(histogram.percentile(1.0), 12345);
+
+    values.push_back(7);
+    values.push_back(999);
+    histogram.record(7);
+    histogram.record(999);
+    checkAgainstReference(histogram, values);
+}
+
+static void testBucketLayout()
+{
+    typedef LatencyHistogram<4, 20> Histogram;
+
+    // Exact below SUB_BUCKETS
+    for (uint64_t value = 0; value < Histogram::SUB_BUCKETS; value++)
+    {
+        CHECK_EQ(Histogram::bucketIndex(value), value);
+        CHECK_EQ(Histogram::bucketLowest(value), value);
+        CHECK_EQ(Histogram::bucketHighest(value), value);
+    }
+
+    // Buckets tile the range without gaps, and each value maps into its own
+    for (size_t index = 0; index + 1 < Histogram::BUCKET_COUNT; index++)
+    {
+        uint64_t lowest = Histogram::bucketLowest(index);
+        uint64_t highest = Histogram::bucketHighest(index);
+        CHECK_EQ(Histogram::bucketLowest(index + 1), highest + 1);
+        CHECK_EQ(Histogram::bucketIndex(lowest), index);
+        CHECK_EQ(Histogram::bucketIndex(highest), index);
+    }
+}
+
+static void testNegativeValues()
+{
+    ReceiverLatencyHistogram histogram;
+
+    histogram.record(-500);
+    histogram.record(-20);
+    histogram.record(1000);
+
+    CHECK_EQ(histogram.getNegativeCount(), 2);
+    CHECK_EQ(histogram.getMin(), -500);
+    CHECK_EQ(histogram.getMax(), 1000);
+    CHECK_NEAR(histogram.getMean(), 480 / 3.0, 1e-9);
+
+    // Negatives share the first bucket and read back as 0
+    CHECK_EQ(histogram.percentile(0.5), 0);
+    CHECK(histogram.percentile(1.0) >= 1000);
+}
+
+static void testOverflow()
+{
+    typedef LatencyHistogram<4, 4> Histogram;
+    Histogram histogram;
+
+    // The top bucket ends just below 2^(4 + 4)
+    histogram.record(100);
+    histogram.record(1000000);
+    histogram.record(5000000);
+
+    CHECK_EQ(histogram.getOverflowCount(), 2);
+    CHECK_EQ(histogram.getCount(), 3);
+    CHECK_EQ(histogram.getMax(), 5000000);
+
+    // Percentiles in the last bucket read back as the top of the range
+    CHECK_EQ(histogram.percentile(1.0), Histogram::bucketHighest(Histogram::BUCKET_COUNT - 1));
+}
+
+static void testMerge()
+{
+    ReceiverLatencyHistogram first;
+    ReceiverLatencyHistogram second;
+    ReceiverLatencyHistogram both;
+    std::vector<int64_t> values;
+
+    for (uint32_t i = 0; i < 20000; i++)
+    {
+        int64_t value = (int64_t)logNormalLatency();
+        (i % 3 == 0 ? first : second).record(value);
+        both.record(value);
+        values.push_back(value);
+    }
+
+    first.merge(second);
+    checkAgainstReference(first, values);
+    for (size_t i = 0; i < ReceiverLatencyHistogram::BUCKET_COUNT; i++)
+    {
+        CHECK_EQ(first.bucketCount(i), both.bucketCount(i));
+    }
+    CHECK_NEAR(first.getMean(), both.getMean(), 1e-6);
+}
+
+static void testSaturation()
+{
+    LatencyHistogram<4, 8, uint8_t> histogram;
+
+    // 300 samples in one 8-bit bucket: it stops at 255 instead of wrapping
+    for (uint32_t i = 0; i < 300; i++)
+    {
+        histogram.record(5);
+    }
+    histogram.record(200);
+
+    CHECK_EQ(histogram.bucketCount(5), 255);
+    CHECK_EQ(histogram.getSaturatedCount(), 45);
+    CHECK_EQ(histogram.getCount(), 301);
+    CHECK_EQ(histogram.percentile(0.5), 5);
+    CHECK(histogram.percentile(1.0) >= 200);
+
+    // Merging two full buckets saturates too
+    LatencyHistogram<4, 8, uint8_t> other;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        other.record(5);
+    }
+    histogram.merge(other);
+    CHECK_EQ(histogram.bucketCount(5), 255);
+    CHECK_EQ(histogram.getSaturatedCount(), 145);
+}
+
+static void testPeerHistogramLongPeriod()
+{
+    PeerLatencyHistogram histogram;
+
+    // 10 s at 10 kHz, all in one bucket, would wrap 16-bit counts
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        histogram.record(1500);
+    }
+    histogram.record(90000);
+
+    CHECK_EQ(histogram.getSaturatedCount(), 0);
+    CHECK_EQ(histogram.bucketCount(PeerLatencyHistogram::bucketIndex(1500)), 100000);
+    CHECK(histogram.percentile(0.99) <= 1500 + 1500 / PeerLatencyHistogram::HALF_BUCKETS);
+}
+
+static void testJitter()
+{
+    InterarrivalJitter jitter;
+
+    // Constant transit time: no jitter
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        jitter.update(2000);
+    }
+    CHECK_NEAR(jitter.getJitter_us(), 0, 1e-9);
+
+    // Alternating by 160 us converges on 160 us
+    for (uint32_t i = 0; i < 2000; i++)
+    {
+        jitter.update(i % 2 ? 2160 : 2000);
+    }
+    CHECK_NEAR(jitter.getJitter_us(), 160, 1);
+}
+
+int main()
+{
+    RUN_TEST(testPercentilesAgainstSort);
+    RUN_TEST(testFewSamples);
+    RUN_TEST(testBucketLayout);
+    RUN_TEST(testNegativeValues);
+    RUN_TEST(testOverflow);
+    RUN_TEST(testMerge);
+    RUN_TEST(testSaturation);
+    RUN_TEST(testPeerHistogramLongPeriod);
+    RUN_TEST(testJitter);
+    return testResult();
+}
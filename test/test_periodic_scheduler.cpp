@@ -0,0 +1,193 @@
+// Host tests for PeriodicScheduler: deadline arithmetic, the MAX_CATCH_UP
+// skip, rate changes and drift over long runs, on a clock the test steps.
+#include "test_support.h"
+#include "timing/periodic_scheduler.h"
+
+class FakeClock : public MonotonicClock
+{
+public:
+    int64_t now_us = 1000000;
+
+    virtual int64_t nowMicros() const override
+    {
+        return now_us;
+    }
+};
+
+static void testNotRunning()
+{
+    FakeClock clock;
+    PeriodicScheduler scheduler(&clock);
+    int64_t scheduled_us = 0;
+
+    CHECK(!scheduler.isRunning());
+    CHECK(!scheduler.nextDue(scheduled_us));
+
+    scheduler.start(10);
+    CHECK(scheduler.isRunning());
+    scheduler.stop();
+    CHECK(!scheduler.nextDue(scheduled_us));
+}
+
+static void testFirstDeadlineImmediate()
+{
+    FakeClock clock;
+    PeriodicScheduler scheduler(&clock);
+    int64_t scheduled_us = 0;
+
+    scheduler.start(10);
+    CHECK(scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduled_us, 1000000);
+    CHECK(!scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduler.getNextDeadline(), 1100000);
+
+    clock.now_us = 1099999;
+    CHECK(!scheduler.nextDue(scheduled_us));
+    clock.now_us = 1100000;
+    CHECK(scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduled_us, 1100000);
+}
+
+static void testRateNotDividingSecond()
+{
+    FakeClock clock;
+    PeriodicScheduler scheduler(&clock);
+    int64_t scheduled_us = 0;
+
+    // 30 Hz: 33333.3 us periods, truncated per deadline but never summed
+    scheduler.start(30);
+    for (uint32_t n = 0; n <= 30; n++)
+    {
+        clock.now_us = scheduler.getNextDeadline();
+        CHECK(scheduler.nextDue(scheduled_us));
+        CHECK_EQ(scheduled_us, 1000000 + (int64_t)n * 1000000 / 30);
+    }
+    CHECK_EQ(scheduled_us, 2000000);
+}
+
+static void testLateSendKeepsPhase()
+{
+    FakeClock clock;
+    PeriodicScheduler scheduler(&clock);
+    int64_t scheduled_us = 0;
+
+    scheduler.start(100);
+    CHECK(scheduler.nextDue(scheduled_us));
+
+    // Served 7 ms late, the next deadline is not pushed back
+    clock.now_us = 1017000;
+    CHECK(scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduled_us, 1010000);
+    CHECK_EQ(scheduler.getNextDeadline(), 1020000);
+    CHECK(!scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduler.getMissedDeadlines(), 0);
+}
+
+static void testCatchUpWithinLimit()
+{
+    FakeClock clock;
+    PeriodicScheduler scheduler(&clock);
+    int64_t scheduled_us = 0;
+
+    scheduler.start(100);
+    CHECK(scheduler.nextDue(scheduled_us));
+
+    // MAX_CATCH_UP periods behind: every deadline is still served, in order
+    clock.now_us = 1000000 + (1 + PeriodicScheduler::MAX_CATCH_UP) * 10000;
+    uint32_t served = 0;
+    while (scheduler.nextDue(scheduled_us))
+    {
+        served++;
+        CHECK_EQ(scheduled_us, 1000000 + (int64_t)served * 10000);
+    }
+    CHECK_EQ(served, PeriodicScheduler::MAX_CATCH_UP + 1);
+    CHECK_EQ(scheduler.getMissedDeadlines(), 0);
+}
+
+static void testCatchUpSkipsBeyondLimit()
+{
+    FakeClock clock;
+    PeriodicScheduler scheduler(&clock);
+    int64_t scheduled_us = 0;
+
+    scheduler.start(100);
+    CHECK(scheduler.nextDue(scheduled_us));
+
+    // 20 periods and a bit behind: jump to the latest deadline, count the rest
+    clock.now_us = 1000000 + 20 * 10000 + 500;
+    CHECK(scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduled_us, 1200000);
+    CHECK_EQ(scheduler.getMissedDeadlines(), 19);
+    CHECK(!scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduler.getNextDeadline(), 1210000);
+}
+
+static void testSetRateKeepsPendingDeadline()
+{
+    FakeClock clock;
+    PeriodicScheduler scheduler(&clock);
+    int64_t scheduled_us = 0;
+
+    scheduler.start(10);
+    CHECK(scheduler.nextDue(scheduled_us));
+    clock.now_us = 1050000;
+
+    // The pending deadline at 1.1 s becomes the new phase
+    scheduler.setRate(1000);
+    CHECK_EQ(scheduler.getRate(), 1000);
+    CHECK_EQ(scheduler.getNextDeadline(), 1100000);
+    CHECK(!scheduler.nextDue(scheduled_us));
+
+    clock.now_us = 1100000;
+    CHECK(scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduled_us, 1100000);
+    CHECK_EQ(scheduler.getNextDeadline(), 1101000);
+
+    // Setting a rate on a stopped scheduler starts it now
+    scheduler.stop();
+    clock.now_us = 5000000;
+    scheduler.setRate(50);
+    CHECK(scheduler.nextDue(scheduled_us));
+    CHECK_EQ(scheduled_us, 5000000);
+}
+
+static void testNoDriftOverLongRun()
+{
+    FakeClock clock;
+    PeriodicScheduler scheduler(&clock);
+    int64_t scheduled_us = 0;
+
+    // A day at 30 Hz, each deadline served 0-3 ms late
+    const uint32_t rate = 30;
+    const uint64_t deadlines = 24ULL * 3600 * rate;
+    scheduler.start(rate);
+    uint32_t lcg = 12345;
+    for (uint64_t n = 0; n < deadlines; n++)
+    {
+        lcg = lcg * 1103515245 + 12345;
+        clock.now_us = scheduler.getNextDeadline() + (lcg >> 16) % 3000;
+        if (!scheduler.nextDue(scheduled_us))
+        {
+            CHECK(false);
+            break;
+        }
+    }
+
+    // The next deadline falls exactly a day after the first
+    CHECK_EQ(scheduler.getNextDeadline(), 1000000 + 86400LL * 1000000);
+    CHECK_EQ(scheduled_us, 1000000 + (int64_t)((deadlines - 1) * 1000000 / rate));
+    CHECK_EQ(scheduler.getMissedDeadlines(), 0);
+}
+
+int main()
+{
+    RUN_TEST(testNotRunning);
+    RUN_TEST(testFirstDeadlineImmediate);
+    RUN_TEST(testRateNotDividingSecond);
+    RUN_TEST(testLateSendKeepsPhase);
+    RUN_TEST(testCatchUpWithinLimit);
+    RUN_TEST(testCatchUpSkipsBeyondLimit);
+    RUN_TEST(testSetRateKeepsPendingDeadline);
+    RUN_TEST(testNoDriftOverLongRun);
+    return testResult();
+}
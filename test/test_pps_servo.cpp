@@ -0,0 +1,238 @@
+// Host tests for PpsServo against a simulated oscillator: convergence under
+// frequency error and interrupt jitter, glitch rejection and the step after
+// STEP_AFTER_OUTLIERS outliers.
+#include <math.h>
+#include "test_support.h"
+#include "timing/pps_servo.h"
+
+// Local counter running drift_ppm fast, and PPS edges timestamped up to
+// jitter_us late by interrupt latency
+class SimulatedOscillator
+{
+public:
+    SimulatedOscillator(double drift_ppm, uint32_t jitter_us)
+        : drift(drift_ppm * 1e-6), jitter_us(jitter_us), origin_us(123456789), lcg(2463534242u)
+    {
+    }
+
+    // Local reading at a true time
+    int64_t local(double utc_s) const
+    {
+        return origin_us + (int64_t)llround(utc_s * 1e6 * (1.0 + drift));
+    }
+
+    // Local timestamp of the edge marking a UTC second
+    int64_t edge(int64_t second)
+    {
+        int64_t latency_us = 0;
+        if (jitter_us > 0)
+        {
+            lcg = lcg * 1664525u + 1013904223u;
+            latency_us = (lcg >> 8) % (jitter_us + 1);
+        }
+        return local((double)second) + latency_us;
+    }
+
+private:
+    double drift;
+    uint32_t jitter_us;
+    int64_t origin_us;
+    uint32_t lcg;
+};
+
+static const int64_t EPOCH_S = 1735689600; // Edges are whole UTC seconds from here
+
+static int64_t utcAt(int64_t second)
+{
+    return (EPOCH_S + second) * 1000000LL;
+}
+
+// Run the servo over seconds [from, to) and return the largest |offset| seen
+// over the last settled edges
+static int64_t runEdges(PpsServo &servo, SimulatedOscillator &oscillator, int64_t from, int64_t to, int64_t settle)
+{
+    int64_t maxOffset_us = 0;
+    for (int64_t second = from; second < to; second++)
+    {
+        servo.update(oscillator.edge(second), utcAt(second));
+        if (second >= from + settle)
+        {
+            int64_t offset_us = llabs(servo.getLastOffset_us());
+            maxOffset_us = offset_us > maxOffset_us ? offset_us : maxOffset_us;
+        }
+    }
+    return maxOffset_us;
+}
+
+static void testAcquireAndLock()
+{
+    PpsServo servo;
+    SimulatedOscillator oscillator(25.0, 0);
+
+    CHECK_EQ(servo.getState(), PpsServo::UNLOCKED);
+    CHECK_EQ(servo.update(oscillator.edge(0), utcAt(0)), PpsServo::STEPPED);
+    CHECK_EQ(servo.getState(), PpsServo::ACQUIRING);
+
+    // The second edge measures the frequency error outright
+    CHECK_EQ(servo.update(oscillator.edge(1), utcAt(1)), PpsServo::STEPPED);
+    CHECK_EQ(servo.getState(), PpsServo::LOCKED);
+    CHECK_NEAR(servo.getOscillatorError_ppm(), 25.0, 0.01);
+
+    CHECK_EQ(servo.update(oscillator.edge(2), utcAt(2)), PpsServo::ADJUSTED);
+    CHECK(llabs(servo.getLastOffset_us()) <= 1);
+}
+
+static void testConvergesUnderDriftAndJitter()
+{
+    static const double DRIFTS_PPM[] = {-80.0, -10.0, 0.0, 15.0, 120.0};
+
+    for (double drift_ppm : DRIFTS_PPM)
+    {
+        PpsServo servo;
+        SimulatedOscillator oscillator(drift_ppm, 20);
+
+        // Offsets stay within a few jitter spans once settled
+        int64_t maxOffset_us = runEdges(servo, oscillator, 0, 600, 20);
+        CHECK_EQ(servo.getState(), PpsServo::LOCKED);
+        CHECK(maxOffset_us <= 60);
+        CHECK_NEAR(servo.getOscillatorError_ppm(), drift_ppm, 10.0);
+        CHECK_EQ(servo.getSteps(), 0);
+        CHECK_EQ(servo.getRejected(), 0);
+
+        // Between edges the clock tracks true time, less the mean latency
+        double mid_s = 599.5;
+        int64_t error_us = servo.toUtc(oscillator.local(mid_s)) - (int64_t)llround((EPOCH_S + mid_s) * 1e6);
+        CHECK(llabs(error_us + 10) <= 60);
+    }
+}
+
+static void testTracksDriftChange()
+{
+    PpsServo servo;
+    SimulatedOscillator cold(30.0, 5);
+    runEdges(servo, cold, 0, 100, 10);
+
+    // The oscillator warms up: same clock reading, new rate. Continue the
+    // local time base where the old one left off.
+    SimulatedOscillator warm(45.0, 5);
+    int64_t shift_us = cold.local(100.0) - warm.local(100.0);
+    int64_t maxOffset_us = 0;
+    for (int64_t second = 100; second < 400; second++)
+    {
+        servo.update(warm.edge(second) + shift_us, utcAt(second));
+        if (second >= 150)
+        {
+            int64_t offset_us = llabs(servo.getLastOffset_us());
+            maxOffset_us = offset_us > maxOffset_us ? offset_us : maxOffset_us;
+        }
+    }
+
+    CHECK(maxOffset_us <= 20);
+    CHECK_NEAR(servo.getOscillatorError_ppm(), 45.0, 3.0);
+    CHECK_EQ(servo.getSteps(), 0);
+}
+
+static void testGlitchRejected()
+{
+    PpsServo servo;
+    SimulatedOscillator oscillator(20.0, 5);
+    runEdges(servo, oscillator, 0, 60, 10);
+
+    double frequency_ppm = servo.getFrequency_ppm();
+    int64_t lastOffset_us = servo.getLastOffset_us();
+
+    // A single edge 5 ms off (a noise pulse) is ignored
+    CHECK_EQ(servo.update(oscillator.edge(60) + 5000, utcAt(60)), PpsServo::REJECTED);
+    CHECK_EQ(servo.getRejected(), 1);
+    CHECK_EQ(servo.getState(), PpsServo::LOCKED);
+    CHECK_NEAR(servo.getFrequency_ppm(), frequency_ppm, 1e-9);
+    CHECK_EQ(servo.getLastOffset_us(), lastOffset_us);
+
+    // Good edges carry on as if nothing happened
+    int64_t maxOffset_us = runEdges(servo, oscillator, 61, 120, 0);
+    CHECK(maxOffset_us <= 20);
+    CHECK_EQ(servo.getSteps(), 0);
+
+    // Outliers that do not run STEP_AFTER_OUTLIERS in a row never step
+    for (int64_t second = 120; second < 140; second++)
+    {
+        int64_t glitch_us = second % PpsServo::STEP_AFTER_OUTLIERS == 0 ? 0 : 8000;
+        servo.update(oscillator.edge(second) + glitch_us, utcAt(second));
+    }
+    CHECK_EQ(servo.getSteps(), 0);
+}
+
+static void testStepAfterOutliers()
+{
+    PpsServo servo;
+    SimulatedOscillator oscillator(-35.0, 5);
+    runEdges(servo, oscillator, 0, 60, 10);
+
+    // The local counter jumps 20 ms (e.g. a missed timer wrap): every edge
+    // from now on is an outlier until the clock is stepped
+    const int64_t jump_us = 20000;
+    for (uint32_t i = 1; i < PpsServo::STEP_AFTER_OUTLIERS; i++)
+    {
+        CHECK_EQ(servo.update(oscillator.edge(59 + i) + jump_us, utcAt(59 + i)), PpsServo::REJECTED);
+    }
+    int64_t second = 59 + PpsServo::STEP_AFTER_OUTLIERS;
+    int64_t edge_us = oscillator.edge(second) + jump_us;
+    CHECK_EQ(servo.update(edge_us, utcAt(second)), PpsServo::STEPPED);
+    CHECK_EQ(servo.getSteps(), 1);
+    CHECK_EQ(servo.getState(), PpsServo::LOCKED);
+    CHECK(llabs(servo.getLastOffset_us() - jump_us) <= 100);
+
+    // Stepped onto the edge, keeping the frequency, so it is locked at once
+    CHECK_EQ(servo.toUtc(edge_us), utcAt(second));
+    CHECK_NEAR(servo.getOscillatorError_ppm(), -35.0, 5.0);
+
+    int64_t maxOffset_us = 0;
+    for (int64_t next = second + 1; next < second + 60; next++)
+    {
+        CHECK_EQ(servo.update(oscillator.edge(next) + jump_us, utcAt(next)), PpsServo::ADJUSTED);
+        int64_t offset_us = llabs(servo.getLastOffset_us());
+        maxOffset_us = offset_us > maxOffset_us ? offset_us : maxOffset_us;
+    }
+    CHECK(maxOffset_us <= 20);
+    CHECK_EQ(servo.getSteps(), 1);
+}
+
+static void testImplausibleFrequency()
+{
+    PpsServo servo;
+
+    // 1000 ppm between the first two edges is beyond the 500 ppm limit:
+    // restart acquisition from the second edge
+    CHECK_EQ(servo.update(0, utcAt(0)), PpsServo::STEPPED);
+    CHECK_EQ(servo.update(1001000, utcAt(1)), PpsServo::REJECTED);
+    CHECK_EQ(servo.getState(), PpsServo::ACQUIRING);
+
+    CHECK_EQ(servo.update(2001010, utcAt(2)), PpsServo::STEPPED);
+    CHECK_EQ(servo.getState(), PpsServo::LOCKED);
+    CHECK_NEAR(servo.getOscillatorError_ppm(), 10.0, 0.01);
+}
+
+static void testNonMonotonicEdges()
+{
+    PpsServo servo;
+    SimulatedOscillator oscillator(0.0, 0);
+    runEdges(servo, oscillator, 0, 10, 0);
+
+    // A repeated UTC second or a local timestamp going backwards
+    CHECK_EQ(servo.update(oscillator.edge(10), utcAt(9)), PpsServo::REJECTED);
+    CHECK_EQ(servo.update(oscillator.edge(5), utcAt(10)), PpsServo::REJECTED);
+    CHECK_EQ(servo.update(oscillator.edge(10), utcAt(10)), PpsServo::ADJUSTED);
+    CHECK_EQ(servo.getSteps(), 0);
+}
+
+int main()
+{
+    RUN_TEST(testAcquireAndLock);
+    RUN_TEST(testConvergesUnderDriftAndJitter);
+    RUN_TEST(testTracksDriftChange);
+    RUN_TEST(testGlitchRejected);
+    RUN_TEST(testStepAfterOutliers);
+    RUN_TEST(testImplausibleFrequency);
+    RUN_TEST(testNonMonotonicEdges);
+    return testResult();
+}
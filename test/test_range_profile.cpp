@@ -0,0 +1,206 @@
+// Host tests for RangeProfile and ChargedGaps: binning by distance, and
+// account(), as the receiver calls it, charging loss where the gap closed,
+// taking it back from the same bin, and ignoring the late packets that must
+// not take anything back.
+#include "test_support.h"
+#include "stats/range_profile.h"
+#include "stats/sequence_tracker.h"
+
+typedef RangeProfile<4> Profile;
+
+// One sender's packets through its tracker and gap log into the profile
+struct Sender
+{
+    SequenceTracker<> tracker;
+    ChargedGaps<4> gaps;
+
+    SequenceTracker<>::Result receive(Profile &profile, uint32_t sequence, float distance_m)
+    {
+        SequenceTracker<>::Result result = tracker.add(sequence);
+        profile.account(gaps, tracker, result, sequence, distance_m, -70, 1500);
+        return result;
+    }
+};
+
+static void testBinning()
+{
+    Profile profile(100);
+
+    CHECK_EQ(profile.add(0.0f, -60, 1000, 0), 0);
+    CHECK_EQ(profile.add(99.9f, -80, 1000, 0), 0);
+    CHECK_EQ(profile.add(150.0f, Profile::NO_RSSI, 0, 2), 1);
+    CHECK_EQ(profile.add(10000.0f, -90, 1000, 0), 3);
+    CHECK_EQ(profile.add(-1.0f, -50, 1000, 1), Profile::UNPLACED);
+
+    CHECK_EQ(profile.bin(0).received, 2);
+    CHECK_EQ(profile.bin(0).rssiMin, -80);
+    CHECK_NEAR(profile.bin(0).rssiMean(), -70.0, 1e-6);
+    CHECK_EQ(profile.bin(0).latency.getCount(), 2);
+
+    // No RSSI and no latency leave those statistics alone
+    CHECK_EQ(profile.bin(1).received, 1);
+    CHECK_EQ(profile.bin(1).lost, 2);
+    CHECK_EQ(profile.bin(1).rssiCount, 0);
+    CHECK_EQ(profile.bin(1).latency.getCount(), 0);
+    CHECK_NEAR(profile.bin(1).lossRate(), 200.0 / 3, 1e-4);
+
+    // The last bin is open-ended
+    CHECK_EQ(profile.bin(3).received, 1);
+    CHECK(profile.bin(2).isEmpty());
+
+    CHECK_EQ(profile.getUnplaced().received, 1);
+    CHECK_EQ(profile.getUnplaced().lost, 1);
+}
+
+static void testGapChargedWhereLinkCameBack()
+{
+    Profile profile(100);
+    Sender sender;
+
+    for (uint32_t seq = 0; seq < 10; seq++)
+    {
+        sender.receive(profile, seq, 50.0f);
+    }
+
+    // 10..14 lost; 15 arrives from the next bin
+    sender.receive(profile, 15, 150.0f);
+    CHECK_EQ(profile.bin(0).lost, 0);
+    CHECK_EQ(profile.bin(1).lost, 5);
+    CHECK_EQ(profile.bin(1).received, 1);
+}
+
+static void testLatePacketTakesBackFromChargedBin()
+{
+    Profile profile(100);
+    Sender sender;
+
+    sender.receive(profile, 0, 250.0f);
+    sender.receive(profile, 1, 250.0f); // Bin 2 has nothing to take back
+    sender.receive(profile, 4, 150.0f); // 2 and 3 charged to bin 1
+
+    // Late 2 arrives while the sender is back in bin 2
+    CHECK_EQ(sender.receive(profile, 2, 250.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(profile.bin(1).lost, 1);
+    CHECK_EQ(profile.bin(2).lost, 0);
+    CHECK_EQ(profile.bin(2).received, 3);
+
+    // Its duplicate takes nothing back
+    CHECK_EQ(sender.receive(profile, 2, 150.0f), SequenceTracker<>::DUPLICATE);
+    CHECK_EQ(profile.bin(1).lost, 1);
+
+    CHECK_EQ(sender.receive(profile, 3, 50.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(profile.bin(1).lost, 0);
+    CHECK_EQ(profile.bin(0).lost, 0);
+}
+
+static void testEarlyPacketTakesNothingBack()
+{
+    Profile profile(100);
+    Sender sender;
+
+    sender.receive(profile, 100, 50.0f);
+    sender.receive(profile, 103, 50.0f); // 101 and 102 charged to bin 0
+
+    // 99 was sent before the first packet seen and was never charged
+    CHECK_EQ(sender.receive(profile, 99, 50.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(profile.bin(0).lost, 2);
+    CHECK_EQ(profile.bin(0).received, 3);
+}
+
+static void testRestartForgetsGaps()
+{
+    Profile profile(100);
+    Sender sender;
+
+    for (uint32_t seq = 0; seq < 100; seq++)
+    {
+        if (seq != 5)
+        {
+            sender.receive(profile, seq, 50.0f);
+        }
+    }
+    CHECK_EQ(profile.bin(0).lost, 1);
+
+    // The sender reboots and counts from 0 again, now further away
+    for (uint32_t seq = 0; seq < 5; seq++)
+    {
+        sender.receive(profile, seq, 150.0f);
+    }
+    sender.receive(profile, 7, 150.0f); // 5 and 6 charged to bin 1
+
+    // 5 fills the new gap, not the one from before the restart
+    CHECK_EQ(sender.receive(profile, 5, 50.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(profile.bin(0).lost, 1);
+    CHECK_EQ(profile.bin(1).lost, 1);
+}
+
+static void testGapGivesBackAtMostItsLoss()
+{
+    Profile profile(100);
+    Sender sender;
+
+    // One hole, then far beyond the tracker's window
+    sender.receive(profile, 100, 50.0f);
+    sender.receive(profile, 102, 50.0f);
+    sender.receive(profile, 3100, 150.0f); // 103..3099 charged to bin 1
+
+    // Too old to tell from a duplicate, so each copy counts as recovered,
+    // but the gap at 101 charged only one
+    CHECK_EQ(sender.receive(profile, 101, 50.0f), SequenceTracker<>::RECOVERED);
+    CHECK_EQ(sender.receive(profile, 101, 50.0f), SequenceTracker<>::RECOVERED);
+    CHECK_EQ(profile.bin(0).lost, 0);
+    CHECK_EQ(profile.bin(1).lost, 2997);
+}
+
+static void testForgottenGapStaysCharged()
+{
+    Profile profile(100);
+    Sender sender;
+
+    // Five gaps in bin 0; the log remembers the last four
+    uint32_t seq = 0;
+    for (int gap = 0; gap < 5; gap++)
+    {
+        sender.receive(profile, seq, 50.0f);
+        seq += 2;
+    }
+    CHECK_EQ(profile.bin(0).lost, 4);
+    sender.receive(profile, seq, 150.0f); // The fifth gap, charged to bin 1
+
+    // The first gap's hole is no longer known
+    CHECK_EQ(sender.receive(profile, 1, 50.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(profile.bin(0).lost, 4);
+
+    CHECK_EQ(sender.receive(profile, 3, 50.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(profile.bin(0).lost, 3);
+    CHECK_EQ(sender.receive(profile, seq - 1, 50.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(profile.bin(1).lost, 0);
+}
+
+static void testGapAcrossWrap()
+{
+    Profile profile(100);
+    Sender sender;
+
+    sender.receive(profile, 0xFFFFFFFD, 50.0f);
+    sender.receive(profile, 1, 150.0f); // 0xFFFFFFFE..0 charged to bin 1
+    CHECK_EQ(profile.bin(1).lost, 3);
+
+    CHECK_EQ(sender.receive(profile, 0xFFFFFFFF, 50.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(sender.receive(profile, 0, 50.0f), SequenceTracker<>::REORDERED);
+    CHECK_EQ(profile.bin(1).lost, 1);
+    CHECK_EQ(profile.bin(0).lost, 0);
+}
+
+int main()
+{
+    RUN_TEST(testBinning);
+    RUN_TEST(testGapChargedWhereLinkCameBack);
+    RUN_TEST(testLatePacketTakesBackFromChargedBin);
+    RUN_TEST(testEarlyPacketTakesNothingBack);
+    RUN_TEST(testRestartForgetsGaps);
+    RUN_TEST(testGapGivesBackAtMostItsLoss);
+    RUN_TEST(testForgottenGapStaysCharged);
+    RUN_TEST(testGapAcrossWrap);
+    return testResult();
+}
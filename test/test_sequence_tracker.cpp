@@ -0,0 +1,330 @@
+// Host tests for SequenceTracker with synthetic sequences: loss charged when
+// a gap opens, reordering and recovery, duplicates, wrap and sender restarts.
+#include "test_support.h"
+#include "stats/sequence_tracker.h"
+
+typedef SequenceTracker<> Tracker;
+
+static void addRange(Tracker &tracker, uint32_t from, uint32_t to)
+{
+    for (uint32_t seq = from; seq != to; seq++)
+    {
+        tracker.add(seq);
+    }
+}
+
+// With send times: one packet per millisecond from start_us
+static void addTimed(Tracker &tracker, uint32_t from, uint32_t to, int64_t start_us)
+{
+    for (uint32_t seq = from; seq != to; seq++)
+    {
+        tracker.add(seq, start_us + (int64_t)(seq - from) * 1000);
+    }
+}
+
+static void testInOrder()
+{
+    Tracker tracker;
+
+    for (uint32_t seq = 0; seq < 5000; seq++)
+    {
+        CHECK_EQ(tracker.add(seq), Tracker::NEW);
+    }
+
+    const Tracker::Counters &counters = tracker.getCounters();
+    CHECK_EQ(counters.received, 5000);
+    CHECK_EQ(counters.lost, 0);
+    CHECK_EQ(counters.reordered, 0);
+    CHECK_EQ(tracker.getPendingMissing(), 0);
+}
+
+static void testGapChargedWhenSeen()
+{
+    Tracker tracker;
+
+    addRange(tracker, 0, 3);
+    CHECK_EQ(tracker.add(5), Tracker::NEW);
+    CHECK_EQ(tracker.getLastGap(), 2);
+
+    // Counted at once, not when the holes leave the window
+    CHECK_EQ(tracker.getCounters().lost, 2);
+    CHECK_EQ(tracker.getCounters().netLost(), 2);
+    CHECK_EQ(tracker.getPendingMissing(), 2);
+
+    // Holes that leave the window stay charged, once
+    addRange(tracker, 6, 3000);
+    CHECK_EQ(tracker.getCounters().lost, 2);
+    CHECK_EQ(tracker.getPendingMissing(), 0);
+    CHECK_EQ(tracker.getLastGap(), 0);
+}
+
+static void testReorderFillsHole()
+{
+    Tracker tracker;
+
+    addRange(tracker, 100, 103);
+    tracker.add(105);
+    CHECK_EQ(tracker.add(103), Tracker::REORDERED);
+    CHECK_EQ(tracker.add(103), Tracker::DUPLICATE);
+
+    const Tracker::Counters &counters = tracker.getCounters();
+    CHECK_EQ(counters.received, 5);
+    CHECK_EQ(counters.lost, 2);
+    CHECK_EQ(counters.recovered, 1);
+    CHECK_EQ(counters.reordered, 1);
+    CHECK_EQ(counters.duplicates, 1);
+    CHECK_EQ(counters.netLost(), 1);
+    CHECK_EQ(tracker.getPendingMissing(), 1);
+
+    // Filled near the back of the window
+    addRange(tracker, 106, 1100);
+    CHECK_EQ(tracker.add(104), Tracker::REORDERED);
+    CHECK_EQ(tracker.getCounters().netLost(), 0);
+    CHECK_EQ(tracker.getPendingMissing(), 0);
+}
+
+static void testDuplicates()
+{
+    Tracker tracker;
+
+    addRange(tracker, 0, 50);
+    CHECK_EQ(tracker.add(49), Tracker::DUPLICATE);
+    CHECK_EQ(tracker.add(20), Tracker::DUPLICATE);
+    CHECK_EQ(tracker.add(20), Tracker::DUPLICATE);
+
+    const Tracker::Counters &counters = tracker.getCounters();
+    CHECK_EQ(counters.received, 50);
+    CHECK_EQ(counters.duplicates, 3);
+    CHECK_EQ(counters.lost, 0);
+}
+
+static void testBeforeFirstPacket()
+{
+    Tracker tracker;
+
+    // Receiver starts listening at 40; 38 overtook by a little
+    addRange(tracker, 40, 45);
+    CHECK_EQ(tracker.add(38), Tracker::REORDERED);
+    CHECK_EQ(tracker.add(38), Tracker::DUPLICATE);
+    CHECK_EQ(tracker.add(38), Tracker::DUPLICATE);
+
+    // Never charged, so nothing is taken back and nothing is pending
+    const Tracker::Counters &counters = tracker.getCounters();
+    CHECK_EQ(counters.received, 6);
+    CHECK_EQ(counters.lost, 0);
+    CHECK_EQ(counters.recovered, 0);
+    CHECK_EQ(counters.duplicates, 2);
+    CHECK_EQ(tracker.getPendingMissing(), 0);
+}
+
+static void testRecoveryAfterWindow()
+{
+    Tracker tracker;
+
+    addRange(tracker, 0, 100);
+    CHECK_EQ(tracker.add(2000), Tracker::NEW);
+    CHECK_EQ(tracker.getLastGap(), 1900);
+    CHECK_EQ(tracker.getCounters().lost, 1900);
+    CHECK_EQ(tracker.getPendingMissing(), 1023);
+
+    // Older than the window: taken as filling a hole
+    CHECK_EQ(tracker.add(150), Tracker::RECOVERED);
+    CHECK_EQ(tracker.getCounters().recovered, 1);
+    CHECK_EQ(tracker.getCounters().netLost(), 1899);
+}
+
+static void testWrap()
+{
+    Tracker tracker;
+
+    addRange(tracker, 0xFFFFFF00u, 0x00000100u);
+    CHECK_EQ(tracker.getCounters().received, 512);
+    CHECK_EQ(tracker.getCounters().lost, 0);
+    CHECK_EQ(tracker.getCounters().restarts, 0);
+
+    // A gap and a reorder across the wrap
+    Tracker wrapped;
+    addRange(wrapped, 0xFFFFFFF0u, 0xFFFFFFFEu);
+    CHECK_EQ(wrapped.add(2), Tracker::NEW);
+    CHECK_EQ(wrapped.getLastGap(), 4);
+    CHECK_EQ(wrapped.add(0xFFFFFFFFu), Tracker::REORDERED);
+    CHECK_EQ(wrapped.add(0), Tracker::REORDERED);
+    CHECK_EQ(wrapped.getCounters().netLost(), 2);
+    CHECK_EQ(wrapped.getPendingMissing(), 2);
+}
+
+static void testRestartFarBehind()
+{
+    Tracker tracker;
+
+    addRange(tracker, 0, 10000);
+    CHECK_EQ(tracker.add(0), Tracker::RESTART);
+    CHECK_EQ(tracker.add(1), Tracker::NEW);
+
+    // More than RESTART_GAP behind, whatever the sequence number
+    addRange(tracker, 2, 20000);
+    CHECK_EQ(tracker.add(20000 - Tracker::RESTART_GAP - 100), Tracker::RESTART);
+
+    const Tracker::Counters &counters = tracker.getCounters();
+    CHECK_EQ(counters.restarts, 2);
+    CHECK_EQ(counters.lost, 0);
+}
+
+static void testRestartEarly()
+{
+    Tracker tracker;
+
+    // A sender that reboots after 100 packets starts over at 0, later
+    addTimed(tracker, 0, 100, 1000000);
+    CHECK_EQ(tracker.add(0, 5000000), Tracker::RESTART);
+    CHECK_EQ(tracker.add(1, 5001000), Tracker::NEW);
+    CHECK_EQ(tracker.add(2, 5002000), Tracker::NEW);
+
+    const Tracker::Counters &counters = tracker.getCounters();
+    CHECK_EQ(counters.restarts, 1);
+    CHECK_EQ(counters.received, 103);
+    CHECK_EQ(counters.duplicates, 0);
+    CHECK_EQ(counters.lost, 0);
+}
+
+static void testRestartWithoutSendTimes()
+{
+    Tracker tracker;
+
+    // The reboot's 0 could be a late duplicate; 1 right after it confirms
+    addRange(tracker, 0, 100);
+    CHECK_EQ(tracker.add(0), Tracker::DUPLICATE);
+    CHECK_EQ(tracker.add(1), Tracker::RESTART);
+    CHECK_EQ(tracker.add(2), Tracker::NEW);
+
+    const Tracker::Counters &counters = tracker.getCounters();
+    CHECK_EQ(counters.restarts, 1);
+    CHECK_EQ(counters.received, 102);
+    CHECK_EQ(counters.duplicates, 1);
+    CHECK_EQ(counters.lost, 0);
+}
+
+static void testRestartAfterLostStart()
+{
+    Tracker tracker;
+
+    // Listening started at 5; the reboot's 0 is before the first packet
+    addTimed(tracker, 5, 40, 1000000);
+    CHECK_EQ(tracker.add(0, 9000000), Tracker::RESTART);
+    CHECK_EQ(tracker.add(1, 9001000), Tracker::NEW);
+    CHECK_EQ(tracker.getCounters().lost, 0);
+}
+
+static void testRestartOnHole()
+{
+    Tracker tracker;
+
+    // The reboot's 0 is lost and its 1 lands on a hole, which it fills;
+    // 2 has been seen before, so it is the restart
+    tracker.add(0);
+    addRange(tracker, 2, 60);
+    CHECK_EQ(tracker.add(1), Tracker::REORDERED);
+    CHECK_EQ(tracker.add(2), Tracker::RESTART);
+    CHECK_EQ(tracker.add(3), Tracker::NEW);
+    CHECK_EQ(tracker.getCounters().restarts, 1);
+    CHECK_EQ(tracker.getCounters().netLost(), 0);
+}
+
+static void testLowSequenceReorder()
+{
+    Tracker tracker;
+
+    // Packet 2 late by 40 packets is a reorder, not a restart
+    addRange(tracker, 0, 2);
+    addRange(tracker, 3, 43);
+    CHECK_EQ(tracker.add(2), Tracker::REORDERED);
+    CHECK_EQ(tracker.getCounters().restarts, 0);
+    CHECK_EQ(tracker.getCounters().netLost(), 0);
+}
+
+static void testLateDuplicateOfLowSequence()
+{
+    // A copy of 3 arriving 48 packets late is a duplicate, with or without
+    // its (older) send time, and costs nothing when the stream goes on
+    for (int timed = 0; timed < 2; timed++)
+    {
+        Tracker tracker;
+
+        addTimed(tracker, 0, 51, 1000000);
+        CHECK_EQ(tracker.add(3, timed ? 1003000 : 0), Tracker::DUPLICATE);
+        addTimed(tracker, 51, 61, 1051000);
+
+        const Tracker::Counters &counters = tracker.getCounters();
+        CHECK_EQ(counters.restarts, 0);
+        CHECK_EQ(counters.lost, 0);
+        CHECK_EQ(counters.duplicates, 1);
+        CHECK_EQ(counters.received, 61);
+    }
+}
+
+static void testLateLowSequencesInARowWithSendTimes()
+{
+    Tracker tracker;
+
+    // Two late copies in a row still carry their old send times
+    addTimed(tracker, 0, 51, 1000000);
+    CHECK_EQ(tracker.add(3, 1003000), Tracker::DUPLICATE);
+    CHECK_EQ(tracker.add(4, 1004000), Tracker::DUPLICATE);
+    CHECK_EQ(tracker.getCounters().restarts, 0);
+}
+
+static void testRebootWithinRestartSequence()
+{
+    Tracker tracker;
+
+    // Too early to tell from duplicates: counted as such until it passes 10
+    addRange(tracker, 0, 10);
+    for (uint32_t seq = 0; seq < 10; seq++)
+    {
+        CHECK_EQ(tracker.add(seq), Tracker::DUPLICATE);
+    }
+    CHECK_EQ(tracker.add(10), Tracker::NEW);
+    CHECK_EQ(tracker.getCounters().lost, 0);
+}
+
+static void testPeriodCounters()
+{
+    Tracker tracker;
+
+    addRange(tracker, 0, 10);
+    tracker.add(15);
+    Tracker::Counters first = tracker.getCounters();
+    CHECK_EQ(first.netLost(), 5);
+
+    // A period in which only late packets arrive reports no loss
+    tracker.add(11);
+    tracker.add(12);
+    Tracker::Counters period = tracker.getCounters() - first;
+    CHECK_EQ(period.received, 2);
+    CHECK_EQ(period.lost, 0);
+    CHECK_EQ(period.recovered, 2);
+    CHECK_EQ(period.netLost(), 0);
+    CHECK_EQ(tracker.getCounters().netLost(), 3);
+}
+
+int main()
+{
+    RUN_TEST(testInOrder);
+    RUN_TEST(testGapChargedWhenSeen);
+    RUN_TEST(testReorderFillsHole);
+    RUN_TEST(testDuplicates);
+    RUN_TEST(testBeforeFirstPacket);
+    RUN_TEST(testRecoveryAfterWindow);
+    RUN_TEST(testWrap);
+    RUN_TEST(testRestartFarBehind);
+    RUN_TEST(testRestartEarly);
+    RUN_TEST(testRestartWithoutSendTimes);
+    RUN_TEST(testRestartAfterLostStart);
+    RUN_TEST(testRestartOnHole);
+    RUN_TEST(testLowSequenceReorder);
+    RUN_TEST(testLateDuplicateOfLowSequence);
+    RUN_TEST(testLateLowSequencesInARowWithSendTimes);
+    RUN_TEST(testRebootWithinRestartSequence);
+    RUN_TEST(testPeriodCounters);
+    return testResult();
+}
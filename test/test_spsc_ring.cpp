@@ -0,0 +1,151 @@
+// Host tests for SpscRing: empty and full, wrap of the free-running indices,
+// overflow counting and the high-water mark.
+#include "test_support.h"
+#include "util/spsc_ring.h"
+
+static void testEmpty()
+{
+    SpscRing<uint32_t, 4> ring;
+    uint32_t value = 0;
+
+    CHECK(ring.empty());
+    CHECK_EQ(ring.size(), 0);
+    CHECK(ring.front() == nullptr);
+    CHECK(!ring.tryPop(value));
+    CHECK_EQ(ring.overflowCount(), 0);
+    CHECK_EQ(ring.highWaterMark(), 0);
+}
+
+static void testFull()
+{
+    SpscRing<uint32_t, 4> ring;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        CHECK(ring.tryPush(i));
+    }
+    CHECK_EQ(ring.size(), 4);
+    CHECK(ring.acquire() == nullptr);
+    CHECK(!ring.tryPush(99));
+
+    // Items come out in order and the ring is usable again
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        CHECK(ring.tryPop(value));
+        CHECK_EQ(value, i);
+    }
+    CHECK(ring.empty());
+    CHECK(ring.tryPush(5));
+}
+
+static void testAcquireCommit()
+{
+    SpscRing<uint32_t, 4> ring;
+
+    uint32_t *slot = ring.acquire();
+    CHECK(slot != nullptr);
+    *slot = 42;
+
+    // Not visible to the consumer until committed
+    CHECK(ring.front() == nullptr);
+    ring.commit();
+
+    const uint32_t *item = ring.front();
+    CHECK(item != nullptr);
+    if (item)
+    {
+        CHECK_EQ(*item, 42);
+    }
+    ring.release();
+    CHECK(ring.empty());
+}
+
+static void testWrap()
+{
+    SpscRing<uint32_t, 8> ring;
+    uint32_t next = 0;
+    uint32_t expected = 0;
+    uint32_t value = 0;
+
+    // Many times round the slots with a varying fill level
+    for (uint32_t round = 0; round < 1000; round++)
+    {
+        uint32_t pushes = 1 + round % 8;
+        for (uint32_t i = 0; i < pushes && ring.size() < ring.capacity(); i++)
+        {
+            CHECK(ring.tryPush(next++));
+        }
+
+        uint32_t pops = 1 + (round * 3) % 8;
+        for (uint32_t i = 0; i < pops && ring.tryPop(value); i++)
+        {
+            CHECK_EQ(value, expected);
+            expected++;
+        }
+    }
+
+    while (ring.tryPop(value))
+    {
+        CHECK_EQ(value, expected);
+        expected++;
+    }
+    CHECK_EQ(expected, next);
+    CHECK_EQ(ring.overflowCount(), 0);
+}
+
+static void testOverflowCount()
+{
+    SpscRing<uint32_t, 2> ring;
+
+    CHECK(ring.tryPush(1));
+    CHECK(ring.tryPush(2));
+    CHECK(!ring.tryPush(3));
+    CHECK(!ring.tryPush(4));
+    CHECK(ring.acquire() == nullptr);
+    CHECK_EQ(ring.overflowCount(), 3);
+
+    // Draining does not reset the count
+    uint32_t value = 0;
+    CHECK(ring.tryPop(value));
+    CHECK(ring.tryPush(5));
+    CHECK_EQ(ring.overflowCount(), 3);
+}
+
+static void testHighWater()
+{
+    SpscRing<uint32_t, 8> ring;
+    uint32_t value = 0;
+
+    ring.tryPush(1);
+    ring.tryPush(2);
+    ring.tryPush(3);
+    CHECK_EQ(ring.highWaterMark(), 3);
+
+    // Stays at the deepest level after draining
+    while (ring.tryPop(value))
+    {
+    }
+    CHECK_EQ(ring.highWaterMark(), 3);
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        ring.tryPush(i);
+    }
+    CHECK_EQ(ring.highWaterMark(), 8);
+
+    // Rejected pushes do not raise it past capacity
+    ring.tryPush(9);
+    CHECK_EQ(ring.highWaterMark(), 8);
+}
+
+int main()
+{
+    RUN_TEST(testEmpty);
+    RUN_TEST(testFull);
+    RUN_TEST(testAcquireCommit);
+    RUN_TEST(testWrap);
+    RUN_TEST(testOverflowCount);
+    RUN_TEST(testHighWater);
+    return testResult();
+}
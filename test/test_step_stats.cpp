@@ -0,0 +1,215 @@
+// Host tests for StepStatsTracker: step boundaries, loss charged to the
+// earlier step, stragglers, and profiles that repeat or alternate steps.
+#include "test_support.h"
+#include "stats/step_stats.h"
+
+// Feed one packet per millisecond with a fixed latency
+static bool feed(StepStatsTracker &tracker, uint8_t stepId, uint32_t sequence, StepReport &report)
+{
+    return tracker.add(stepId, sequence, 100, (int64_t)sequence * 1000, 2000, report);
+}
+
+static void testSingleStep()
+{
+    StepStatsTracker tracker;
+    StepReport report;
+
+    for (uint32_t seq = 10; seq < 20; seq++)
+    {
+        if (seq != 15)
+        {
+            CHECK(!feed(tracker, 3, seq, report));
+        }
+    }
+
+    CHECK(tracker.flush(report));
+    CHECK_EQ(report.stepId, 3);
+    CHECK_EQ(report.received, 9);
+    CHECK_EQ(report.lost, 1);
+    CHECK_EQ(report.payloadBytes, 900);
+    CHECK_EQ(report.span_us, 9000);
+    CHECK_NEAR(report.latencyP50_us, 2000, 2000 * 0.07);
+
+    // Nothing left to flush
+    CHECK(!tracker.flush(report));
+}
+
+static void testGapChargedToEarlierStep()
+{
+    StepStatsTracker tracker;
+    StepReport report;
+
+    for (uint32_t seq = 0; seq < 10; seq++)
+    {
+        feed(tracker, 0, seq, report);
+    }
+
+    // 10..12 lost across the boundary; step 1 starts at 13
+    CHECK(feed(tracker, 1, 13, report));
+    CHECK_EQ(report.stepId, 0);
+    CHECK_EQ(report.received, 10);
+    CHECK_EQ(report.lost, 3);
+
+    CHECK(tracker.flush(report));
+    CHECK_EQ(report.stepId, 1);
+    CHECK_EQ(report.received, 1);
+    CHECK_EQ(report.lost, 0);
+}
+
+static void testStraggler()
+{
+    StepStatsTracker tracker;
+    StepReport report;
+
+    for (uint32_t seq = 0; seq < 10; seq++)
+    {
+        if (seq != 8)
+        {
+            feed(tracker, 0, seq, report);
+        }
+    }
+    CHECK(feed(tracker, 1, 10, report));
+    CHECK_EQ(report.lost, 1);
+
+    // Packet 8 arrives after step 1 started: late, not a new step
+    CHECK(!feed(tracker, 0, 8, report));
+    CHECK_EQ(tracker.getLatePackets(), 1);
+
+    CHECK(tracker.flush(report));
+    CHECK_EQ(report.stepId, 1);
+    CHECK_EQ(report.received, 1);
+}
+
+static void testAlternatingSteps()
+{
+    StepStatsTracker tracker;
+    StepReport report;
+    uint32_t reports = 0;
+    uint32_t seq = 0;
+
+    // Two steps of 50 packets repeated five times, as a 2-step ramp or burst
+    for (uint32_t cycle = 0; cycle < 5; cycle++)
+    {
+        for (uint8_t step = 0; step < 2; step++)
+        {
+            for (uint32_t i = 0; i < 50; i++)
+            {
+                if (feed(tracker, step, seq++, report))
+                {
+                    CHECK_EQ(report.stepId, reports % 2);
+                    CHECK_EQ(report.received, 50);
+                    CHECK_EQ(report.lost, 0);
+                    reports++;
+                }
+            }
+        }
+    }
+    CHECK(tracker.flush(report));
+    reports++;
+
+    CHECK_EQ(reports, 10);
+    CHECK_EQ(tracker.getLatePackets(), 0);
+}
+
+static void testAlternatingStepsWithStraggler()
+{
+    StepStatsTracker tracker;
+    StepReport report;
+
+    // Step 0 (0..49), step 1 (50..99), step 0 again from 100
+    for (uint32_t seq = 0; seq < 100; seq++)
+    {
+        if (seq != 40 && seq != 95)
+        {
+            feed(tracker, seq < 50 ? 0 : 1, seq, report);
+        }
+    }
+    CHECK(feed(tracker, 0, 100, report));
+    CHECK_EQ(report.stepId, 1);
+    CHECK_EQ(report.lost, 1);
+
+    // Stragglers of both earlier steps, including one with the current id
+    CHECK(!feed(tracker, 1, 95, report));
+    CHECK(!feed(tracker, 0, 40, report));
+    CHECK_EQ(tracker.getLatePackets(), 2);
+
+    // The repeated step 0 carries on
+    for (uint32_t seq = 101; seq < 110; seq++)
+    {
+        CHECK(!feed(tracker, 0, seq, report));
+    }
+    CHECK(tracker.flush(report));
+    CHECK_EQ(report.stepId, 0);
+    CHECK_EQ(report.received, 10);
+    CHECK_EQ(report.lost, 0);
+}
+
+static void testReorderedWithinStep()
+{
+    StepStatsTracker tracker;
+    StepReport report;
+
+    feed(tracker, 2, 0, report);
+    feed(tracker, 2, 2, report);
+    feed(tracker, 2, 1, report);
+    feed(tracker, 2, 3, report);
+
+    CHECK(tracker.flush(report));
+    CHECK_EQ(report.received, 4);
+    CHECK_EQ(report.lost, 0);
+    CHECK_EQ(tracker.getLatePackets(), 0);
+}
+
+static void testRestartAfterFlush()
+{
+    StepStatsTracker tracker;
+    StepReport report;
+
+    for (uint32_t seq = 5000; seq < 5010; seq++)
+    {
+        feed(tracker, 1, seq, report);
+    }
+
+    // The receiver flushes on a sender restart; numbering then starts over
+    CHECK(tracker.flush(report));
+    CHECK_EQ(report.received, 10);
+    for (uint32_t seq = 0; seq < 5; seq++)
+    {
+        CHECK(!feed(tracker, 0, seq, report));
+    }
+    CHECK(tracker.flush(report));
+    CHECK_EQ(report.stepId, 0);
+    CHECK_EQ(report.received, 5);
+    CHECK_EQ(tracker.getLatePackets(), 0);
+}
+
+static void testSequenceWrap()
+{
+    StepStatsTracker tracker;
+    StepReport report;
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        feed(tracker, 0, 0xFFFFFFFA + i, report);
+    }
+    CHECK(feed(tracker, 1, 4, report));
+    CHECK_EQ(report.received, 10);
+    CHECK_EQ(report.lost, 0);
+
+    // A straggler from before the wrap is still late
+    CHECK(!feed(tracker, 0, 0xFFFFFFFF, report));
+    CHECK_EQ(tracker.getLatePackets(), 1);
+}
+
+int main()
+{
+    RUN_TEST(testSingleStep);
+    RUN_TEST(testGapChargedToEarlierStep);
+    RUN_TEST(testStraggler);
+    RUN_TEST(testAlternatingSteps);
+    RUN_TEST(testAlternatingStepsWithStraggler);
+    RUN_TEST(testReorderedWithinStep);
+    RUN_TEST(testRestartAfterFlush);
+    RUN_TEST(testSequenceWrap);
+    return testResult();
+}
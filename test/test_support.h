@@ -0,0 +1,67 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <cstdio>
+
+// Minimal checks for the host tests: each failure is printed with its
+// location, and testResult() turns the count into the process exit code
+// ctest looks at.
+static int testFailures = 0;
+
+#define CHECK(condition)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!(condition))                                                       \
+        {                                                                       \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures++;                                                     \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                              \
+    do                                                                          \
+    {                                                                           \
+        long long actualValue = (long long)(actual);                            \
+        long long expectedValue = (long long)(expected);                        \
+        if (actualValue != expectedValue)                                       \
+        {                                                                       \
+            std::printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",       \
+                        __FILE__, __LINE__, #actual, #expected, actualValue, expectedValue); \
+            testFailures++;                                                     \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                                 \
+    do                                                                          \
+    {                                                                           \
+        double actualValue = (double)(actual);                                  \
+        double expectedValue = (double)(expected);                              \
+        double difference = actualValue - expectedValue;                        \
+        if (difference > (tolerance) || difference < -(tolerance))              \
+        {                                                                       \
+            std::printf("%s:%d: CHECK_NEAR(%s, %s, %s) failed: %g vs %g\n",     \
+                        __FILE__, __LINE__, #actual, #expected, #tolerance, actualValue, expectedValue); \
+            testFailures++;                                                     \
+        }                                                                       \
+    } while (0)
+
+// Run one test function, naming it on failure
+#define RUN_TEST(test)                                                          \
+    do                                                                          \
+    {                                                                           \
+        int before = testFailures;                                              \
+        test();                                                                 \
+        std::printf("%s %s\n", testFailures == before ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+static inline int testResult()
+{
+    if (testFailures > 0)
+    {
+        std::printf("%d check(s) failed\n", testFailures);
+        return 1;
+    }
+    return 0;
+}
+
+#endif // TEST_SUPPORT_H
@@ -0,0 +1,229 @@
+// Measure how fast the log writer and a file sink take receiver records.
+//
+// Usage: logsinkbench [--records n] [--rate n] [--segment bytes] [--dir path]
+//
+// Appends n framed RX records (default 200000) through LogWriter into a
+// FileLogSink, as the receiver does at --rate records per second (default
+// 1000) of simulated time, so the flush and sync intervals apply as on the
+// board. Blocks are written inline by poll(); each sink call is timed on the
+// host clock. Files go to a temporary directory that is removed afterwards,
+// or are kept under --dir. Point --dir at a mounted SD card to measure the
+// card through a USB reader.
+
+#include <Arduino.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "log/file_log_sink.h"
+#include "log/log_record.h"
+#include "log/log_writer.h"
+#include "timing/host_clock.h"
+
+// FileLogSink with every call timed on the host clock. Syncs include those
+// the sink makes itself when it moves to the next file.
+class TimedFileLogSink : public FileLogSink
+{
+public:
+    uint32_t syncs;
+    uint64_t write_us;
+    uint64_t sync_us;
+    uint32_t maxWrite_us;
+    uint32_t maxSync_us;
+
+    TimedFileLogSink(const char *directory, uint32_t segmentSize)
+        : FileLogSink(directory, segmentSize), syncs(0), write_us(0), sync_us(0), maxWrite_us(0), maxSync_us(0),
+          writing(false), syncInWrite_us(0)
+    {
+    }
+
+    // Time spent in the sink, counting a sync inside a write once
+    double seconds() const
+    {
+        return (write_us + sync_us - syncInWrite_us) / 1e6;
+    }
+
+    virtual size_t write(const uint8_t *data, size_t length) override
+    {
+        int64_t start_us = clock.nowMicros();
+        writing = true;
+        size_t written = FileLogSink::write(data, length);
+        writing = false;
+        record(clock.nowMicros() - start_us, write_us, maxWrite_us);
+        return written;
+    }
+
+    virtual bool sync() override
+    {
+        int64_t start_us = clock.nowMicros();
+        bool ok = FileLogSink::sync();
+        syncs++;
+        int64_t elapsed_us = clock.nowMicros() - start_us;
+        record(elapsed_us, sync_us, maxSync_us);
+        if (writing)
+        {
+            syncInWrite_us += elapsed_us;
+        }
+        return ok;
+    }
+
+private:
+    HostClock clock;
+    bool writing;
+    uint64_t syncInWrite_us;
+
+    static void record(int64_t elapsed_us, uint64_t &total_us, uint32_t &max_us)
+    {
+        total_us += elapsed_us;
+        if ((uint32_t)elapsed_us > max_us)
+        {
+            max_us = (uint32_t)elapsed_us;
+        }
+    }
+};
+
+static void removeDirectory(const char *path)
+{
+    DIR *dir = opendir(path);
+    if (!dir)
+    {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        char file[512];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        unlink(file);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t records = 200000;
+    uint32_t rate = 1000;
+    uint32_t segmentSize = 0;
+    const char *directory = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+        {
+            option = "";
+        }
+
+        if (strcmp(option, "--records") == 0)
+        {
+            records = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--rate") == 0)
+        {
+            rate = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--segment") == 0)
+        {
+            segmentSize = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--dir") == 0)
+        {
+            directory = value;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--records n] [--rate n] [--segment bytes] [--dir path]\n", argv[0]);
+            return 2;
+        }
+        i++;
+    }
+
+    if (records == 0 || rate == 0)
+    {
+        fprintf(stderr, "--records and --rate must be positive\n");
+        return 2;
+    }
+
+    char temporary[] = "/tmp/logsinkbench.XXXXXX";
+    if (!directory)
+    {
+        directory = mkdtemp(temporary);
+        if (!directory)
+        {
+            fprintf(stderr, "Cannot create a temporary directory\n");
+            return 1;
+        }
+    }
+
+    TimedFileLogSink sink(directory, segmentSize);
+    if (!sink.begin())
+    {
+        fprintf(stderr, "Cannot write logs to %s\n", directory);
+        return 1;
+    }
+
+    // A typical RX record, sequence number varying so blocks do not repeat
+    RxLogRecord rx = {};
+    rx.rssi_dBm = -72;
+    rx.phyRate = 1;
+    rx.bandwidth_MHz = 20;
+    uint8_t body[RxLogRecord::BODY_SIZE];
+    uint8_t frame[RxLogRecord::BODY_SIZE + LogFrame::OVERHEAD];
+
+    SimNode node("bench", nullptr);
+    simSetNode(&node);
+
+    LogWriter writer(&sink);
+    writer.startSession();
+
+    HostClock clock;
+    int64_t start_us = clock.nowMicros();
+    int64_t interval_us = 1000000 / rate > 0 ? 1000000 / rate : 1;
+
+    for (uint32_t i = 0; i < records; i++)
+    {
+        rx.sequenceNumber = i;
+        size_t length = LogFrame::encode(LOG_RECORD_RX, body, rx.encode(body), frame, sizeof(frame));
+        writer.append(frame, length);
+        writer.poll();
+        simAdvanceTo(simNow() + interval_us);
+    }
+    writer.flush();
+
+    double elapsed_s = (clock.nowMicros() - start_us) / 1e6;
+    LogWriter::Stats stats = writer.getStats();
+    double megabytes = stats.bytes / 1e6;
+    double sinkSeconds = sink.seconds();
+
+    printf("Records:   %lu of %u bytes at %lu/s simulated (%.1f s)\n", (unsigned long)records,
+           (unsigned)sizeof(frame), (unsigned long)rate, records / (double)rate);
+    printf("Written:   %.2f MB in %lu blocks, last file LOG%05lu.BIN under %s\n", megabytes,
+           (unsigned long)stats.blocks, (unsigned long)sink.getFileNumber(), directory);
+    printf("Elapsed:   %.3f s, %.1f MB/s overall\n", elapsed_s, elapsed_s > 0 ? megabytes / elapsed_s : 0.0);
+    printf("Sink:      %.3f s, %.1f MB/s, %.2f%% of simulated time\n", sinkSeconds,
+           sinkSeconds > 0 ? megabytes / sinkSeconds : 0.0, 100.0 * sinkSeconds * rate / records);
+    printf("Writes:    avg %.0f us, max %lu us per block\n",
+           stats.blocks > 0 ? (double)sink.write_us / stats.blocks : 0.0, (unsigned long)sink.maxWrite_us);
+    printf("Syncs:     %lu, avg %.0f us, max %lu us\n", (unsigned long)sink.syncs,
+           sink.syncs > 0 ? (double)sink.sync_us / sink.syncs : 0.0, (unsigned long)sink.maxSync_us);
+    printf("Errors:    %lu, Dropped %lu records\n", (unsigned long)stats.writeErrors,
+           (unsigned long)stats.droppedRecords);
+
+    simSetNode(nullptr);
+
+    if (directory == temporary)
+    {
+        removeDirectory(directory);
+    }
+
+    return stats.writeErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+// Run the receiver hot-path microbenchmarks on the host.
+//
+// Usage: receiverbench [--iterations n]   (default 200000)
+//
+// Builds the firmware sources against the Arduino/ESP shim in native/.
+// Serial output produced by the stages goes to /dev/null; the results table
+// goes to stdout. Heap allocations are counted by wrapping glibc's malloc.
+
+#include <Arduino.h>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench/receiver_benchmark.h"
+#include "timing/host_clock.h"
+
+static std::atomic<uint64_t> allocations(0);
+
+#if defined(__GLIBC__)
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+static uint64_t hostAllocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+#endif
+
+static int64_t hostNowNanos()
+{
+    static HostClock clock;
+    return clock.nowMicros() * 1000;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 200000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+        {
+            iterations = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--iterations n]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    BenchCounters counters = {hostNowNanos, nullptr, nullptr};
+#if defined(__GLIBC__)
+    counters.allocationCount = hostAllocationCount;
+#endif
+
+    // Stage output is written for real, but not to the terminal
+    FILE *devNull = fopen("/dev/null", "w");
+    SimNode benchNode("bench", devNull);
+    SimNode reportNode("report", stdout);
+
+    ReceiverBenchmark benchmark(counters, iterations);
+
+    simSetNode(&benchNode);
+    benchmark.run();
+
+    simSetNode(&reportNode);
+    benchmark.printResults(Serial);
+
+    simSetNode(nullptr);
+    if (devNull)
+    {
+        fclose(devNull);
+    }
+
+    return 0;
+}
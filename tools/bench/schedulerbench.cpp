@@ -0,0 +1,177 @@
+// Measure the sender's periodic scheduler on the host.
+//
+// Usage: schedulerbench [--iterations n] [--rate n] [--duration s]
+//
+// First times nextDue() and getNextDeadline() per call with MicroBench, on a
+// clock the benchmark steps and on the host clock. Then paces sends in real
+// time at --rate per second (default 1000) for --duration seconds (default
+// 5), sleeping until each deadline as the sender task does, and reports how
+// late sends were served, deadlines skipped, and the count against the ideal.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench/microbench.h"
+#include "stats/latency_histogram.h"
+#include "timing/host_clock.h"
+#include "timing/periodic_scheduler.h"
+
+// Clock the deadline-math stages step by hand, so nothing but the scheduler
+// is timed
+class SteppedClock : public MonotonicClock
+{
+public:
+    int64_t now_us = 0;
+
+    virtual int64_t nowMicros() const override
+    {
+        return now_us;
+    }
+};
+
+static HostClock hostClock;
+
+static int64_t hostNowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleepUntil(int64_t deadline_us)
+{
+    int64_t remaining_us = deadline_us - hostClock.nowMicros();
+    if (remaining_us > 0)
+    {
+        struct timespec ts;
+        ts.tv_sec = remaining_us / 1000000;
+        ts.tv_nsec = (remaining_us % 1000000) * 1000;
+        nanosleep(&ts, nullptr);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 2000000;
+    uint32_t rate = 1000;
+    double duration_s = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+        {
+            option = "";
+        }
+
+        if (strcmp(option, "--iterations") == 0)
+        {
+            iterations = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--rate") == 0)
+        {
+            rate = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--duration") == 0)
+        {
+            duration_s = atof(value);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--iterations n] [--rate n] [--duration s]\n", argv[0]);
+            return 2;
+        }
+        i++;
+    }
+
+    if (rate == 0 || duration_s <= 0)
+    {
+        fprintf(stderr, "--rate and --duration must be positive\n");
+        return 2;
+    }
+
+    BenchCounters counters = {hostNowNanos, nullptr, nullptr};
+    MicroBench bench(counters, iterations);
+
+    SteppedClock stepped;
+    PeriodicScheduler steppedScheduler(&stepped);
+    steppedScheduler.start(30);
+
+    bench.run("nextDue, due (30 Hz)", [&](uint32_t)
+    {
+        int64_t scheduled_us = 0;
+        stepped.now_us = steppedScheduler.getNextDeadline();
+        bool due = steppedScheduler.nextDue(scheduled_us);
+        benchKeep(due);
+        benchKeep(scheduled_us);
+    });
+
+    bench.run("nextDue, not due", [&](uint32_t)
+    {
+        int64_t scheduled_us = 0;
+        bool due = steppedScheduler.nextDue(scheduled_us);
+        benchKeep(due);
+    });
+
+    bench.run("nextDue, catch-up skip", [&](uint32_t)
+    {
+        int64_t scheduled_us = 0;
+        stepped.now_us += 1000000;
+        bool due = steppedScheduler.nextDue(scheduled_us);
+        benchKeep(due);
+    });
+
+    PeriodicScheduler hostScheduler(&hostClock);
+    hostScheduler.start(rate);
+
+    bench.run("nextDue (host clock)", [&](uint32_t)
+    {
+        int64_t scheduled_us = 0;
+        bool due = hostScheduler.nextDue(scheduled_us);
+        benchKeep(due);
+    });
+
+    printf("Scheduler: %lu iterations per stage\n", (unsigned long)bench.getIterations());
+    printf("%-32s %12s\n", "Stage", "ns/op");
+    for (size_t i = 0; i < bench.size(); i++)
+    {
+        const BenchResult &result = bench.result(i);
+        printf("%-32s %12.1f\n", result.name, result.nsPerOp);
+    }
+
+    // Real-time pacing, lateness of each send behind its deadline
+    LatencyHistogram<4, 20> lateness;
+    PeriodicScheduler scheduler(&hostClock);
+    scheduler.start(rate);
+    int64_t start_us = scheduler.getNextDeadline();
+    int64_t end_us = start_us + (int64_t)(duration_s * 1e6);
+    uint64_t sends = 0;
+    int64_t lastScheduled_us = start_us;
+
+    while (hostClock.nowMicros() < end_us)
+    {
+        sleepUntil(scheduler.getNextDeadline());
+
+        int64_t scheduled_us = 0;
+        while (scheduler.nextDue(scheduled_us))
+        {
+            lateness.record(hostClock.nowMicros() - scheduled_us);
+            lastScheduled_us = scheduled_us;
+            sends++;
+        }
+    }
+
+    // Deadlines up to the last one served, whether sent or skipped; deadline
+    // times are truncated, so round the index up
+    uint64_t expected = ((uint64_t)(lastScheduled_us - start_us) * rate + 999999) / 1000000 + 1;
+
+    printf("\nPacing:    %lu Hz for %.1f s on the host clock\n", (unsigned long)rate, duration_s);
+    printf("Sent:      %llu, skipped %lu, %llu deadlines to the last send\n", (unsigned long long)sends,
+           (unsigned long)scheduler.getMissedDeadlines(), (unsigned long long)expected);
+    printf("Late:      p50 %lld us, p99 %lld us, max %lld us\n", (long long)lateness.percentile(0.50),
+           (long long)lateness.percentile(0.99), (long long)lateness.getMax());
+
+    return sends + scheduler.getMissedDeadlines() == expected ? 0 : 1;
+}
@@ -0,0 +1,861 @@
+// Summarise range-test captures by distance, protocol and outage.
+//
+// Usage: loganalyze [options] capture [capture...]
+//   --threads n       worker threads (default: all cores)
+//   --bin m           distance bin width in metres (default 25)
+//   --max-distance m  last bin starts here (default 5000)
+//   --outage-ms n     reception gap counted as an outage (default 1000)
+//   --cell m          GeoJSON grid cell size in metres (default 25)
+//   --max-cells n     grid cells kept (default 100000)
+//   --max-outages n   outages kept (default 10000)
+//   --format f        auto, binary or csv (default auto)
+//   --bins file       per-protocol, per-bin table as CSV
+//   --outages file    outage list as CSV
+//   --geojson file    grid cells and outage starts as GeoJSON
+//
+// Captures are binary receiver logs (LOG_FORMAT=LOG_FORMAT_BINARY) or the
+// receiver's CSV lines, as printed on the console or by logdecode; several
+// are analysed as one run in the order given. Each is memory-mapped and cut
+// into one chunk per thread; pages are released as the threads pass them, and
+// every table is fixed size or capped, so memory stays flat however large
+// the capture. Per-sender sequence gaps give the loss, counted in the bin of
+// the packet that ended the gap. The summary goes to stdout, per-capture
+// notes to stderr.
+
+#include "range_analysis.h"
+#include "log/log_record.h"
+#include "util/geo.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Consumed input is handed back to the kernel in windows of this size
+static const size_t RELEASE_WINDOW = 8 * 1024 * 1024;
+
+// Chunks smaller than this are not worth a thread
+static const size_t MIN_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// CSV columns, as in ReceiverRole::formatCsvLine
+static const int CSV_FIELDS = 33;
+static const int CSV_RECEIVER_MS = 0;
+static const int CSV_PROTOCOL = 1;
+static const int CSV_SEQUENCE = 2;
+static const int CSV_SENDER_TS = 3;
+static const int CSV_RECEIVER_TS = 4;
+static const int CSV_LATENCY = 5;
+static const int CSV_RSSI = 6;
+static const int CSV_RX_LAT = 9;
+static const int CSV_RX_LON = 10;
+static const int CSV_TX_LAT = 14;
+static const int CSV_TX_LON = 15;
+static const int CSV_DISTANCE = 19;
+static const int CSV_NODE = 29;
+
+enum CaptureFormat
+{
+    FORMAT_AUTO,
+    FORMAT_BINARY,
+    FORMAT_CSV
+};
+
+struct ScanStats
+{
+    uint64_t records = 0;     // Frames or lines used
+    uint64_t senderRecords = 0;
+    uint64_t skipped = 0;     // Bytes outside frames, or lines that are not packets
+};
+
+// Releases the pages of a mapped range behind a reader
+class PageReleaser
+{
+public:
+    PageReleaser(const uint8_t *base, size_t begin) : base(base), released(alignDown(begin)) {}
+
+    void consumed(size_t offset)
+    {
+        size_t page = alignDown(offset);
+        if (page - released >= RELEASE_WINDOW)
+        {
+            madvise((void *)(base + released), page - released, MADV_DONTNEED);
+            released = page;
+        }
+    }
+
+private:
+    const uint8_t *base;
+    size_t released;
+
+    static size_t alignDown(size_t offset)
+    {
+        size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        return offset / pageSize * pageSize;
+    }
+};
+
+static bool isPlaced(int32_t latitude_e7, int32_t longitude_e7)
+{
+    return latitude_e7 != 0 || longitude_e7 != 0;
+}
+
+// Frames that start in [begin, end); a frame may run past end
+static void scanBinary(const uint8_t *data, size_t size, size_t begin, size_t end, ChunkAnalysis &chunk,
+                       ScanStats &stats)
+{
+    PageReleaser releaser(data, begin);
+    size_t offset = begin;
+
+    while (offset < end)
+    {
+        if (data[offset] != LogFrame::SYNC0)
+        {
+            const void *next = memchr(data + offset, LogFrame::SYNC0, end - offset);
+            size_t found = next ? (const uint8_t *)next - data : end;
+            stats.skipped += found - offset;
+            offset = found;
+            continue;
+        }
+
+        uint8_t type;
+        const uint8_t *body;
+        size_t bodyLength;
+        int length = LogFrame::decode(data + offset, size - offset, type, body, bodyLength);
+        if (length == 0)
+        {
+            // Truncated at the end of the capture
+            stats.skipped += size - offset;
+            break;
+        }
+        if (length < 0)
+        {
+            stats.skipped++;
+            offset++;
+            continue;
+        }
+
+        switch (type)
+        {
+        case LOG_RECORD_RX:
+        {
+            RxLogRecord r;
+            if (!r.decode(body, bodyLength))
+            {
+                break;
+            }
+
+            PacketSample packet;
+            packet.nodeId = r.nodeId;
+            packet.sequenceNumber = r.sequenceNumber;
+            packet.senderTimestamp_us = r.senderTimestamp_us;
+            packet.receiverTimestamp_us =
+                r.receiverTimestamp_us != 0 ? r.receiverTimestamp_us : (int64_t)r.receiverMillis * 1000;
+            packet.latency_us = r.latency_us();
+            packet.hasLatency = r.senderTimestamp_us != 0 && r.receiverTimestamp_us != 0;
+            packet.rssi_dBm = r.rssi_dBm;
+            packet.latitude = r.senderLatitude_e7 / 1e7;
+            packet.longitude = r.senderLongitude_e7 / 1e7;
+            packet.placed = isPlaced(r.receiverLatitude_e7, r.receiverLongitude_e7) &&
+                            isPlaced(r.senderLatitude_e7, r.senderLongitude_e7);
+            packet.distance_m = packet.placed ? haversineDistance(r.receiverLatitude_e7 / 1e7,
+                                                                  r.receiverLongitude_e7 / 1e7, packet.latitude,
+                                                                  packet.longitude)
+                                              : -1;
+            chunk.addPacket(packet);
+            stats.records++;
+            break;
+        }
+
+        case LOG_RECORD_SESSION:
+        {
+            SessionLogRecord r;
+            if (r.decode(body, bodyLength))
+            {
+                chunk.setProtocol(r.protocolName, strnlen(r.protocolName, sizeof(r.protocolName)));
+                stats.records++;
+            }
+            break;
+        }
+
+        case LOG_RECORD_LINK:
+        {
+            // Types as in Protocol::LinkEventType
+            LinkLogRecord r;
+            if (r.decode(body, bodyLength) && r.type == 2)
+            {
+                chunk.addLinkDown();
+            }
+            stats.records++;
+            break;
+        }
+
+        case LOG_RECORD_TX:
+        case LOG_RECORD_TX_DONE:
+            stats.senderRecords++;
+            break;
+
+        default:
+            break;
+        }
+
+        offset += length;
+        releaser.consumed(offset);
+    }
+}
+
+// Integer field; false if it is empty or not a number
+static bool parseInteger(const char *begin, const char *end, int64_t &value)
+{
+    bool negative = begin < end && *begin == '-';
+    const char *p = negative ? begin + 1 : begin;
+    if (p == end)
+    {
+        return false;
+    }
+
+    int64_t result = 0;
+    for (; p < end; p++)
+    {
+        if (*p < '0' || *p > '9')
+        {
+            return false;
+        }
+        result = result * 10 + (*p - '0');
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+// Fixed-point field as printed with %.Nf
+static bool parseDecimal(const char *begin, const char *end, double &value)
+{
+    bool negative = begin < end && *begin == '-';
+    const char *p = negative ? begin + 1 : begin;
+    if (p == end)
+    {
+        return false;
+    }
+
+    int64_t mantissa = 0;
+    double scale = 1.0;
+    bool fraction = false;
+    for (; p < end; p++)
+    {
+        if (*p == '.' && !fraction)
+        {
+            fraction = true;
+        }
+        else if (*p >= '0' && *p <= '9')
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (fraction)
+            {
+                scale *= 10.0;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    value = (negative ? -mantissa : mantissa) / scale;
+    return true;
+}
+
+// Packet lines of the receiver's CSV; anything else is skipped
+static bool parseCsvLine(const char *line, const char *end, ChunkAnalysis &chunk)
+{
+    const char *fields[CSV_FIELDS + 1];
+    int count = 0;
+    fields[count++] = line;
+    for (const char *p = line; p < end; p++)
+    {
+        if (*p == ',')
+        {
+            if (count == CSV_FIELDS)
+            {
+                return false;
+            }
+            fields[count++] = p + 1;
+        }
+    }
+    if (count != CSV_FIELDS)
+    {
+        return false;
+    }
+    fields[CSV_FIELDS] = end + 1;
+
+    // Field i runs to the comma before field i + 1
+    auto fieldEnd = [&](int i) { return fields[i + 1] - 1; };
+
+    int64_t receiverMillis, sequence, senderTs, receiverTs, latency, rssi, node;
+    double rxLat, rxLon, txLat, txLon, distance;
+    if (!parseInteger(fields[CSV_RECEIVER_MS], fieldEnd(CSV_RECEIVER_MS), receiverMillis) ||
+        !parseInteger(fields[CSV_SEQUENCE], fieldEnd(CSV_SEQUENCE), sequence) ||
+        !parseInteger(fields[CSV_SENDER_TS], fieldEnd(CSV_SENDER_TS), senderTs) ||
+        !parseInteger(fields[CSV_RECEIVER_TS], fieldEnd(CSV_RECEIVER_TS), receiverTs) ||
+        !parseInteger(fields[CSV_LATENCY], fieldEnd(CSV_LATENCY), latency) ||
+        !parseInteger(fields[CSV_RSSI], fieldEnd(CSV_RSSI), rssi) ||
+        !parseInteger(fields[CSV_NODE], fieldEnd(CSV_NODE), node) ||
+        !parseDecimal(fields[CSV_RX_LAT], fieldEnd(CSV_RX_LAT), rxLat) ||
+        !parseDecimal(fields[CSV_RX_LON], fieldEnd(CSV_RX_LON), rxLon) ||
+        !parseDecimal(fields[CSV_TX_LAT], fieldEnd(CSV_TX_LAT), txLat) ||
+        !parseDecimal(fields[CSV_TX_LON], fieldEnd(CSV_TX_LON), txLon) ||
+        !parseDecimal(fields[CSV_DISTANCE], fieldEnd(CSV_DISTANCE), distance))
+    {
+        return false;
+    }
+
+    chunk.setProtocol(fields[CSV_PROTOCOL], fieldEnd(CSV_PROTOCOL) - fields[CSV_PROTOCOL]);
+
+    PacketSample packet;
+    packet.nodeId = (uint16_t)node;
+    packet.sequenceNumber = (uint32_t)sequence;
+    packet.senderTimestamp_us = senderTs;
+    packet.receiverTimestamp_us = receiverTs != 0 ? receiverTs : receiverMillis * 1000;
+    packet.latency_us = latency;
+    packet.hasLatency = senderTs != 0 && receiverTs != 0;
+    packet.rssi_dBm = (int8_t)rssi;
+    packet.latitude = txLat;
+    packet.longitude = txLon;
+    packet.placed = (rxLat != 0 || rxLon != 0) && (txLat != 0 || txLon != 0);
+    packet.distance_m = packet.placed ? distance : -1;
+    chunk.addPacket(packet);
+    return true;
+}
+
+// Lines that start in [begin, end); a line may run past end
+static void scanCsv(const uint8_t *data, size_t size, size_t begin, size_t end, ChunkAnalysis &chunk,
+                    ScanStats &stats)
+{
+    PageReleaser releaser(data, begin);
+    const char *text = (const char *)data;
+    size_t offset = begin;
+
+    // The line that began before the chunk belongs to the previous one
+    if (begin > 0)
+    {
+        const void *newline = memchr(text + begin - 1, '\n', size - (begin - 1));
+        offset = newline ? (const char *)newline - text + 1 : size;
+    }
+
+    while (offset < end)
+    {
+        const void *newline = memchr(text + offset, '\n', size - offset);
+        size_t lineEnd = newline ? (const char *)newline - text : size;
+        size_t contentEnd = lineEnd > offset && text[lineEnd - 1] == '\r' ? lineEnd - 1 : lineEnd;
+
+        if (parseCsvLine(text + offset, text + contentEnd, chunk))
+        {
+            stats.records++;
+        }
+        else
+        {
+            stats.skipped++;
+        }
+
+        offset = lineEnd + 1;
+        releaser.consumed(offset);
+    }
+}
+
+// Binary if the start of the capture holds a valid frame
+static bool looksBinary(const uint8_t *data, size_t size)
+{
+    size_t limit = size < 65536 ? size : 65536;
+    for (size_t offset = 0; offset < limit; offset++)
+    {
+        uint8_t type;
+        const uint8_t *body;
+        size_t bodyLength;
+        if (data[offset] == LogFrame::SYNC0 && LogFrame::decode(data + offset, size - offset, type, body, bodyLength) > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Analyse one capture into the run's analysis. Returns false if it cannot be read.
+static bool analyzeCapture(const char *path, CaptureFormat format, unsigned threads, const AnalysisOptions &options,
+                           RangeAnalysis &analysis, uint64_t &bytes)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        perror(path);
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (size == 0)
+    {
+        close(fd);
+        fprintf(stderr, "%s: empty\n", path);
+        return true;
+    }
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        perror(path);
+        return false;
+    }
+    const uint8_t *data = (const uint8_t *)mapping;
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    bool binary = format == FORMAT_AUTO ? looksBinary(data, size) : format == FORMAT_BINARY;
+
+    size_t chunkCount = size / MIN_CHUNK_SIZE;
+    if (chunkCount > threads)
+    {
+        chunkCount = threads;
+    }
+    if (chunkCount == 0)
+    {
+        chunkCount = 1;
+    }
+
+    std::vector<ChunkAnalysis> chunks(chunkCount, ChunkAnalysis(options));
+    std::vector<ScanStats> stats(chunkCount);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        size_t begin = size / chunkCount * i;
+        size_t end = i + 1 == chunkCount ? size : size / chunkCount * (i + 1);
+        workers.emplace_back([=, &chunks, &stats]() {
+            if (binary)
+            {
+                scanBinary(data, size, begin, end, chunks[i], stats[i]);
+            }
+            else
+            {
+                scanCsv(data, size, begin, end, chunks[i], stats[i]);
+            }
+        });
+    }
+
+    ScanStats total;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        workers[i].join();
+        analysis.merge(chunks[i]);
+        total.records += stats[i].records;
+        total.senderRecords += stats[i].senderRecords;
+        total.skipped += stats[i].skipped;
+    }
+
+    munmap(mapping, size);
+    bytes += size;
+
+    if (binary)
+    {
+        fprintf(stderr, "%s: binary, %" PRIu64 " records, %" PRIu64 " sender records, %" PRIu64
+                        " bytes skipped, %zu chunks\n",
+                path, total.records, total.senderRecords, total.skipped, chunkCount);
+    }
+    else
+    {
+        fprintf(stderr, "%s: CSV, %" PRIu64 " packet lines, %" PRIu64 " other lines, %zu chunks\n", path,
+                total.records, total.skipped, chunkCount);
+    }
+    return true;
+}
+
+static double lossPercent(const DistanceBin &bin)
+{
+    int64_t lost = bin.lost > 0 ? bin.lost : 0;
+    int64_t sent = (int64_t)bin.received + lost;
+    return sent > 0 ? 100.0 * lost / sent : 0.0;
+}
+
+static double rssiMean(const DistanceBin &bin)
+{
+    return bin.received > 0 ? (double)bin.rssiSum / bin.received : 0.0;
+}
+
+static void formatTime(int64_t time_us, char *buffer, size_t length)
+{
+    // Receiver wall clock once it has one, milliseconds since boot before
+    if (time_us < 946684800LL * 1000000)
+    {
+        snprintf(buffer, length, "%.3f s", time_us / 1e6);
+        return;
+    }
+
+    time_t seconds = (time_t)(time_us / 1000000);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    size_t written = strftime(buffer, length, "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(buffer + written, length - written, ".%03dZ", (int)(time_us / 1000 % 1000));
+}
+
+static void printSummary(const RangeAnalysis &analysis, const AnalysisOptions &options)
+{
+    printf("%-20s %10s %9s %7s %8s %8s %8s %7s %6s %6s %8s %6s\n", "Protocol", "Received", "Lost", "Loss %",
+           "p50 us", "p90 us", "p99 us", "RSSI", "Late", "Dup", "Restarts", "Downs");
+    for (size_t p = 0; p < analysis.protocolCount(); p++)
+    {
+        const ProtocolStats &stats = analysis.protocol(p);
+        DistanceBin total = stats.total();
+        printf("%-20s %10" PRIu64 " %9" PRId64 " %7.2f %8" PRId64 " %8" PRId64 " %8" PRId64 " %7.1f %6" PRIu64
+               " %6" PRIu64 " %8" PRIu64 " %6" PRIu64 "\n",
+               analysis.protocolName(p).c_str(), total.received, total.lost, lossPercent(total),
+               total.latency.percentile(0.50), total.latency.percentile(0.90), total.latency.percentile(0.99),
+               rssiMean(total), stats.late, stats.duplicates, stats.restarts, stats.linkDowns);
+    }
+
+    for (size_t p = 0; p < analysis.protocolCount(); p++)
+    {
+        const ProtocolStats &stats = analysis.protocol(p);
+        printf("\n%s by distance\n", analysis.protocolName(p).c_str());
+        printf("%13s %10s %9s %7s %8s %8s %8s %7s %5s %5s\n", "Distance m", "Received", "Lost", "Loss %", "p50 us",
+               "p90 us", "p99 us", "RSSI", "Min", "Max");
+
+        for (uint32_t i = 0; i <= stats.bins.size(); i++)
+        {
+            const DistanceBin &bin = i < stats.bins.size() ? stats.bins[i] : stats.unplaced;
+            if (bin.received == 0)
+            {
+                continue;
+            }
+
+            char range[24];
+            if (i == stats.bins.size())
+            {
+                snprintf(range, sizeof(range), "no fix");
+            }
+            else if (i + 1 == stats.bins.size())
+            {
+                snprintf(range, sizeof(range), "%.0f+", analysis.binStart_m(i));
+            }
+            else
+            {
+                snprintf(range, sizeof(range), "%.0f-%.0f", analysis.binStart_m(i), analysis.binStart_m(i + 1));
+            }
+
+            printf("%13s %10" PRIu64 " %9" PRId64 " %7.2f %8" PRId64 " %8" PRId64 " %8" PRId64 " %7.1f %5d %5d\n",
+                   range, bin.received, bin.lost, lossPercent(bin), bin.latency.percentile(0.50),
+                   bin.latency.percentile(0.90), bin.latency.percentile(0.99), rssiMean(bin), bin.rssiMin,
+                   bin.rssiMax);
+        }
+    }
+
+    std::vector<Outage> outages = analysis.sortedOutages();
+    int64_t longest_us = 0;
+    int64_t total_us = 0;
+    for (const Outage &outage : outages)
+    {
+        int64_t duration_us = outage.end_us - outage.start_us;
+        total_us += duration_us;
+        if (duration_us > longest_us)
+        {
+            longest_us = duration_us;
+        }
+    }
+
+    printf("\nOutages over %.0f ms: %zu, longest %.0f ms, total %.1f s\n", options.outageGap_us / 1000.0,
+           outages.size(), longest_us / 1000.0, total_us / 1e6);
+    if (analysis.getDroppedOutages() > 0)
+    {
+        printf("  %" PRIu64 " more not kept (--max-outages)\n", analysis.getDroppedOutages());
+    }
+    for (const Outage &outage : outages)
+    {
+        char start[40];
+        formatTime(outage.start_us, start, sizeof(start));
+        char distance[16] = "no fix";
+        if (outage.distance_m >= 0)
+        {
+            snprintf(distance, sizeof(distance), "%.0f m", outage.distance_m);
+        }
+        printf("  node %-5u %-20s %-24s %9.0f ms %7" PRId64 " lost  %s\n", outage.nodeId,
+               analysis.protocolName(outage.protocol).c_str(), start, (outage.end_us - outage.start_us) / 1000.0,
+               outage.lost, distance);
+    }
+}
+
+static bool writeBins(const char *path, const RangeAnalysis &analysis)
+{
+    FILE *out = fopen(path, "w");
+    if (!out)
+    {
+        perror(path);
+        return false;
+    }
+
+    fprintf(out, "protocol,bin_start_m,bin_end_m,received,lost,loss_pct,latency_p50_us,latency_p90_us,"
+                 "latency_p99_us,rssi_mean_dbm,rssi_min_dbm,rssi_max_dbm\n");
+    for (size_t p = 0; p < analysis.protocolCount(); p++)
+    {
+        const ProtocolStats &stats = analysis.protocol(p);
+        for (uint32_t i = 0; i < stats.bins.size(); i++)
+        {
+            const DistanceBin &bin = stats.bins[i];
+            if (bin.received == 0)
+            {
+                continue;
+            }
+
+            // Empty end for the open last bin
+            char binEnd[16] = "";
+            if (i + 1 < stats.bins.size())
+            {
+                snprintf(binEnd, sizeof(binEnd), "%.0f", analysis.binStart_m(i + 1));
+            }
+            fprintf(out, "%s,%.0f,%s,%" PRIu64 ",%" PRId64 ",%.3f,%" PRId64 ",%" PRId64 ",%" PRId64 ",%.2f,%d,%d\n",
+                    analysis.protocolName(p).c_str(), analysis.binStart_m(i), binEnd, bin.received, bin.lost,
+                    lossPercent(bin), bin.latency.percentile(0.50), bin.latency.percentile(0.90),
+                    bin.latency.percentile(0.99), rssiMean(bin), bin.rssiMin, bin.rssiMax);
+        }
+    }
+
+    return fclose(out) == 0;
+}
+
+static bool writeOutages(const char *path, const RangeAnalysis &analysis)
+{
+    FILE *out = fopen(path, "w");
+    if (!out)
+    {
+        perror(path);
+        return false;
+    }
+
+    fprintf(out, "node,protocol,start_us,end_us,duration_ms,lost,tx_lat,tx_lon,distance_m\n");
+    for (const Outage &outage : analysis.sortedOutages())
+    {
+        char distance[16] = "";
+        if (outage.distance_m >= 0)
+        {
+            snprintf(distance, sizeof(distance), "%.2f", outage.distance_m);
+        }
+        fprintf(out, "%u,%s,%" PRId64 ",%" PRId64 ",%.1f,%" PRId64 ",%.7f,%.7f,%s\n", outage.nodeId,
+                analysis.protocolName(outage.protocol).c_str(), outage.start_us, outage.end_us,
+                (outage.end_us - outage.start_us) / 1000.0, outage.lost, outage.latitude, outage.longitude,
+                distance);
+    }
+
+    return fclose(out) == 0;
+}
+
+// Grid cells at the mean sender position of their packets, and outage starts
+static bool writeGeoJson(const char *path, const RangeAnalysis &analysis)
+{
+    FILE *out = fopen(path, "w");
+    if (!out)
+    {
+        perror(path);
+        return false;
+    }
+
+    fprintf(out, "{\"type\":\"FeatureCollection\",\"features\":[");
+    bool first = true;
+    for (const auto &entry : analysis.getCells())
+    {
+        const GridCell &cell = entry.second;
+        if (cell.received == 0)
+        {
+            continue;
+        }
+
+        int64_t lost = cell.lost > 0 ? cell.lost : 0;
+        fprintf(out,
+                "%s\n{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.7f,%.7f]},"
+                "\"properties\":{\"kind\":\"cell\",\"received\":%" PRIu64 ",\"lost\":%" PRId64
+                ",\"loss_pct\":%.2f,\"rssi_mean_dbm\":%.1f}}",
+                first ? "" : ",", cell.longitudeSum / cell.received, cell.latitudeSum / cell.received,
+                cell.received, lost, 100.0 * lost / (cell.received + lost), (double)cell.rssiSum / cell.received);
+        first = false;
+    }
+
+    for (const Outage &outage : analysis.sortedOutages())
+    {
+        if (outage.distance_m < 0)
+        {
+            continue;
+        }
+
+        fprintf(out,
+                "%s\n{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.7f,%.7f]},"
+                "\"properties\":{\"kind\":\"outage\",\"node\":%u,\"protocol\":\"%s\",\"start_us\":%" PRId64
+                ",\"duration_ms\":%.1f,\"lost\":%" PRId64 "}}",
+                first ? "" : ",", outage.longitude, outage.latitude, outage.nodeId,
+                analysis.protocolName(outage.protocol).c_str(), outage.start_us,
+                (outage.end_us - outage.start_us) / 1000.0, outage.lost);
+        first = false;
+    }
+    fprintf(out, "\n]}\n");
+
+    return fclose(out) == 0;
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [--threads n] [--bin m] [--max-distance m] [--outage-ms n] [--cell m]\n"
+            "       [--max-cells n] [--max-outages n] [--format auto|binary|csv]\n"
+            "       [--bins file] [--outages file] [--geojson file] capture [capture...]\n",
+            program);
+}
+
+int main(int argc, char **argv)
+{
+    AnalysisOptions options;
+    unsigned threads = std::thread::hardware_concurrency();
+    double maxDistance_m = 5000;
+    CaptureFormat format = FORMAT_AUTO;
+    const char *binsPath = nullptr;
+    const char *outagesPath = nullptr;
+    const char *geoJsonPath = nullptr;
+    std::vector<const char *> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *option = argv[i];
+        if (option[0] != '-' || option[1] == '\0')
+        {
+            paths.push_back(option);
+            continue;
+        }
+
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+
+        if (strcmp(option, "--threads") == 0)
+        {
+            threads = (unsigned)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--bin") == 0)
+        {
+            options.binSize_m = strtod(value, nullptr);
+        }
+        else if (strcmp(option, "--max-distance") == 0)
+        {
+            maxDistance_m = strtod(value, nullptr);
+        }
+        else if (strcmp(option, "--outage-ms") == 0)
+        {
+            options.outageGap_us = (int64_t)strtoul(value, nullptr, 10) * 1000;
+        }
+        else if (strcmp(option, "--cell") == 0)
+        {
+            options.cellSize_m = strtod(value, nullptr);
+        }
+        else if (strcmp(option, "--max-cells") == 0)
+        {
+            options.maxCells = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--max-outages") == 0)
+        {
+            options.maxOutages = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(option, "--format") == 0 && strcmp(value, "auto") == 0)
+        {
+            format = FORMAT_AUTO;
+        }
+        else if (strcmp(option, "--format") == 0 && strcmp(value, "binary") == 0)
+        {
+            format = FORMAT_BINARY;
+        }
+        else if (strcmp(option, "--format") == 0 && strcmp(value, "csv") == 0)
+        {
+            format = FORMAT_CSV;
+        }
+        else if (strcmp(option, "--bins") == 0)
+        {
+            binsPath = value;
+        }
+        else if (strcmp(option, "--outages") == 0)
+        {
+            outagesPath = value;
+        }
+        else if (strcmp(option, "--geojson") == 0)
+        {
+            geoJsonPath = value;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (paths.empty() || options.binSize_m <= 0 || options.cellSize_m <= 0 || maxDistance_m < 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Bins up to maxDistance_m, capped so a typo cannot take all memory
+    double binCount = ceil(maxDistance_m / options.binSize_m) + 1;
+    options.binCount = binCount < 4096 ? (uint32_t)binCount : 4096;
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+
+    struct timespec start, finish;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    RangeAnalysis analysis(options);
+    uint64_t bytes = 0;
+    for (const char *path : paths)
+    {
+        if (!analyzeCapture(path, format, threads, options, analysis, bytes))
+        {
+            return 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    double elapsed_s = (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1e9;
+    struct rusage resources;
+    getrusage(RUSAGE_SELF, &resources);
+    fprintf(stderr, "Analysed %.1f MB, %" PRIu64 " packets in %.2f s (%.0f MB/s, %u threads), peak memory %.1f MB\n",
+            bytes / 1e6, analysis.getPackets(), elapsed_s, elapsed_s > 0 ? bytes / 1e6 / elapsed_s : 0.0, threads,
+            resources.ru_maxrss / 1024.0);
+    if (analysis.getDroppedCells() > 0)
+    {
+        fprintf(stderr, "Grid full: %" PRIu64 " packets outside the kept cells (--max-cells)\n",
+                analysis.getDroppedCells());
+    }
+
+    printSummary(analysis, options);
+
+    bool ok = true;
+    if (binsPath)
+    {
+        ok = writeBins(binsPath, analysis) && ok;
+    }
+    if (outagesPath)
+    {
+        ok = writeOutages(outagesPath, analysis) && ok;
+    }
+    if (geoJsonPath)
+    {
+        ok = writeGeoJson(geoJsonPath, analysis) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,428 @@
+#include "range_analysis.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// A lower sequence number this far below the highest, from a sender without
+// a clock, is a restart rather than a late arrival
+static const uint32_t LATE_WINDOW = 1024;
+
+static const double METRES_PER_DEGREE = 111320.0;
+
+void DistanceBin::merge(const DistanceBin &other)
+{
+    received += other.received;
+    lost += other.lost;
+    rssiSum += other.rssiSum;
+    rssiMin = std::min(rssiMin, other.rssiMin);
+    rssiMax = std::max(rssiMax, other.rssiMax);
+    latency.merge(other.latency);
+}
+
+DistanceBin ProtocolStats::total() const
+{
+    DistanceBin sum;
+    for (const DistanceBin &bin : bins)
+    {
+        sum.merge(bin);
+    }
+    sum.merge(unplaced);
+    return sum;
+}
+
+void ProtocolStats::merge(const ProtocolStats &other)
+{
+    for (size_t i = 0; i < bins.size() && i < other.bins.size(); i++)
+    {
+        bins[i].merge(other.bins[i]);
+    }
+    unplaced.merge(other.unplaced);
+    duplicates += other.duplicates;
+    late += other.late;
+    restarts += other.restarts;
+    linkDowns += other.linkDowns;
+}
+
+SequenceState::Step SequenceState::step(const PacketSample &packet, uint32_t &gap) const
+{
+    gap = 0;
+    if (!seen)
+    {
+        return FIRST;
+    }
+
+    int32_t delta = (int32_t)(packet.sequenceNumber - highest);
+    if (delta > 0)
+    {
+        gap = (uint32_t)delta - 1;
+        return NEW;
+    }
+    if (delta == 0)
+    {
+        return DUPLICATE;
+    }
+
+    // Counting again from a lower number: a sweep slot or a reboot. A late
+    // packet was sent before the highest one; a restarted sender's was after.
+    bool timed = packet.senderTimestamp_us != 0 && highestTimestamp_us != 0;
+    if (timed ? packet.senderTimestamp_us > highestTimestamp_us : (uint32_t)-delta > LATE_WINDOW)
+    {
+        return RESTART;
+    }
+    return LATE;
+}
+
+bool SequenceState::isOutage(const PacketSample &packet, int64_t outageGap_us) const
+{
+    return seen && packet.receiverTimestamp_us - lastReceived_us > outageGap_us;
+}
+
+void SequenceState::advance(const PacketSample &packet, Step step)
+{
+    if (step == FIRST || step == NEW || step == RESTART)
+    {
+        highest = packet.sequenceNumber;
+        highestTimestamp_us = packet.senderTimestamp_us;
+    }
+
+    if (!seen || packet.receiverTimestamp_us > lastReceived_us)
+    {
+        lastReceived_us = packet.receiverTimestamp_us;
+        lastLatitude = packet.latitude;
+        lastLongitude = packet.longitude;
+        lastDistance_m = packet.placed ? packet.distance_m : -1;
+    }
+    seen = true;
+}
+
+// Grid cell of a position: rows of cellSize_m in latitude, columns of
+// cellSize_m in longitude at the row's latitude
+static uint64_t cellKey(double latitude, double longitude, double cellSize_m)
+{
+    double rowSize = cellSize_m / METRES_PER_DEGREE;
+    int32_t row = (int32_t)floor(latitude / rowSize);
+    double rowLatitude = (row + 0.5) * rowSize;
+    double columnSize = rowSize / std::max(cos(rowLatitude * M_PI / 180.0), 0.01);
+    int32_t column = (int32_t)floor(longitude / columnSize);
+    return ((uint64_t)(uint32_t)row << 32) | (uint32_t)column;
+}
+
+static Outage makeOutage(const SequenceState &state, const PacketSample &packet, uint32_t protocol, int64_t lost)
+{
+    Outage outage;
+    outage.nodeId = packet.nodeId;
+    outage.protocol = protocol;
+    outage.start_us = state.lastReceived_us;
+    outage.end_us = packet.receiverTimestamp_us;
+    outage.lost = lost;
+    outage.latitude = state.lastLatitude;
+    outage.longitude = state.lastLongitude;
+    outage.distance_m = state.lastDistance_m;
+    return outage;
+}
+
+ChunkAnalysis::ChunkAnalysis(const AnalysisOptions &options)
+    : options(options), current(PREFIX), packets(0), droppedCells(0), droppedOutages(0)
+{
+    protocolNames.push_back(std::string());
+    protocols.push_back(ProtocolStats(options.binCount));
+}
+
+void ChunkAnalysis::setProtocol(const char *name, size_t length)
+{
+    // CSV names every line, so the current protocol is the common case
+    const std::string &currentName = protocolNames[current];
+    if (current != PREFIX && currentName.size() == length && memcmp(currentName.data(), name, length) == 0)
+    {
+        return;
+    }
+
+    for (uint32_t i = PREFIX + 1; i < protocolNames.size(); i++)
+    {
+        if (protocolNames[i].size() == length && memcmp(protocolNames[i].data(), name, length) == 0)
+        {
+            current = i;
+            return;
+        }
+    }
+
+    protocolNames.push_back(std::string(name, length));
+    protocols.push_back(ProtocolStats(options.binCount));
+    current = (uint32_t)protocolNames.size() - 1;
+}
+
+DistanceBin &ChunkAnalysis::binFor(const PacketSample &packet, uint32_t protocol, int &index)
+{
+    ProtocolStats &stats = protocols[protocol];
+    if (!packet.placed)
+    {
+        index = -1;
+        return stats.unplaced;
+    }
+
+    double bin = packet.distance_m / options.binSize_m;
+    index = bin < options.binCount - 1 ? (int)bin : (int)options.binCount - 1;
+    return stats.bins[index];
+}
+
+GridCell *ChunkAnalysis::cellFor(const PacketSample &packet, uint64_t &key)
+{
+    if (!packet.placed)
+    {
+        return nullptr;
+    }
+
+    key = cellKey(packet.latitude, packet.longitude, options.cellSize_m);
+    auto it = cells.find(key);
+    if (it != cells.end())
+    {
+        return &it->second;
+    }
+    if (cells.size() >= options.maxCells)
+    {
+        droppedCells++;
+        return nullptr;
+    }
+    return &cells[key];
+}
+
+void ChunkAnalysis::addPacket(const PacketSample &packet)
+{
+    auto inserted = nodes.emplace(packet.nodeId, NodeEdge());
+    NodeEdge &node = inserted.first->second;
+
+    uint32_t gap;
+    SequenceState::Step step = node.state.step(packet, gap);
+    ProtocolStats &stats = protocols[current];
+
+    if (step == SequenceState::DUPLICATE)
+    {
+        stats.duplicates++;
+        return;
+    }
+
+    if (node.state.isOutage(packet, options.outageGap_us))
+    {
+        if (outages.size() < options.maxOutages)
+        {
+            outages.push_back(makeOutage(node.state, packet, current, gap));
+        }
+        else
+        {
+            droppedOutages++;
+        }
+    }
+
+    int binIndex;
+    DistanceBin &bin = binFor(packet, current, binIndex);
+    uint64_t key = 0;
+    GridCell *cell = cellFor(packet, key);
+
+    // Missing sequence numbers are put where the packet after them arrived
+    int64_t lost = 0;
+    if (step == SequenceState::NEW)
+    {
+        lost = gap;
+    }
+    else if (step == SequenceState::LATE)
+    {
+        lost = -1;
+        stats.late++;
+    }
+    else if (step == SequenceState::RESTART)
+    {
+        stats.restarts++;
+    }
+    else
+    {
+        node.first = packet;
+        node.firstProtocol = current;
+        node.firstBin = binIndex;
+        node.firstInGrid = cell != nullptr;
+        node.firstCell = key;
+    }
+
+    packets++;
+    bin.received++;
+    bin.lost += lost;
+    bin.rssiSum += packet.rssi_dBm;
+    bin.rssiMin = std::min(bin.rssiMin, (int)packet.rssi_dBm);
+    bin.rssiMax = std::max(bin.rssiMax, (int)packet.rssi_dBm);
+    if (packet.hasLatency)
+    {
+        bin.latency.record(packet.latency_us);
+    }
+
+    if (cell)
+    {
+        cell->received++;
+        cell->lost += lost;
+        cell->rssiSum += packet.rssi_dBm;
+        cell->latitudeSum += packet.latitude;
+        cell->longitudeSum += packet.longitude;
+    }
+
+    node.state.advance(packet, step);
+}
+
+void ChunkAnalysis::addLinkDown()
+{
+    protocols[current].linkDowns++;
+}
+
+RangeAnalysis::RangeAnalysis(const AnalysisOptions &options)
+    : options(options), current(-1), packets(0), droppedCells(0), droppedOutages(0)
+{
+}
+
+uint32_t RangeAnalysis::protocolIndex(const std::string &name)
+{
+    for (uint32_t i = 0; i < protocolNames.size(); i++)
+    {
+        if (protocolNames[i] == name)
+        {
+            return i;
+        }
+    }
+
+    protocolNames.push_back(name);
+    protocols.push_back(ProtocolStats(options.binCount));
+    return (uint32_t)protocolNames.size() - 1;
+}
+
+void RangeAnalysis::addCell(uint64_t key, const GridCell &cell)
+{
+    auto it = cells.find(key);
+    if (it == cells.end())
+    {
+        if (cells.size() >= options.maxCells)
+        {
+            droppedCells += cell.received;
+            return;
+        }
+        it = cells.emplace(key, GridCell()).first;
+    }
+
+    GridCell &sum = it->second;
+    sum.received += cell.received;
+    sum.lost += cell.lost;
+    sum.rssiSum += cell.rssiSum;
+    sum.latitudeSum += cell.latitudeSum;
+    sum.longitudeSum += cell.longitudeSum;
+}
+
+void RangeAnalysis::addOutage(const Outage &outage)
+{
+    if (outages.size() < options.maxOutages)
+    {
+        outages.push_back(outage);
+    }
+    else
+    {
+        droppedOutages++;
+    }
+}
+
+void RangeAnalysis::merge(ChunkAnalysis &chunk)
+{
+    // Records before the chunk's first session record continue the session
+    // the previous chunk ended in
+    std::vector<uint32_t> global(chunk.protocolNames.size());
+    if (current < 0 && chunk.protocols[ChunkAnalysis::PREFIX].total().received > 0)
+    {
+        current = (int)protocolIndex("unknown");
+    }
+    global[ChunkAnalysis::PREFIX] = current < 0 ? 0 : (uint32_t)current;
+    for (uint32_t i = ChunkAnalysis::PREFIX + 1; i < chunk.protocolNames.size(); i++)
+    {
+        global[i] = protocolIndex(chunk.protocolNames[i]);
+    }
+
+    for (uint32_t i = 0; i < chunk.protocols.size(); i++)
+    {
+        if (i != ChunkAnalysis::PREFIX || current >= 0)
+        {
+            protocols[global[i]].merge(chunk.protocols[i]);
+        }
+    }
+
+    // Each sender's first packet in the chunk was counted without knowing
+    // what came before; settle it against where the sender left off
+    for (auto &entry : chunk.nodes)
+    {
+        ChunkAnalysis::NodeEdge &edge = entry.second;
+        SequenceState &state = nodes[entry.first];
+        const PacketSample &first = edge.first;
+        ProtocolStats &stats = protocols[global[edge.firstProtocol]];
+        DistanceBin &bin = edge.firstBin < 0 ? stats.unplaced : stats.bins[edge.firstBin];
+
+        uint32_t gap;
+        SequenceState::Step step = state.step(first, gap);
+        int64_t lost = 0;
+        if (step == SequenceState::NEW)
+        {
+            lost = gap;
+        }
+        else if (step == SequenceState::LATE)
+        {
+            lost = -1;
+            stats.late++;
+        }
+        else if (step == SequenceState::RESTART)
+        {
+            stats.restarts++;
+        }
+        else if (step == SequenceState::DUPLICATE)
+        {
+            // Counted as received by the chunk
+            bin.received--;
+            stats.duplicates++;
+            packets--;
+        }
+
+        if (step != SequenceState::DUPLICATE && state.isOutage(first, options.outageGap_us))
+        {
+            addOutage(makeOutage(state, first, global[edge.firstProtocol], gap));
+        }
+
+        bin.lost += lost;
+        if (lost != 0 && edge.firstInGrid)
+        {
+            GridCell correction;
+            correction.lost = lost;
+            addCell(edge.firstCell, correction);
+        }
+
+        state = edge.state;
+    }
+
+    for (const Outage &outage : chunk.outages)
+    {
+        Outage merged = outage;
+        merged.protocol = global[outage.protocol];
+        addOutage(merged);
+    }
+
+    for (const auto &entry : chunk.cells)
+    {
+        addCell(entry.first, entry.second);
+    }
+
+    packets += chunk.packets;
+    droppedCells += chunk.droppedCells;
+    droppedOutages += chunk.droppedOutages;
+
+    if (chunk.current != ChunkAnalysis::PREFIX)
+    {
+        current = (int)global[chunk.current];
+    }
+}
+
+std::vector<Outage> RangeAnalysis::sortedOutages() const
+{
+    std::vector<Outage> sorted = outages;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Outage &a, const Outage &b) { return a.start_us < b.start_us; });
+    return sorted;
+}
@@ -0,0 +1,242 @@
+#ifndef RANGE_ANALYSIS_H
+#define RANGE_ANALYSIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "stats/latency_histogram.h"
+
+// Streaming range-test statistics for loganalyze.
+//
+// A capture is cut into chunks that are analysed in parallel, each into a
+// ChunkAnalysis, and the chunks are merged in capture order into one
+// RangeAnalysis. Everything is fixed size or capped by AnalysisOptions, so
+// memory does not grow with the capture. What a chunk cannot know on its own
+// (the session its first records belong to, the sequence numbers just before
+// it) is kept at its edges and settled by the merge.
+
+struct AnalysisOptions
+{
+    double binSize_m = 25.0;
+    uint32_t binCount = 201;         // The last bin collects everything beyond
+    double cellSize_m = 25.0;        // GeoJSON grid
+    uint32_t maxCells = 100000;      // Per chunk and in total
+    int64_t outageGap_us = 1000000;  // Reception gap counted as an outage
+    uint32_t maxOutages = 10000;     // Per chunk and in total
+};
+
+// ~6% resolution up to ~33 s in 1.4 KB per distance bin
+typedef LatencyHistogram<5, 20> BinLatencyHistogram;
+
+// One received packet, from a binary RX record or a CSV line
+struct PacketSample
+{
+    uint16_t nodeId;
+    uint32_t sequenceNumber;
+    int64_t senderTimestamp_us;   // 0 if the sender had no clock
+    int64_t receiverTimestamp_us; // Receive time, for outages
+    int64_t latency_us;
+    bool hasLatency;
+    int8_t rssi_dBm;
+    bool placed;                  // Both positions known
+    double distance_m;
+    double latitude;              // Sender position
+    double longitude;
+};
+
+struct DistanceBin
+{
+    uint64_t received = 0;
+    int64_t lost = 0; // Late arrivals are taken back, so a bin can briefly go negative
+    int64_t rssiSum = 0;
+    int rssiMin = 127;
+    int rssiMax = -128;
+    BinLatencyHistogram latency;
+
+    void merge(const DistanceBin &other);
+};
+
+struct ProtocolStats
+{
+    std::vector<DistanceBin> bins;
+    DistanceBin unplaced; // Packets without a position fix at either end
+    uint64_t duplicates = 0;
+    uint64_t late = 0;     // Arrived after a later sequence number
+    uint64_t restarts = 0; // Sender started counting again
+    uint64_t linkDowns = 0;
+
+    explicit ProtocolStats(uint32_t binCount) : bins(binCount) {}
+
+    DistanceBin total() const;
+    void merge(const ProtocolStats &other);
+};
+
+struct GridCell
+{
+    uint64_t received = 0;
+    int64_t lost = 0;
+    int64_t rssiSum = 0;
+    double latitudeSum = 0;
+    double longitudeSum = 0;
+};
+
+struct Outage
+{
+    uint16_t nodeId;
+    uint32_t protocol; // Chunk-local index until merged
+    int64_t start_us;  // Last packet before the gap, receiver clock
+    int64_t end_us;    // First packet after it
+    int64_t lost;      // Sequence numbers missing across the gap
+    double latitude;   // Sender position at the start
+    double longitude;
+    double distance_m; // -1 if unknown
+};
+
+// Sequence and timing state of one sender
+struct SequenceState
+{
+    enum Step
+    {
+        FIRST,
+        NEW,
+        DUPLICATE,
+        LATE,
+        RESTART
+    };
+
+    bool seen = false;
+    uint32_t highest = 0;
+    int64_t highestTimestamp_us = 0;
+    int64_t lastReceived_us = 0;
+    double lastLatitude = 0;
+    double lastLongitude = 0;
+    double lastDistance_m = -1;
+
+    // Classify the next packet; gap is the number of sequence numbers it skips
+    Step step(const PacketSample &packet, uint32_t &gap) const;
+
+    // True if the packet follows a reception gap long enough to be an outage
+    bool isOutage(const PacketSample &packet, int64_t outageGap_us) const;
+
+    void advance(const PacketSample &packet, Step step);
+};
+
+// Analysis of one chunk of a capture
+class ChunkAnalysis
+{
+public:
+    // Records before the chunk's first session record; the merge assigns
+    // them to the session that was current where the previous chunk ended
+    static const uint32_t PREFIX = 0;
+
+    explicit ChunkAnalysis(const AnalysisOptions &options);
+
+    // Protocol of the records that follow: session records, CSV column
+    void setProtocol(const char *name, size_t length);
+    void addPacket(const PacketSample &packet);
+    void addLinkDown();
+
+    uint64_t getPackets() const
+    {
+        return packets;
+    }
+
+private:
+    friend class RangeAnalysis;
+
+    // First packet of a sender in the chunk, where it was counted
+    struct NodeEdge
+    {
+        SequenceState state;
+        PacketSample first;
+        uint32_t firstProtocol;
+        int firstBin; // -1 if unplaced
+        bool firstInGrid;
+        uint64_t firstCell;
+    };
+
+    const AnalysisOptions &options;
+    std::vector<std::string> protocolNames; // [PREFIX] is empty
+    std::vector<ProtocolStats> protocols;
+    uint32_t current;
+    std::unordered_map<uint16_t, NodeEdge> nodes;
+    std::unordered_map<uint64_t, GridCell> cells;
+    std::vector<Outage> outages;
+    uint64_t packets;
+    uint64_t droppedCells;
+    uint64_t droppedOutages;
+
+    DistanceBin &binFor(const PacketSample &packet, uint32_t protocol, int &index);
+    GridCell *cellFor(const PacketSample &packet, uint64_t &key);
+};
+
+// Merged analysis of a whole capture, or several captures in order
+class RangeAnalysis
+{
+public:
+    explicit RangeAnalysis(const AnalysisOptions &options);
+
+    // Merge the next chunk in capture order
+    void merge(ChunkAnalysis &chunk);
+
+    // Protocols in the order they first appeared
+    size_t protocolCount() const
+    {
+        return protocolNames.size();
+    }
+    const std::string &protocolName(size_t index) const
+    {
+        return protocolNames[index];
+    }
+    const ProtocolStats &protocol(size_t index) const
+    {
+        return protocols[index];
+    }
+
+    // Outages sorted by start time
+    std::vector<Outage> sortedOutages() const;
+
+    const std::unordered_map<uint64_t, GridCell> &getCells() const
+    {
+        return cells;
+    }
+
+    uint64_t getPackets() const
+    {
+        return packets;
+    }
+    uint64_t getDroppedCells() const
+    {
+        return droppedCells;
+    }
+    uint64_t getDroppedOutages() const
+    {
+        return droppedOutages;
+    }
+
+    // Distance range of bin i, in metres; the last bin has no upper end
+    double binStart_m(uint32_t index) const
+    {
+        return index * options.binSize_m;
+    }
+
+private:
+    const AnalysisOptions &options;
+    std::vector<std::string> protocolNames;
+    std::vector<ProtocolStats> protocols;
+    int current; // Session at the end of the chunks merged so far, -1 before any
+    std::unordered_map<uint16_t, SequenceState> nodes;
+    std::unordered_map<uint64_t, GridCell> cells;
+    std::vector<Outage> outages;
+    uint64_t packets;
+    uint64_t droppedCells;
+    uint64_t droppedOutages;
+
+    uint32_t protocolIndex(const std::string &name);
+    void addCell(uint64_t key, const GridCell &cell);
+    void addOutage(const Outage &outage);
+};
+
+#endif // RANGE_ANALYSIS_H
@@ -0,0 +1,262 @@
+// Decode a binary receiver log capture (LOG_FORMAT=LOG_FORMAT_BINARY) back
+// into the CSV columns printed by ReceiverRole::logPacketData. Sender
+// records are counted and left to logjoin.
+//
+// Usage: logdecode [--header] [capture.bin]   (reads stdin if no file given)
+//
+// Bytes that do not belong to a valid frame (console text, corruption) are
+// skipped; a summary is printed to stderr at the end.
+
+#include "log/log_record.h"
+#include "protocol/phy_rate.h"
+#include "util/geo.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char *CSV_HEADER =
+    "receiver_ms,protocol,sequence,sender_ts_us,receiver_ts_us,latency_us,rssi_dbm,"
+    "tx_power_dbm,channel,rx_lat,rx_lon,rx_alt_m,rx_sats,rx_hacc_m,"
+    "tx_lat,tx_lon,tx_alt_m,tx_sats,tx_hacc_m,distance_m,send_lag_us,step,clock_offset_us,"
+    "noise_floor_dbm,snr_db,phy,rate,bw_mhz,radio_ts_us,node,slot,batch,batch_delay_us";
+
+struct DecodeStats
+{
+    uint64_t rxRecords = 0;
+    uint64_t sessionRecords = 0;
+    uint64_t linkRecords = 0;
+    uint64_t senderRecords = 0; // TX and completion records, see logjoin
+    uint64_t unknownRecords = 0;
+    uint64_t skippedBytes = 0;
+};
+
+// Link events go to stderr with the other per-run notes; types as in Protocol::LinkEventType
+static void printLinkRecord(const LinkLogRecord &r)
+{
+    switch (r.type)
+    {
+    case 1:
+        fprintf(stderr, "Link at %" PRIu32 " ms: first frame %" PRIu32 " ms after start\n", r.receiverMillis, r.duration_ms);
+        break;
+
+    case 2:
+        fprintf(stderr, "Link at %" PRIu32 " ms: down, reason %u\n", r.receiverMillis, r.reason);
+        break;
+
+    case 3:
+        fprintf(stderr, "Link at %" PRIu32 " ms: up after %" PRIu32 " ms outage\n", r.receiverMillis, r.duration_ms);
+        break;
+
+    case 4:
+        fprintf(stderr, "Link at %" PRIu32 " ms: unicast peer found %" PRIu32 " ms after start\n", r.receiverMillis, r.duration_ms);
+        break;
+
+    default:
+        fprintf(stderr, "Link at %" PRIu32 " ms: unknown event %u\n", r.receiverMillis, r.type);
+        break;
+    }
+}
+
+static void printRxRecord(const RxLogRecord &r, const SessionLogRecord &session)
+{
+    double rxLat = r.receiverLatitude_e7 / 1e7;
+    double rxLon = r.receiverLongitude_e7 / 1e7;
+    double txLat = r.senderLatitude_e7 / 1e7;
+    double txLon = r.senderLongitude_e7 / 1e7;
+
+    // Empty column when the sender has no clock offset estimate
+    char clockOffset[12] = "";
+    if (r.clockOffset_us != INT32_MIN)
+    {
+        snprintf(clockOffset, sizeof(clockOffset), "%" PRId32, r.clockOffset_us);
+    }
+
+    // Empty column outside a protocol sweep
+    char sweepSlot[12] = "";
+    if (session.sweepSlot != SessionLogRecord::NO_SLOT)
+    {
+        snprintf(sweepSlot, sizeof(sweepSlot), "%" PRIu32, session.sweepSlot);
+    }
+
+    printf("%" PRIu32 ",%s,%" PRIu32 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%d,%d,%d,"
+           "%.6f,%.6f,%.2f,%u,%.2f,%.6f,%.6f,%.2f,%u,%.2f,%.2f,%" PRId32 ",%u,%s,%d,%d,%u,%u,%u,%" PRIu32 ",%u,%s,%u,%" PRId32 "\n",
+           r.receiverMillis,
+           session.protocolName,
+           r.sequenceNumber,
+           r.senderTimestamp_us,
+           r.receiverTimestamp_us,
+           r.latency_us(),
+           r.rssi_dBm,
+           session.txPower_dBm,
+           session.channel,
+           rxLat,
+           rxLon,
+           r.receiverAltitude_mm / 1000.0f,
+           r.receiverSatellites,
+           r.receiverHorizontalAccuracy_mm / 1000.0f,
+           txLat,
+           txLon,
+           r.senderAltitude_mm / 1000.0f,
+           r.senderSatellites,
+           r.senderHorizontalAccuracy_mm / 1000.0f,
+           haversineDistance(rxLat, rxLon, txLat, txLon),
+           r.sendLag_us,
+           r.stepId,
+           clockOffset,
+           r.noiseFloor_dBm,
+           r.noiseFloor_dBm != 0 ? r.rssi_dBm - r.noiseFloor_dBm : 0,
+           r.phyMode,
+           r.phyRate,
+           r.bandwidth_MHz,
+           r.radioTimestamp_us,
+           r.nodeId,
+           sweepSlot,
+           r.aggregateCount,
+           r.batchDelay_us);
+}
+
+int main(int argc, char **argv)
+{
+    bool header = false;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--header") == 0)
+        {
+            header = true;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            fprintf(stderr, "Usage: %s [--header] [capture.bin]\n", argv[0]);
+            return 2;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+
+    FILE *in = path ? fopen(path, "rb") : stdin;
+    if (!in)
+    {
+        perror(path);
+        return 1;
+    }
+
+    if (header)
+    {
+        puts(CSV_HEADER);
+    }
+
+    SessionLogRecord session;
+    memset(&session, 0, sizeof(session));
+    strcpy(session.protocolName, "unknown");
+    session.sweepSlot = SessionLogRecord::NO_SLOT;
+    uint32_t reportedEspnowSettings = 0; // None yet
+
+    DecodeStats stats;
+    std::vector<uint8_t> buffer;
+    buffer.reserve(1 << 16);
+    uint8_t chunk[1 << 15];
+    size_t offset = 0;
+    bool eof = false;
+
+    while (!eof || offset < buffer.size())
+    {
+        // Refill when less than one maximum frame remains
+        if (!eof && buffer.size() - offset < LogFrame::MAX_BODY_SIZE + LogFrame::OVERHEAD)
+        {
+            buffer.erase(buffer.begin(), buffer.begin() + offset);
+            offset = 0;
+
+            size_t n = fread(chunk, 1, sizeof(chunk), in);
+            buffer.insert(buffer.end(), chunk, chunk + n);
+            eof = (n == 0);
+            continue;
+        }
+
+        uint8_t type;
+        const uint8_t *body;
+        size_t bodyLength;
+        int frameLength = LogFrame::decode(&buffer[offset], buffer.size() - offset, type, body, bodyLength);
+
+        if (frameLength == 0 && eof)
+        {
+            // Truncated frame at the end of the capture
+            stats.skippedBytes += buffer.size() - offset;
+            break;
+        }
+
+        if (frameLength <= 0)
+        {
+            stats.skippedBytes++;
+            offset++;
+            continue;
+        }
+
+        if (type == LOG_RECORD_RX)
+        {
+            RxLogRecord record;
+            if (record.decode(body, bodyLength))
+            {
+                printRxRecord(record, session);
+                stats.rxRecords++;
+            }
+        }
+        else if (type == LOG_RECORD_SESSION)
+        {
+            uint32_t previousSlot = session.sweepSlot;
+            if (session.decode(body, bodyLength))
+            {
+                stats.sessionRecords++;
+
+                // ESP-NOW link settings, once per change; protocolType 4 is ESP-NOW
+                uint32_t espnowSettings = 0x1000000u | session.espnowUnicast << 16 | session.espnowRate << 8 | session.espnowRetries;
+                if (session.protocolType == 4 && espnowSettings != reportedEspnowSettings)
+                {
+                    reportedEspnowSettings = espnowSettings;
+                    fprintf(stderr, "ESP-NOW: %s, PHY rate %s, %u retries\n", session.espnowUnicast ? "unicast" : "broadcast",
+                            PhyRate::name(session.espnowRate), session.espnowRetries);
+                }
+
+                // Sessions repeat every statistics period; report each sweep slot once
+                if (session.sweepSlot != SessionLogRecord::NO_SLOT && session.sweepSlot != previousSlot)
+                {
+                    fprintf(stderr, "Sweep slot %" PRIu32 ": %s, started in %" PRIu32 " ms\n",
+                            session.sweepSlot, session.protocolName, session.protocolStart_ms);
+                }
+            }
+        }
+        else if (type == LOG_RECORD_LINK)
+        {
+            LinkLogRecord record;
+            if (record.decode(body, bodyLength))
+            {
+                printLinkRecord(record);
+                stats.linkRecords++;
+            }
+        }
+        else if (type == LOG_RECORD_TX || type == LOG_RECORD_TX_DONE)
+        {
+            stats.senderRecords++;
+        }
+        else
+        {
+            stats.unknownRecords++;
+        }
+
+        offset += frameLength;
+    }
+
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+
+    fprintf(stderr, "Decoded %" PRIu64 " packet records, %" PRIu64 " session records, %" PRIu64 " link records, %" PRIu64 " sender records, %" PRIu64 " unknown; skipped %" PRIu64 " bytes\n",
+            stats.rxRecords, stats.sessionRecords, stats.linkRecords, stats.senderRecords, stats.unknownRecords, stats.skippedBytes);
+    return 0;
+}
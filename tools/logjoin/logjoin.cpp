@@ -0,0 +1,416 @@
+// Join sender and receiver binary logs (LOG_FORMAT=LOG_FORMAT_BINARY) into
+// one row per packet the sender scheduled.
+//
+// Usage: logjoin [--header] receiver.bin sender.bin [sender.bin...]
+//
+// Each sender TX record is matched to the receiver's RX records on node id,
+// sequence number and sender timestamp, which stays unique across sessions
+// and reboots, and to the driver's completion for its frame. The outcome
+// column tells the ways a packet can go missing apart:
+//   received     at least one copy reached the receiver
+//   send_failed  the protocol refused it (queue full, driver error)
+//   not_acked    a unicast frame the receiver never acknowledged
+//   lost         sent, but never received
+// A per-node summary and the receiver records no sender log accounts for
+// (usually sender log drops) go to stderr.
+
+#include "log/log_record.h"
+#include "util/geo.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+static const char *CSV_HEADER =
+    "node,protocol,slot,sequence,type,step,payload,sender_ts_us,scheduled_us,send_lag_us,send_call_us,in_flight,"
+    "result,tx_done,attempts,tx_latency_us,copies,receiver_ts_us,latency_us,rssi_dbm,snr_db,"
+    "tx_lat,tx_lon,tx_alt_m,rx_lat,rx_lon,distance_m,outcome";
+
+// Packet identity shared by TX and RX records
+struct PacketKey
+{
+    uint16_t nodeId;
+    uint32_t sequenceNumber;
+    int64_t senderTimestamp_us;
+
+    bool operator==(const PacketKey &other) const
+    {
+        return nodeId == other.nodeId && sequenceNumber == other.sequenceNumber &&
+               senderTimestamp_us == other.senderTimestamp_us;
+    }
+};
+
+struct PacketKeyHash
+{
+    size_t operator()(const PacketKey &key) const
+    {
+        uint64_t h = (uint64_t)key.senderTimestamp_us * 0x9E3779B97F4A7C15ull;
+        return (size_t)(h ^ ((uint64_t)key.nodeId << 32 | key.sequenceNumber));
+    }
+};
+
+// Receiver side of one packet: the first copy, and how many arrived
+struct Reception
+{
+    RxLogRecord first;
+    uint32_t copies;
+    bool matched;
+};
+
+// Sender side of one packet
+struct TxRow
+{
+    TxLogRecord tx;
+    SessionLogRecord session;
+    bool hasCompletion;
+    TxDoneLogRecord completion;
+};
+
+struct NodeSummary
+{
+    uint64_t packets = 0;
+    uint64_t received = 0;
+    uint64_t sendFailed = 0;
+    uint64_t notAcked = 0;
+    uint64_t lost = 0;
+};
+
+// Call handler(type, body, length) for every valid frame in a capture.
+// Returns false if the file cannot be read.
+template <typename Handler>
+static bool readCapture(const char *path, Handler handler)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in)
+    {
+        perror(path);
+        return false;
+    }
+
+    std::vector<uint8_t> buffer;
+    buffer.reserve(1 << 16);
+    uint8_t chunk[1 << 15];
+    size_t offset = 0;
+    bool eof = false;
+
+    while (!eof || offset < buffer.size())
+    {
+        // Refill when less than one maximum frame remains
+        if (!eof && buffer.size() - offset < LogFrame::MAX_BODY_SIZE + LogFrame::OVERHEAD)
+        {
+            buffer.erase(buffer.begin(), buffer.begin() + offset);
+            offset = 0;
+
+            size_t n = fread(chunk, 1, sizeof(chunk), in);
+            buffer.insert(buffer.end(), chunk, chunk + n);
+            eof = (n == 0);
+            continue;
+        }
+
+        uint8_t type;
+        const uint8_t *body;
+        size_t bodyLength;
+        int frameLength = LogFrame::decode(&buffer[offset], buffer.size() - offset, type, body, bodyLength);
+        if (frameLength == 0 && eof)
+        {
+            break; // Truncated frame at the end of the capture
+        }
+        if (frameLength <= 0)
+        {
+            offset++;
+            continue;
+        }
+
+        handler(type, body, bodyLength);
+        offset += frameLength;
+    }
+
+    fclose(in);
+    return true;
+}
+
+static SessionLogRecord unknownSession()
+{
+    SessionLogRecord session;
+    memset(&session, 0, sizeof(session));
+    strcpy(session.protocolName, "unknown");
+    session.sweepSlot = SessionLogRecord::NO_SLOT;
+    session.aggregateRecords = 1;
+    return session;
+}
+
+// An aggregate frame's completion is logged under its first packet. The
+// packets queued after it share it, up to the session's frame size, until
+// a packet with its own completion starts the next frame.
+static void shareAggregateCompletions(std::vector<TxRow> &rows)
+{
+    const TxRow *frameStart = nullptr;
+    for (TxRow &row : rows)
+    {
+        if (row.tx.result != TxLogRecord::QUEUED)
+        {
+            frameStart = nullptr;
+        }
+        else if (row.hasCompletion)
+        {
+            frameStart = &row;
+        }
+        else if (frameStart && frameStart->tx.nodeId == row.tx.nodeId &&
+                 row.tx.sequenceNumber - frameStart->tx.sequenceNumber < row.session.aggregateRecords)
+        {
+            row.hasCompletion = true;
+            row.completion = frameStart->completion;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool header = false;
+    std::vector<const char *> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--header") == 0)
+        {
+            header = true;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            paths.clear();
+            break;
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.size() < 2)
+    {
+        fprintf(stderr, "Usage: %s [--header] receiver.bin sender.bin [sender.bin...]\n", argv[0]);
+        return 2;
+    }
+
+    // Every copy the receiver logged
+    std::unordered_map<PacketKey, Reception, PacketKeyHash> receptions;
+    uint64_t rxRecords = 0;
+    bool ok = readCapture(paths[0], [&](uint8_t type, const uint8_t *body, size_t length)
+                          {
+        RxLogRecord record;
+        if (type != LOG_RECORD_RX || !record.decode(body, length))
+        {
+            return;
+        }
+
+        rxRecords++;
+        PacketKey key = {record.nodeId, record.sequenceNumber, record.senderTimestamp_us};
+        auto inserted = receptions.emplace(key, Reception{record, 0, false});
+        inserted.first->second.copies++; });
+    if (!ok)
+    {
+        return 1;
+    }
+
+    // Every packet the senders scheduled, with the session it was sent in
+    std::vector<TxRow> rows;
+    uint64_t completions = 0;
+    uint64_t unmatchedCompletions = 0;
+    for (size_t i = 1; i < paths.size(); i++)
+    {
+        SessionLogRecord session = unknownSession();
+
+        // Latest row for each sequence number, for the completions that follow
+        std::unordered_map<uint32_t, size_t> rowBySequence;
+
+        ok = readCapture(paths[i], [&](uint8_t type, const uint8_t *body, size_t length)
+                         {
+            if (type == LOG_RECORD_SESSION)
+            {
+                SessionLogRecord decoded;
+                if (decoded.decode(body, length))
+                {
+                    session = decoded;
+                }
+            }
+            else if (type == LOG_RECORD_TX)
+            {
+                TxRow row = {};
+                if (row.tx.decode(body, length))
+                {
+                    row.session = session;
+                    rowBySequence[row.tx.sequenceNumber] = rows.size();
+                    rows.push_back(row);
+                }
+            }
+            else if (type == LOG_RECORD_TX_DONE)
+            {
+                TxDoneLogRecord completion;
+                if (!completion.decode(body, length))
+                {
+                    return;
+                }
+
+                completions++;
+                auto found = rowBySequence.find(completion.sequenceNumber);
+                if (found == rowBySequence.end() || rows[found->second].hasCompletion)
+                {
+                    unmatchedCompletions++;
+                    return;
+                }
+                rows[found->second].hasCompletion = true;
+                rows[found->second].completion = completion;
+            } });
+        if (!ok)
+        {
+            return 1;
+        }
+    }
+
+    shareAggregateCompletions(rows);
+
+    if (header)
+    {
+        puts(CSV_HEADER);
+    }
+
+    std::map<uint16_t, NodeSummary> summaries;
+
+    // Lost packets are placed against the receiver's last known position
+    int32_t receiverLatitude_e7 = 0;
+    int32_t receiverLongitude_e7 = 0;
+
+    for (const TxRow &row : rows)
+    {
+        const TxLogRecord &tx = row.tx;
+        PacketKey key = {tx.nodeId, tx.sequenceNumber, tx.senderTimestamp_us};
+        auto found = receptions.find(key);
+        const Reception *reception = found != receptions.end() ? &found->second : nullptr;
+
+        NodeSummary &summary = summaries[tx.nodeId];
+        summary.packets++;
+
+        const char *outcome;
+        if (reception)
+        {
+            found->second.matched = true;
+            receiverLatitude_e7 = reception->first.receiverLatitude_e7;
+            receiverLongitude_e7 = reception->first.receiverLongitude_e7;
+            outcome = "received";
+            summary.received++;
+        }
+        else if (tx.result == TxLogRecord::FAILED)
+        {
+            outcome = "send_failed";
+            summary.sendFailed++;
+        }
+        else if (row.hasCompletion && !row.completion.delivered)
+        {
+            outcome = "not_acked";
+            summary.notAcked++;
+        }
+        else
+        {
+            outcome = "lost";
+            summary.lost++;
+        }
+
+        static const char *RESULTS[] = {"sent", "queued", "failed"};
+        const char *result = tx.result < 3 ? RESULTS[tx.result] : "unknown";
+
+        // Empty columns for what did not happen
+        char slot[12] = "";
+        if (row.session.sweepSlot != SessionLogRecord::NO_SLOT)
+        {
+            snprintf(slot, sizeof(slot), "%" PRIu32, row.session.sweepSlot);
+        }
+
+        char completion[48] = ",,";
+        if (row.hasCompletion)
+        {
+            snprintf(completion, sizeof(completion), "%u,%u,%" PRIu32, row.completion.delivered,
+                     row.completion.attempts, row.completion.latency_us);
+        }
+
+        char received[96] = ",,,";
+        if (reception)
+        {
+            const RxLogRecord &rx = reception->first;
+
+            // No noise floor, no SNR
+            char snr[8] = "";
+            if (rx.noiseFloor_dBm != 0)
+            {
+                snprintf(snr, sizeof(snr), "%d", rx.rssi_dBm - rx.noiseFloor_dBm);
+            }
+
+            snprintf(received, sizeof(received), "%" PRId64 ",%" PRId64 ",%d,%s", rx.receiverTimestamp_us,
+                     rx.latency_us(), rx.rssi_dBm, snr);
+        }
+
+        double txLat = tx.latitude_e7 / 1e7;
+        double txLon = tx.longitude_e7 / 1e7;
+        double rxLat = receiverLatitude_e7 / 1e7;
+        double rxLon = receiverLongitude_e7 / 1e7;
+        bool havePositions = tx.latitude_e7 != 0 && receiverLatitude_e7 != 0;
+
+        // Empty receiver position until the first packet arrives
+        char receiverPosition[32] = ",";
+        char distance[16] = "";
+        if (havePositions)
+        {
+            snprintf(receiverPosition, sizeof(receiverPosition), "%.6f,%.6f", rxLat, rxLon);
+            snprintf(distance, sizeof(distance), "%.2f", haversineDistance(rxLat, rxLon, txLat, txLon));
+        }
+
+        printf("%u,%s,%s,%" PRIu32 ",%s,%u,%u,%" PRId64 ",%" PRId64 ",%" PRId32 ",%" PRIu32 ",%u,%s,%s,%u,%s,"
+               "%.6f,%.6f,%.2f,%s,%s,%s\n",
+               tx.nodeId,
+               row.session.protocolName,
+               slot,
+               tx.sequenceNumber,
+               tx.packetType == 1 ? "echo" : "data",
+               tx.stepId,
+               tx.payloadLength,
+               tx.senderTimestamp_us,
+               tx.scheduled_us,
+               tx.sendLag_us,
+               tx.sendDuration_us,
+               tx.inFlight,
+               result,
+               completion,
+               reception ? reception->copies : 0,
+               received,
+               txLat,
+               txLon,
+               tx.altitude_mm / 1000.0f,
+               receiverPosition,
+               distance,
+               outcome);
+    }
+
+    for (const auto &entry : summaries)
+    {
+        const NodeSummary &s = entry.second;
+        fprintf(stderr, "Node %u: %" PRIu64 " packets, received %" PRIu64 " (%.2f%%), send failed %" PRIu64
+                        ", not acknowledged %" PRIu64 ", lost in the air %" PRIu64 "\n",
+                entry.first, s.packets, s.received, s.packets > 0 ? 100.0 * s.received / s.packets : 0.0,
+                s.sendFailed, s.notAcked, s.lost);
+    }
+
+    uint64_t unmatched = 0;
+    for (const auto &entry : receptions)
+    {
+        if (!entry.second.matched)
+        {
+            unmatched++;
+        }
+    }
+    fprintf(stderr, "Joined %zu sender packets with %" PRIu64 " receiver records; %" PRIu64
+                    " received packets have no sender record, %" PRIu64 " of %" PRIu64 " completions no packet\n",
+            rows.size(), rxRecords, unmatched, unmatchedCompletions, completions);
+    return 0;
+}